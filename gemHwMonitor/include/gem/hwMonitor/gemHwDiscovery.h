@@ -0,0 +1,165 @@
+/** @file gemHwDiscovery.h */
+
+#ifndef GEM_HWMONITOR_GEMHWDISCOVERY_H
+#define GEM_HWMONITOR_GEMHWDISCOVERY_H
+
+#include <stdint.h>
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "log4cplus/logger.h"
+
+#include "toolbox/task/TimerListener.h"
+#include "toolbox/task/TimerEvent.h"
+#include "toolbox/lang/Class.h"
+#include "toolbox/TimeVal.h"
+
+#include "gem/utils/Lock.h"
+#include "gem/utils/gemComplexDeviceProperties.h"
+
+namespace toolbox {
+  namespace task {
+    class Timer;
+    class WorkLoop;
+    class ActionSignature;
+  }
+}
+
+namespace gem {
+  namespace hwMonitor {
+
+    /**
+     * @class gemHwDiscovery
+     * @brief Probes the GLIBs and OptoHybrids of all configured crates in the background
+     *
+     * Every board of the configuration is a probe target, read with a single register access
+     * and a short uHAL timeout, PROBE_TIMEOUT_MSEC, so that a board which does not answer costs
+     * at most that long. The targets of a round are handed to a pool of N_WORKERS waiting
+     * workloops and probed concurrently. A round is started every PROBE_PERIOD_SEC seconds by a
+     * timer, or on demand with probe(), which returns immediately.
+     * The web pages only read the cached status of the last probe and the time it was taken.
+     * Statuses follow gemHwMonitorBase: 0 answered, 1 did not answer, 2 not probed yet.
+     */
+    class gemHwDiscovery : public toolbox::task::TimerListener, public toolbox::lang::Class
+    {
+    public:
+      static const unsigned N_WORKERS          = 8;
+      static const unsigned PROBE_TIMEOUT_MSEC = 500;
+      static const unsigned PROBE_PERIOD_SEC   = 30;
+
+      static const unsigned STATUS_OK      = 0;
+      static const unsigned STATUS_ERROR   = 1;
+      static const unsigned STATUS_UNKNOWN = 2;
+
+      typedef struct ProbeResult {
+        unsigned         status;
+        toolbox::TimeVal lastProbe;   ///< when the last probe finished, zero if never probed
+        uint64_t         probeUsec;   ///< duration of the last probe
+        std::string      error;       ///< uHAL error of the last failed probe
+      } ProbeResult;
+
+      /**
+       * @param name unique name, used to build the names of the timer and of the workloops
+       * @param addressTable uHAL address table of the boards
+       */
+      gemHwDiscovery(std::string const& name, std::string const& addressTable);
+
+      ~gemHwDiscovery();
+
+      /**
+       * @brief replace the probe targets with the GLIBs and OptoHybrids of the configuration and start a round,
+       *        results of the previous configuration still being probed are discarded
+       * @param system the configured system, only read during the call
+       */
+      void setSystemConfiguration(gem::utils::gemSystemProperties& system);
+
+      /**
+       * @brief queue a probe of every target which is not already being probed, returns immediately
+       */
+      void probe();
+
+      /**
+       * @returns the worst status of the boards of the crate, STATUS_UNKNOWN until one of them was probed
+       */
+      unsigned getCrateStatus(std::string const& crate);
+
+      /**
+       * @param oh OptoHybrid id, empty for the GLIB itself
+       * @returns the cached status of the board, STATUS_UNKNOWN if there is no such target
+       */
+      unsigned getStatus(std::string const& crate, std::string const& glib, std::string const& oh="");
+
+      /**
+       * @returns a copy of the cached result of the board, with status STATUS_UNKNOWN if there is no such target
+       */
+      ProbeResult getResult(std::string const& crate, std::string const& glib, std::string const& oh="");
+
+      /**
+       * @returns when the last probe of the crate finished, zero if none did
+       */
+      toolbox::TimeVal getLastProbe(std::string const& crate);
+
+      /**
+       * @returns whether some targets are queued or being probed
+       */
+      bool isProbing();
+
+      /**
+       * Inherited from TimerListener, starts a probe round
+       * @param event
+       */
+      virtual void timeExpired(toolbox::task::TimerEvent& event);
+
+    private:
+      // Prevent copying.
+      gemHwDiscovery(gemHwDiscovery const&);
+      gemHwDiscovery& operator=(gemHwDiscovery const&);
+
+      /**
+       * Workloop action, probes one queued target
+       * @returns false, each submission handles exactly one probe
+       */
+      bool runProbe(toolbox::task::WorkLoop* wl);
+
+      void start();
+
+      /**
+       * @brief queue every idle target, the caller must hold m_lock
+       */
+      void queueRound();
+
+      typedef struct ProbeTarget {
+        std::string crate;
+        std::string glib;
+        std::string oh;       ///< empty for the GLIB itself
+        std::string uri;
+        std::string node;     ///< register read to check that the board answers
+        bool        busy;     ///< queued or being probed
+        ProbeResult result;
+      } ProbeTarget;
+
+      ProbeTarget* findTarget(std::string const& crate, std::string const& glib, std::string const& oh);
+
+      log4cplus::Logger m_gemLogger;
+      gem::utils::Lock  m_lock;
+
+      std::string m_name;
+      std::string m_addressTable;
+      bool        m_started;
+      uint64_t    m_generation;   ///< incremented whenever the targets are replaced
+      unsigned    m_nextWorker;
+
+      std::vector<ProbeTarget> m_targets;
+      std::deque<size_t>       m_pending;
+
+      toolbox::task::Timer*                 p_timer;
+      std::string                           m_timerName;
+      toolbox::task::ActionSignature*       p_probeSig;
+      std::vector<toolbox::task::WorkLoop*> m_workers;
+    };
+  }  // namespace gem::hwMonitor
+}  // namespace gem
+
+#endif  // GEM_HWMONITOR_GEMHWDISCOVERY_H
@@ -50,12 +50,16 @@ namespace gem {
         { return m_subDeviceStatus.at(i); }
 
         /**
-         *   Set subdevice status
+         *   Set subdevice status, subdevices before i without a status are marked unknown
          *   0 - device is working well, 1 - device has errors, 2 - device status unknown
          */
         void setSubDeviceStatus (const unsigned int deviceStatus, const unsigned int i)
           throw (xgi::exception::Exception)
-        { m_subDeviceStatus.at(i) = deviceStatus; }
+        {
+          if (i >= m_subDeviceStatus.size())
+            m_subDeviceStatus.resize(i+1, 2);
+          m_subDeviceStatus.at(i) = deviceStatus;
+        }
 
         /**
          *   Add subdevice status
@@ -12,6 +12,7 @@
 
 #include "gemHwMonitorBase.h"
 #include "gemHwMonitorHelper.h"
+#include "gemHwDiscovery.h"
 
 #include "gem/hw/GEMHwDevice.h"
 #include "gem/hw/glib/HwGLIB.h"
@@ -115,6 +116,7 @@ namespace gem {
         std::vector<gemHwMonitorOH*>    m_gemHwMonitorOH;
         std::vector<gemHwMonitorVFAT*>  m_gemHwMonitorVFAT;
         gemHwMonitorHelper* p_gemSystemHelper;
+        gemHwDiscovery*     p_discovery;  ///< probes the configured boards in the background
         bool m_crateCfgAvailable;
         int m_nCrates;
         int m_indexCrate;
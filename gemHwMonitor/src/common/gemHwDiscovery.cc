@@ -0,0 +1,300 @@
+/**
+ * class: gemHwDiscovery
+ * description: Background probing of the configured GLIBs and OptoHybrids for the hardware monitor,
+ *              so that no uHAL access is made from the web handlers
+ */
+
+#include <time.h>
+
+#include <sstream>
+
+#include "gem/hwMonitor/gemHwDiscovery.h"
+
+#include "gem/utils/GEMLogging.h"
+#include "gem/utils/GEMLatencyHistogram.h"
+#include "gem/utils/LockGuard.h"
+
+#include "toolbox/string.h"
+#include "toolbox/task/Timer.h"
+#include "toolbox/task/TimerFactory.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
+#include "toolbox/task/Action.h"
+#include "toolbox/task/exception/Exception.h"
+
+#include "uhal/uhal.hpp"
+
+#include "xdaq/exception/Exception.h"
+#include "xcept/Exception.h"
+
+gem::hwMonitor::gemHwDiscovery::gemHwDiscovery(std::string const& name, std::string const& addressTable) :
+  m_gemLogger(log4cplus::Logger::getInstance("gemHwDiscovery")),
+  m_lock(toolbox::BSem::FULL, true),
+  m_name(name),
+  m_addressTable(addressTable),
+  m_started(false),
+  m_generation(0),
+  m_nextWorker(0),
+  p_timer(NULL),
+  m_timerName("urn:gem:hwMonitor:gemHwDiscovery:" + name),
+  p_probeSig(NULL)
+{
+  p_probeSig = toolbox::task::bind(this, &gemHwDiscovery::runProbe, "runProbe");
+}
+
+gem::hwMonitor::gemHwDiscovery::~gemHwDiscovery()
+{
+  if (p_timer) {
+    try {
+      p_timer->stop();
+    } catch (toolbox::task::exception::Exception& te) {
+      DEBUG("gemHwDiscovery::~gemHwDiscovery timer was not active " << te.what());
+    }
+  }
+  for (auto worker = m_workers.begin(); worker != m_workers.end(); ++worker) {
+    try {
+      (*worker)->cancel();
+    } catch (toolbox::task::exception::Exception& te) {
+      WARN("gemHwDiscovery::~gemHwDiscovery unable to cancel probe workloop " << te.what());
+    }
+  }
+}
+
+void gem::hwMonitor::gemHwDiscovery::start()
+{
+  // called with m_lock held
+  if (m_started)
+    return;
+
+  try {
+    for (unsigned worker = 0; worker < N_WORKERS; ++worker) {
+      std::string loopName = toolbox::toString("urn:toolbox-task-workloop:gemHwDiscovery:%s:worker%d",
+                                               m_name.c_str(), worker);
+      DEBUG("gemHwDiscovery::start obtaining workloop " << loopName);
+      toolbox::task::WorkLoop* loop = toolbox::task::getWorkLoopFactory()->getWorkLoop(loopName, "waiting");
+      if (!loop->isActive())
+        loop->activate();
+      m_workers.push_back(loop);
+    }
+
+    if (toolbox::task::getTimerFactory()->hasTimer(m_timerName))
+      p_timer = toolbox::task::getTimerFactory()->getTimer(m_timerName);
+    else
+      p_timer = toolbox::task::getTimerFactory()->createTimer(m_timerName);
+
+    try {
+      p_timer->stop();
+    } catch (toolbox::task::exception::NotActive const& ex) {
+      DEBUG("gemHwDiscovery::start timer was not active " << ex.what());
+    }
+    p_timer->start();
+
+    toolbox::TimeVal firstRound = toolbox::TimeVal::gettimeofday() + toolbox::TimeInterval(PROBE_PERIOD_SEC, 0);
+    p_timer->scheduleAtFixedRate(firstRound, this, toolbox::TimeInterval(PROBE_PERIOD_SEC, 0), 0, "gemHwDiscoveryRound");
+  } catch (toolbox::task::exception::Exception& te) {
+    m_workers.clear();
+    ERROR("gemHwDiscovery::start unable to set up the probe timer or workloops " << te.what());
+    XCEPT_RETHROW(xdaq::exception::Exception, "Cannot start gemHwDiscovery", te);
+  }
+
+  INFO("gemHwDiscovery::start probing every " << PROBE_PERIOD_SEC << "s with " << N_WORKERS
+       << " workers and a " << PROBE_TIMEOUT_MSEC << "ms timeout");
+  m_started = true;
+}
+
+void gem::hwMonitor::gemHwDiscovery::setSystemConfiguration(gem::utils::gemSystemProperties& system)
+{
+  std::vector<ProbeTarget> targets;
+  ProbeTarget target;
+  target.busy             = false;
+  target.result.status    = STATUS_UNKNOWN;
+  target.result.lastProbe = toolbox::TimeVal::zero();
+  target.result.probeUsec = 0;
+
+  std::vector<gem::utils::gemCrateProperties*> const& crates = system.getSubDevicesRefs();
+  for (auto crate = crates.begin(); crate != crates.end(); ++crate) {
+    target.crate = (*crate)->getDeviceId();
+    std::vector<gem::utils::gemGLIBProperties*> const& glibs = (*crate)->getSubDevicesRefs();
+    for (auto glib = glibs.begin(); glib != glibs.end(); ++glib) {
+      std::map<std::string, std::string> const& properties = (*glib)->getDeviceProperties();
+      auto ip = properties.find("IP");
+      if (ip == properties.end()) {
+        WARN("gemHwDiscovery::setSystemConfiguration no IP for " << (*glib)->getDeviceId()
+             << " in crate " << target.crate << ", not probed");
+        continue;
+      }
+      std::stringstream uri;
+      uri << "chtcp-2.0://localhost:10203?target=" << ip->second << ":50001";
+
+      target.glib = (*glib)->getDeviceId();
+      target.oh   = "";
+      target.uri  = uri.str();
+      target.node = "GLIB.SYSTEM.BOARD_ID";
+      targets.push_back(target);
+
+      // the OptoHybrids are reached through their GLIB, on the link given by their position
+      std::vector<gem::utils::gemOHProperties*> const& ohs = (*glib)->getSubDevicesRefs();
+      for (unsigned link = 0; link < ohs.size(); ++link) {
+        target.oh   = ohs.at(link)->getDeviceId();
+        target.node = toolbox::toString("GLIB.OptoHybrid_%d.OptoHybrid.STATUS.FW", link);
+        targets.push_back(target);
+      }
+    }
+  }
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  m_targets.swap(targets);
+  m_pending.clear();
+  ++m_generation;
+  INFO("gemHwDiscovery::setSystemConfiguration " << m_targets.size() << " boards to probe");
+  start();
+  queueRound();
+}
+
+void gem::hwMonitor::gemHwDiscovery::probe()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  queueRound();
+}
+
+void gem::hwMonitor::gemHwDiscovery::timeExpired(toolbox::task::TimerEvent& event)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  queueRound();
+}
+
+void gem::hwMonitor::gemHwDiscovery::queueRound()
+{
+  if (m_workers.empty())
+    return;
+
+  for (size_t index = 0; index < m_targets.size(); ++index) {
+    if (m_targets[index].busy)
+      continue;  // a board that is still timing out is not queued a second time
+    m_targets[index].busy = true;
+    m_pending.push_back(index);
+    try {
+      m_workers.at(m_nextWorker)->submit(p_probeSig);
+      m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+    } catch (toolbox::task::exception::Exception const& te) {
+      ERROR("gemHwDiscovery::queueRound unable to submit the probe of " << m_targets[index].uri
+            << " " << te.what());
+      m_pending.pop_back();
+      m_targets[index].busy = false;
+    }
+  }
+}
+
+bool gem::hwMonitor::gemHwDiscovery::runProbe(toolbox::task::WorkLoop* wl)
+{
+  size_t      index;
+  uint64_t    generation;
+  std::string uri, node;
+
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+    if (m_pending.empty())
+      return false;
+    index = m_pending.front();
+    m_pending.pop_front();
+    generation = m_generation;
+    uri  = m_targets.at(index).uri;
+    node = m_targets.at(index).node;
+  }
+
+  unsigned    status = STATUS_ERROR;
+  std::string error;
+  timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  try {
+    uhal::HwInterface hw = uhal::ConnectionManager::getDevice(m_name, uri, m_addressTable);
+    hw.setTimeoutPeriod(PROBE_TIMEOUT_MSEC);
+    uhal::ValWord<uint32_t> val = hw.getNode(node).read();
+    hw.dispatch();
+    DEBUG("gemHwDiscovery::runProbe " << uri << " " << node << " = 0x" << std::hex << val.value() << std::dec);
+    status = STATUS_OK;
+  } catch (uhal::exception::exception const& ex) {
+    error = ex.what();
+  } catch (std::exception const& ex) {
+    error = ex.what();
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  if (generation != m_generation)
+    return false;  // the configuration changed while probing
+
+  ProbeTarget& target = m_targets.at(index);
+  if (status != target.result.status && target.result.status != STATUS_UNKNOWN)
+    WARN("gemHwDiscovery::runProbe " << target.crate << "/" << target.glib
+         << (target.oh.empty() ? "" : "/") << target.oh << " at " << uri
+         << (status == STATUS_OK ? " answers again" : " stopped answering: ") << error);
+  target.busy             = false;
+  target.result.status    = status;
+  target.result.lastProbe = toolbox::TimeVal::gettimeofday();
+  target.result.probeUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+  target.result.error     = error;
+  return false;
+}
+
+gem::hwMonitor::gemHwDiscovery::ProbeTarget* gem::hwMonitor::gemHwDiscovery::findTarget(std::string const& crate,
+                                                                                        std::string const& glib,
+                                                                                        std::string const& oh)
+{
+  for (auto target = m_targets.begin(); target != m_targets.end(); ++target)
+    if (target->crate == crate && target->glib == glib && target->oh == oh)
+      return &(*target);
+  return NULL;
+}
+
+unsigned gem::hwMonitor::gemHwDiscovery::getCrateStatus(std::string const& crate)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  unsigned status = STATUS_UNKNOWN;
+  for (auto target = m_targets.begin(); target != m_targets.end(); ++target) {
+    if (target->crate != crate || target->result.status == STATUS_UNKNOWN)
+      continue;
+    if (status == STATUS_UNKNOWN || target->result.status == STATUS_ERROR)
+      status = target->result.status;
+  }
+  return status;
+}
+
+unsigned gem::hwMonitor::gemHwDiscovery::getStatus(std::string const& crate, std::string const& glib,
+                                                   std::string const& oh)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  ProbeTarget* target = findTarget(crate, glib, oh);
+  return target ? target->result.status : STATUS_UNKNOWN;
+}
+
+gem::hwMonitor::gemHwDiscovery::ProbeResult gem::hwMonitor::gemHwDiscovery::getResult(std::string const& crate,
+                                                                                     std::string const& glib,
+                                                                                     std::string const& oh)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  ProbeTarget* target = findTarget(crate, glib, oh);
+  if (target)
+    return target->result;
+  ProbeResult none = {STATUS_UNKNOWN, toolbox::TimeVal::zero(), 0, ""};
+  return none;
+}
+
+toolbox::TimeVal gem::hwMonitor::gemHwDiscovery::getLastProbe(std::string const& crate)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  toolbox::TimeVal last = toolbox::TimeVal::zero();
+  for (auto target = m_targets.begin(); target != m_targets.end(); ++target)
+    if (target->crate == crate && target->result.lastProbe > last)
+      last = target->result.lastProbe;
+  return last;
+}
+
+bool gem::hwMonitor::gemHwDiscovery::isProbing()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  for (auto target = m_targets.begin(); target != m_targets.end(); ++target)
+    if (target->busy)
+      return true;
+  return false;
+}
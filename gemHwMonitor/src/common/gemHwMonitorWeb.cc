@@ -32,11 +32,14 @@ gem::hwMonitor::gemHwMonitorWeb::gemHwMonitorWeb(xdaq::ApplicationStub* s)
   // m_gemHwMonitorOH = new gemHwMonitorOH();
   // m_gemHwMonitorVFAT = new gemHwMonitorVFAT();
   p_gemSystemHelper = new gemHwMonitorHelper(m_gemHwMonitorSystem);
+  p_discovery = new gemHwDiscovery(toolbox::toString("lid%d", getApplicationDescriptor()->getLocalId()),
+                                   "file://${GEM_ADDRESS_TABLE_PATH}/glib_address_table.xml");
   m_crateCfgAvailable = false;
 }
 
 gem::hwMonitor::gemHwMonitorWeb::~gemHwMonitorWeb()
 {
+  delete p_discovery;
   delete m_gemHwMonitorSystem;
   // delete m_gemHwMonitorCrate;
   for_each(m_gemHwMonitorCrate.begin(), m_gemHwMonitorCrate.end(), free);
@@ -59,23 +62,8 @@ void gem::hwMonitor::gemHwMonitorWeb::pingCrate(xgi::Input* in, xgi::Output* out
 
   throw (xgi::exception::Exception)
 {
-  cgicc::Cgicc cgi(in);
-  for (unsigned i = 0; i != m_gemHwMonitorSystem->getDevice()->getSubDevicesRefs().size(); ++i) {
-    if (cgi.queryCheckbox(m_gemHwMonitorSystem->getDevice()->getSubDevicesRefs().at(i)->getDeviceId())) {
-      //            // gem::hw::GEMHwDevice* crateDevice_ = new gem::hw::GEMHwDevice();
-      // this really needs to go
-      std::stringstream tmpURI;
-      tmpURI << "chtcp-2.0://localhost:10203?target=" << "192.168.0.170" << ":50001";
-      vfat_shared_ptr crateDevice_(new gem::hw::vfat::HwVFAT2("VFAT0", tmpURI.str(),
-                                                              "file://${GEM_ADDRESS_TABLE_PATH}/glib_address_table.xml"));
-      if (crateDevice_->isHwConnected()) {
-        m_gemHwMonitorSystem->setSubDeviceStatus(0, i);
-      } else {
-        m_gemHwMonitorSystem->setSubDeviceStatus(1, i);
-      }
-      // delete crateDevice_;
-    }
-  }
+  // the boards are probed by the discovery workers, the page shows the cached results
+  p_discovery->probe();
   this->controlPanel(in, out);
 }
 
@@ -227,6 +215,7 @@ void gem::hwMonitor::gemHwMonitorWeb::showCratesAvailability(xgi::Input* in, xgi
     for (int i = 0; i < m_nCrates; ++i) {
       std::string currentCrateID;
       currentCrateID += m_gemHwMonitorSystem->getCurrentSubDeviceId(i);
+      m_gemHwMonitorSystem->setSubDeviceStatus(p_discovery->getCrateStatus(currentCrateID), i);
       *out << cgicc::td();
       *out << cgicc::form().set("method", "POST").set("action", methodExpandCrate) << std::endl ;
       if (m_gemHwMonitorSystem->getSubDeviceStatus(i) == 0) {
@@ -244,19 +233,25 @@ void gem::hwMonitor::gemHwMonitorWeb::showCratesAvailability(xgi::Input* in, xgi
     }
     *out << cgicc::tr();
     *out << cgicc::tr();
-    *out << cgicc::form().set("method", "GET").set("action", methodPingCrate) << std::endl ;
     for (int i = 0; i < m_nCrates; ++i) {
       std::string currentCrateID;
       currentCrateID += m_gemHwMonitorSystem->getCurrentSubDeviceId(i);
+      toolbox::TimeVal lastProbe = p_discovery->getLastProbe(currentCrateID);
       *out << cgicc::td();
-      *out << "<div align=\"center\">" << cgicc::input().set("type", "checkbox").set("name", currentCrateID)
-           << "</div>" << std::endl;
+      *out << "<div align=\"center\"><small>"
+           << (lastProbe == toolbox::TimeVal::zero() ? "not probed yet" :
+               "probed " + lastProbe.toString("%Y-%m-%d %H:%M:%S", toolbox::TimeVal::loc))
+           << "</small></div>" << std::endl;
       *out << cgicc::td();
     }
     *out << cgicc::tr();
     *out << cgicc::table();
+    if (p_discovery->isProbing())
+      *out << "<h5><div class=\"alert alert-info\" align=\"center\" role=\"alert\">"
+           << "Probe in progress, reload the page to see the results</div></h5>" << std::endl;
+    *out << cgicc::form().set("method", "GET").set("action", methodPingCrate) << std::endl ;
     *out << "<button type=\"submit\" class=\"btn btn-primary\">"
-         << "Check availability of selected crates</button>" << std::endl;
+         << "Check availability of all crates now</button>" << std::endl;
     *out << cgicc::form();
     *out << "</div>" << std::endl;
     *out << cgicc::br();
@@ -318,6 +313,7 @@ void gem::hwMonitor::gemHwMonitorWeb::getCratesConfiguration(xgi::Input* in, xgi
 {
   p_gemSystemHelper->configure();
   std::cout << "Configured." << std::endl;
+  p_discovery->setSystemConfiguration(*m_gemHwMonitorSystem->getDevice());
   m_crateCfgAvailable = true;
   m_nCrates = m_gemHwMonitorSystem->getNumberOfSubDevices();
   // continuously redefining the variable 'i' is bad form, though maybe this is the point of the compiler comment below
@@ -395,21 +391,11 @@ void gem::hwMonitor::gemHwMonitorWeb::expandCrate(xgi::Input* in, xgi::Output* o
       m_indexCrate = i;
       for (int i = 0; i < m_gemHwMonitorCrate.at(m_indexCrate)->getNumberOfSubDevices(); ++i) {
         m_gemHwMonitorGLIB.at(i)->setDeviceConfiguration(*m_gemHwMonitorCrate.at(m_indexCrate)->getDevice()->getSubDevicesRefs().at(i));
-        std::map <std::string, std::string> glibProperties_;
-        glibProperties_ = m_gemHwMonitorGLIB.at(i)->getDevice()->getDeviceProperties();
-        for (auto it = glibProperties_.begin(); it != glibProperties_.end(); ++it) {
-          if (it->first == "IP") m_glibIP = it->second;
-          std::cout << "property: " << it->first << " - GLIB IP is " << m_glibIP << std::endl;
-        }
-        std::stringstream tmpURI;
-        tmpURI << "chtcp-2.0://localhost:10203?target=" << m_glibIP << ":50001";
-        p_glibDevice = glib_shared_ptr(new gem::hw::glib::HwGLIB("HwGLIB", tmpURI.str(),
-                                                                "file://${GEM_ADDRESS_TABLE_PATH}/glib_address_table.xml"));
-        if (p_glibDevice->isHwConnected())
-          {
-            m_gemHwMonitorCrate.at(m_indexCrate)->addSubDeviceStatus(0);
-          } else {
-          m_gemHwMonitorCrate.at(m_indexCrate)->addSubDeviceStatus(2);
+        std::string glibID = m_gemHwMonitorCrate.at(m_indexCrate)->getCurrentSubDeviceId(i);
+        if (p_discovery->getStatus(m_crateToShow, glibID) == gemHwDiscovery::STATUS_OK) {
+          m_gemHwMonitorCrate.at(m_indexCrate)->setSubDeviceStatus(0, i);
+        } else {
+          m_gemHwMonitorCrate.at(m_indexCrate)->setSubDeviceStatus(2, i);
         }
       }
     }
@@ -479,24 +465,11 @@ void gem::hwMonitor::gemHwMonitorWeb::expandGLIB(xgi::Input* in, xgi::Output* ou
     if (m_gemHwMonitorCrate.at(m_indexCrate)->getDevice()->getSubDevicesRefs().at(i)->getDeviceId() == m_glibToShow) {
       m_indexGLIB = i;
       for (int i = 0; i < m_gemHwMonitorGLIB.at(m_indexGLIB)->getNumberOfSubDevices(); ++i) {
-        std::map <std::string, std::string> glibProperties_;
-        glibProperties_ = m_gemHwMonitorGLIB.at(m_indexGLIB)->getDevice()->getDeviceProperties();
-        std::string ohIP = "";
-        for (auto it = glibProperties_.begin(); it != glibProperties_.end(); ++it) {
-          if (it->first == "IP") ohIP = it->second;
-          std::cout << "property: " << it->first << " - OH IP is " << ohIP << std::endl;
-        }
-        // this needs to come from the xml config somehow
-        int ohGTX = 0;
-        std::string currentOHId = toolbox::toString("HwOptoHybrid_%d", ohGTX);
-        std::stringstream tmpURI;
-        tmpURI << "chtcp-2.0://localhost:10203?target=" << ohIP << ":50001";
-        p_ohDevice = optohybrid_shared_ptr(new gem::hw::optohybrid::HwOptoHybrid(currentOHId, tmpURI.str(),
-                                                                                "file://${GEM_ADDRESS_TABLE_PATH}/glib_address_table.xml"));
-        if (p_ohDevice->isHwConnected()) {
-          m_gemHwMonitorGLIB.at(m_indexGLIB)->addSubDeviceStatus(0);
+        std::string ohID = m_gemHwMonitorGLIB.at(m_indexGLIB)->getCurrentSubDeviceId(i);
+        if (p_discovery->getStatus(m_crateToShow, m_glibToShow, ohID) == gemHwDiscovery::STATUS_OK) {
+          m_gemHwMonitorGLIB.at(m_indexGLIB)->setSubDeviceStatus(0, i);
         } else {
-          m_gemHwMonitorGLIB.at(m_indexGLIB)->addSubDeviceStatus(2);
+          m_gemHwMonitorGLIB.at(m_indexGLIB)->setSubDeviceStatus(2, i);
         }
       }
     }
@@ -535,6 +508,8 @@ void gem::hwMonitor::gemHwMonitorWeb::glibPanel(xgi::Input* in, xgi::Output* out
   tmpURI << "chtcp-2.0://localhost:10203?target=" << m_glibIP << ":50001";
   p_glibDevice = glib_shared_ptr(new gem::hw::glib::HwGLIB("HwGLIB", tmpURI.str(),
                                                           "file://${GEM_ADDRESS_TABLE_PATH}/glib_address_table.xml"));
+  // link counters and addresses shown below are read together in one transaction
+  gem::hw::glib::HwGLIB::GLIBStatusSnapshot glibStatus = p_glibDevice->getStatusSnapshot();
 
   *out << "<div class=\"panel panel-primary\">" << std::endl;
   *out << "<div class=\"panel-heading\">"       << std::endl;
@@ -571,7 +546,11 @@ void gem::hwMonitor::gemHwMonitorWeb::glibPanel(xgi::Input* in, xgi::Output* out
   *out << "</tr>" << std::endl;
   *out << cgicc::table() <<std::endl;
 
-  gem::hw::GEMHwDevice::OpticalLinkStatus linkStatus_;
+  if (glibStatus.valid)
+    *out << "<p>Status read at " << glibStatus.timestamp.toString("%Y-%m-%d %H:%M:%S", toolbox::TimeVal::loc)
+         << " in " << glibStatus.readUsec << " us</p>" << std::endl;
+  else
+    *out << "<div class=\"alert alert-danger\" role=\"alert\">Unable to read the GLIB status</div>" << std::endl;
 
   // moved table header outside the loop
   *out << cgicc::table().set("class", "table");
@@ -591,7 +570,7 @@ void gem::hwMonitor::gemHwMonitorWeb::glibPanel(xgi::Input* in, xgi::Output* out
   *out << "</tr>" << std::endl;
 
   for (uint8_t i = 0; i < gem::hw::glib::HwGLIB::N_GTX; ++i) {
-    linkStatus_ = p_glibDevice->LinkStatus(i);
+    gem::hw::GEMHwDevice::OpticalLinkStatus const& linkStatus_ = glibStatus.gtx[i].link;
     *out << "<tr>" << std::endl;
     *out << "<td>" << std::endl;
     *out << static_cast<int>(i) << std::endl;
@@ -617,7 +596,7 @@ void gem::hwMonitor::gemHwMonitorWeb::glibPanel(xgi::Input* in, xgi::Output* out
   *out << "Device IP" << std::endl;
   *out << "</td>" << std::endl;
   *out << "<td>" << std::endl;
-  *out << p_glibDevice->getIPAddress() << std::endl;
+  *out << gem::utils::uint32ToDottedQuad(glibStatus.ipAddress) << std::endl;
   *out << "</td>" << std::endl;
   *out << "</td>" << std::endl;
   *out << "</tr>" << std::endl;
@@ -626,7 +605,7 @@ void gem::hwMonitor::gemHwMonitorWeb::glibPanel(xgi::Input* in, xgi::Output* out
   *out << "Device MAC address" << std::endl;
   *out << "</td>" << std::endl;
   *out << "<td>" << std::endl;
-  *out << p_glibDevice->getMACAddress() << std::endl;
+  *out << gem::utils::uint32ToGroupedHex(glibStatus.macUpper, glibStatus.macLower) << std::endl;
   *out << "</td>" << std::endl;
   *out << "</td>" << std::endl;
   *out << "</tr>" << std::endl;
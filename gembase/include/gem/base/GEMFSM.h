@@ -3,8 +3,10 @@
 #ifndef GEM_BASE_GEMFSM_H
 #define GEM_BASE_GEMFSM_H
 
+#include <deque>
 #include <map>
 #include <string>
+#include <utility>
 
 #include "log4cplus/logger.h"
 
@@ -19,6 +21,7 @@
 #include "xoap/MessageReference.h"
 
 #include "gem/base/GEMState.h"
+#include "gem/utils/Lock.h"
 
 //Basic implementation copied from TCDS code
 
@@ -26,6 +29,14 @@ namespace toolbox {
   namespace fsm {
     class AsynchronousFiniteStateMachine;
   }
+  namespace task {
+    class WorkLoop;
+    class ActionSignature;
+  }
+}
+
+namespace xdaq {
+  class ApplicationDescriptor;
 }
 
 namespace gem {
@@ -53,6 +64,13 @@ namespace gem {
          */
         xoap::MessageReference changeState(xoap::MessageReference msg);
 
+        /**
+         * @brief Fires the FSM event for a command that has already been extracted from a SOAP message
+         * @param commandName name of the FSM command
+         * @returns the SOAP reply carrying the new state, or a fault reply
+         */
+        xoap::MessageReference changeState(std::string const& commandName);
+
         /**
          * @brief
          */
@@ -95,6 +113,19 @@ namespace gem {
          */
         void invalidAction(toolbox::Event::Reference event);
 
+        /**
+         * @brief Queues the current state for the GEMSupervisor, so that it does not need to poll for it
+         *        The SOAP message is posted from the notification workloop, never from the FSM thread
+         * @param stateName the new state of the application
+         */
+        void notifySupervisor(std::string const& stateName);
+
+        /**
+         * @brief Workloop action posting the oldest queued state to the GEMSupervisor
+         *        Failures are logged only, the application does not depend on a supervisor being present
+         */
+        bool sendStateNotification(toolbox::task::WorkLoop* wl);
+
       private:
         toolbox::fsm::AsynchronousFiniteStateMachine* p_gemfsm;
         xdata::InfoSpace *p_appInfoSpace;
@@ -104,6 +135,14 @@ namespace gem {
         xdata::String m_reasonForFailure;
 
         GEMFSMApplication* p_gemApp;
+        xdaq::ApplicationDescriptor* p_supervisorDescriptor;  // looked up on the first state notification
+
+        typedef std::pair<std::string, std::string> StateNotification;  // state name, reason for failure
+        gem::utils::Lock                 m_notifyLock;
+        std::deque<StateNotification>    m_pendingNotifications;
+        std::string                      m_notifyLoopName;
+        toolbox::task::WorkLoop*         p_notifyLoop;
+        toolbox::task::ActionSignature*  p_notifySig;
         log4cplus::Logger m_gemLogger;
         std::map<std::string, std::string> m_lookupMap;
       };
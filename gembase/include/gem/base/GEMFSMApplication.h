@@ -7,6 +7,7 @@
 
 #include "gem/base/GEMApplication.h"
 #include "gem/base/GEMFSM.h"
+#include "gem/base/utils/exception/Exception.h"
 
 #include "gem/utils/Lock.h"
 #include "gem/utils/LockGuard.h"
@@ -252,6 +253,25 @@ namespace gem {
        */
       virtual xoap::MessageReference changeState(xoap::MessageReference msg);
 
+      /**
+       * @brief changeStateWithParameters
+       * Applies the run parameters carried by a TransitionWithParameters message,
+       * then forwards the command to the GEMFSM object
+       * @param xoap::MessageReference msg message containing the parameters and the state transition
+       * @returns xoap::MessageReference response of the SOAP transaction
+       */
+      virtual xoap::MessageReference changeStateWithParameters(xoap::MessageReference msg);
+
+      /**
+       * @brief applyParameters
+       * Sets a list of application infospace items in one step, all values are parsed before any item
+       * is modified, so either all of the parameters are applied, or none of them
+       * @param parameters vector of parameters, each contaning the item name, value, and xsd type,
+       *        fields of a bag item are named as <bag name>.<field name>
+       */
+      void applyParameters(std::vector<std::vector<std::string> > const& parameters)
+        throw (gem::base::utils::exception::ValueError);
+
       std::string workLoopName;
 
       toolbox::task::ActionSignature* initSig_  ;  ///<
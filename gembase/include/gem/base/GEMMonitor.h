@@ -3,19 +3,19 @@
 #ifndef GEM_BASE_GEMMONITOR_H
 #define GEM_BASE_GEMMONITOR_H
 
+#include <stdint.h>
+
 #include <string>
 #include <unordered_map>
 #include <utility>
 #include <vector>
 #include <list>
+#include <memory>
 
 #include "log4cplus/logger.h"
 
 #include "xdaq/Application.h"
 #include "xdaq/ApplicationStub.h"
-#include "toolbox/task/TimerFactory.h"
-#include "toolbox/task/TimerListener.h"
-#include "toolbox/task/TimerEvent.h"
 #include "toolbox/lang/Class.h"
 #include "toolbox/TimeVal.h"
 #include "toolbox/TimeInterval.h"
@@ -23,12 +23,7 @@
 #include "cgicc/HTMLClasses.h"
 
 #include "gem/base/utils/GEMInfoSpaceToolBox.h"
-
-namespace toolbox {
-  namespace task {
-    class Timer;
-  }
-}
+#include "gem/utils/Lock.h"
 
 namespace xdata {
   class InfoSpace;
@@ -49,7 +44,7 @@ namespace gem {
       class GEMInfoSpaceToolBox;
     }
 
-    class GEMMonitor : public toolbox::task::TimerListener, public toolbox::lang::Class
+    class GEMMonitor : public toolbox::lang::Class
       {
       public:
         /**
@@ -76,20 +71,31 @@ namespace gem {
 
         /**
          * Destructor
-         *
+         * Derived classes must call stopMonitoring() in their own destructor, the scheduler may
+         * otherwise still run an update on the partially destroyed object
          */
         virtual ~GEMMonitor();
 
         /**
-         * Start the monitoring
+         * Start the monitoring, registers the monitor with the shared GEMMonitorScheduler
+         * at the shortest interval of the monitored info spaces, each info space is then
+         * refreshed at its own interval, see isSetDue
          */
         void startMonitoring();
 
         /**
-         * Stop the monitoring
+         * Stop the monitoring, returns once any running update of this monitor has finished,
+         * so the monitor can be destroyed right after
          */
         void stopMonitoring();
 
+        /**
+         * Monitors returning the same group are never updated concurrently by the scheduler,
+         * hardware monitors should return a key identifying the board they talk to
+         * @returns the key used to group this monitor with others in the GEMMonitorScheduler
+         */
+        virtual std::string getSchedulerGroup() const { return m_monitorName; };
+
         /**
          * Setup the basic monitoring for all GEMApplications, can be further reimplemented in derived
          * classes, provided the first call is to the base implementation (which will happen in the constructor
@@ -97,12 +103,6 @@ namespace gem {
          */
         virtual void setupMonitoring(bool isFSMApp);
 
-        /**
-         * Inherited from TimerListener, must be implemented
-         * @param event
-         */
-        virtual void timeExpired(toolbox::task::TimerEvent& event);
-
         /**
          * Update method, pure virtual, must be implemented in specific monitor class
          * Should perform all actions to update any values stored in the monitor info space
@@ -160,9 +160,67 @@ namespace gem {
          * @param out is the output xgi page
          */
         void jsonUpdateItemSet(   std::string const& setname, std::ostream *out);
-        void jsonUpdateItemSets(  xgi::Output *out);
         void jsonUpdateInfoSpaces(xgi::Output *out);
 
+        /**
+         * Writes the item sets from the snapshot taken at the end of the last update cycle,
+         * no info space is touched while serving the request
+         * @param out is the output xgi page
+         * @param since if non-zero, only the items that changed after this sequence number are written,
+         *        the full document is written instead if since is newer than the last published sequence
+         *        number, or if items were removed or reordered after since
+         * @returns true if anything was written, i.e., the caller needs a separator before further entries
+         */
+        bool jsonUpdateItemSets(std::ostream *out, uint64_t const& since=0);
+
+        /**
+         * Serialises the current values of all monitorables into the snapshot served by jsonUpdateItemSets,
+         * items whose formatted value differs from the previous snapshot are tagged with a new sequence number
+         */
+        void updateJSONSnapshot();
+
+        /**
+         * One monitoring cycle of this monitor alone, updateMonitorables followed by updateJSONSnapshot
+         */
+        void runUpdateCycle();
+
+        typedef std::vector<std::pair<std::pair<uint32_t, uint32_t>, uint32_t> > RegisterReadList;
+
+        /**
+         * Register based monitors take part in the combined update of their scheduler group:
+         * each due monitor of the group appends the registers (address, mask) it needs to a shared list,
+         * the first one reads the whole list in a single transaction with readRegisters,
+         * and each monitor then publishes its part with publishRegisterReads
+         * @returns false if the monitor does not read registers, updateMonitorables is then called instead
+         */
+        virtual bool collectRegisterReads(RegisterReadList& regs) { return false; };
+
+        /**
+         * @returns false if the registers could not be read, their values are then undefined
+         */
+        virtual bool readRegisters(RegisterReadList& regs) { return false; };
+
+        /**
+         * @param regs the list filled by collectRegisterReads and read by readRegisters
+         * @param valid false if the read failed, the previous values are then kept and flagged stale
+         */
+        virtual void publishRegisterReads(RegisterReadList const& regs, bool const& valid) {};
+
+        /**
+         * Called by the scheduler around each cycle, decides which info spaces are due,
+         * beginUpdateCycle takes the update lock of the monitor and endUpdateCycle releases it
+         * after taking the JSON snapshot
+         */
+        void beginUpdateCycle();
+        void endUpdateCycle();
+
+        /**
+         * Every change published by any monitor before this call has a sequence number no larger than the
+         * returned one, so a client passing it back as since will not miss any update
+         * @returns the sequence number of the last published snapshot in this process
+         */
+        static uint64_t getJSONSequence();
+
         /**
          * Takes care of cleaning up the monitor after a reset
          * should empty all lists and maps of known items
@@ -175,9 +233,47 @@ namespace gem {
           std::shared_ptr<gem::base::utils::GEMInfoSpaceToolBox> infoSpace;
           utils::GEMInfoSpaceToolBox::UpdateType updatetype;
           std::string format;
+          // resolved on first use by setMonitorableValues
+          utils::GEMInfoSpaceToolBox::UInt32Handle uint32Handle;
+          utils::GEMInfoSpaceToolBox::UInt64Handle uint64Handle;
         } GEMMonitorable;
 
+        typedef struct {
+          std::string id;     // element id on the web page, "<infospace>-<item>"
+          std::string value;  // json escaped formatted value
+          bool        stale;  // the last read of the value failed
+          uint64_t    changed;
+        } JSONItem;
+
+        typedef std::vector<std::pair<std::string, std::vector<JSONItem> > > JSONSnapshot;
+
       protected:
+        /**
+         * Reads and publishes the registers of this monitor alone, for updateMonitorables of register based monitors
+         */
+        void updateRegisterMonitorables();
+
+        /**
+         * Outside of a scheduled cycle, e.g., when updateMonitorables is called directly, every set is due
+         * @returns whether the info space holding the set is due for an update in this cycle
+         */
+        bool isSetDue(std::string const& setname) const;
+
+        /**
+         * @brief flags the values of the set as not refreshed by the last update, shown as such on the web pages
+         */
+        void setStale(std::string const& setname, bool const& stale);
+
+        /**
+         * Publishes the values read in an update cycle, the monitorables belonging to infoSpace are
+         * written through cached item handles under a single lock, with one change notification
+         * @param infoSpace the toolbox holding (most of) the monitorables
+         * @param values the monitorables and the value read for each, HW64 and I2CSTAT items
+         *        are stored as 64-bit values, all others as 32-bit values
+         */
+        void setMonitorableValues(std::shared_ptr<utils::GEMInfoSpaceToolBox> infoSpace,
+                                  std::vector<std::pair<GEMMonitorable*, uint64_t> > const& values);
+
         // map between infoSpaceName and info space toolbox plus update interval
         std::unordered_map<std::string,
           std::pair<std::shared_ptr<gem::base::utils::GEMInfoSpaceToolBox>,
@@ -199,10 +295,24 @@ namespace gem {
         //  std::shared_ptr<GEMFSM>         p_gemFSM;
 
         log4cplus::Logger m_gemLogger;
-        toolbox::task::Timer* p_timer;    // timer for general info space updates
-        std::string m_timerName;
-        toolbox::task::Timer* m_hwtimer;  // time for hw updates
-        std::string m_hwTimerName;
+        std::string m_monitorName;
+
+      private:
+        // held for a whole update cycle, so a direct update never interleaves with a scheduled one
+        gem::utils::Lock m_updateLock;
+        bool             m_inCycle;
+        // per info space name, when it is next due (CLOCK_MONOTONIC, usec) and whether it is due in this cycle
+        std::unordered_map<std::string, uint64_t> m_infoSpaceNextUpdate;
+        std::unordered_map<std::string, bool>     m_infoSpaceDue;
+        std::unordered_map<std::string, bool>     m_staleSets;
+
+        // published by the update cycle, read by the web threads, both swapped under s_jsonLock
+        std::shared_ptr<JSONSnapshot const> p_jsonSnapshot;
+        std::shared_ptr<std::string const>  p_jsonItemSets;
+        uint64_t                            m_jsonLayoutSequence;  ///< snapshot in which the item list last changed
+
+        static gem::utils::Lock s_jsonLock;
+        static uint64_t         s_jsonSequence;
       };
   }  // namespace gem::base
 }  // namespace gem
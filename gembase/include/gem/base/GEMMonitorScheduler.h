@@ -0,0 +1,161 @@
+/** @file GEMMonitorScheduler.h */
+
+#ifndef GEM_BASE_GEMMONITORSCHEDULER_H
+#define GEM_BASE_GEMMONITORSCHEDULER_H
+
+#include <time.h>
+#include <pthread.h>
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+
+#include "log4cplus/logger.h"
+
+#include "toolbox/task/TimerListener.h"
+#include "toolbox/task/TimerEvent.h"
+#include "toolbox/lang/Class.h"
+#include "toolbox/TimeInterval.h"
+
+#include "gem/utils/Lock.h"
+#include "gem/utils/GEMLatencyHistogram.h"
+
+namespace toolbox {
+  namespace task {
+    class Timer;
+    class WorkLoop;
+    class ActionSignature;
+  }
+}
+
+namespace gem {
+  namespace base {
+
+    class GEMMonitor;
+
+    /**
+     * @class GEMMonitorScheduler
+     * @brief Process wide scheduler driving the periodic updates of every GEMMonitor
+     *
+     * A single timer ticks every TICK_MSEC milliseconds and hands the update cycles that are due
+     * to a bounded pool of N_WORKERS waiting workloops, so the number of monitoring threads no longer
+     * grows with the number of monitors.
+     * Monitors registered with the same group key (e.g., the uHAL URI of the board they read from)
+     * are run back to back in a single job, so they never compete with each other for the hardware.
+     * Each group gets a phase offset of PHASE_STRIDE_TICKS times its registration index, so that
+     * groups with the same interval do not all wake up on the same tick.
+     * Cycles that start more than a tick late, and cycles that are still queued or running when
+     * the next one is due, are counted and reported.
+     * Within a group, the registers of all due monitors implementing GEMMonitor::collectRegisterReads
+     * are read in one transaction.
+     */
+    class GEMMonitorScheduler : public toolbox::task::TimerListener, public toolbox::lang::Class
+    {
+    public:
+      static const unsigned TICK_MSEC          = 250;
+      static const unsigned N_WORKERS          = 4;
+      static const unsigned PHASE_STRIDE_TICKS = 3;
+      static const unsigned REPORT_EVERY       = 100;
+      static const unsigned REMOVE_WARN_MSEC   = 10000;
+
+      /**
+       * @returns the scheduler shared by all monitors in this process
+       */
+      static GEMMonitorScheduler* getInstance();
+
+      /**
+       * @brief register a monitor, or update the settings of an already registered one
+       * @param monitor the monitor whose updateMonitorables() will be called
+       * @param group key identifying the device the monitor talks to,
+       *        monitors in the same group are never run concurrently
+       * @param interval the interval between successive updates of this monitor
+       */
+      void addMonitor(GEMMonitor* monitor, std::string const& group, toolbox::TimeInterval const& interval);
+
+      /**
+       * @brief remove a monitor from the schedule,
+       *        returns once no update cycle for its group is running on another thread,
+       *        however long that takes, warning every REMOVE_WARN_MSEC while it waits
+       * Called from an update cycle of the same group, e.g., by the monitor's own update,
+       * the monitor is skipped for the rest of the cycle and the call returns immediately
+       * @param monitor the monitor to remove
+       */
+      void removeMonitor(GEMMonitor* monitor);
+
+      /**
+       * Inherited from TimerListener, decides which groups are due and queues them to the workers
+       * @param event
+       */
+      virtual void timeExpired(toolbox::task::TimerEvent& event);
+
+      /**
+       * @returns a human readable summary of the cycle counts, late and overrun cycles per group
+       */
+      std::string getStatistics();
+
+    private:
+      GEMMonitorScheduler();
+      ~GEMMonitorScheduler();
+
+      // Prevent copying.
+      GEMMonitorScheduler(GEMMonitorScheduler const&);
+      GEMMonitorScheduler& operator=(GEMMonitorScheduler const&);
+
+      /**
+       * Workloop action, runs the update cycle of one queued group
+       * @returns false, each submission handles exactly one job
+       */
+      bool runCycle(toolbox::task::WorkLoop* wl);
+
+      /**
+       * @returns whether monitor is still scheduled in group, must be called with m_lock held
+       */
+      bool isScheduled(GEMMonitor* monitor, std::string const& group) const;
+
+      void start();
+
+      typedef struct {
+        GEMMonitor* monitor;
+        uint64_t    periodTicks;
+        uint64_t    nextTick;
+        bool        due;
+        bool        removed;  // removed while its group was running, dropped at the end of the cycle
+      } MonitorEntry;
+
+      typedef struct {
+        std::vector<MonitorEntry> entries;
+        uint64_t phase;
+        bool     busy;      // a cycle is queued or running
+        bool      running;  // a cycle is running on runner
+        pthread_t runner;
+        timespec dueTime;   // when the queued cycle was due
+        uint64_t dueUsec;   // shortest interval of the monitors in the queued cycle
+        uint64_t cycles;
+        uint64_t late;
+        uint64_t overruns;
+        uint64_t skipped;
+        gem::utils::GEMLatencyHistogram cycleTime;
+      } MonitorGroup;
+
+      log4cplus::Logger m_gemLogger;
+      gem::utils::Lock  m_lock;
+
+      bool     m_started;
+      uint64_t m_tick;
+      uint64_t m_nGroupsAdded;
+      unsigned m_nextWorker;
+
+      std::unordered_map<std::string, MonitorGroup> m_groups;
+      std::unordered_map<GEMMonitor*, std::string>  m_monitorGroups;
+      std::deque<std::string>                       m_pending;
+
+      toolbox::task::Timer*                  p_timer;
+      std::string                            m_timerName;
+      toolbox::task::ActionSignature*        p_cycleSig;
+      std::vector<toolbox::task::WorkLoop*>  m_workers;
+    };
+  }  // namespace gem::base
+}  // namespace gem
+
+#endif  // GEM_BASE_GEMMONITORSCHEDULER_H
@@ -49,6 +49,13 @@ namespace gem {
       static std::string jsonEscape(std::string const& orig);
       static std::string htmlEscape(std::string const& orig);
 
+      /**
+       * @param in the xgi input of a jsonUpdate request
+       * @returns the value of the 'since' parameter, the sequence number returned by the previous
+       *          update as 'jsonSequence', or 0 if the client asked for the full document
+       */
+      static uint64_t getJSONSince(xgi::Input* in);
+
     protected:
       // maybe only have the control panel built in the base class?
       // perhaps can extend it in derived classes
@@ -4,6 +4,7 @@
 #define GEM_BASE_UTILS_GEMINFOSPACETOOLBOX_H
 
 // using the infospace toolbox defined in the TCDS code base
+#include <list>
 #include <memory>
 #include <string>
 #include <unordered_map>
@@ -69,6 +70,90 @@ namespace gem {
                           NOUPDATE  //!< Value is not to be updated
         };
 
+        /**
+         * NotifyMode controls which listener events are fired for the items written in an UpdateBatch
+         */
+        enum NotifyMode { NOTIFY_NONE,   //!< No events are fired
+                          NOTIFY_ITEMS,  //!< One ItemChangedEvent for each item whose value changed
+                          NOTIFY_GROUP   //!< A single ItemGroupChangedEvent listing all items whose value changed
+        };
+
+        /**
+         * Typed reference to an item of the managed InfoSpace
+         * The lookup and the type check are done once when the handle is obtained from getHandle,
+         * so that reading or writing through the handle is a pointer dereference
+         * Handles are invalidated by reset() and must then be obtained again
+         * @tparam T the C++ type of the value
+         * @tparam X the xdata type holding the value in the InfoSpace
+         */
+        template <typename T, typename X>
+          class ItemHandle
+          {
+          public:
+            ItemHandle() : p_item(NULL), m_generation(0) {};
+
+            bool isNull() const { return p_item == NULL; };
+            std::string const& name() const { return m_name; };
+
+          private:
+            friend class GEMInfoSpaceToolBox;
+
+            X*          p_item;
+            std::string m_name;
+            uint32_t    m_generation;
+          };
+
+        typedef ItemHandle<std::string, xdata::String>            StringHandle;
+        typedef ItemHandle<bool,        xdata::Boolean>           BoolHandle;
+        typedef ItemHandle<double,      xdata::Double>            DoubleHandle;
+        typedef ItemHandle<int,         xdata::Integer>           IntegerHandle;
+        typedef ItemHandle<int32_t,     xdata::Integer32>         Integer32Handle;
+        typedef ItemHandle<int64_t,     xdata::Integer64>         Integer64Handle;
+        typedef ItemHandle<uint32_t,    xdata::UnsignedInteger32> UInt32Handle;
+        typedef ItemHandle<uint64_t,    xdata::UnsignedInteger64> UInt64Handle;
+
+        /**
+         * Scoped access to several items of the managed InfoSpace under a single lock
+         * The InfoSpace is locked on construction, and on destruction the listeners are notified
+         * of the items whose value changed, according to the NotifyMode, before it is unlocked
+         * Values written through the batch do not fire an ItemRetrieveEvent
+         */
+        class UpdateBatch
+        {
+        public:
+          /**
+           * @param toolbox the toolbox managing the InfoSpace to lock
+           * @param mode which events to fire for the modified items when the batch is closed
+           */
+          UpdateBatch(GEMInfoSpaceToolBox* toolbox, NotifyMode mode=NOTIFY_GROUP);
+
+          ~UpdateBatch();
+
+          /**
+           * Sets the value of an item, the item is only marked as changed if the value differs
+           * @param handle the handle to the item, obtained from the same toolbox
+           * @param value is the value to assign to the item
+           */
+          template <typename T, typename X>
+            void set(ItemHandle<T, X> const& handle, T const& value);
+
+          /**
+           * @param handle the handle to the item, obtained from the same toolbox
+           * @returns the value of the item
+           */
+          template <typename T, typename X>
+            T get(ItemHandle<T, X> const& handle) const;
+
+        private:
+          // Prevent copying.
+          UpdateBatch(UpdateBatch const&);
+          UpdateBatch& operator=(UpdateBatch const&);
+
+          GEMInfoSpaceToolBox*   p_toolbox;
+          NotifyMode             m_mode;
+          std::list<std::string> m_changed;
+        };
+
         class GEMInfoSpaceItem
         {
           /**
@@ -182,6 +267,40 @@ namespace gem {
         bool setUInt32(   std::string const& itemName, uint32_t    const& value);
         bool setUInt64(   std::string const& itemName, uint64_t    const& value);
 
+        /**
+         * Resolves an item of the InfoSpace into a typed handle
+         * @param itemName is the name of the item in the infospace
+         * @param handle is set to refer to the item
+         * @returns false if the item does not exist or is not of the type of the handle
+         */
+        template <typename T, typename X>
+          bool getHandle(std::string const& itemName, ItemHandle<T, X>& handle);
+
+        /**
+         * @param handle the handle to check
+         * @returns true if the handle was obtained from this toolbox since its last reset
+         */
+        template <typename T, typename X>
+          bool isValid(ItemHandle<T, X> const& handle) const
+          { return !handle.isNull() && handle.m_generation == m_generation; };
+
+        /**
+         * Gets the value of an item through its handle
+         * @param handle the handle to the item
+         * @param notify whether to fire an ItemRetrieveEvent, as the name based getters do
+         */
+        template <typename T, typename X>
+          T get(ItemHandle<T, X> const& handle, bool notify=false);
+
+        /**
+         * Sets the value of an item through its handle
+         * @param handle the handle to the item
+         * @param value is the value to assign to the item in the infospace
+         * @param notify whether to fire an ItemChangedEvent, as the name based setters do
+         */
+        template <typename T, typename X>
+          void set(ItemHandle<T, X> const& handle, T const& value, bool notify=true);
+
         xdata::InfoSpace* getInfoSpace()  { return p_infoSpace;         };
         std::string       name()          { return p_infoSpace->name(); };
         bool find(std::string const& key) { return m_itemMap.find(key) != m_itemMap.end(); };
@@ -208,10 +327,19 @@ namespace gem {
         void reset();
 
       private:
+        /**
+         * Raises an InfoSpaceProblem if the handle was not obtained from this toolbox since its last reset
+         */
+        template <typename T, typename X>
+          void checkHandle(ItemHandle<T, X> const& handle) const;
+
         log4cplus::Logger m_gemLogger;
 
         std::unordered_map<std::string, GEMInfoSpaceItem*> m_itemMap;
 
+        // incremented by reset(), handles from an earlier generation are rejected
+        uint32_t m_generation;
+
         // maps of variables and their associated xdata types
         std::unordered_map<std::string, std::pair<uint32_t,    xdata::UnsignedInteger32* > >  m_uint32Items;
         std::unordered_map<std::string, std::pair<uint64_t,    xdata::UnsignedInteger64* > >  m_uint64Items;
@@ -236,4 +364,90 @@ namespace gem {
   typedef gem::base::utils::GEMInfoSpaceToolBox::UpdateType GEMUpdateType;
 }  // namespace gem
 
+template <typename T, typename X>
+bool gem::base::utils::GEMInfoSpaceToolBox::getHandle(std::string const& itemName, ItemHandle<T, X>& handle)
+{
+  handle = ItemHandle<T, X>();
+  p_infoSpace->lock();
+  X* item = NULL;
+  try {
+    if (p_infoSpace->hasItem(itemName))
+      item = dynamic_cast<X*>(p_infoSpace->find(itemName));
+  } catch (...) {
+    item = NULL;
+  }
+  p_infoSpace->unlock();
+  if (!item) {
+    WARN("GEMInfoSpaceToolBox::getHandle item '" << itemName << "' not found in "
+         << p_infoSpace->name() << " or of the wrong type");
+    return false;
+  }
+  handle.p_item       = item;
+  handle.m_name       = itemName;
+  handle.m_generation = m_generation;
+  return true;
+}
+
+template <typename T, typename X>
+void gem::base::utils::GEMInfoSpaceToolBox::checkHandle(ItemHandle<T, X> const& handle) const
+{
+  if (!isValid(handle)) {
+    std::string msg = "Trying to access the InfoSpace through a stale or empty handle '" + handle.name() + "'.";
+    XCEPT_RAISE(gem::base::utils::exception::InfoSpaceProblem, msg);
+  }
+}
+
+template <typename T, typename X>
+T gem::base::utils::GEMInfoSpaceToolBox::get(ItemHandle<T, X> const& handle, bool notify)
+{
+  checkHandle(handle);
+  p_infoSpace->lock();
+  try {
+    if (notify)
+      p_infoSpace->fireItemValueRetrieve(handle.m_name);
+  } catch (...) {
+    p_infoSpace->unlock();
+    std::string msg = "Failed to notify the retrieval of InfoSpace item '" + handle.m_name + "'.";
+    XCEPT_RAISE(gem::base::utils::exception::InfoSpaceProblem, msg);
+  }
+  T value = handle.p_item->value_;
+  p_infoSpace->unlock();
+  return value;
+}
+
+template <typename T, typename X>
+void gem::base::utils::GEMInfoSpaceToolBox::set(ItemHandle<T, X> const& handle, T const& value, bool notify)
+{
+  checkHandle(handle);
+  p_infoSpace->lock();
+  *(handle.p_item) = value;
+  try {
+    if (notify)
+      p_infoSpace->fireItemValueChanged(handle.m_name);
+  } catch (...) {
+    p_infoSpace->unlock();
+    std::string msg = "Failed to notify the change of InfoSpace item '" + handle.m_name + "'.";
+    XCEPT_RAISE(gem::base::utils::exception::InfoSpaceProblem, msg);
+  }
+  p_infoSpace->unlock();
+}
+
+template <typename T, typename X>
+void gem::base::utils::GEMInfoSpaceToolBox::UpdateBatch::set(ItemHandle<T, X> const& handle, T const& value)
+{
+  p_toolbox->checkHandle(handle);
+  if (handle.p_item->value_ == value)
+    return;
+  *(handle.p_item) = value;
+  if (m_mode != NOTIFY_NONE)
+    m_changed.push_back(handle.m_name);
+}
+
+template <typename T, typename X>
+T gem::base::utils::GEMInfoSpaceToolBox::UpdateBatch::get(ItemHandle<T, X> const& handle) const
+{
+  p_toolbox->checkHandle(handle);
+  return handle.p_item->value_;
+}
+
 #endif  // GEM_BASE_UTILS_GEMINFOSPACETOOLBOX_H
@@ -8,6 +8,9 @@
 
 #include "toolbox/fsm/AsynchronousFiniteStateMachine.h"
 #include "toolbox/fsm/InvalidInputEvent.h"
+#include "toolbox/task/Action.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
 #include "toolbox/string.h"
 #include "xercesc/dom/DOMNode.hpp"
 #include "xercesc/dom/DOMNodeList.hpp"
@@ -18,6 +21,7 @@
 #include "gem/base/GEMFSM.h"
 #include "gem/base/utils/GEMInfoSpaceToolBox.h"
 
+#include "gem/utils/LockGuard.h"
 #include "gem/utils/soap/GEMSOAPToolBox.h"
 #include "gem/utils/exception/Exception.h"
 
@@ -26,6 +30,10 @@ gem::base::GEMFSM::GEMFSM(GEMFSMApplication* const gemAppP) :
   m_gemFSMState("Undefined"),
   m_reasonForFailure(""),
   p_gemApp(gemAppP),
+  p_supervisorDescriptor(NULL),
+  m_notifyLock(toolbox::BSem::FULL, true),
+  p_notifyLoop(NULL),
+  p_notifySig(NULL),
   m_gemLogger(gemAppP->getApplicationLogger())
 {
   DEBUG("GEMFSM::ctor begin");
@@ -40,6 +48,12 @@ gem::base::GEMFSM::GEMFSM(GEMFSMApplication* const gemAppP) :
                   << className << ":" << instanceNumber;
   p_gemfsm = new toolbox::fsm::AsynchronousFiniteStateMachine(commandLoopName.str());
 
+  // State notifications to the GEMSupervisor are posted from their own workloop,
+  // a slow or absent supervisor must not hold up the FSM thread
+  m_notifyLoopName = toolbox::toString("urn:toolbox-task-workloop:gemFSMNotifyLoop:%s:%d",
+                                       className.c_str(), instanceNumber);
+  p_notifySig = toolbox::task::bind(this, &GEMFSM::sendStateNotification, "sendStateNotification");
+
   // A map to look up the names of the 'intermediate' state transitions.
   // TCDS does things this way, is it the right way for GEMs?
   m_lookupMap["Initializing"] = "Halted"     ;  // Halted
@@ -205,6 +219,14 @@ gem::base::GEMFSM::GEMFSM(GEMFSMApplication* const gemAppP) :
 
 gem::base::GEMFSM::~GEMFSM()
 {
+  if (p_notifyLoop) {
+    try {
+      if (p_notifyLoop->isActive())
+        p_notifyLoop->cancel();
+    } catch (toolbox::task::exception::Exception& e) {
+      WARN("GEMFSM::~GEMFSM unable to cancel the notification workloop: " << e.what());
+    }
+  }
   if (p_gemfsm)
     delete p_gemfsm;
   p_gemfsm = 0;
@@ -251,7 +273,11 @@ xoap::MessageReference gem::base::GEMFSM::changeState(xoap::MessageReference msg
   }
 
   DEBUG("GEMFSM::changeState() received command '" <<  commandName.c_str() << "'.");
+  return changeState(commandName);
+}
 
+xoap::MessageReference gem::base::GEMFSM::changeState(std::string const& commandName)
+{
   try {
     toolbox::Event::Reference event(new toolbox::Event(commandName, this));
     INFO("Firing GEMFSM for event " << commandName);
@@ -365,9 +391,62 @@ void gem::base::GEMFSM::stateChanged(toolbox::fsm::FiniteStateMachine &fsm)
     XCEPT_RAISE(gem::utils::exception::SoftwareProblem, msg.str());
   }
   INFO("GEMFSM::stateChanged:Current state is: [" << m_gemFSMState.toString() << "]");
+  notifySupervisor(m_gemFSMState.toString());
   DEBUG("GEMFSM::stateChanged:stateChanged() end");
 }
 
+void gem::base::GEMFSM::notifySupervisor(std::string const& stateName)
+{
+  if (p_gemApp->getApplicationDescriptor()->getClassName() == "gem::supervisor::GEMSupervisor")
+    return;  // the supervisor computes the global state itself
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_notifyLock);
+  m_pendingNotifications.push_back(StateNotification(stateName, m_reasonForFailure.toString()));
+  try {
+    if (!p_notifyLoop)
+      p_notifyLoop = toolbox::task::getWorkLoopFactory()->getWorkLoop(m_notifyLoopName, "waiting");
+    if (!p_notifyLoop->isActive())
+      p_notifyLoop->activate();
+    // one action per queued state, the waiting workloop runs them in order
+    p_notifyLoop->submit(p_notifySig);
+  } catch (toolbox::task::exception::Exception& e) {
+    m_pendingNotifications.pop_back();
+    WARN("GEMFSM::notifySupervisor unable to queue state " << stateName << " for the GEMSupervisor: " << e.what());
+  }
+}
+
+bool gem::base::GEMFSM::sendStateNotification(toolbox::task::WorkLoop* wl)
+{
+  StateNotification notification;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_notifyLock);
+    if (m_pendingNotifications.empty())
+      return false;
+    notification = m_pendingNotifications.front();
+    m_pendingNotifications.pop_front();
+  }
+
+  xdaq::ApplicationDescriptor* self = p_gemApp->getApplicationDescriptor();
+  try {
+    if (!p_supervisorDescriptor)
+      p_supervisorDescriptor = p_gemApp->getApplicationContext()->getDefaultZone()->getApplicationDescriptor(
+        "gem::supervisor::GEMSupervisor", 0);  // same lookup as the AMC13Manager EndScanPoint
+  } catch (xcept::Exception& e) {
+    DEBUG("GEMFSM::sendStateNotification no GEMSupervisor found, not pushing state " << notification.first);
+    return false;
+  }
+
+  try {
+    gem::utils::soap::GEMSOAPToolBox::sendStateNotification(notification.first, notification.second,
+                                                            p_gemApp->getApplicationContext(),
+                                                            self, p_supervisorDescriptor);
+  } catch (xcept::Exception& e) {
+    WARN("GEMFSM::sendStateNotification unable to push state " << notification.first
+         << " to the GEMSupervisor: " << e.what());
+  }
+  return false;
+}
+
 
 void gem::base::GEMFSM::invalidAction(toolbox::Event::Reference event)
 // throw (toolbox::fsm::exception::Exception)
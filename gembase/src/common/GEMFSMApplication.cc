@@ -8,6 +8,9 @@
 
 #include "gem/base/GEMFSMApplication.h"
 
+#include <algorithm>
+#include <list>
+
 #include "toolbox/BSem.h"
 #include "toolbox/string.h"
 
@@ -19,6 +22,8 @@
 
 #include "xcept/Exception.h"
 
+#include "xdata/AbstractBag.h"
+
 #include "xdaq/ApplicationStub.h"
 #include "xdaq/NamespaceURI.h"
 
@@ -83,6 +88,8 @@ gem::base::GEMFSMApplication::GEMFSMApplication(xdaq::ApplicationStub* stub)
   xoap::bind(this, &GEMFSMApplication::changeState, "Resume",     XDAQ_NS_URI);
   xoap::bind(this, &GEMFSMApplication::changeState, "Halt",       XDAQ_NS_URI);
   xoap::bind(this, &GEMFSMApplication::changeState, "Reset",      XDAQ_NS_URI);
+  // a single message carrying the run parameters together with the command
+  xoap::bind(this, &GEMFSMApplication::changeStateWithParameters, "TransitionWithParameters", XDAQ_NS_URI);
   DEBUG("GEMFSMApplication::Created xoap bindings");
 
   // benefit or disadvantage to setting up the workloop signatures this way?
@@ -429,6 +436,110 @@ xoap::MessageReference gem::base::GEMFSMApplication::changeState(xoap::MessageRe
   return m_gemfsm.changeState(msg);
 }
 
+xoap::MessageReference gem::base::GEMFSMApplication::changeStateWithParameters(xoap::MessageReference msg)
+{
+  DEBUG("GEMFSMApplication::changeStateWithParameters");
+  std::string commandName = "undefined";
+  try {
+    std::vector<std::vector<std::string> > parameters;
+    commandName = gem::utils::soap::GEMSOAPToolBox::extractCommandWithParameters(msg, parameters);
+    INFO("GEMFSMApplication::changeStateWithParameters received command " << commandName
+         << " with " << parameters.size() << " parameters");
+    applyParameters(parameters);
+  } catch (xcept::Exception& err) {
+    std::string msgBase = toolbox::toString("Unable to apply the parameters for command %s", commandName.c_str());
+    ERROR(toolbox::toString("%s: %s.", msgBase.c_str(), xcept::stdformat_exception_history(err).c_str()));
+    XCEPT_DECLARE_NESTED(gem::base::utils::exception::SOAPTransitionProblem, top,
+                         toolbox::toString("%s.", msgBase.c_str()), err);
+    notifyQualified("error", top);
+    std::string faultString = toolbox::toString("%s failed", commandName.c_str());
+    std::string faultCode   = "Client";
+    std::string detail      = toolbox::toString("%s: %s.", msgBase.c_str(), err.message().c_str());
+    std::string faultActor  = getFullURL();
+    return gem::utils::soap::GEMSOAPToolBox::makeSOAPFaultReply(faultString, faultCode, detail, faultActor);
+  }
+
+  updateState();
+  return m_gemfsm.changeState(commandName);
+}
+
+void gem::base::GEMFSMApplication::applyParameters(std::vector<std::vector<std::string> > const& parameters)
+  throw (gem::base::utils::exception::ValueError)
+{
+  typedef std::pair<xdata::Serializable*, std::shared_ptr<xdata::Serializable> > StagedValue;
+  std::vector<StagedValue> staged;
+  std::list<std::string>   items;
+
+  // resolve and parse every value before touching the infospace
+  for (auto p = parameters.begin(); p != parameters.end(); ++p) {
+    std::string const& name  = p->at(0);
+    std::string const& value = p->at(1);
+    size_t dot = name.find('.');
+    std::string itemName = name.substr(0, dot);
+
+    if (!p_appInfoSpace->hasItem(itemName))
+      XCEPT_RAISE(gem::base::utils::exception::ValueError,
+                  toolbox::toString("Unknown parameter %s", name.c_str()));
+    xdata::Serializable* target = p_appInfoSpace->find(itemName);
+    if (dot != std::string::npos) {
+      xdata::AbstractBag* bag = dynamic_cast<xdata::AbstractBag*>(target);
+      target = bag ? bag->getField(name.substr(dot+1)) : 0;
+      if (!target)
+        XCEPT_RAISE(gem::base::utils::exception::ValueError,
+                    toolbox::toString("Unknown parameter %s", name.c_str()));
+    }
+
+    std::shared_ptr<xdata::Serializable> parsed;
+    std::string const type = target->type();
+    if (type == "string")
+      parsed.reset(new xdata::String());
+    else if (type == "bool")
+      parsed.reset(new xdata::Boolean());
+    else if (type == "int")
+      parsed.reset(new xdata::Integer());
+    else if (type == "int 32")
+      parsed.reset(new xdata::Integer32());
+    else if (type == "int 64")
+      parsed.reset(new xdata::Integer64());
+    else if (type == "unsigned int 32")
+      parsed.reset(new xdata::UnsignedInteger32());
+    else if (type == "unsigned int 64")
+      parsed.reset(new xdata::UnsignedInteger64());
+    else if (type == "unsigned long")
+      parsed.reset(new xdata::UnsignedLong());
+    else if (type == "unsigned short")
+      parsed.reset(new xdata::UnsignedShort());
+    else if (type == "float")
+      parsed.reset(new xdata::Float());
+    else if (type == "double")
+      parsed.reset(new xdata::Double());
+    else
+      XCEPT_RAISE(gem::base::utils::exception::ValueError,
+                  toolbox::toString("Parameter %s has unsupported type %s", name.c_str(), type.c_str()));
+
+    try {
+      parsed->fromString(value);
+    } catch (xcept::Exception& e) {
+      XCEPT_RETHROW(gem::base::utils::exception::ValueError,
+                    toolbox::toString("Invalid value '%s' for parameter %s", value.c_str(), name.c_str()), e);
+    }
+    staged.push_back(std::make_pair(target, parsed));
+    if (std::find(items.begin(), items.end(), itemName) == items.end())
+      items.push_back(itemName);
+  }
+
+  if (staged.empty())
+    return;
+
+  p_appInfoSpace->lock();
+  for (auto s = staged.begin(); s != staged.end(); ++s)
+    s->first->setValue(*(s->second));
+  p_appInfoSpace->unlock();
+
+  // one notification for the whole set, listeners see the parameters change together
+  p_appInfoSpace->fireItemGroupChanged(items, this);
+}
+
 /** workloop driven transitions*/
 bool gem::base::GEMFSMApplication::initialize(toolbox::task::WorkLoop *wl)
 {
@@ -9,7 +9,10 @@
 
 // GEMMonitor.cc
 
+#include <time.h>
+
 #include "gem/base/GEMMonitor.h"
+#include "gem/base/GEMMonitorScheduler.h"
 #include "gem/base/GEMApplication.h"
 #include "gem/base/GEMWebApplication.h"
 #include "gem/base/GEMFSMApplication.h"
@@ -19,27 +22,27 @@
 
 #include "xdata/InfoSpace.h"
 
+#include "gem/utils/LockGuard.h"
+
+gem::utils::Lock gem::base::GEMMonitor::s_jsonLock(toolbox::BSem::FULL, true);
+uint64_t         gem::base::GEMMonitor::s_jsonSequence = 0;
+
 gem::base::GEMMonitor::GEMMonitor(log4cplus::Logger& logger, xdaq::Application* xdaqApp, int const& index) :
-  m_gemLogger(logger)
+  m_gemLogger(logger),
+  m_updateLock(toolbox::BSem::FULL, true),
+  m_inCycle(false),
+  m_jsonLayoutSequence(0)
 {
-  std::stringstream timerName;
-  timerName << xdaqApp->getApplicationDescriptor()->getURN() << ":MonitoringTimer" << index;
-  m_timerName = timerName.str();
-
-  try {
-    DEBUG("GEMMonitor::Creating timer with name " << m_timerName);
-    if (toolbox::task::getTimerFactory()->hasTimer(m_timerName))
-      p_timer = toolbox::task::getTimerFactory()->getTimer(m_timerName);
-    else
-      p_timer = toolbox::task::getTimerFactory()->createTimer(m_timerName);
-    p_timer->stop();
-  } catch (toolbox::task::exception::Exception& te) {
-    XCEPT_RETHROW(xdaq::exception::Exception, "Cannot run GEMMonitor, timer already created", te);
-  }
+  std::stringstream monitorName;
+  monitorName << xdaqApp->getApplicationDescriptor()->getURN() << ":Monitor" << index;
+  m_monitorName = monitorName.str();
 }
 
 gem::base::GEMMonitor::GEMMonitor(log4cplus::Logger& logger, GEMApplication* gemApp, int const& index) :
-  m_gemLogger(logger)
+  m_gemLogger(logger),
+  m_updateLock(toolbox::BSem::FULL, true),
+  m_inCycle(false),
+  m_jsonLayoutSequence(0)
 {
   p_gemApp = gemApp;
 
@@ -50,24 +53,16 @@ gem::base::GEMMonitor::GEMMonitor(log4cplus::Logger& logger, GEMApplication* gem
   // update with interval
   addInfoSpace("Monitoring",    gemApp->getMonISToolBox(), toolbox::TimeInterval(7,  0));
 
-  std::stringstream timerName;
-  timerName << gemApp->m_urn << ":MonitoringTimer" << index;
-  m_timerName = timerName.str();
-
-  try {
-    DEBUG("GEMMonitor::Creating timer with name " << m_timerName);
-    if (toolbox::task::getTimerFactory()->hasTimer(m_timerName))
-      p_timer = toolbox::task::getTimerFactory()->getTimer(m_timerName);
-    else
-      p_timer = toolbox::task::getTimerFactory()->createTimer(m_timerName);
-    p_timer->stop();
-  } catch (toolbox::task::exception::Exception& te) {
-    XCEPT_RETHROW(xdaq::exception::Exception, "Cannot run GEMMonitor, timer already created", te);
-  }
+  std::stringstream monitorName;
+  monitorName << gemApp->m_urn << ":Monitor" << index;
+  m_monitorName = monitorName.str();
 }
 
 gem::base::GEMMonitor::GEMMonitor(log4cplus::Logger& logger, GEMFSMApplication* gemFSMApp, int const& index) :
-  m_gemLogger(logger)
+  m_gemLogger(logger),
+  m_updateLock(toolbox::BSem::FULL, true),
+  m_inCycle(false),
+  m_jsonLayoutSequence(0)
 {
   p_gemApp = static_cast<gem::base::GEMApplication*>(gemFSMApp);
   // maybe it's really better to use the listener functionality... which we can put into the actionPerformed callback!
@@ -80,54 +75,44 @@ gem::base::GEMMonitor::GEMMonitor(log4cplus::Logger& logger, GEMFSMApplication*
   // update with interval for state changes
   addInfoSpace("AppStateMonitoring", gemFSMApp->getAppStateISToolBox(), toolbox::TimeInterval(2.5, 0));
 
-  std::stringstream timerName;
-  timerName << gemFSMApp->m_urn << ":MonitoringTimer" << index;
-  m_timerName = timerName.str();
-
-  try {
-    DEBUG("GEMMonitor::Creating timer with name " << m_timerName);
-    if (toolbox::task::getTimerFactory()->hasTimer(m_timerName))
-      p_timer = toolbox::task::getTimerFactory()->getTimer(m_timerName);
-    else
-      p_timer = toolbox::task::getTimerFactory()->createTimer(m_timerName);
-    p_timer->stop();
-  } catch (toolbox::task::exception::Exception& te) {
-    XCEPT_RETHROW(xdaq::exception::Exception, "Cannot run GEMMonitor, timer already created", te);
-  }
+  std::stringstream monitorName;
+  monitorName << gemFSMApp->m_urn << ":Monitor" << index;
+  m_monitorName = monitorName.str();
 }
 
 gem::base::GEMMonitor::~GEMMonitor()
 {
+  // the monitor must already be out of the scheduler, see stopMonitoring in the derived destructors
 }
 
 void gem::base::GEMMonitor::startMonitoring()
 {
-  DEBUG("GEMMonitor::startMonitoring");
-
-  try {
-    p_timer->stop();
-  } catch (toolbox::task::exception::NotActive const& ex) {
-    WARN("GEMMonitor::startMonitoring could not stop timer " << ex.what());
+  DEBUG("GEMMonitor::startMonitoring " << m_monitorName);
+
+  // the monitor is woken up at the pace of its fastest info space, the others are skipped until due
+  toolbox::TimeInterval interval(5, 0);
+  bool first = true;
+  for (auto iset = m_monitorableSetInfoSpaceMap.begin(); iset != m_monitorableSetInfoSpaceMap.end(); ++iset) {
+    auto infoSpace = m_infoSpaceMap.find(iset->second);
+    if (infoSpace == m_infoSpaceMap.end())
+      continue;
+    toolbox::TimeInterval const& isInterval = infoSpace->second.second;
+    if (first || (isInterval.sec() < interval.sec()) ||
+        (isInterval.sec() == interval.sec() && isInterval.usec() < interval.usec()))
+      interval = isInterval;
+    first = false;
   }
 
-  p_timer->start();
+  // first update before scheduling, so it can't overlap with a scheduled one
+  runUpdateCycle();
 
-  DEBUG("GEMMonitor::startMonitoring");
-  for (auto infoSpace = m_infoSpaceMap.begin(); infoSpace != m_infoSpaceMap.end(); ++infoSpace) {
-    toolbox::TimeVal startTime;
-    startTime = toolbox::TimeVal::gettimeofday();
-    p_timer->scheduleAtFixedRate(startTime, this, infoSpace->second.second,
-                                 infoSpace->second.first->getInfoSpace(),
-                                 infoSpace->first);
-  }
-
-  updateMonitorables();
+  GEMMonitorScheduler::getInstance()->addMonitor(this, getSchedulerGroup(), interval);
 }
 
 void gem::base::GEMMonitor::stopMonitoring()
 {
-  DEBUG("GEMMonitor::stopMonitoring");
-  p_timer->stop();
+  DEBUG("GEMMonitor::stopMonitoring " << m_monitorName);
+  GEMMonitorScheduler::getInstance()->removeMonitor(this);
 }
 
 void gem::base::GEMMonitor::setupMonitoring(bool isFSMApp)
@@ -149,12 +134,6 @@ void gem::base::GEMMonitor::setupMonitoring(bool isFSMApp)
                    GEMUpdateType::PROCESS, "");
 }
 
-void gem::base::GEMMonitor::timeExpired(toolbox::task::TimerEvent& event)
-{
-  DEBUG("GEMMonitor::timeExpired received event:" << event.type());
-  updateMonitorables();
-}
-
 void gem::base::GEMMonitor::addInfoSpace(std::string const& name,
                                          std::shared_ptr<gem::base::utils::GEMInfoSpaceToolBox> infoSpace,
                                          toolbox::TimeInterval const& interval)
@@ -260,15 +239,62 @@ std::list<std::vector<std::string> > gem::base::GEMMonitor::getFormattedItemSet(
   return result;
 }
 
+void gem::base::GEMMonitor::setMonitorableValues(std::shared_ptr<utils::GEMInfoSpaceToolBox> infoSpace,
+                                                 std::vector<std::pair<GEMMonitorable*, uint64_t> > const& values)
+{
+  // handles have to be resolved before the batch takes the InfoSpace lock
+  std::vector<std::pair<GEMMonitorable*, uint64_t> > others;
+  std::vector<std::pair<GEMMonitorable*, uint64_t> > batched;
+  batched.reserve(values.size());
+  for (auto val = values.begin(); val != values.end(); ++val) {
+    GEMMonitorable& monitem = *(val->first);
+    bool wide = (monitem.updatetype == GEMUpdateType::HW64 || monitem.updatetype == GEMUpdateType::I2CSTAT);
+    bool valid = false;
+    if (monitem.infoSpace == infoSpace) {
+      if (wide)
+        valid = infoSpace->isValid(monitem.uint64Handle) ||
+          infoSpace->getHandle(monitem.name, monitem.uint64Handle);
+      else
+        valid = infoSpace->isValid(monitem.uint32Handle) ||
+          infoSpace->getHandle(monitem.name, monitem.uint32Handle);
+    }
+    if (valid)
+      batched.push_back(*val);
+    else
+      others.push_back(*val);
+  }
+
+  {
+    utils::GEMInfoSpaceToolBox::UpdateBatch batch(infoSpace.get());
+    for (auto val = batched.begin(); val != batched.end(); ++val) {
+      GEMMonitorable const& monitem = *(val->first);
+      if (monitem.updatetype == GEMUpdateType::HW64 || monitem.updatetype == GEMUpdateType::I2CSTAT)
+        batch.set(monitem.uint64Handle, val->second);
+      else
+        batch.set(monitem.uint32Handle, static_cast<uint32_t>(val->second));
+    }
+  }
+
+  for (auto val = others.begin(); val != others.end(); ++val) {
+    GEMMonitorable const& monitem = *(val->first);
+    if (monitem.updatetype == GEMUpdateType::HW64 || monitem.updatetype == GEMUpdateType::I2CSTAT)
+      (monitem.infoSpace)->setUInt64(monitem.name, val->second);
+    else
+      (monitem.infoSpace)->setUInt32(monitem.name, static_cast<uint32_t>(val->second));
+  }
+}
+
 void gem::base::GEMMonitor::jsonUpdateItemSet(std::string const& setname, std::ostream *out)
 {
   std::list< std::vector<std::string> > items = getFormattedItemSet(setname);
   std::list< std::vector<std::string> >::const_iterator it;
 
+  // same info space for every item in the set
+  std::string infoSpaceName = getInfoSpace(setname)->name();
   std::list< std::vector<std::string> >::const_iterator end = items.end();
   for ( it = items.begin(); it != items.end(); ++it ) {
     std::string val = gem::base::GEMWebApplication::jsonEscape( (*it)[1] );
-    *out << "{ \"name\":\"" << getInfoSpace(setname)->name() << "-" << (*it)[0]
+    *out << "{ \"name\":\"" << infoSpaceName << "-" << (*it)[0]
          << "\",\"value\":\"" << val;
     // can't have a trailing comma for the last entry...
     if (std::distance(it, end) == 1) {
@@ -279,30 +305,238 @@ void gem::base::GEMMonitor::jsonUpdateItemSet(std::string const& setname, std::o
   }
 }
 
-void gem::base::GEMMonitor::jsonUpdateItemSets(xgi::Output *out)
+void gem::base::GEMMonitor::runUpdateCycle()
 {
-  auto end = m_monitorableSetsMap.end();
-  for (auto iset = m_monitorableSetsMap.begin(); iset != m_monitorableSetsMap.end(); ++iset) {
-    *out << "\"" << iset->first << "\" : [ " << std::endl;
+  beginUpdateCycle();
+  try {
+    updateMonitorables();
+  } catch (...) {
+    endUpdateCycle();
+    throw;
+  }
+  endUpdateCycle();
+}
 
-    if (m_monitorableSetsMap.find(iset->first) == m_monitorableSetsMap.end()) {
-      DEBUG("GEMMonitor::Monitorable set " << iset->first << " not found, not exporting as JSON");
-    } else if (m_monitorableSetsMap.find(iset->first)->second.empty()) {
-      DEBUG("GEMMonitor::Monitorable set " << iset->first << " is empty, not exporting as JSON");
-    } else {
-      DEBUG("GEMMonitor::Found monitorable set " << iset->first << " while updating for JSON export");
+void gem::base::GEMMonitor::beginUpdateCycle()
+{
+  m_updateLock.lock();
+
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t nowUsec = static_cast<uint64_t>(now.tv_sec)*1000000 + now.tv_nsec/1000;
+
+  // the scheduler wakes the monitor on a coarse tick, accept being up to half of the fastest interval early
+  uint64_t slack = 0;
+  for (auto iset = m_monitorableSetInfoSpaceMap.begin(); iset != m_monitorableSetInfoSpaceMap.end(); ++iset) {
+    auto infoSpace = m_infoSpaceMap.find(iset->second);
+    if (infoSpace == m_infoSpaceMap.end())
+      continue;
+    toolbox::TimeInterval const& interval = infoSpace->second.second;
+    uint64_t usec = static_cast<uint64_t>(interval.sec())*1000000 + interval.usec();
+    if (slack == 0 || usec/2 < slack)
+      slack = usec/2;
+  }
 
-      jsonUpdateItemSet(iset->first, out);
+  m_infoSpaceDue.clear();
+  for (auto iset = m_monitorableSetInfoSpaceMap.begin(); iset != m_monitorableSetInfoSpaceMap.end(); ++iset) {
+    if (m_infoSpaceDue.find(iset->second) != m_infoSpaceDue.end())
+      continue;
+    auto infoSpace = m_infoSpaceMap.find(iset->second);
+    if (infoSpace == m_infoSpaceMap.end())
+      continue;
+    toolbox::TimeInterval const& interval = infoSpace->second.second;
+    uint64_t usec = static_cast<uint64_t>(interval.sec())*1000000 + interval.usec();
+    auto next = m_infoSpaceNextUpdate.find(iset->second);
+    bool due = (next == m_infoSpaceNextUpdate.end() || nowUsec + slack >= next->second);
+    if (due)
+      m_infoSpaceNextUpdate[iset->second] = nowUsec + usec;
+    m_infoSpaceDue[iset->second] = due;
+  }
+  m_inCycle = true;
+}
+
+void gem::base::GEMMonitor::endUpdateCycle()
+{
+  m_inCycle = false;
+  try {
+    updateJSONSnapshot();
+  } catch (...) {
+    m_updateLock.unlock();
+    throw;
+  }
+  m_updateLock.unlock();
+}
+
+bool gem::base::GEMMonitor::isSetDue(std::string const& setname) const
+{
+  if (!m_inCycle)
+    return true;
+  auto iset = m_monitorableSetInfoSpaceMap.find(setname);
+  if (iset == m_monitorableSetInfoSpaceMap.end())
+    return true;
+  auto due = m_infoSpaceDue.find(iset->second);
+  return due == m_infoSpaceDue.end() || due->second;
+}
+
+void gem::base::GEMMonitor::setStale(std::string const& setname, bool const& stale)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_updateLock);
+  if (stale)
+    m_staleSets[setname] = true;
+  else
+    m_staleSets.erase(setname);
+}
+
+void gem::base::GEMMonitor::updateRegisterMonitorables()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_updateLock);
+  RegisterReadList regs;
+  if (!collectRegisterReads(regs))
+    return;
+  bool valid = regs.empty() || readRegisters(regs);
+  publishRegisterReads(regs, valid);
+}
+
+void gem::base::GEMMonitor::updateJSONSnapshot()
+{
+  gem::utils::LockGuard<gem::utils::Lock> updateLock(m_updateLock);
+  std::shared_ptr<JSONSnapshot const> previous;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(s_jsonLock);
+    previous = p_jsonSnapshot;
+  }
+
+  // the set map is only rebuilt on setup/reset, so the order normally matches the previous snapshot
+  std::shared_ptr<JSONSnapshot> snapshot(new JSONSnapshot());
+  snapshot->reserve(m_monitorableSetsMap.size());
+  std::vector<JSONItem*> changed;
+  // a delta can't tell a client that an item went away, it has to get the full document again
+  bool layoutChanged = !previous || previous->size() != m_monitorableSetsMap.size();
+  for (auto iset = m_monitorableSetsMap.begin(); iset != m_monitorableSetsMap.end(); ++iset) {
+    JSONSnapshot::value_type const* prevSet = NULL;
+    if (previous && snapshot->size() < previous->size() && previous->at(snapshot->size()).first == iset->first)
+      prevSet = &(previous->at(snapshot->size()));
+    if (!prevSet || prevSet->second.size() != iset->second.size())
+      layoutChanged = true;
+
+    snapshot->push_back(std::make_pair(iset->first, std::vector<JSONItem>()));
+    std::vector<JSONItem>& items = snapshot->back().second;
+    bool stale = m_staleSets.find(iset->first) != m_staleSets.end();
+    items.reserve(iset->second.size());
+    for (auto monitem = iset->second.begin(); monitem != iset->second.end(); ++monitem) {
+      GEMMonitorable const& item = monitem->second;
+      JSONItem jsonItem;
+      jsonItem.id      = item.infoSpace->name() + "-" + item.name;
+      jsonItem.value   = gem::base::GEMWebApplication::jsonEscape(item.infoSpace->getFormattedItem(item.name,
+                                                                                                  item.format));
+      jsonItem.stale   = stale;
+      jsonItem.changed = 0;
+      if (prevSet && items.size() < prevSet->second.size()) {
+        JSONItem const& prevItem = prevSet->second.at(items.size());
+        if (prevItem.id == jsonItem.id && prevItem.value == jsonItem.value && prevItem.stale == jsonItem.stale)
+          jsonItem.changed = prevItem.changed;
+        if (prevItem.id != jsonItem.id)
+          layoutChanged = true;
+      }
+      items.push_back(jsonItem);
     }
-    // can't have a trailing comma for the last entry...
-    if (std::distance(iset, end) == 1) {
-      DEBUG("GEMMonitor::Found last monitorable set " << iset->first << ", no trailing comma (])");
-      *out << " ]"  << std::endl;
-    } else {
-      DEBUG("GEMMonitor::Found monitorable set " << iset->first << ", trailing comma (],)");
+  }
+  for (auto iset = snapshot->begin(); iset != snapshot->end(); ++iset)
+    for (auto item = iset->second.begin(); item != iset->second.end(); ++item)
+      if (item->changed == 0)
+        changed.push_back(&(*item));
+
+  // serialise the full document once here rather than once per web request
+  std::stringstream itemSets;
+  for (auto iset = snapshot->begin(); iset != snapshot->end(); ++iset) {
+    if (iset != snapshot->begin())
+      itemSets << " ]," << std::endl;
+    itemSets << "\"" << iset->first << "\" : [ " << std::endl;
+    for (auto item = iset->second.begin(); item != iset->second.end(); ++item) {
+      itemSets << "{ \"name\":\"" << item->id << "\",\"value\":\"" << item->value
+               << (item->stale ? "\",\"stale\":\"1" : "");
+      // can't have a trailing comma for the last entry...
+      if (std::distance(item, iset->second.end()) == 1)
+        itemSets << "\" }"  << std::endl;
+      else
+        itemSets << "\" }," << std::endl;
+    }
+  }
+  if (!snapshot->empty())
+    itemSets << " ]" << std::endl;
+  std::shared_ptr<std::string const> jsonItemSets(new std::string(itemSets.str()));
+
+  // take the sequence number and publish under the same lock, see getJSONSequence
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(s_jsonLock);
+  uint64_t sequence = ++s_jsonSequence;
+  for (auto item = changed.begin(); item != changed.end(); ++item)
+    (*item)->changed = sequence;
+  p_jsonSnapshot  = snapshot;
+  p_jsonItemSets  = jsonItemSets;
+  if (layoutChanged)
+    m_jsonLayoutSequence = sequence;
+}
+
+uint64_t gem::base::GEMMonitor::getJSONSequence()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(s_jsonLock);
+  return s_jsonSequence;
+}
+
+bool gem::base::GEMMonitor::jsonUpdateItemSets(std::ostream *out, uint64_t const& since)
+{
+  std::shared_ptr<JSONSnapshot const> snapshot;
+  std::shared_ptr<std::string const>  itemSets;
+  uint64_t layoutSequence, sequence;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(s_jsonLock);
+    snapshot       = p_jsonSnapshot;
+    itemSets       = p_jsonItemSets;
+    layoutSequence = m_jsonLayoutSequence;
+    sequence       = s_jsonSequence;
+  }
+
+  if (!snapshot) {
+    // nothing published yet, e.g., monitoring not started
+    DEBUG("GEMMonitor::jsonUpdateItemSets no snapshot available yet, taking one");
+    updateJSONSnapshot();
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(s_jsonLock);
+    snapshot       = p_jsonSnapshot;
+    itemSets       = p_jsonItemSets;
+    layoutSequence = m_jsonLayoutSequence;
+    sequence       = s_jsonSequence;
+  }
+
+  if (snapshot->empty())
+    return false;
+
+  // a since from the future comes from before a restart of the process,
+  // and items may have been removed since the client's last update
+  if (since == 0 || since > sequence || since < layoutSequence) {
+    *out << *itemSets;
+    return true;
+  }
+
+  // delta mode, every set is written so the layout is the same as the full document
+  for (auto iset = snapshot->begin(); iset != snapshot->end(); ++iset) {
+    if (iset != snapshot->begin())
       *out << " ]," << std::endl;
+    *out << "\"" << iset->first << "\" : [ " << std::endl;
+    bool first = true;
+    for (auto item = iset->second.begin(); item != iset->second.end(); ++item) {
+      if (item->changed <= since)
+        continue;
+      if (!first)
+        *out << "," << std::endl;
+      *out << "{ \"name\":\"" << item->id << "\",\"value\":\"" << item->value
+           << (item->stale ? "\",\"stale\":\"1" : "") << "\" }";
+      first = false;
     }
+    if (!first)
+      *out << std::endl;
   }
+  *out << " ]" << std::endl;
+  return true;
 }
 
 void gem::base::GEMMonitor::jsonUpdateInfoSpaces(xgi::Output *out)
@@ -314,23 +548,9 @@ void gem::base::GEMMonitor::jsonUpdateInfoSpaces(xgi::Output *out)
 
 void gem::base::GEMMonitor::reset()
 {
-  // have to get rid of the timer
+  // take the monitor out of the shared scheduler
   DEBUG("GEMMonitor::reset");
-  for (auto infoSpace = m_infoSpaceMap.begin(); infoSpace != m_infoSpaceMap.end(); ++infoSpace) {
-    DEBUG("GEMMonitor::reset removing " << infoSpace->first << " from p_timer");
-    try {
-      p_timer->remove(infoSpace->first);
-    } catch (toolbox::task::exception::Exception& te) {
-      ERROR("GEMMonitor::Caught exception while removing timer task " << infoSpace->first << " " << te.what());
-    }
-  }
   stopMonitoring();
-  DEBUG("GEMMonitor::reset removing timer " << m_timerName << " from timerFactory");
-  try {
-    toolbox::task::getTimerFactory()->removeTimer(m_timerName);
-  } catch (toolbox::task::exception::Exception& te) {
-    ERROR("GEMMonitor::Caught exception while removing timer " << m_timerName << " " << te.what());
-  }
 
   // is this necessary? how to do for some applications and not others?
   // make this simply an interface and force every derived application to implement it properly
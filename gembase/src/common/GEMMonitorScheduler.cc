@@ -0,0 +1,416 @@
+/**
+ * class: GEMMonitorScheduler
+ * description: Single timer and bounded workloop pool driving the updates of all GEMMonitor objects
+ *              in the process, replacing the per monitor timers
+ */
+
+#include <unistd.h>
+
+#include <sstream>
+#include <algorithm>
+
+#include "gem/base/GEMMonitorScheduler.h"
+#include "gem/base/GEMMonitor.h"
+
+#include "gem/utils/GEMLogging.h"
+#include "gem/utils/LockGuard.h"
+
+#include "toolbox/string.h"
+#include "toolbox/TimeVal.h"
+#include "toolbox/task/Timer.h"
+#include "toolbox/task/TimerFactory.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
+#include "toolbox/task/Action.h"
+
+#include "xdaq/exception/Exception.h"
+#include "xcept/Exception.h"
+
+gem::base::GEMMonitorScheduler* gem::base::GEMMonitorScheduler::getInstance()
+{
+  // never deleted, the workloops and the timer live as long as the process
+  static GEMMonitorScheduler* instance = new GEMMonitorScheduler();
+  return instance;
+}
+
+gem::base::GEMMonitorScheduler::GEMMonitorScheduler() :
+  m_gemLogger(log4cplus::Logger::getInstance("GEMMonitorScheduler")),
+  m_lock(toolbox::BSem::FULL, true),
+  m_started(false),
+  m_tick(0),
+  m_nGroupsAdded(0),
+  m_nextWorker(0),
+  p_timer(NULL),
+  m_timerName("urn:gem:base:GEMMonitorScheduler:timer"),
+  p_cycleSig(NULL)
+{
+  p_cycleSig = toolbox::task::bind(this, &GEMMonitorScheduler::runCycle, "runCycle");
+}
+
+gem::base::GEMMonitorScheduler::~GEMMonitorScheduler()
+{
+}
+
+void gem::base::GEMMonitorScheduler::start()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  if (m_started)
+    return;
+
+  try {
+    for (unsigned worker = 0; worker < N_WORKERS; ++worker) {
+      std::string loopName = toolbox::toString("urn:toolbox-task-workloop:GEMMonitorScheduler:worker%d", worker);
+      DEBUG("GEMMonitorScheduler::start obtaining workloop " << loopName);
+      toolbox::task::WorkLoop* loop = toolbox::task::getWorkLoopFactory()->getWorkLoop(loopName, "waiting");
+      if (!loop->isActive())
+        loop->activate();
+      m_workers.push_back(loop);
+    }
+
+    DEBUG("GEMMonitorScheduler::start creating timer with name " << m_timerName);
+    if (toolbox::task::getTimerFactory()->hasTimer(m_timerName))
+      p_timer = toolbox::task::getTimerFactory()->getTimer(m_timerName);
+    else
+      p_timer = toolbox::task::getTimerFactory()->createTimer(m_timerName);
+
+    try {
+      p_timer->stop();
+    } catch (toolbox::task::exception::NotActive const& ex) {
+      DEBUG("GEMMonitorScheduler::start timer was not active " << ex.what());
+    }
+    p_timer->start();
+
+    toolbox::TimeVal startTime = toolbox::TimeVal::gettimeofday();
+    p_timer->scheduleAtFixedRate(startTime, this, toolbox::TimeInterval(0, TICK_MSEC*1000), 0, "GEMMonitorSchedulerTick");
+  } catch (toolbox::task::exception::Exception& te) {
+    m_workers.clear();
+    ERROR("GEMMonitorScheduler::start unable to set up the monitoring timer or workloops " << te.what());
+    XCEPT_RETHROW(xdaq::exception::Exception, "Cannot start GEMMonitorScheduler", te);
+  }
+
+  INFO("GEMMonitorScheduler::start running with " << N_WORKERS << " workers and a "
+       << TICK_MSEC << "ms tick");
+  m_started = true;
+}
+
+void gem::base::GEMMonitorScheduler::addMonitor(GEMMonitor* monitor, std::string const& group,
+                                                toolbox::TimeInterval const& interval)
+{
+  uint64_t usec        = static_cast<uint64_t>(interval.sec())*1000000 + interval.usec();
+  uint64_t periodTicks = usec/(TICK_MSEC*1000);
+  if (periodTicks < 1)
+    periodTicks = 1;
+
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+    auto mon = m_monitorGroups.find(monitor);
+    if (mon != m_monitorGroups.end() && mon->second == group) {
+      // already scheduled, only the interval may have changed
+      std::vector<MonitorEntry>& entries = m_groups.find(group)->second.entries;
+      for (auto entry = entries.begin(); entry != entries.end(); ++entry)
+        if (entry->monitor == monitor && !entry->removed)
+          entry->periodTicks = periodTicks;
+      return;
+    }
+  }
+
+  // moving to another group
+  removeMonitor(monitor);
+
+  start();
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  auto grp = m_groups.find(group);
+  if (grp == m_groups.end()) {
+    MonitorGroup newGroup;
+    newGroup.phase    = m_nGroupsAdded*PHASE_STRIDE_TICKS;
+    newGroup.busy     = false;
+    newGroup.running  = false;
+    newGroup.dueUsec  = 0;
+    newGroup.cycles   = 0;
+    newGroup.late     = 0;
+    newGroup.overruns = 0;
+    newGroup.skipped  = 0;
+    ++m_nGroupsAdded;
+    grp = m_groups.insert(std::make_pair(group, newGroup)).first;
+  }
+
+  MonitorEntry entry = {monitor, periodTicks, m_tick + 1 + (grp->second.phase % periodTicks), false, false};
+  grp->second.entries.push_back(entry);
+  m_monitorGroups.insert(std::make_pair(monitor, group));
+
+  DEBUG("GEMMonitorScheduler::addMonitor added monitor to group " << group
+        << " with period " << periodTicks << " ticks, phase " << (grp->second.phase % periodTicks)
+        << " (" << grp->second.entries.size() << " monitors in group)");
+}
+
+void gem::base::GEMMonitorScheduler::removeMonitor(GEMMonitor* monitor)
+{
+  // the caller may free the monitor as soon as we return, so never give up on a running cycle
+  timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  uint64_t nextWarnUsec = REMOVE_WARN_MSEC*1000;
+  while (true) {
+    {
+      gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+      auto mon = m_monitorGroups.find(monitor);
+      if (mon == m_monitorGroups.end())
+        return;
+
+      auto grp = m_groups.find(mon->second);
+      MonitorGroup& group = grp->second;
+      std::vector<MonitorEntry>& entries = group.entries;
+      auto entry = entries.begin();
+      for ( ; entry != entries.end(); ++entry)
+        if (entry->monitor == monitor && !entry->removed)
+          break;
+
+      // don't let it be scheduled again while we wait for the running cycle
+      entry->nextTick = ~static_cast<uint64_t>(0);
+      entry->due      = false;
+
+      if (!group.running) {
+        // a queued cycle picks its monitors when it starts, so the entry can go right away
+        entries.erase(entry);
+        DEBUG("GEMMonitorScheduler::removeMonitor removed monitor from group " << mon->second);
+        if (entries.empty())
+          m_groups.erase(grp);
+        m_monitorGroups.erase(mon);
+        return;
+      } else if (pthread_equal(group.runner, pthread_self())) {
+        // runCycle skips the monitor from now on and drops the entry when the cycle ends
+        entry->removed = true;
+        DEBUG("GEMMonitorScheduler::removeMonitor removed monitor from its own cycle of group " << mon->second);
+        m_monitorGroups.erase(mon);
+        return;
+      }
+
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      uint64_t waited = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, now);
+      if (waited > nextWarnUsec) {
+        WARN("GEMMonitorScheduler::removeMonitor still waiting for the monitoring cycle of group "
+             << mon->second << " after " << waited/1000 << "ms");
+        nextWarnUsec += REMOVE_WARN_MSEC*1000;
+      }
+    }
+    usleep(TICK_MSEC*1000/5);
+  }
+}
+
+bool gem::base::GEMMonitorScheduler::isScheduled(GEMMonitor* monitor, std::string const& group) const
+{
+  auto mon = m_monitorGroups.find(monitor);
+  return mon != m_monitorGroups.end() && mon->second == group;
+}
+
+void gem::base::GEMMonitorScheduler::timeExpired(toolbox::task::TimerEvent& event)
+{
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  ++m_tick;
+
+  for (auto grp = m_groups.begin(); grp != m_groups.end(); ++grp) {
+    MonitorGroup& group = grp->second;
+    bool     anyDue   = false;
+    uint64_t dueTicks = 0;
+    for (auto entry = group.entries.begin(); entry != group.entries.end(); ++entry) {
+      if (m_tick < entry->nextTick)
+        continue;
+
+      anyDue = true;
+      entry->nextTick += entry->periodTicks;
+      if (entry->nextTick <= m_tick)  // fell behind, e.g., after the timer thread was stalled
+        entry->nextTick = m_tick + entry->periodTicks;
+
+      if (group.busy)
+        continue;
+
+      entry->due = true;
+      if (dueTicks == 0 || entry->periodTicks < dueTicks)
+        dueTicks = entry->periodTicks;
+    }
+
+    if (!anyDue)
+      continue;
+
+    if (group.busy) {
+      // previous cycle still queued or running, drop this one rather than piling up
+      if ((group.skipped++ % REPORT_EVERY) == 0)
+        WARN("GEMMonitorScheduler::timeExpired monitoring cycle for " << grp->first
+             << " is still running when the next one is due, skipped " << group.skipped << " cycle(s) so far");
+      continue;
+    }
+
+    group.busy    = true;
+    group.dueTime = now;
+    group.dueUsec = dueTicks*TICK_MSEC*1000;
+    m_pending.push_back(grp->first);
+    try {
+      m_workers.at(m_nextWorker)->submit(p_cycleSig);
+      m_nextWorker = (m_nextWorker + 1) % m_workers.size();
+    } catch (toolbox::task::exception::Exception const& te) {
+      ERROR("GEMMonitorScheduler::timeExpired unable to submit monitoring cycle for " << grp->first
+            << " " << te.what());
+      m_pending.pop_back();
+      group.busy = false;
+      for (auto entry = group.entries.begin(); entry != group.entries.end(); ++entry)
+        entry->due = false;
+    }
+  }
+}
+
+bool gem::base::GEMMonitorScheduler::runCycle(toolbox::task::WorkLoop* wl)
+{
+  std::string groupName;
+  std::vector<GEMMonitor*> monitors;
+  timespec dueTime;
+  uint64_t dueUsec;
+
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+    if (m_pending.empty())
+      return false;
+    groupName = m_pending.front();
+    m_pending.pop_front();
+
+    auto grp = m_groups.find(groupName);
+    if (grp == m_groups.end())
+      return false;
+    for (auto entry = grp->second.entries.begin(); entry != grp->second.entries.end(); ++entry) {
+      if (entry->due)
+        monitors.push_back(entry->monitor);
+      entry->due = false;
+    }
+    dueTime = grp->second.dueTime;
+    dueUsec = grp->second.dueUsec;
+    grp->second.running = true;
+    grp->second.runner  = pthread_self();
+  }
+
+  timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  // monitors removed during the cycle, e.g., by their own update, are skipped from then on
+  std::vector<GEMMonitor*> begun;
+  std::vector<GEMMonitor*> batched;
+  GEMMonitor::RegisterReadList regs;
+  for (auto monitor = monitors.begin(); monitor != monitors.end(); ++monitor) {
+    {
+      gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+      if (!isScheduled(*monitor, groupName))
+        continue;
+    }
+    try {
+      (*monitor)->beginUpdateCycle();
+      begun.push_back(*monitor);
+      if ((*monitor)->collectRegisterReads(regs))
+        batched.push_back(*monitor);
+    } catch (xcept::Exception const& ex) {
+      ERROR("GEMMonitorScheduler::runCycle caught exception preparing monitor in group " << groupName
+            << " " << ex.what());
+    } catch (std::exception const& ex) {
+      ERROR("GEMMonitorScheduler::runCycle caught std::exception preparing monitor in group " << groupName
+            << " " << ex.what());
+    } catch (...) {
+      ERROR("GEMMonitorScheduler::runCycle caught unknown exception preparing monitor in group " << groupName);
+    }
+  }
+
+  // one transaction for the registers of the whole group
+  bool valid = true;
+  if (!batched.empty() && !regs.empty()) {
+    try {
+      valid = batched.front()->readRegisters(regs);
+    } catch (...) {
+      valid = false;
+    }
+    if (!valid)
+      WARN("GEMMonitorScheduler::runCycle reading " << regs.size() << " registers for group " << groupName
+           << " failed, keeping the previous values");
+  }
+
+  for (auto monitor = begun.begin(); monitor != begun.end(); ++monitor) {
+    bool scheduled;
+    {
+      gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+      scheduled = isScheduled(*monitor, groupName);
+    }
+    try {
+      if (scheduled) {
+        if (std::find(batched.begin(), batched.end(), *monitor) != batched.end())
+          (*monitor)->publishRegisterReads(regs, valid);
+        else
+          (*monitor)->updateMonitorables();
+      }
+    } catch (xcept::Exception const& ex) {
+      ERROR("GEMMonitorScheduler::runCycle caught exception updating monitor in group " << groupName
+            << " " << ex.what());
+    } catch (std::exception const& ex) {
+      ERROR("GEMMonitorScheduler::runCycle caught std::exception updating monitor in group " << groupName
+            << " " << ex.what());
+    } catch (...) {
+      ERROR("GEMMonitorScheduler::runCycle caught unknown exception updating monitor in group " << groupName);
+    }
+    // always, beginUpdateCycle holds the update lock of the monitor
+    try {
+      (*monitor)->endUpdateCycle();
+    } catch (...) {
+      ERROR("GEMMonitorScheduler::runCycle caught exception publishing monitor in group " << groupName);
+    }
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  uint64_t waited   = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(dueTime, start);
+  uint64_t duration = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  auto grp = m_groups.find(groupName);
+  if (grp == m_groups.end())
+    return false;
+
+  MonitorGroup& group = grp->second;
+  group.busy    = false;
+  group.running = false;
+  for (auto entry = group.entries.begin(); entry != group.entries.end(); )
+    if (entry->removed)
+      entry = group.entries.erase(entry);
+    else
+      ++entry;
+  ++group.cycles;
+  group.cycleTime.record(duration);
+
+  if (waited > TICK_MSEC*1000 && (group.late++ % REPORT_EVERY) == 0)
+    WARN("GEMMonitorScheduler::runCycle monitoring cycle for " << groupName << " started "
+         << waited/1000 << "ms late, all " << N_WORKERS << " workers busy? ("
+         << group.late << " late cycle(s) so far)");
+
+  if (duration > dueUsec && (group.overruns++ % REPORT_EVERY) == 0)
+    WARN("GEMMonitorScheduler::runCycle monitoring cycle for " << groupName << " took "
+         << duration/1000 << "ms, longer than its " << dueUsec/1000 << "ms interval ("
+         << group.overruns << " overrun(s) so far)");
+
+  if (group.entries.empty())
+    m_groups.erase(grp);
+
+  return false;
+}
+
+std::string gem::base::GEMMonitorScheduler::getStatistics()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  std::stringstream stats;
+  for (auto grp = m_groups.begin(); grp != m_groups.end(); ++grp) {
+    MonitorGroup const& group = grp->second;
+    stats << grp->first
+          << " monitors="  << group.entries.size()
+          << " cycles="    << group.cycles
+          << " late="      << group.late
+          << " overruns="  << group.overruns
+          << " skipped="   << group.skipped
+          << " cycle time " << group.cycleTime.toString()
+          << std::endl;
+  }
+  return stats.str();
+}
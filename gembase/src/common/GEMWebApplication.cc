@@ -2,6 +2,10 @@
 
 #include "gem/base/GEMWebApplication.h"
 
+#include <stdlib.h>
+
+#include "cgicc/Cgicc.h"
+
 #include "xcept/tools.h"
 
 #include "xgi/framework/UIManager.h"
@@ -295,16 +299,29 @@ void gem::base::GEMWebApplication::jsonUpdate(xgi::Input *in, xgi::Output *out)
 {
   DEBUG("GEMWebApplication::jsonUpdate");
   out->getHTTPResponseHeader().addHeader("Content-Type", "application/json");
+  uint64_t since    = getJSONSince(in);
+  uint64_t sequence = GEMMonitor::getJSONSequence();
   *out << " { " << std::endl;
   auto monitor = p_gemFSMApp->p_gemMonitor;
   // if (p_gemMonitor) {
   if (monitor) {
     // p_gemMonitor->jsonUpdateItemSets(out);
-    monitor->jsonUpdateItemSets(out);
+    if (monitor->jsonUpdateItemSets(out, since))
+      *out << "," << std::endl;
   }
+  *out << "\"jsonSequence\" : " << sequence << std::endl;
   *out << " } " << std::endl;
 }
 
+uint64_t gem::base::GEMWebApplication::getJSONSince(xgi::Input* in)
+{
+  cgicc::Cgicc cgi(in);
+  cgicc::const_form_iterator since = cgi.getElement("since");
+  if (since == cgi.getElements().end())
+    return 0;
+  return strtoull(since->getValue().c_str(), NULL, 10);
+}
+
 /* *FSM callbacks */
 /*To be filled in with the startup (enable) routine*/
 void gem::base::GEMWebApplication::webInitialize(xgi::Input *in, xgi::Output *out)
@@ -1,5 +1,7 @@
 #include "gem/base/utils/GEMInfoSpaceToolBox.h"
 
+#include <iomanip>
+
 #include "toolbox/string.h"
 
 #include "xdaq/ApplicationStub.h"
@@ -12,6 +14,7 @@ gem::base::utils::GEMInfoSpaceToolBox::GEMInfoSpaceToolBox(gem::base::GEMApplica
                                                            // gem::base::GEMMonitor* gemMonitor,
                                                            bool autoPush) :
   m_gemLogger(gemApp->getApplicationLogger()),
+  m_generation(0),
   p_gemApp(gemApp),
   // p_gemMonitor(gemMonitor),
   p_infoSpace(infoSpace)
@@ -26,6 +29,7 @@ gem::base::utils::GEMInfoSpaceToolBox::GEMInfoSpaceToolBox(gem::base::GEMApplica
                                                            // gem::base::GEMMonitor* gemMonitor,
                                                            bool autoPush) :
   m_gemLogger(gemApp->getApplicationLogger()),
+  m_generation(0),
   p_gemApp(gemApp)
   // p_gemMonitor),
 {
@@ -985,7 +989,18 @@ std::string gem::base::utils::GEMInfoSpaceToolBox::getFormattedItem(std::string
       WARN("GEMInfoSpaceToolBox::Unsupported format " << format);
       result << val;
     }
-  }  // end of type == STRING
+  } else if (type == DOUBLE) {  // end of type == STRING
+    double val = this->getDouble(itemName);
+    DEBUG(itemName << " has value " << val);
+    if ( format == "" ) {
+      result << val;
+    } else if ( format == "dec" ) {
+      result << std::fixed << std::setprecision(2) << val;
+    } else  {
+      WARN("GEMInfoSpaceToolBox::Unsupported format " << format);
+      result << val;
+    }
+  }  // end of type == DOUBLE
 
   return result.str();
 }
@@ -1016,6 +1031,8 @@ void gem::base::utils::GEMInfoSpaceToolBox::reset()
   }
   // now clear out the map so it could be repopulated
   m_itemMap.clear();
+  // and invalidate all outstanding handles
+  ++m_generation;
 
   // simply empty the item lists?
   m_uint32Items.clear();
@@ -1027,3 +1044,30 @@ void gem::base::utils::GEMInfoSpaceToolBox::reset()
   m_doubleItems.clear();
   m_stringItems.clear();
 }
+
+gem::base::utils::GEMInfoSpaceToolBox::UpdateBatch::UpdateBatch(GEMInfoSpaceToolBox* toolbox, NotifyMode mode) :
+  p_toolbox(toolbox),
+  m_mode(mode)
+{
+  p_toolbox->p_infoSpace->lock();
+}
+
+gem::base::utils::GEMInfoSpaceToolBox::UpdateBatch::~UpdateBatch()
+{
+  xdata::InfoSpace* infoSpace = p_toolbox->p_infoSpace;
+  try {
+    if (!m_changed.empty()) {
+      if (m_mode == NOTIFY_GROUP) {
+        infoSpace->fireItemGroupChanged(m_changed, this);
+      } else if (m_mode == NOTIFY_ITEMS) {
+        for (auto item = m_changed.begin(); item != m_changed.end(); ++item)
+          infoSpace->fireItemValueChanged(*item, this);
+      }
+    }
+  } catch (...) {
+    log4cplus::Logger m_gemLogger = p_toolbox->m_gemLogger;
+    ERROR("GEMInfoSpaceToolBox::UpdateBatch failed to notify the change of "
+          << m_changed.size() << " items in " << infoSpace->name());
+  }
+  infoSpace->unlock();
+}
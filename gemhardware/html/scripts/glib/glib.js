@@ -1,9 +1,17 @@
+// sequence number of the last update received, after the first full update only changes are requested
+var jsonSequence = 0;
+
 function sendrequest( jsonurl )
 {
+    if (jsonSequence > 0)
+        jsonurl = jsonurl + "?since=" + jsonSequence;
+
     if (window.jQuery) {
         // can use jQuery libraries rather than raw javascript
         $.getJSON(jsonurl)
             .done(function(data) {
+                    if ("jsonSequence" in data)
+                        jsonSequence = data.jsonSequence;
                     updateGLIBMonitorables( data );
                 })
             .fail(function(data, textStatus, error) {
@@ -22,6 +30,8 @@ function sendrequest( jsonurl )
                     var res = eval( "(" + xmlhttp.responseText + ")" );
                     console.log("response:"+xmlhttp.responseText);
                     console.log("res:"+res);
+                    if ("jsonSequence" in res)
+                        jsonSequence = res.jsonSequence;
                     updateGLIBMonitorables( res );
                 }
             };
@@ -33,11 +43,16 @@ function sendrequest( jsonurl )
 function updateGLIBMonitorables( glibjson )
 {
     for ( var glib in glibjson ) {
+        if (glib == "jsonSequence")
+            continue;
         var monitorset = glibjson[glib];
         for ( var monitem in monitorset ) {
             var arr = monitorset[monitem];
             for( var i = 0; i < arr.length; ++i ) {
-                document.getElementById( arr[i].name ).innerHTML = arr[i].value;
+                var elem = document.getElementById( arr[i].name );
+                elem.innerHTML = arr[i].value;
+                // the last read failed, the previous value is kept
+                elem.style.color = arr[i].stale ? "gray" : "";
             }
         }
     }
@@ -5,12 +5,20 @@ function pdebug( text )
     document.getElementById("debug").innerHTML = text;
 };
 
+// sequence number of the last update received, after the first full update only changes are requested
+var jsonSequence = 0;
+
 function sendrequest( jsonurl )
 {
+    if (jsonSequence > 0)
+        jsonurl = jsonurl + "?since=" + jsonSequence;
+
     if (window.jQuery) {
         // can use jQuery libraries rather than raw javascript
         $.getJSON(jsonurl)
             .done(function(data) {
+                    if ("jsonSequence" in data)
+                        jsonSequence = data.jsonSequence;
                     updateOptoHybridMonitorables( data );
                 })
             .fail(function(data, textStatus, error) {
@@ -29,6 +37,8 @@ function sendrequest( jsonurl )
                     var res = eval( "(" + xmlhttp.responseText + ")" );
                     console.log("response:"+xmlhttp.responseText);
                     console.log("res:"+res);
+                    if ("jsonSequence" in res)
+                        jsonSequence = res.jsonSequence;
                     updateOptoHybridMonitorables( res );
                 }
             };
@@ -40,12 +50,17 @@ function sendrequest( jsonurl )
 function updateOptoHybridMonitorables( glibjson )
 {
     for ( var glib in glibjson ) {
+        if (glib == "jsonSequence")
+            continue;
         var monitorset = glibjson[glib];
         for ( var monitem in monitorset ) {
             var arr = monitorset[monitem];
             for( var i = 0; i < arr.length; ++i ) {
                 try {
-                    document.getElementById( arr[i].name ).innerHTML = arr[i].value;
+                    var elem = document.getElementById( arr[i].name );
+                    elem.innerHTML = arr[i].value;
+                    // the last read failed, the previous value is kept
+                    elem.style.color = arr[i].stale ? "gray" : "";
                 } catch (err) {
                     console.error(err.message);
                 }
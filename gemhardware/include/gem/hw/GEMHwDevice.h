@@ -18,6 +18,7 @@
 
 #include "gem/utils/GEMLogging.h"
 #include "gem/utils/GEMRegisterUtils.h"
+#include "gem/utils/GEMLatencyHistogram.h"
 
 #include "gem/utils/Lock.h"
 #include "gem/utils/LockGuard.h"
@@ -47,6 +48,12 @@ namespace uhal {
 }
 
 namespace gem {
+  namespace base {
+    namespace utils {
+      class GEMInfoSpaceToolBox;
+    }
+  }
+
   namespace hw {
 
     class GEMHwDevice
@@ -106,6 +113,35 @@ namespace gem {
       typedef std::pair<uint8_t, OpticalLinkStatus>  linkStatus;
       //typedef std::vector<linkStatus>                linkStatus;
 
+      /**
+       * IPBusCategory identifies the kind of caller performing an IPBus transaction,
+       * dispatch latencies are histogrammed separately for each category
+       */
+      enum IPBusCategory { CONFIGURATION = 0,  //!< default, FSM transitions, scans, expert pages
+                           MONITORING,         //!< periodic monitoring updates
+                           READOUT,            //!< data FIFO reads
+                           N_IPBUS_CATEGORIES
+      };
+
+      /**
+       * @class IPBusCategoryGuard
+       * @brief Tags all IPBus transactions made by the current thread with a category
+       * for as long as the guard is in scope, the previous category is restored on destruction
+       */
+      class IPBusCategoryGuard
+      {
+      public:
+        IPBusCategoryGuard(IPBusCategory const& category);
+        ~IPBusCategoryGuard();
+
+      private:
+        IPBusCategory m_previous;
+
+        // Prevent copying.
+        IPBusCategoryGuard(IPBusCategoryGuard const&);
+        IPBusCategoryGuard& operator=(IPBusCategoryGuard const&);
+      };
+
       /**
        * GEMHwDevice constructor
        * @param deviceName string to put into the logger
@@ -177,24 +213,27 @@ namespace gem {
        * read list of registers in a single transaction (one dispatch call)
        * into the supplied vector regList
        * @param regList list of register name and uint32_t value to store the result
+       * @returns false if the registers could not be read, the values in regList are then left unchanged
        */
-      void     readRegs( register_pair_list &regList);
+      bool     readRegs( register_pair_list &regList);
 
       /**
        * readRegs( addressed_register_pair_list &regList)
        * read list of registers in a single transaction (one dispatch call)
        * into the supplied vector regList
        * @param regList list of register address and uint32_t value to store the result
+       * @returns false if the registers could not be read, the values in regList are then left unchanged
        */
-      void     readRegs( addressed_register_pair_list &regList);
+      bool     readRegs( addressed_register_pair_list &regList);
 
       /**
        * readRegs( masked_register_pair_list &regList)
        * read list of registers in a single transaction (one dispatch call)
        * into the supplied vector regList
        * @param regList list of register address/mask pair and uint32_t value to store the result
+       * @returns false if the registers could not be read, the values in regList are then left unchanged
        */
-      void     readRegs( masked_register_pair_list &regList);
+      bool     readRegs( masked_register_pair_list &regList);
 
       /**
        * writeReg(std::string const& regName, uint32_t const val)
@@ -270,6 +309,19 @@ namespace gem {
       std::vector<uint32_t> readBlock( std::string const& regName,
                                        size_t      const& nWords);
 
+      /**
+       * readBlocks(std::vector<std::string> const& regNames, size_t const nWords)
+       * read the same number of words from several memory blocks or FIFOs in a single transaction
+       * (one dispatch call)
+       * @param regNames memory blocks to read from
+       * @param nWords number of words to read from each block
+       * @retval returns one vector of 32 bit unsigned values per block, in the order of regNames
+       * @throws gem::hw::exception::HardwareProblem if the blocks could not be read,
+       * unlike readBlock, which returns zeroed words
+       */
+      std::vector<std::vector<uint32_t> > readBlocks(std::vector<std::string> const& regNames,
+                                                     size_t                   const& nWords);
+
       uint32_t readBlock(std::string const& regName, uint32_t* buffer, size_t const& nWords);
       uint32_t readBlock(std::string const& regName, std::vector<toolbox::mem::Reference*>& buffer,
                          size_t const& nWords);
@@ -366,6 +418,39 @@ namespace gem {
 
       virtual std::string printErrorCounts() const;
 
+      /**
+       * @param category the caller category for which to retrieve the dispatch latencies
+       * @returns a copy of the dispatch latency histogram, taken under the hardware lock
+       */
+      gem::utils::GEMLatencyHistogram getIPBusLatency(IPBusCategory const& category) const;
+
+      /**
+       * @brief clear the dispatch latency histograms of all categories
+       */
+      void resetIPBusLatency();
+
+      /**
+       * @returns the name of the category, as used in the monitoring items
+       */
+      static std::string getIPBusCategoryName(IPBusCategory const& category);
+
+      /**
+       * @returns the names of the InfoSpace items holding the dispatch latency summaries
+       */
+      static std::vector<std::string> getIPBusLatencyItemNames();
+
+      /**
+       * @brief creates the dispatch latency summary items in the given InfoSpace
+       * @param is the InfoSpace toolbox (e.g., the HWMonitoring InfoSpace of the device)
+       */
+      void createIPBusLatencyItems(gem::base::utils::GEMInfoSpaceToolBox* is);
+
+      /**
+       * @brief copies the current dispatch latency summaries into the given InfoSpace
+       * @param is the InfoSpace toolbox in which createIPBusLatencyItems was called
+       */
+      void updateIPBusLatencyItems(gem::base::utils::GEMInfoSpaceToolBox* is);
+
       /**
        * @brief performs a general reset of the GLIB
        */
@@ -401,6 +486,13 @@ namespace gem {
       void setParametersFromInfoSpace();
       void setup(std::string const& deviceName);
 
+      /**
+       * @brief dispatches the queued transactions, recording the round trip time
+       * in the histogram of the calling thread's category, must be called with m_hwLock held
+       * @param hw the uhal interface on which to call dispatch
+       */
+      void dispatch(uhal::HwInterface& hw);
+
     private:
       std::string m_controlHubIPAddress;
       std::string m_addressTable;
@@ -413,6 +505,10 @@ namespace gem {
       uint32_t m_controlHubPort;
       uint32_t m_ipBusPort;
 
+      gem::utils::GEMLatencyHistogram m_ipBusLatency[N_IPBUS_CATEGORIES];
+
+      static __thread IPBusCategory s_ipBusCategory;
+
       //infospace im(ex)portables
       xdata::String xs_controlHubIPAddress;
       xdata::String xs_deviceIPAddress;
@@ -29,6 +29,18 @@ namespace gem {
 
         virtual void updateMonitorables();
         virtual void reset();
+
+        virtual bool collectRegisterReads(RegisterReadList& regs);
+        virtual bool readRegisters(RegisterReadList& regs);
+        virtual void publishRegisterReads(RegisterReadList const& regs, bool const& valid);
+
+        /**
+         * All monitors of the same board (GLIB and its OptoHybrids) share the uHAL target,
+         * so the scheduler runs them back to back rather than concurrently
+         * @returns the uHAL URI of the monitored device
+         */
+        virtual std::string getSchedulerGroup() const { return p_glib->getGEMHwInterface().uri(); };
+
         void setupHwMonitoring();
         void buildMonitorPage(xgi::Output* out);
         std::string getDeviceID() { return p_glib->getDeviceID(); }
@@ -36,6 +48,10 @@ namespace gem {
       private:
         std::shared_ptr<HwGLIB> p_glib;
 
+        // filled by collectRegisterReads, item and offset of its first register in the read list
+        std::vector<std::pair<GEMMonitorable*, size_t> > m_pendingItems;
+        std::vector<std::string> m_pendingSets;
+
         // system_monitorables
         //  "BOARD_ID"
         //  "SYSTEM_ID"
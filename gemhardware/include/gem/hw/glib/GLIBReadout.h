@@ -2,7 +2,13 @@
 #define GEM_HW_GLIB_GLIBREADOUT_H
 
 #include "gem/readout/GEMReadoutApplication.h"
+#include <fstream>
+#include <memory>
+
 #include "gem/readout/GEMDataAMCformat.h"
+#include "gem/readout/GEMEventArena.h"
+#include "gem/readout/GEMEventBuilder.h"
+#include "gem/readout/GEMEventSerializer.h"
 #include "gem/hw/glib/exception/Exception.h"
 
 namespace gem {
@@ -69,21 +75,13 @@ namespace gem {
 
           void GEMevSelector(const uint32_t& ES);
 
-          void GEMfillHeaders(uint32_t const& BC, uint32_t const& BX,
-                              gem::readout::GEMDataAMCformat::GEMData& gem,
-                              gem::readout::GEMDataAMCformat::GEBData& geb);
-
-          bool VFATfillData(/*int const& islot, */gem::readout::GEMDataAMCformat::GEBData& geb);
-
-          void GEMfillTrailers(gem::readout::GEMDataAMCformat::GEMData& gem,
-                               gem::readout::GEMDataAMCformat::GEBData& geb);
-
-          void writeGEMevent(std::string outFile,
-                             bool const& OKprint,
-                             std::string const& TypeDataFlag,
-                             gem::readout::GEMDataAMCformat::GEMData& gem,
-                             gem::readout::GEMDataAMCformat::GEBData& geb,
-                             gem::readout::GEMDataAMCformat::VFATData& vfat);
+          /**
+           * @brief writes the whole event to outf, in the format chosen in configureAction
+           * @returns the time spent writing, in nanoseconds, which is recorded as the write stage
+           */
+          uint64_t writeGEMevent(std::ofstream& outf,
+                                 gem::readout::GEMArenaEvent const& gem,
+                                 gem::readout::GEMArenaGEB const& geb);
 
           int queueDepth() {return m_dataque.size();}
 
@@ -94,13 +92,13 @@ namespace gem {
           glib_shared_ptr p_glib;
 
           // copied in from GEMDataParker
-          uint32_t m_ESexp;
-          bool     m_isFirst;
           //uint64_t m_ZSFlag;
           uint32_t m_contvfats;
 
           void readVFATblock(std::queue<uint32_t>& dataque);
 
+          void closeOutputFiles();
+
           // this can't be the best way to do this...
           uint32_t dat10,dat11, dat20,dat21, dat30,dat31, dat40,dat41;
           uint32_t BX;
@@ -110,13 +108,8 @@ namespace gem {
 
           uint8_t m_latency, m_VT1, m_VT2;
 
-          //why are these global and not part of the header???
-          std::vector<AMCVFATData> m_vfats;
-          std::vector<AMCVFATData> m_erros;
-          int m_rvent;
-
-          static const int MaxVFATS = 24; // was 32 ???
-          static const int MaxERRS  = 4095; // should this also be 24? Or we can accomodate full GLIB FIFO of bad blocks belonging to the same event?
+          // builds the events in recycled fixed capacity records, without a slot map all VFATs are payload
+          gem::readout::GEMEventBuilder m_builder;
 
           //std::unique_ptr<GEMslotContents> slotInfo;// time to die!!!
 
@@ -127,6 +120,11 @@ namespace gem {
           std::string m_errFileName;
           std::string m_outputType;
 
+          // resolved from m_outputType in configureAction
+          std::unique_ptr<gem::readout::GEMEventSerializer> p_serializer;
+          std::ofstream m_outFile;
+          std::ofstream m_errFile;
+
           // queue safety
           mutable gem::utils::Lock m_queueLock;
           // The main data flow
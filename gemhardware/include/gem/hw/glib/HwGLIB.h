@@ -3,6 +3,8 @@
 
 //nclude "toolbox/Task.h"
 
+#include "toolbox/TimeVal.h"
+
 #include "gem/hw/GEMHwDevice.h"
 
 #include "gem/hw/glib/exception/Exception.h"
@@ -55,6 +57,61 @@ namespace gem {
               return; };
           } GLIBIPBusCounters;
 
+          /**
+           * @struct GLIBGTXStatus
+           * @brief Status of one GTX link, as read by getStatusSnapshot
+           */
+          typedef struct GLIBGTXStatus {
+            GEMHwDevice::OpticalLinkStatus link;  ///< COUNTERS.GTXn error and packet counters
+            GLIBIPBusCounters ipBus;              ///< COUNTERS.IPBus counters of the link
+            uint32_t daqStatus        ;           ///< DAQ.GTXn.STATUS
+            uint32_t corruptVFATBlocks;           ///< DAQ.GTXn.COUNTERS.CORRUPT_VFAT_BLK_CNT
+            uint32_t eventNumber      ;           ///< DAQ.GTXn.COUNTERS.EVN
+            uint32_t lastBlock        ;           ///< DAQ.GTXn.LASTBLOCK
+            uint32_t davTimeout       ;           ///< DAQ.GTXn.CONTROL.DAV_TIMEOUT
+            uint32_t maxDAVTimer      ;           ///< DAQ.GTXn.COUNTERS.MAX_DAV_TIMER
+            uint32_t lastDAVTimer     ;           ///< DAQ.GTXn.COUNTERS.LAST_DAV_TIMER
+          } GLIBGTXStatus;
+
+          /**
+           * @struct GLIBStatusSnapshot
+           * @brief System, TTC, DAQ link and IPBus counter registers of the GLIB, read together
+           * All values come from the same IPBus transaction, at the time given by timestamp.
+           * If the transaction failed, valid is false and the register values are all zero.
+           */
+          typedef struct GLIBStatusSnapshot {
+            bool             valid;
+            toolbox::TimeVal timestamp;  ///< when the transaction was started
+            uint64_t         readUsec;   ///< duration of the transaction, retries included
+
+            // system registers
+            uint32_t boardID, systemID, firmwareID, firmwareDate;
+            uint32_t ipAddress, macUpper, macLower;
+            uint32_t sfpStatus[4];
+            uint32_t fmcPresent[2];
+            uint32_t fpgaReset, gbeInterrupt, v6CPLD, cdceLock;
+
+            // TTC registers and T1 counters
+            uint32_t ttcControl, ttcSpy;
+            uint32_t l1a, calPulse, resync, bc0;
+
+            // DAQ link registers
+            uint32_t daqControl, daqStatus, daqInputMask, daqDAVTimeout;
+            uint32_t daqMaxDAVTimer, daqLastDAVTimer;
+            uint32_t daqNotInTableErrors, daqDisperErrors, daqEventsSent, daqL1AID;
+            uint32_t daqInputTimeout, daqRunType, daqRunParams;
+
+            // IPBus counters of the counter module, also copied into each gtx[].ipBus
+            uint32_t counterStrobe, counterAck;
+
+            GLIBGTXStatus gtx[N_GTX];
+
+          GLIBStatusSnapshot() :
+            valid(false), readUsec(0) {};
+            uint64_t getMACAddress() const {
+              return (static_cast<uint64_t>(macUpper) << 32) + macLower; };
+          } GLIBStatusSnapshot;
+
 
           /**
            * Constructors, the preferred constructor is with a connection file and device name
@@ -457,6 +514,13 @@ namespace gem {
               LinkReset(gtx->first,resets);
           };
 
+          /**
+           * @returns the gtx links found to be active by the last connection check
+           */
+          std::vector<linkStatus> const& getActiveLinks() const {
+            return v_activeLinks;
+          };
+
           /**
            * Set the Trigger source
            * @param uint8_t mode 0 from software, 1 from TTC decoder (AMC13), 2 from both
@@ -508,6 +572,14 @@ namespace gem {
            */
           GLIBIPBusCounters getIPBusCounters(uint8_t const& gtx, uint8_t const& mode);
 
+          /**
+           * Read the system, TTC, DAQ link, GTX link and IPBus counter registers of the board
+           * in a single IPBus transaction, rather than with one dispatch per getter
+           * The register names are built on the first call only.
+           * @returns GLIBStatusSnapshot struct, with valid false if the transaction failed
+           */
+          GLIBStatusSnapshot getStatusSnapshot();
+
           /**
            * Get the recorded number of L1A signals received from the TTC decoder
            */
@@ -886,6 +958,8 @@ namespace gem {
           // uint8_t m_controlLink;
           int m_crate, m_slot;
 
+          register_pair_list m_statusRegs;  ///< registers read by getStatusSnapshot, in mapStatusRegisters order
+
         };  // class HwGLIB
     }  // namespace gem::hw::glib
   }  // namespace gem::hw
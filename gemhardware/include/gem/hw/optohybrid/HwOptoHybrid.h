@@ -177,6 +177,13 @@ namespace gem {
           HwOptoHybrid(std::string const& optohybridDevice, std::string const& connectionFile);
           HwOptoHybrid(std::string const& optohybridDevice, std::string const& connectionURI,
                        std::string const& addressTable);
+          /**
+           * The other constructors take the link from the last character of the device name,
+           * which only works for links 0 to 9 and for names following that convention
+           * @param link the GTX link of the GLIB the OptoHybrid is connected to
+           */
+          HwOptoHybrid(std::string const& optohybridDevice, std::string const& connectionURI,
+                       std::string const& addressTable, int const& link);
           HwOptoHybrid(std::string const& optohybridDevice, uhal::HwInterface& uhalDevice);
           HwOptoHybrid(gem::hw::glib::HwGLIB const& glib, int const& slot);
 
@@ -547,24 +554,28 @@ namespace gem {
                                       uint8_t const& step,
                                       uint8_t const& chip, uint8_t const& channel,
                                       bool reset) {
+            std::string const base = getDeviceBaseNode()+".ScanController.THLAT.";
+            register_pair_list regs;
             if (reset)
-              writeReg(getDeviceBaseNode(),"ScanController.THLAT.RESET",0x1);
+              regs.push_back(std::make_pair(base+"RESET", 0x1));
 
-            writeReg(getDeviceBaseNode(),"ScanController.THLAT.MODE", mode);
-            writeReg(getDeviceBaseNode(),"ScanController.THLAT.MIN",  min);
-            writeReg(getDeviceBaseNode(),"ScanController.THLAT.MAX",  max);
-            writeReg(getDeviceBaseNode(),"ScanController.THLAT.STEP", step);
+            regs.push_back(std::make_pair(base+"MODE", mode));
+            regs.push_back(std::make_pair(base+"MIN",  min));
+            regs.push_back(std::make_pair(base+"MAX",  max));
+            regs.push_back(std::make_pair(base+"STEP", step));
 
             // need also to enable this chip and disable all others, use a broadcast write?
-            writeReg(getDeviceBaseNode(),"ScanController.THLAT.CHIP", chip);
+            regs.push_back(std::make_pair(base+"CHIP", chip));
             if (mode == 0x1 || mode == 0x3) {
               // protect for non-existent channels?
               // need also to enable this channel and disable all others
-              writeReg(getDeviceBaseNode(),"ScanController.THLAT.CHAN",channel);
+              regs.push_back(std::make_pair(base+"CHAN", channel));
               if (mode == 0x3) {
                 // need also to enable cal pulse to this channel and disable all others
               }
             }
+            // the whole configuration goes out in a single transaction
+            writeRegs(regs);
           };
 
           /**
@@ -610,6 +621,25 @@ namespace gem {
             return readReg(getDeviceBaseNode(),"ScanController.THLAT.RESULTS");
           };
 
+          /**
+           * @brief Get all the results of the last scan in a single block read of the results FIFO
+           * @param uint32_t npoints the number of points in the scan
+           * @returns std::vector<uint32_t> one word per scan point, the 8 MSBs hold the scanned value
+           * and the 24 LSBs hold the number of events that fired
+           * @throws gem::hw::exception::HardwareProblem if the FIFO could not be read
+           */
+          std::vector<uint32_t> getScanResults(uint32_t const& npoints) {
+            std::vector<std::string> fifo(1, getDeviceBaseNode()+".ScanController.THLAT.RESULTS");
+            return readBlocks(fifo, npoints).front();
+          };
+
+          /**
+           * @brief Number of points a scan from min to max in steps of step will produce
+           */
+          static uint32_t getScanPoints(uint8_t const& min, uint8_t const& max, uint8_t const& step) {
+            return (max < min || step == 0) ? 0 : ((max-min)/step)+1;
+          };
+
           /**
            * @brief the T1 module is very different between V1/1.5 and V2
            * One must select the mode
@@ -590,6 +590,22 @@ namespace gem {
             return readVFATReg(toolbox::toString("VFATChannels.ChanReg%d",(unsigned)channel)); }
           uint8_t getChannelTrimDAC(uint8_t channel);
           void    setChannelTrimDAC(uint8_t channel, uint8_t trimDAC);
+
+          /**
+           * @brief Read the TrimDAC of all 128 channels in a single transaction
+           * @param trimDACs filled with the TrimDAC values, element 0 is channel 1, left empty if the read fails
+           * @returns whether the channel registers could be read
+           */
+          bool    getChannelTrimDACs(std::vector<uint8_t>& trimDACs);
+
+          /**
+           * @brief Set the TrimDAC of all 128 channels, the channel registers are read in one
+           * transaction and written back in another, so the other channel settings are kept
+           * Nothing is written if the channel registers cannot be read
+           * @param trimDACs one value per channel, element 0 is channel 1
+           * @returns false if nothing was written
+           */
+          bool    setChannelTrimDACs(std::vector<uint8_t> const& trimDACs);
           //void    setChannelTrimDAC(uint8_t channel, double trimDAC);
 
           uhal::HwInterface& getVFAT2HwInterface() {
@@ -1,10 +1,25 @@
 /*General structure taken blatantly from tcds::utils::HwDeviceTCA as we're using the same card*/
 
+#include <array>
+
 #include "toolbox/net/URN.h"
 
 #include "gem/hw/GEMHwDevice.h"
 #include "gem/base/utils/GEMInfoSpaceToolBox.h"
 
+__thread gem::hw::GEMHwDevice::IPBusCategory gem::hw::GEMHwDevice::s_ipBusCategory = gem::hw::GEMHwDevice::CONFIGURATION;
+
+gem::hw::GEMHwDevice::IPBusCategoryGuard::IPBusCategoryGuard(IPBusCategory const& category) :
+  m_previous(GEMHwDevice::s_ipBusCategory)
+{
+  GEMHwDevice::s_ipBusCategory = category;
+}
+
+gem::hw::GEMHwDevice::IPBusCategoryGuard::~IPBusCategoryGuard()
+{
+  GEMHwDevice::s_ipBusCategory = m_previous;
+}
+
 gem::hw::GEMHwDevice::GEMHwDevice(std::string const& deviceName,
                                   std::string const& connectionFile) :
   b_is_connected(false),
@@ -256,7 +271,7 @@ uint32_t gem::hw::GEMHwDevice::readReg(std::string const& name)
     ++retryCount;
     try {
       uhal::ValWord<uint32_t> val = hw.getNode(name).read();
-      hw.dispatch();
+      dispatch(hw);
       res = val.value();
       TRACE("GEMHwDevice::Successfully read register " << name.c_str() << " with value 0x"
             << std::setfill('0') << std::setw(8) << std::hex << res << std::dec
@@ -303,7 +318,7 @@ uint32_t gem::hw::GEMHwDevice::readReg(uint32_t const& address)
     ++retryCount;
     try {
       uhal::ValWord<uint32_t> val = hw.getClient().read(address);
-      hw.dispatch();
+      dispatch(hw);
       res = val.value();
       TRACE("GEMHwDevice::Successfully read register 0x" << std::setfill('0') << std::setw(8)
             << std::hex << address << std::dec << " with value 0x"
@@ -353,7 +368,7 @@ uint32_t gem::hw::GEMHwDevice::readReg(uint32_t const& address, uint32_t const&
     ++retryCount;
     try {
       uhal::ValWord<uint32_t> val = hw.getClient().read(address,mask);
-      hw.dispatch();
+      dispatch(hw);
       res = val.value();
       TRACE("GEMHwDevice::Successfully read register 0x" << std::setfill('0') << std::setw(8)
             << std::hex << address << std::dec << " with mask "
@@ -399,7 +414,7 @@ uint32_t gem::hw::GEMHwDevice::readMaskedAddress(std::string const& name)
   return readReg(address,mask);
 }
 
-void gem::hw::GEMHwDevice::readRegs(register_pair_list &regList)
+bool gem::hw::GEMHwDevice::readRegs(register_pair_list &regList)
 {
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
   uhal::HwInterface& hw = getGEMHwInterface();
@@ -412,14 +427,14 @@ void gem::hw::GEMHwDevice::readRegs(register_pair_list &regList)
       // vals.reserve(regList.size());
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
         vals.push_back(std::make_pair(curReg->first,hw.getNode(curReg->first).read()));
-      hw.dispatch();
+      dispatch(hw);
 
       // would like to have these local to the loop, how to do...?
       auto curVal = vals.begin();
       auto curReg = regList.begin();
       for ( ; curReg != regList.end(); ++curVal,++curReg)
         curReg->second = (curVal->second).value();
-      return;
+      return true;
     } catch (uhal::exception::exception const& err) {
       std::string msgBase = "Could not read from register in list:";
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
@@ -445,9 +460,10 @@ void gem::hw::GEMHwDevice::readRegs(register_pair_list &regList)
   std::string msg = toolbox::toString("Maximum number of retries reached, unable to read registers");
   ERROR("GEMHwDevice::" << msg);
   // XCEPT_RAISE(gem::hw::exception::HardwareProblem, msg);
+  return false;
 }
 
-void gem::hw::GEMHwDevice::readRegs(addressed_register_pair_list &regList)
+bool gem::hw::GEMHwDevice::readRegs(addressed_register_pair_list &regList)
 {
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
   uhal::HwInterface& hw = getGEMHwInterface();
@@ -460,14 +476,14 @@ void gem::hw::GEMHwDevice::readRegs(addressed_register_pair_list &regList)
       // vals.reserve(regList.size());
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
         vals.push_back(std::make_pair(curReg->first,hw.getClient().read(curReg->first)));
-      hw.dispatch();
+      dispatch(hw);
 
       // would like to have these local to the loop, how to do...?
       auto curVal = vals.begin();
       auto curReg = regList.begin();
       for ( ; curReg != regList.end(); ++curVal,++curReg)
         curReg->second = (curVal->second).value();
-      return;
+      return true;
     } catch (uhal::exception::exception const& err) {
       std::string msgBase = "Could not read from register in list:";
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
@@ -493,9 +509,10 @@ void gem::hw::GEMHwDevice::readRegs(addressed_register_pair_list &regList)
   std::string msg = toolbox::toString("Maximum number of retries reached, unable to read registers");
   ERROR("GEMHwDevice::" << msg);
   // XCEPT_RAISE(gem::hw::exception::HardwareProblem, msg);
+  return false;
 }
 
-void gem::hw::GEMHwDevice::readRegs(masked_register_pair_list &regList)
+bool gem::hw::GEMHwDevice::readRegs(masked_register_pair_list &regList)
 {
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
   uhal::HwInterface& hw = getGEMHwInterface();
@@ -508,15 +525,15 @@ void gem::hw::GEMHwDevice::readRegs(masked_register_pair_list &regList)
       // vals.reserve(regList.size());
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
         vals.push_back(std::make_pair(std::make_pair(curReg->first.first,curReg->first.second),
-                                      hw.getClient().read(curReg->first.first,curReg->second)));
-      hw.dispatch();
+                                      hw.getClient().read(curReg->first.first,curReg->first.second)));
+      dispatch(hw);
 
       // would like to have these local to the loop, how to do...?
       auto curVal = vals.begin();
       auto curReg = regList.begin();
       for ( ; curReg != regList.end(); ++curVal,++curReg)
         curReg->second = (curVal->second).value();
-      return;
+      return true;
     } catch (uhal::exception::exception const& err) {
       std::string msgBase = "Could not read from register in list:";
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
@@ -542,6 +559,7 @@ void gem::hw::GEMHwDevice::readRegs(masked_register_pair_list &regList)
   std::string msg = toolbox::toString("Maximum number of retries reached, unable to read registers");
   ERROR("GEMHwDevice::" << msg);
   // XCEPT_RAISE(gem::hw::exception::HardwareProblem, msg);
+  return false;
 }
 
 void gem::hw::GEMHwDevice::writeReg(std::string const& name, uint32_t const val)
@@ -553,7 +571,7 @@ void gem::hw::GEMHwDevice::writeReg(std::string const& name, uint32_t const val)
     ++retryCount;
     try {
       hw.getNode(name).write(val);
-      hw.dispatch();
+      dispatch(hw);
       return;
     } catch (uhal::exception::exception const& err) {
       std::string msgBase = toolbox::toString("Could not write to register '%s' (uHAL)", name.c_str());
@@ -591,7 +609,7 @@ void gem::hw::GEMHwDevice::writeReg(uint32_t const& address, uint32_t const val)
     ++retryCount;
     try {
       hw.getClient().write(address, val);
-      hw.dispatch();
+      dispatch(hw);
       return;
     } catch (uhal::exception::exception const& err) {
       std::string msgBase = toolbox::toString("Could not write to register '0x%08x' (uHAL)", address);
@@ -632,7 +650,7 @@ void gem::hw::GEMHwDevice::writeRegs(register_pair_list const& regList)
     try {
       for (auto curReg = regList.begin(); curReg != regList.end(); ++curReg)
         hw.getNode(curReg->first).write(curReg->second);
-      hw.dispatch();
+      dispatch(hw);
       return;
       //break;
     } catch (uhal::exception::exception const& err) {
@@ -706,7 +724,7 @@ std::vector<uint32_t> gem::hw::GEMHwDevice::readBlock(std::string const& name, s
     ++retryCount;
     try {
       uhal::ValVector<uint32_t> values = hw.getNode(name).readBlock(numWords);
-      hw.dispatch();
+      dispatch(hw);
       std::copy(values.begin(), values.end(), res.begin());
       return res;
     } catch (uhal::exception::exception const& err) {
@@ -738,6 +756,59 @@ std::vector<uint32_t> gem::hw::GEMHwDevice::readBlock(std::string const& name, s
   return res;
 }
 
+std::vector<std::vector<uint32_t> > gem::hw::GEMHwDevice::readBlocks(std::vector<std::string> const& names,
+                                                                     size_t                   const& numWords)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
+  uhal::HwInterface& hw = getGEMHwInterface();
+
+  std::vector<std::vector<uint32_t> > res(names.size(), std::vector<uint32_t>(numWords));
+
+  unsigned retryCount = 0;
+  if (numWords < 1 || names.empty())
+    return res;
+
+  std::string msgBase = "Could not read blocks in list:";
+  for (auto name = names.begin(); name != names.end(); ++name)
+    msgBase += toolbox::toString(" '%s'", name->c_str());
+
+  while (retryCount < MAX_IPBUS_RETRIES) {
+    ++retryCount;
+    try {
+      std::vector<uhal::ValVector<uint32_t> > values;
+      values.reserve(names.size());
+      for (auto name = names.begin(); name != names.end(); ++name)
+        values.push_back(hw.getNode(*name).readBlock(numWords));
+      dispatch(hw);
+      for (size_t i = 0; i < values.size(); ++i)
+        std::copy(values.at(i).begin(), values.at(i).end(), res.at(i).begin());
+      return res;
+    } catch (uhal::exception::exception const& err) {
+      std::string msg     = toolbox::toString("%s (uHAL): %s.", msgBase.c_str(), err.what());
+      std::string errCode = toolbox::toString("%s",err.what());
+      if (knownErrorCode(errCode)) {
+        if (retryCount > 4)
+          WARN("GEMHwDevice::Failed to read " << names.size() << " blocks with " << numWords << " words" <<
+               ", retrying. retryCount("<<retryCount<<")" << std::endl
+               << "error was " << errCode
+               << std::endl);
+        updateErrorCounters(errCode);
+        continue;
+      }
+      // the callers cannot tell zeroed words from real data, so unknown errors are not retried or hidden
+      ERROR("GEMHwDevice::" << msg);
+      XCEPT_RAISE(gem::hw::exception::HardwareProblem, msg);
+    } catch (std::exception const& err) {
+      std::string msg = toolbox::toString("%s (std): %s.", msgBase.c_str(), err.what());
+      ERROR("GEMHwDevice::" << msg);
+      XCEPT_RAISE(gem::hw::exception::HardwareProblem, msg);
+    }
+  }
+  std::string msg = toolbox::toString("%s: maximum number of retries reached.", msgBase.c_str());
+  ERROR("GEMHwDevice::" << msg);
+  XCEPT_RAISE(gem::hw::exception::HardwareProblem, msg);
+}
+
 uint32_t gem::hw::GEMHwDevice::readBlock(std::string const& name, uint32_t* buffer,
                                          size_t const& numWords)
 {
@@ -764,7 +835,7 @@ void gem::hw::GEMHwDevice::writeBlock(std::string const& name, std::vector<uint3
     ++retryCount;
     try {
       hw.getNode(name).writeBlock(values);
-      hw.dispatch();
+      dispatch(hw);
       return;
     } catch (uhal::exception::exception const& err) {
       std::string msgBase = toolbox::toString("Could not write to block '%s' (uHAL)", name.c_str());
@@ -849,6 +920,87 @@ void gem::hw::GEMHwDevice::updateErrorCounters(std::string const& errCode) {
     ++m_ipBusErrs.ControlHubErr;
 }
 
+void gem::hw::GEMHwDevice::dispatch(uhal::HwInterface& hw)
+{
+  timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  try {
+    hw.dispatch();
+  } catch (...) {
+    // failed round trips (e.g., timeouts) are exactly the tail we want to see
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    m_ipBusLatency[s_ipBusCategory].record(gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop));
+    throw;
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  m_ipBusLatency[s_ipBusCategory].record(gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop));
+}
+
+gem::utils::GEMLatencyHistogram gem::hw::GEMHwDevice::getIPBusLatency(IPBusCategory const& category) const
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
+  return m_ipBusLatency[category];
+}
+
+void gem::hw::GEMHwDevice::resetIPBusLatency()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
+  for (unsigned cat = 0; cat < N_IPBUS_CATEGORIES; ++cat)
+    m_ipBusLatency[cat].reset();
+}
+
+std::string gem::hw::GEMHwDevice::getIPBusCategoryName(IPBusCategory const& category)
+{
+  switch (category) {
+  case CONFIGURATION :
+    return "CONFIGURATION";
+  case MONITORING :
+    return "MONITORING";
+  case READOUT :
+    return "READOUT";
+  default :
+    return "UNKNOWN";
+  }
+}
+
+std::vector<std::string> gem::hw::GEMHwDevice::getIPBusLatencyItemNames()
+{
+  std::vector<std::string> names;
+  std::array<std::string, 6> stats = {{"COUNT","MEAN","P50","P90","P99","MAX"}};
+  for (unsigned cat = 0; cat < N_IPBUS_CATEGORIES; ++cat)
+    for (auto stat = stats.begin(); stat != stats.end(); ++stat)
+      names.push_back("IPBUS_"+getIPBusCategoryName(static_cast<IPBusCategory>(cat))+"_"+(*stat));
+  return names;
+}
+
+void gem::hw::GEMHwDevice::createIPBusLatencyItems(gem::base::utils::GEMInfoSpaceToolBox* is)
+{
+  std::vector<std::string> names = getIPBusLatencyItemNames();
+  for (auto name = names.begin(); name != names.end(); ++name) {
+    if (is->find(*name))
+      continue;
+    if (name->rfind("_COUNT") != std::string::npos)
+      is->createUInt64(*name, 0, NULL, GEMUpdateType::NOUPDATE, "number of IPBus dispatches", "dec");
+    else
+      is->createUInt32(*name, 0, NULL, GEMUpdateType::NOUPDATE, "IPBus dispatch latency (us)", "dec");
+  }
+}
+
+void gem::hw::GEMHwDevice::updateIPBusLatencyItems(gem::base::utils::GEMInfoSpaceToolBox* is)
+{
+  for (unsigned cat = 0; cat < N_IPBUS_CATEGORIES; ++cat) {
+    IPBusCategory category = static_cast<IPBusCategory>(cat);
+    gem::utils::GEMLatencyHistogram hist = getIPBusLatency(category);
+    std::string prefix = "IPBUS_"+getIPBusCategoryName(category)+"_";
+    is->setUInt64(prefix+"COUNT", hist.getCount());
+    is->setUInt32(prefix+"MEAN",  static_cast<uint32_t>(hist.getMean()+0.5));
+    is->setUInt32(prefix+"P50",   static_cast<uint32_t>(hist.getQuantile(0.50)));
+    is->setUInt32(prefix+"P90",   static_cast<uint32_t>(hist.getQuantile(0.90)));
+    is->setUInt32(prefix+"P99",   static_cast<uint32_t>(hist.getQuantile(0.99)));
+    is->setUInt32(prefix+"MAX",   static_cast<uint32_t>(hist.getMax()));
+  }
+}
+
 void gem::hw::GEMHwDevice::zeroBlock(std::string const& name)
 {
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
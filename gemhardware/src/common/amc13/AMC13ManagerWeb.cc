@@ -139,7 +139,8 @@ void gem::hw::amc13::AMC13ManagerWeb::jsonUpdate(xgi::Input *in, xgi::Output *ou
   throw (xgi::exception::Exception)
 {
   DEBUG("AMC13ManagerWeb::jsonUpdate");
-  updateStatus(out);
+  // the HTML status report is served by updateStatus
+  gem::base::GEMWebApplication::jsonUpdate(in, out);
 }
 
 void gem::hw::amc13::AMC13ManagerWeb::setDisplayLevel(xgi::Input *in)
@@ -576,63 +576,65 @@ void gem::hw::glib::GLIBManager::resetAction(toolbox::Event::Reference e)
 
 void gem::hw::glib::GLIBManager::createGLIBInfoSpaceItems(is_toolbox_ptr is_glib, glib_shared_ptr glib)
 {
+  // all initial values come from a single IPBus transaction
+  HwGLIB::GLIBStatusSnapshot snap = glib->getStatusSnapshot();
+  if (!snap.valid)
+    WARN("GLIBManager::createGLIBInfoSpaceItems unable to read the status of "
+         << glib->getDeviceID() << ", items start at zero");
+
   // system registers
-  is_glib->createUInt32("BOARD_ID",      glib->getBoardIDRaw(),      NULL, GEMUpdateType::NOUPDATE, "docstring", "id");
-  is_glib->createUInt32("SYSTEM_ID",     glib->getSystemIDRaw(),     NULL, GEMUpdateType::NOUPDATE, "docstring", "id");
-  is_glib->createUInt32("FIRMWARE_ID",   glib->getFirmwareVerRaw(),  NULL, GEMUpdateType::PROCESS,  "docstring", "fwver");
-  is_glib->createUInt32("FIRMWARE_DATE", glib->getFirmwareDateRaw(), NULL, GEMUpdateType::PROCESS,  "docstring", "date");
-  is_glib->createUInt32("IP_ADDRESS",    glib->getIPAddressRaw(),    NULL, GEMUpdateType::NOUPDATE, "docstring", "ip");
-  is_glib->createUInt64("MAC_ADDRESS",   glib->getMACAddressRaw(),   NULL, GEMUpdateType::NOUPDATE, "docstring", "mac");
-  is_glib->createUInt32("SFP1_STATUS",   glib->SFPStatus(1),         NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("SFP2_STATUS",   glib->SFPStatus(2),         NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("SFP3_STATUS",   glib->SFPStatus(3),         NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("SFP4_STATUS",   glib->SFPStatus(4),         NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("FMC1_STATUS",   glib->FMCPresence(0),       NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("FMC2_STATUS",   glib->FMCPresence(1),       NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("FPGA_RESET",    glib->FPGAResetStatus(),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GBE_INT",       glib->GbEInterrupt(),       NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("V6_CPLD",       glib->V6CPLDStatus(),       NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("CPLD_LOCK",     glib->CDCELockStatus(),     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("BOARD_ID",      snap.boardID,          NULL, GEMUpdateType::NOUPDATE, "docstring", "id");
+  is_glib->createUInt32("SYSTEM_ID",     snap.systemID,         NULL, GEMUpdateType::NOUPDATE, "docstring", "id");
+  is_glib->createUInt32("FIRMWARE_ID",   snap.firmwareID,       NULL, GEMUpdateType::PROCESS,  "docstring", "fwver");
+  is_glib->createUInt32("FIRMWARE_DATE", snap.firmwareDate,     NULL, GEMUpdateType::PROCESS,  "docstring", "date");
+  is_glib->createUInt32("IP_ADDRESS",    snap.ipAddress,        NULL, GEMUpdateType::NOUPDATE, "docstring", "ip");
+  is_glib->createUInt64("MAC_ADDRESS",   snap.getMACAddress(),  NULL, GEMUpdateType::NOUPDATE, "docstring", "mac");
+  is_glib->createUInt32("SFP1_STATUS",   snap.sfpStatus[0],     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("SFP2_STATUS",   snap.sfpStatus[1],     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("SFP3_STATUS",   snap.sfpStatus[2],     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("SFP4_STATUS",   snap.sfpStatus[3],     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("FMC1_STATUS",   snap.fmcPresent[0],    NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("FMC2_STATUS",   snap.fmcPresent[1],    NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("FPGA_RESET",    snap.fpgaReset,        NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("GBE_INT",       snap.gbeInterrupt,     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("V6_CPLD",       snap.v6CPLD,           NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("CPLD_LOCK",     snap.cdceLock,         NULL, GEMUpdateType::HW32);
 
   // ttc registers
-  is_glib->createUInt32("L1A",      glib->getL1ACount(),      NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("CalPulse", glib->getCalPulseCount(), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("Resync",   glib->getResyncCount(),   NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("BC0",      glib->getBC0Count(),      NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("L1A",      snap.l1a,      NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("CalPulse", snap.calPulse, NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("Resync",   snap.resync,   NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("BC0",      snap.bc0,      NULL, GEMUpdateType::HW32);
 
   // DAQ link registers
-  is_glib->createUInt32("CONTROL",           glib->getDAQLinkControl(),               NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("STATUS",            glib->getDAQLinkStatus(),                NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("INPUT_ENABLE_MASK", glib->getDAQLinkInputMask(),             NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("DAV_TIMEOUT",       glib->getDAQLinkDAVTimeout(),            NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("MAX_DAV_TIMER",     glib->getDAQLinkDAVTimer(0),             NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("LAST_DAV_TIMER",    glib->getDAQLinkDAVTimer(1),             NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("NOTINTABLE_ERR",    glib->getDAQLinkNonidentifiableErrors(), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("DISPER_ERR",        glib->getDAQLinkDisperErrors(),          NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("EVT_SENT",          glib->getDAQLinkEventsSent(),            NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("L1AID",             glib->getDAQLinkL1AID(),                 NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("INPUT_TIMEOUT",     glib->getDAQLinkL1AID(),                 NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("RUN_TYPE",          glib->getDAQLinkL1AID(),                 NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("RUN_PARAMS",        glib->getDAQLinkL1AID(),                 NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("SBIT_RATE",         glib->getDAQLinkL1AID(),                 NULL, GEMUpdateType::HW32);
-
-  is_glib->createUInt32("GTX0_STATUS",               glib->getDAQLinkStatus(0),      NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_CORRUPT_VFAT_BLK_CNT", glib->getDAQLinkCounters(0, 0), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_EVN",                  glib->getDAQLinkCounters(0, 1), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_DAV_TIMEOUT",          glib->getDAQLinkDAVTimer(0),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_MAX_DAV_TIMER",        glib->getDAQLinkDAVTimer(0),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_LAST_DAV_TIMER",       glib->getDAQLinkDAVTimer(1),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_CLUSTER_01",           glib->getDAQLinkCounters(0, 1), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX0_CLUSTER_23",           glib->getDAQLinkCounters(0, 1), NULL, GEMUpdateType::HW32);
-
-  is_glib->createUInt32("GTX1_STATUS",               glib->getDAQLinkStatus(1),      NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_CORRUPT_VFAT_BLK_CNT", glib->getDAQLinkCounters(1, 0), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_EVN",                  glib->getDAQLinkCounters(1, 1), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_DAV_TIMEOUT",          glib->getDAQLinkDAVTimer(0),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_MAX_DAV_TIMER",        glib->getDAQLinkDAVTimer(0),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_LAST_DAV_TIMER",       glib->getDAQLinkDAVTimer(1),    NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_CLUSTER_01",           glib->getDAQLinkCounters(1, 1), NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("GTX1_CLUSTER_23",           glib->getDAQLinkCounters(1, 1), NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("CONTROL",           snap.daqControl,          NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("STATUS",            snap.daqStatus,           NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("INPUT_ENABLE_MASK", snap.daqInputMask,        NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("DAV_TIMEOUT",       snap.daqDAVTimeout,       NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("MAX_DAV_TIMER",     snap.daqMaxDAVTimer,      NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("LAST_DAV_TIMER",    snap.daqLastDAVTimer,     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("NOTINTABLE_ERR",    snap.daqNotInTableErrors, NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("DISPER_ERR",        snap.daqDisperErrors,     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("EVT_SENT",          snap.daqEventsSent,       NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("L1AID",             snap.daqL1AID,            NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("INPUT_TIMEOUT",     snap.daqInputTimeout,     NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("RUN_TYPE",          snap.daqRunType,          NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("RUN_PARAMS",        snap.daqRunParams,        NULL, GEMUpdateType::HW32);
+  // not part of the snapshot, filled by the first monitoring update
+  is_glib->createUInt32("SBIT_RATE",         0,                        NULL, GEMUpdateType::HW32);
+
+  for (unsigned gtx = 0; gtx < HwGLIB::N_GTX; ++gtx) {
+    HwGLIB::GLIBGTXStatus const& link = snap.gtx[gtx];
+    std::string prefix = toolbox::toString("GTX%d_", gtx);
+    is_glib->createUInt32(prefix+"STATUS",               link.daqStatus,         NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"CORRUPT_VFAT_BLK_CNT", link.corruptVFATBlocks, NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"EVN",                  link.eventNumber,       NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"DAV_TIMEOUT",          link.davTimeout,        NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"MAX_DAV_TIMER",        link.maxDAVTimer,       NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"LAST_DAV_TIMER",       link.lastDAVTimer,      NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"CLUSTER_01",           0,                      NULL, GEMUpdateType::HW32);
+    is_glib->createUInt32(prefix+"CLUSTER_23",           0,                      NULL, GEMUpdateType::HW32);
+  }
 
   // request counters
   is_glib->createUInt64("OptoHybrid_0", 0, NULL, GEMUpdateType::I2CSTAT, "docstring", "i2c/hex");
@@ -650,8 +652,11 @@ void gem::hw::glib::GLIBManager::createGLIBInfoSpaceItems(is_toolbox_ptr is_glib
   is_glib->createUInt32("GTX1_DATA_Packets", 0, NULL, GEMUpdateType::PROCESS, "docstring", "raw/rate");
 
   // TTC registers
-  is_glib->createUInt32("TTC_CONTROL", glib->getTTCControl(),   NULL, GEMUpdateType::HW32);
-  is_glib->createUInt32("TTC_SPY",     glib->getTTCSpyBuffer(), NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("TTC_CONTROL", snap.ttcControl, NULL, GEMUpdateType::HW32);
+  is_glib->createUInt32("TTC_SPY",     snap.ttcSpy,     NULL, GEMUpdateType::HW32);
+
+  // IPBus dispatch latency summaries
+  glib->createIPBusLatencyItems(is_glib.get());
 }
 
 void gem::hw::glib::GLIBManager::dumpGLIBFIFO(xgi::Input* in, xgi::Output* out)
@@ -198,19 +198,18 @@ void gem::hw::glib::GLIBManagerWeb::jsonUpdate(xgi::Input* in, xgi::Output* out)
 {
   DEBUG("GLIBManagerWeb::jsonUpdate");
   out->getHTTPResponseHeader().addHeader("Content-Type", "application/json");
+  uint64_t since    = getJSONSince(in);
+  uint64_t sequence = gem::base::GEMMonitor::getJSONSequence();
   *out << " { " << std::endl;
   for (unsigned int i = 0; i < gem::base::GEMFSMApplication::MAX_AMCS_PER_CRATE; ++i) {
     *out << "\"glib" << std::setw(2) << std::setfill('0') << (i+1) << "\"  : { " << std::endl;
     auto card = dynamic_cast<gem::hw::glib::GLIBManager*>(p_gemFSMApp)->m_glibMonitors.at(i);
     if (card) {
-      card->jsonUpdateItemSets(out);
+      card->jsonUpdateItemSets(out, since);
     }
-    // can't have a trailing comma for the last entry...
-    if (i == (gem::base::GEMFSMApplication::MAX_AMCS_PER_CRATE-1))
-      *out << " }" << std::endl;
-    else
-      *out << " }," << std::endl;
+    *out << " }," << std::endl;
   }
+  *out << "\"jsonSequence\" : " << std::dec << sequence << std::endl;
   *out << " } " << std::endl;
 }
 
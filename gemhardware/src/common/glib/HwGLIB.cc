@@ -1,7 +1,100 @@
+#include <time.h>
+
 #include <iomanip>
 
 #include "gem/hw/glib/HwGLIB.h"
 
+namespace {
+  /**
+   * Pairs each register of the status snapshot with the snapshot field it is read into,
+   * the names are only built when filling the register list
+   */
+  struct StatusRegisterMap {
+    StatusRegisterMap(std::string const& base, bool buildNames) :
+      m_base(base+"."), m_buildNames(buildNames) {};
+
+    void add(char const* reg, uint32_t& field) {
+      if (m_buildNames)
+        names.push_back(m_base+reg);
+      fields.push_back(&field);
+    };
+
+    void add(unsigned const& gtx, char const* regFormat, uint32_t& field) {
+      if (m_buildNames)
+        names.push_back(m_base+toolbox::toString(regFormat, gtx));
+      fields.push_back(&field);
+    };
+
+    std::vector<std::string> names;
+    std::vector<uint32_t*>   fields;
+
+  private:
+    std::string m_base;
+    bool        m_buildNames;
+  };
+
+  void mapStatusRegisters(gem::hw::glib::HwGLIB::GLIBStatusSnapshot& snap, StatusRegisterMap& map)
+  {
+    map.add("SYSTEM.BOARD_ID",      snap.boardID);
+    map.add("SYSTEM.SYSTEM_ID",     snap.systemID);
+    map.add("SYSTEM.FIRMWARE.ID",   snap.firmwareID);
+    map.add("SYSTEM.FIRMWARE.DATE", snap.firmwareDate);
+    map.add("SYSTEM.IP_INFO",       snap.ipAddress);
+    map.add("SYSTEM.MAC.UPPER",     snap.macUpper);
+    map.add("SYSTEM.MAC.LOWER",     snap.macLower);
+    for (unsigned sfp = 0; sfp < 4; ++sfp)
+      map.add(sfp+1, "SYSTEM.STATUS.SFP%d.STATUS", snap.sfpStatus[sfp]);
+    for (unsigned fmc = 0; fmc < 2; ++fmc)
+      map.add(fmc+1, "SYSTEM.STATUS.FMC%d_PRESENT", snap.fmcPresent[fmc]);
+    map.add("SYSTEM.STATUS.FPGA_RESET", snap.fpgaReset);
+    map.add("SYSTEM.STATUS.GBE_INT",    snap.gbeInterrupt);
+    map.add("SYSTEM.STATUS.V6_CPLD",    snap.v6CPLD);
+    map.add("SYSTEM.STATUS.CDCE_LOCK",  snap.cdceLock);
+
+    map.add("TTC.CONTROL",          snap.ttcControl);
+    map.add("TTC.SPY",              snap.ttcSpy);
+    map.add("COUNTERS.T1.L1A",      snap.l1a);
+    map.add("COUNTERS.T1.CalPulse", snap.calPulse);
+    map.add("COUNTERS.T1.Resync",   snap.resync);
+    map.add("COUNTERS.T1.BC0",      snap.bc0);
+
+    map.add("DAQ.CONTROL",                   snap.daqControl);
+    map.add("DAQ.STATUS",                    snap.daqStatus);
+    map.add("DAQ.CONTROL.INPUT_ENABLE_MASK", snap.daqInputMask);
+    map.add("DAQ.CONTROL.DAV_TIMEOUT",       snap.daqDAVTimeout);
+    map.add("DAQ.EXT_STATUS.MAX_DAV_TIMER",  snap.daqMaxDAVTimer);
+    map.add("DAQ.EXT_STATUS.LAST_DAV_TIMER", snap.daqLastDAVTimer);
+    map.add("DAQ.EXT_STATUS.NOTINTABLE_ERR", snap.daqNotInTableErrors);
+    map.add("DAQ.EXT_STATUS.DISPER_ERR",     snap.daqDisperErrors);
+    map.add("DAQ.EXT_STATUS.EVT_SENT",       snap.daqEventsSent);
+    map.add("DAQ.EXT_STATUS.L1AID",          snap.daqL1AID);
+    map.add("DAQ.EXT_CONTROL.INPUT_TIMEOUT", snap.daqInputTimeout);
+    map.add("DAQ.EXT_CONTROL.RUN_TYPE",      snap.daqRunType);
+    map.add("DAQ.EXT_CONTROL.RUN_PARAMS",    snap.daqRunParams);
+
+    map.add("COUNTERS.IPBus.Strobe.Counters", snap.counterStrobe);
+    map.add("COUNTERS.IPBus.Ack.Counters",    snap.counterAck);
+
+    for (unsigned gtx = 0; gtx < gem::hw::glib::HwGLIB::N_GTX; ++gtx) {
+      gem::hw::glib::HwGLIB::GLIBGTXStatus& link = snap.gtx[gtx];
+      map.add(gtx, "COUNTERS.GTX%d.TRK_ERR",                   link.link.TRK_Errors);
+      map.add(gtx, "COUNTERS.GTX%d.TRG_ERR",                   link.link.TRG_Errors);
+      map.add(gtx, "COUNTERS.GTX%d.DATA_Packets",              link.link.Data_Packets);
+      map.add(gtx, "COUNTERS.IPBus.Strobe.OptoHybrid_%d",      link.ipBus.OptoHybridStrobe);
+      map.add(gtx, "COUNTERS.IPBus.Ack.OptoHybrid_%d",         link.ipBus.OptoHybridAck);
+      map.add(gtx, "COUNTERS.IPBus.Strobe.TRK_%d",             link.ipBus.TrackingStrobe);
+      map.add(gtx, "COUNTERS.IPBus.Ack.TRK_%d",                link.ipBus.TrackingAck);
+      map.add(gtx, "DAQ.GTX%d.STATUS",                         link.daqStatus);
+      map.add(gtx, "DAQ.GTX%d.COUNTERS.CORRUPT_VFAT_BLK_CNT",  link.corruptVFATBlocks);
+      map.add(gtx, "DAQ.GTX%d.COUNTERS.EVN",                   link.eventNumber);
+      map.add(gtx, "DAQ.GTX%d.LASTBLOCK",                      link.lastBlock);
+      map.add(gtx, "DAQ.GTX%d.CONTROL.DAV_TIMEOUT",            link.davTimeout);
+      map.add(gtx, "DAQ.GTX%d.COUNTERS.MAX_DAV_TIMER",         link.maxDAVTimer);
+      map.add(gtx, "DAQ.GTX%d.COUNTERS.LAST_DAV_TIMER",        link.lastDAVTimer);
+    }
+  }
+}
+
 gem::hw::glib::HwGLIB::HwGLIB() :
   gem::hw::GEMHwDevice::GEMHwDevice("HwGLIB"),
   // monGLIB_(0),
@@ -480,22 +573,60 @@ gem::hw::glib::HwGLIB::GLIBIPBusCounters gem::hw::glib::HwGLIB::getIPBusCounters
 {
 
   if (linkCheck(gtx, "IPBus counter")) {
-    if (mode&0x01)
-      m_ipBusCounters.at(gtx).OptoHybridStrobe = readReg(getDeviceBaseNode(),toolbox::toString("COUNTERS.IPBus.Strobe.OptoHybrid_%d",gtx));
-    if (mode&0x02)
-      m_ipBusCounters.at(gtx).OptoHybridAck    = readReg(getDeviceBaseNode(),toolbox::toString("COUNTERS.IPBus.Ack.OptoHybrid_%d",gtx));
-    if (mode&0x04)
-      m_ipBusCounters.at(gtx).TrackingStrobe   = readReg(getDeviceBaseNode(),toolbox::toString("COUNTERS.IPBus.Strobe.OptoHybrid_%d",gtx));
-    if (mode&0x08)
-      m_ipBusCounters.at(gtx).TrackingAck      = readReg(getDeviceBaseNode(),toolbox::toString("COUNTERS.IPBus.Ack.OptoHybrid_%d",gtx));
-    if (mode&0x10)
-      m_ipBusCounters.at(gtx).CounterStrobe    = readReg(getDeviceBaseNode(),toolbox::toString("COUNTERS.IPBus.Strobe.Counters"));
-    if (mode&0x20)
-      m_ipBusCounters.at(gtx).CounterAck       = readReg(getDeviceBaseNode(),toolbox::toString("COUNTERS.IPBus.Ack.Counters"));
+    GLIBIPBusCounters& counters = m_ipBusCounters.at(gtx);
+    uint32_t* fields[6] = {&counters.OptoHybridStrobe, &counters.OptoHybridAck,
+                           &counters.TrackingStrobe,   &counters.TrackingAck,
+                           &counters.CounterStrobe,    &counters.CounterAck};
+    char const* regs[6] = {"COUNTERS.IPBus.Strobe.OptoHybrid_%d", "COUNTERS.IPBus.Ack.OptoHybrid_%d",
+                           "COUNTERS.IPBus.Strobe.TRK_%d",        "COUNTERS.IPBus.Ack.TRK_%d",
+                           "COUNTERS.IPBus.Strobe.Counters",      "COUNTERS.IPBus.Ack.Counters"};
+
+    // all the requested counters are read with a single dispatch
+    register_pair_list regList;
+    std::vector<uint32_t*> regFields;
+    for (unsigned bit = 0; bit < 6; ++bit) {
+      if (mode&(0x1<<bit)) {
+        regList.push_back(std::make_pair(getDeviceBaseNode()+"."+toolbox::toString(regs[bit],gtx),0x0));
+        regFields.push_back(fields[bit]);
+      }
+    }
+    if (!regList.empty() && readRegs(regList))
+      for (unsigned reg = 0; reg < regList.size(); ++reg)
+        *regFields[reg] = regList[reg].second;
   }
   return m_ipBusCounters.at(gtx);
 }
 
+gem::hw::glib::HwGLIB::GLIBStatusSnapshot gem::hw::glib::HwGLIB::getStatusSnapshot()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_hwLock);
+
+  GLIBStatusSnapshot snap;
+  StatusRegisterMap map(getDeviceBaseNode(), m_statusRegs.empty());
+  mapStatusRegisters(snap, map);
+  if (m_statusRegs.empty()) {
+    for (auto name = map.names.begin(); name != map.names.end(); ++name)
+      m_statusRegs.push_back(std::make_pair(*name,0x0));
+    DEBUG("HwGLIB::getStatusSnapshot reading " << m_statusRegs.size() << " registers per snapshot");
+  }
+
+  timespec start, stop;
+  snap.timestamp = toolbox::TimeVal::gettimeofday();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  snap.valid = readRegs(m_statusRegs);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  snap.readUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+
+  for (unsigned reg = 0; reg < map.fields.size(); ++reg)
+    *map.fields[reg] = snap.valid ? m_statusRegs[reg].second : 0x0;
+
+  for (unsigned gtx = 0; gtx < N_GTX; ++gtx) {
+    snap.gtx[gtx].ipBus.CounterStrobe = snap.counterStrobe;
+    snap.gtx[gtx].ipBus.CounterAck    = snap.counterAck;
+  }
+  return snap;
+}
+
 void gem::hw::glib::HwGLIB::resetIPBusCounters(uint8_t const& gtx, uint8_t const& resets)
 {
   if (linkCheck(gtx, "Reset IPBus counters")) {
@@ -571,6 +702,7 @@ std::vector<uint32_t> gem::hw::glib::HwGLIB::getTrackingData(uint8_t const& gtx,
   regName << getDeviceBaseNode() << ".TRK_DATA.OptoHybrid_" << (int)gtx << ".FIFO";
   // best way to read a real block? make getTrackingData ask for N blocks?
   // can we return the memory another way, rather than a vector?
+  IPBusCategoryGuard ipBusCategory(READOUT);
   return readBlock(regName.str(),7*nBlocks);
 }
 
@@ -49,6 +49,22 @@ gem::hw::optohybrid::HwOptoHybrid::HwOptoHybrid(std::string const& optohybridDev
   INFO("HwOptoHybrid ctor done " << isHwConnected());
 }
 
+gem::hw::optohybrid::HwOptoHybrid::HwOptoHybrid(std::string const& optohybridDevice,
+                                                std::string const& connectionURI,
+                                                std::string const& addressTable,
+                                                int const& link) :
+  gem::hw::GEMHwDevice::GEMHwDevice(optohybridDevice, connectionURI, addressTable),
+  //monOptoHybrid_(0)
+  b_links({false,false,false}),
+  m_controlLink(-1)
+{
+  setAddressTableFileName("glib_address_table.xml");
+  std::stringstream basenode;
+  basenode << "GLIB.OptoHybrid_" << link << ".OptoHybrid";
+  setDeviceBaseNode(basenode.str());
+  INFO("HwOptoHybrid ctor done " << isHwConnected());
+}
+
 gem::hw::optohybrid::HwOptoHybrid::HwOptoHybrid(std::string const& optohybridDevice,
                                                 uhal::HwInterface& uhalDevice) :
   gem::hw::GEMHwDevice::GEMHwDevice(optohybridDevice,uhalDevice),
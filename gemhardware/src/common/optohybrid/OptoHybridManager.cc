@@ -795,6 +795,9 @@ void gem::hw::optohybrid::OptoHybridManager::createOptoHybridInfoSpaceItems(is_t
       is_optohybrid->createUInt32((*scan)+(*scanreg), optohybrid->getFirmware(), NULL, GEMUpdateType::HW32);
     }
   }
+
+  // IPBus dispatch latency summaries
+  optohybrid->createIPBusLatencyItems(is_optohybrid.get());
 }
 
 
@@ -95,6 +95,8 @@ void gem::hw::optohybrid::OptoHybridManagerWeb::jsonUpdate(xgi::Input* in, xgi::
 {
   DEBUG("OptoHybridManagerWeb::jsonUpdate");
   out->getHTTPResponseHeader().addHeader("Content-Type", "application/json");
+  uint64_t since    = getJSONSince(in);
+  uint64_t sequence = gem::base::GEMMonitor::getJSONSequence();
   *out << " { " << std::endl;
   for (unsigned int i = 0; i < gem::base::GEMFSMApplication::MAX_AMCS_PER_CRATE; ++i) {
     for (unsigned int j = 0; j < gem::base::GEMFSMApplication::MAX_OPTOHYBRIDS_PER_AMC; ++j) {
@@ -103,16 +105,12 @@ void gem::hw::optohybrid::OptoHybridManagerWeb::jsonUpdate(xgi::Input* in, xgi::
            << "\"  : { "    << std::endl;
       auto card = dynamic_cast<gem::hw::optohybrid::OptoHybridManager*>(p_gemFSMApp)->m_optohybridMonitors.at(i).at(j);
       if (card) {
-        card->jsonUpdateItemSets(out);
+        card->jsonUpdateItemSets(out, since);
       }
-      // can't have a trailing comma for the last entry...
-      if (i == (gem::base::GEMFSMApplication::MAX_AMCS_PER_CRATE-1) &&
-          j == (gem::base::GEMFSMApplication::MAX_OPTOHYBRIDS_PER_AMC-1))
-        *out << " }" << std::endl;
-      else
-        *out << " }," << std::endl;
+      *out << " }," << std::endl;
     }
   }
+  *out << "\"jsonSequence\" : " << std::dec << sequence << std::endl;
   *out << " } " << std::endl;
 }
 
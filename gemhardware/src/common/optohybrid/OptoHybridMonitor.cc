@@ -204,68 +204,111 @@ void gem::hw::optohybrid::OptoHybridMonitor::setupHwMonitoring()
     }
   }
 
+  addMonitorableSet("IPBus Latency", "HWMonitoring");
+  std::vector<std::string> latencyItems = gem::hw::GEMHwDevice::getIPBusLatencyItemNames();
+  for (auto item = latencyItems.begin(); item != latencyItems.end(); ++item)
+    addMonitorable("IPBus Latency", "HWMonitoring",
+                   std::make_pair(*item, ""),
+                   GEMUpdateType::NOUPDATE, "dec");
+
   updateMonitorables();
 }
 
 gem::hw::optohybrid::OptoHybridMonitor::~OptoHybridMonitor()
 {
-
+  // make sure no update is running on this object while it is torn down
+  stopMonitoring();
 }
 
 void gem::hw::optohybrid::OptoHybridMonitor::updateMonitorables()
 {
   // define how to update the desired values
-  // get SYSTEM monitorables
-  // can this be split into two loops, one just to do a list read, the second to fill the InfoSpace with the returned values
   DEBUG("OptoHybridMonitor: Updating monitorables");
+  updateRegisterMonitorables();
+}
+
+bool gem::hw::optohybrid::OptoHybridMonitor::collectRegisterReads(RegisterReadList& regs)
+{
+  // first loop builds the list of registers to read, which is then read in a single transaction
+  // together with the other monitors of the board, publishRegisterReads fills the InfoSpace
+  m_pendingItems.clear();
+  m_pendingSets.clear();
   for (auto monlist = m_monitorableSetsMap.begin(); monlist != m_monitorableSetsMap.end(); ++monlist) {
+    if (!isSetDue(monlist->first))
+      continue;
     DEBUG("OptoHybridMonitor: Updating monitorables in set " << monlist->first);
+    size_t nItems = m_pendingItems.size();
     for (auto monitem = monlist->second.begin(); monitem != monlist->second.end(); ++monitem) {
       DEBUG("OptoHybridMonitor: Updating monitorable " << monitem->first);
+      if (monitem->second.updatetype == GEMUpdateType::NOUPDATE)
+        continue;
       std::stringstream regName;
       regName << p_optohybrid->getDeviceBaseNode() << "." << monitem->second.regname;
-      uint32_t address = p_optohybrid->getGEMHwInterface().getNode(regName.str()).getAddress();
-      uint32_t mask    = p_optohybrid->getGEMHwInterface().getNode(regName.str()).getMask();
-      if (monitem->second.updatetype == GEMUpdateType::HW8) {
-        (monitem->second.infoSpace)->setUInt32(monitem->first,p_optohybrid->readReg(address,mask));
-      } else if (monitem->second.updatetype == GEMUpdateType::HW16) {
-        (monitem->second.infoSpace)->setUInt32(monitem->first,p_optohybrid->readReg(address,mask));
-      } else if (monitem->second.updatetype == GEMUpdateType::HW24) {
-        (monitem->second.infoSpace)->setUInt32(monitem->first,p_optohybrid->readReg(address,mask));
-      } else if (monitem->second.updatetype == GEMUpdateType::HW32) {
-        (monitem->second.infoSpace)->setUInt32(monitem->first,p_optohybrid->readReg(address,mask));
+      std::vector<std::string> nodes;
+      if (monitem->second.updatetype == GEMUpdateType::HW8  ||
+          monitem->second.updatetype == GEMUpdateType::HW16 ||
+          monitem->second.updatetype == GEMUpdateType::HW24 ||
+          monitem->second.updatetype == GEMUpdateType::HW32 ||
+          monitem->second.updatetype == GEMUpdateType::PROCESS ||
+          monitem->second.updatetype == GEMUpdateType::TRACKER) {
+        nodes.push_back(regName.str());
       } else if (monitem->second.updatetype == GEMUpdateType::HW64) {
-        address = p_optohybrid->getGEMHwInterface().getNode(regName.str()+".LOWER").getAddress();
-        mask    = p_optohybrid->getGEMHwInterface().getNode(regName.str()+".LOWER").getMask();
-        uint32_t lower = p_optohybrid->readReg(address,mask);
-        address = p_optohybrid->getGEMHwInterface().getNode(regName.str()+".UPPER").getAddress();
-        mask    = p_optohybrid->getGEMHwInterface().getNode(regName.str()+".UPPER").getMask();
-        uint32_t upper = p_optohybrid->readReg(address,mask);
-        (monitem->second.infoSpace)->setUInt64(monitem->first, (((uint64_t)upper) << 32) + lower);
+        nodes.push_back(regName.str()+".LOWER");
+        nodes.push_back(regName.str()+".UPPER");
       } else if (monitem->second.updatetype == GEMUpdateType::I2CSTAT) {
-        std::stringstream strobeReg;
-        strobeReg << regName.str() << ".Strobe." << monitem->first;
-        address = p_optohybrid->getGEMHwInterface().getNode(strobeReg.str()).getAddress();
-        mask    = p_optohybrid->getGEMHwInterface().getNode(strobeReg.str()).getMask();
-        uint32_t strobe = p_optohybrid->readReg(address,mask);
-        std::stringstream ackReg;
-        ackReg << regName.str() << ".Ack." << monitem->first;
-        address = p_optohybrid->getGEMHwInterface().getNode(ackReg.str()).getAddress();
-        mask    = p_optohybrid->getGEMHwInterface().getNode(ackReg.str()).getMask();
-        uint32_t ack = p_optohybrid->readReg(address,mask);
-        (monitem->second.infoSpace)->setUInt64(monitem->first, (((uint64_t)ack) << 32) + strobe);
-      } else if (monitem->second.updatetype == GEMUpdateType::PROCESS) {
-        (monitem->second.infoSpace)->setUInt32(monitem->first,p_optohybrid->readReg(address,mask));
-      } else if (monitem->second.updatetype == GEMUpdateType::TRACKER) {
-        (monitem->second.infoSpace)->setUInt32(monitem->first,p_optohybrid->readReg(address,mask));
-      } else if (monitem->second.updatetype == GEMUpdateType::NOUPDATE) {
-        continue;
+        nodes.push_back(regName.str()+".Strobe."+monitem->first);
+        nodes.push_back(regName.str()+".Ack."+monitem->first);
       } else {
         ERROR("OptoHybridMonitor: Unknown update type encountered");
         continue;
       }
+      m_pendingItems.push_back(std::make_pair(&(monitem->second), regs.size()));
+      for (auto node = nodes.begin(); node != nodes.end(); ++node) {
+        uint32_t address = p_optohybrid->getGEMHwInterface().getNode(*node).getAddress();
+        uint32_t mask    = p_optohybrid->getGEMHwInterface().getNode(*node).getMask();
+        regs.push_back(std::make_pair(std::make_pair(address, mask), 0x0));
+      }
     } // end loop over items in list
+    if (m_pendingItems.size() != nItems)
+      m_pendingSets.push_back(monlist->first);
   } // end loop over monitorableSets
+  return true;
+}
+
+bool gem::hw::optohybrid::OptoHybridMonitor::readRegisters(RegisterReadList& regs)
+{
+  gem::hw::GEMHwDevice::IPBusCategoryGuard ipBusCategory(gem::hw::GEMHwDevice::MONITORING);
+  return p_optohybrid->readRegs(regs);
+}
+
+void gem::hw::optohybrid::OptoHybridMonitor::publishRegisterReads(RegisterReadList const& regs, bool const& valid)
+{
+  // on a failed read the InfoSpace keeps the previous values, flagged as stale on the web pages
+  for (auto set = m_pendingSets.begin(); set != m_pendingSets.end(); ++set)
+    setStale(*set, !valid);
+
+  if (valid) {
+    std::vector<std::pair<GEMMonitorable*, uint64_t> > values;
+    values.reserve(m_pendingItems.size());
+    for (auto item = m_pendingItems.begin(); item != m_pendingItems.end(); ++item) {
+      GEMMonitorable const& monitem = *(item->first);
+      uint64_t value = regs.at(item->second).second;
+      if (monitem.updatetype == GEMUpdateType::HW64 || monitem.updatetype == GEMUpdateType::I2CSTAT) {
+        // upper word for HW64, acknowledge counter for I2CSTAT
+        uint64_t upper = regs.at(item->second+1).second;
+        value += (upper << 32);
+      }
+      values.push_back(std::make_pair(item->first, value));
+    }
+    if (!values.empty())
+      setMonitorableValues(m_infoSpaceMap.find("HWMonitoring")->second.first, values);
+  }
+  m_pendingItems.clear();
+  m_pendingSets.clear();
+
+  // dispatch latencies are kept by the device itself, not read from registers
+  if (m_monitorableSetsMap.find("IPBus Latency") != m_monitorableSetsMap.end() && isSetDue("IPBus Latency"))
+    p_optohybrid->updateIPBusLatencyItems(getInfoSpace("IPBus Latency").get());
 }
 
 void gem::hw::optohybrid::OptoHybridMonitor::buildMonitorPage(xgi::Output* out)
@@ -727,27 +770,16 @@ void gem::hw::optohybrid::OptoHybridMonitor::buildFirmwareScanTable(xgi::Output*
 
 void gem::hw::optohybrid::OptoHybridMonitor::reset()
 {
-  //have to get rid of the timer
-  DEBUG("GEMMonitor::reset");
-  for (auto infoSpace = m_infoSpaceMap.begin(); infoSpace != m_infoSpaceMap.end(); ++infoSpace) {
-    DEBUG("OptoHybridMonitor::reset removing " << infoSpace->first << " from p_timer");
-    try {
-      p_timer->remove(infoSpace->first);
-    } catch (toolbox::task::exception::Exception& te) {
-      ERROR("OptoHybridMonitor::Caught exception while removing timer task " << infoSpace->first << " " << te.what());
-    }
-  }
+  // take the monitor out of the shared scheduler
+  DEBUG("OptoHybridMonitor::reset");
   stopMonitoring();
-  DEBUG("GEMMonitor::reset removing timer " << m_timerName << " from timerFactory");
-  try {
-    toolbox::task::getTimerFactory()->removeTimer(m_timerName);
-  } catch (toolbox::task::exception::Exception& te) {
-    ERROR("OptoHybridMonitor::Caught exception while removing timer " << m_timerName << " " << te.what());
-  }
 
   DEBUG("OptoHybridMonitor::reset - clearing all maps");
   m_infoSpaceMap.clear();
   m_infoSpaceMonitorableSetMap.clear();
   m_monitorableSetInfoSpaceMap.clear();
   m_monitorableSetsMap.clear();
+
+  // don't keep serving the values of the removed items
+  updateJSONSnapshot();
 }
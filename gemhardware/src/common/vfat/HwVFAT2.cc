@@ -552,6 +552,46 @@ void gem::hw::vfat::HwVFAT2::setChannelTrimDAC(uint8_t channel, uint8_t trimDAC)
   }
 }
 
+bool gem::hw::vfat::HwVFAT2::getChannelTrimDACs(std::vector<uint8_t>& trimDACs)
+{
+  trimDACs.clear();
+  register_pair_list regs;
+  for (unsigned chan = 1; chan < 129; ++chan)
+    regs.push_back(std::make_pair(getDeviceBaseNode()+toolbox::toString(".VFATChannels.ChanReg%d", chan), 0x0));
+  if (!readRegs(regs)) {
+    ERROR("getChannelTrimDACs unable to read the channel registers");
+    return false;
+  }
+
+  trimDACs.reserve(regs.size());
+  for (auto reg = regs.begin(); reg != regs.end(); ++reg)
+    trimDACs.push_back(reg->second&VFAT2ChannelBitMasks::TRIMDAC);
+  return true;
+}
+
+bool gem::hw::vfat::HwVFAT2::setChannelTrimDACs(std::vector<uint8_t> const& trimDACs)
+{
+  if (trimDACs.size() != 128) {
+    ERROR(toolbox::toString("setChannelTrimDACs expects 128 values, %d given", (int)trimDACs.size()));
+    return false;
+  }
+
+  register_pair_list regs;
+  for (unsigned chan = 1; chan < 129; ++chan)
+    regs.push_back(std::make_pair(getDeviceBaseNode()+toolbox::toString(".VFATChannels.ChanReg%d", chan), 0x0));
+  // writing back what we did not read would clear the mask and calibration pulse bits of every channel
+  if (!readRegs(regs)) {
+    ERROR("setChannelTrimDACs unable to read the channel registers, TrimDACs not written");
+    return false;
+  }
+
+  auto trimDAC = trimDACs.begin();
+  for (auto reg = regs.begin(); reg != regs.end(); ++reg, ++trimDAC)
+    reg->second = (reg->second&~VFAT2ChannelBitMasks::TRIMDAC)|(*trimDAC&VFAT2ChannelBitMasks::TRIMDAC);
+  writeRegs(regs);
+  return true;
+}
+
 /***
     void gem::hw::vfat::HwVFAT2::setChannelTrimDAC(uint8_t channel, double trimDAC)
     {
@@ -132,7 +132,7 @@ class GEBdata {
   uint8_t  Stuckd()   {return m_Stuckd;}
 
 
-  void v_add(VFATdata v){vfatd.push_back(v);}
+  void v_add(VFATdata const& v){vfatd.push_back(v);}
 };
 
 class AMCdata
@@ -247,7 +247,7 @@ class AMCdata
   uint8_t L1AT()    {return m_L1AT;}
   uint32_t DlengthT()    {return m_DlengthT;}
 
-  void g_add(GEBdata g){gebd.push_back(g);}
+  void g_add(GEBdata const& g){gebd.push_back(g);}
 };
 
 class AMC13Event {
@@ -288,7 +288,7 @@ class AMC13Event {
     m_BoardID.push_back(BoardID_);
   }
 
-  void addAMCpayload(AMCdata a) {m_amcs.push_back(a);}
+  void addAMCpayload(AMCdata const& a) {m_amcs.push_back(a);}
 
 };
 
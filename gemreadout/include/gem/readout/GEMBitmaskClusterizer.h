@@ -0,0 +1,112 @@
+/** @file GEMBitmaskClusterizer.h */
+
+#ifndef GEM_READOUT_GEMBITMASKCLUSTERIZER_H
+#define GEM_READOUT_GEMBITMASKCLUSTERIZER_H
+
+#include <stdint.h>
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMStripMask
+     * @brief Fired strips of one eta partition, one bit per strip
+     *
+     * An eta partition is read out by three VFATs, so it has 3x128 strips.
+     */
+    class GEMStripMask {
+      public:
+        static const int NSTRIPS = 384;
+        static const int NWORDS  = NSTRIPS/64;
+
+        GEMStripMask() { clear(); };
+
+        void clear() {
+          for (int w = 0; w < NWORDS; ++w)
+            words[w] = 0;
+        };
+
+        void set(int const& strip) {
+          if (strip >= 0 && strip < NSTRIPS)
+            words[strip/64] |= 0x1ULL << (strip%64);
+        };
+
+        bool test(int const& strip) const {
+          return (strip >= 0 && strip < NSTRIPS) && ((words[strip/64] >> (strip%64)) & 0x1);
+        };
+
+        bool empty() const {
+          for (int w = 0; w < NWORDS; ++w)
+            if (words[w])
+              return false;
+          return true;
+        };
+
+        /**
+         * @returns the number of fired strips
+         */
+        int count() const {
+          int n = 0;
+          for (int w = 0; w < NWORDS; ++w)
+            n += __builtin_popcountll(words[w]);
+          return n;
+        };
+
+        uint64_t words[NWORDS];
+    };
+
+    typedef struct GEMBitmaskCluster {
+      int firstStrip;
+      int size;
+    } GEMBitmaskCluster;
+
+    /**
+     * @class GEMBitmaskClusterizer
+     * @brief Finds clusters of adjacent fired strips directly on a strip mask
+     *
+     * A cluster is a run of adjacent set bits. The start of each run is found with count trailing
+     * zeros, its extent with x & ~(x+1) (x+1 carries through the run) and its size with popcount.
+     * Runs that end on bit 63 of a word are merged with runs that start on bit 0 of the next one.
+     * Nothing is allocated, the clusters are written to a caller provided array.
+     */
+    class GEMBitmaskClusterizer {
+      public:
+        /// separated runs need at least one empty strip between them
+        static const int MAX_CLUSTERS = (GEMStripMask::NSTRIPS+1)/2;
+
+        /**
+         * @param mask the fired strips
+         * @param clusters array of at least MAX_CLUSTERS entries, filled in increasing strip order
+         * @returns the number of clusters found
+         */
+        static int clusterize(GEMStripMask const& mask, GEMBitmaskCluster* clusters) {
+          int nClusters = 0;
+          bool open = false;  // the last cluster reaches the top bit of the previous word
+          for (int w = 0; w < GEMStripMask::NWORDS; ++w) {
+            uint64_t bits = mask.words[w];
+            if (!(bits & 0x1))
+              open = false;
+            while (bits) {
+              int start    = __builtin_ctzll(bits);
+              uint64_t x   = bits >> start;
+              uint64_t run = x & ~(x + 1);
+              int size     = __builtin_popcountll(run);
+              if (open && start == 0) {
+                clusters[nClusters-1].size += size;
+              } else {
+                clusters[nClusters].firstStrip = 64*w + start;
+                clusters[nClusters].size       = size;
+                ++nClusters;
+              }
+              open  = (start + size) == 64;
+              bits &= ~(run << start);
+            }
+          }
+          return nClusters;
+        };
+
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMBITMASKCLUSTERIZER_H
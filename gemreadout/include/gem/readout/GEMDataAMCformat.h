@@ -386,33 +386,205 @@ namespace gem {
         return true;
       };
 
-      static bool readVFATdataBinary(std::ifstream& inpf, int event, VFATData& vfat) {
+      /**
+       * @brief reads the VFAT record written by writeVFATdataBinary or GEMEventSerializer, see decodeVFATrecord
+       * @param gebHeader header of the GEB the record belongs to, says whether it is zero suppressed
+       * @param index position of the record in its GEB
+       */
+      static bool readVFATdataBinary(std::ifstream& inpf, int event, VFATData& vfat,
+                                     uint64_t const& gebHeader=0, size_t const& index=0) {
         if (event<0) return false;
-        inpf.read( (char*)&vfat.BC,     sizeof(vfat.BC));
-        inpf.read( (char*)&vfat.EC,     sizeof(vfat.EC));
-        inpf.read( (char*)&vfat.ChipID, sizeof(vfat.ChipID));
-        inpf.read( (char*)&vfat.msData, sizeof(vfat.msData));
-        inpf.read( (char*)&vfat.lsData, sizeof(vfat.lsData));
-        inpf.read( (char*)&vfat.crc,    sizeof(vfat.crc));
-        inpf.read( (char*)&vfat.BXfrOH, sizeof(vfat.BXfrOH));
-        inpf.seekg (0, inpf.cur);
-        if(inpf.eof()) return false;
-        return true;
+        uint64_t words[VFAT_RECORD_MAX_WORDS];
+        size_t   nWords = 0;
+        do {
+          if (!inpf.read((char*)&words[nWords], sizeof(words[nWords]))) return false;
+        } while (++nWords < vfatRecordWords(words, nWords, gebHeader, index, false));
+        return decodeVFATrecord(words, nWords, gebHeader, index, false, vfat) == nWords;
+      };
+
+      /**
+       * @brief reads the VFAT record and its BX word, as written by writeVFATdata or GEMEventSerializer
+       * @param gebHeader header of the GEB the record belongs to, says whether it is zero suppressed
+       * @param index position of the record in its GEB
+       */
+      static bool readVFATdata(std::ifstream& inpf, int event, VFATData& vfat,
+                               uint64_t const& gebHeader=0, size_t const& index=0) {
+        if (event<0) return false;
+        uint64_t words[VFAT_RECORD_MAX_WORDS+1];
+        size_t   nWords = 0;
+        do {
+          if (!(inpf >> std::hex >> words[nWords])) return false;
+        } while (++nWords < vfatRecordWords(words, nWords, gebHeader, index, true));
+        return decodeVFATrecord(words, nWords, gebHeader, index, true, vfat) == nWords;
       };
 
-      static bool readVFATdata(std::ifstream& inpf, int event, VFATData& vfat) {
-        if (event<0) return false;
-        uint16_t msTmpUp, lsTmpUp;
-        uint16_t msTmpMid, lsTmpMid;
-        uint32_t msTmpLow, lsTmpLow;
-        inpf >> std::hex >> vfat.BC  >> vfat.EC >> vfat.ChipID >> msTmpUp;
-        inpf >> std::hex >> msTmpMid >> msTmpLow >> lsTmpUp;
-        inpf >> std::hex >> lsTmpMid >> lsTmpLow >> vfat.crc;
-        inpf >> std::hex >> vfat.BXfrOH;
-        vfat.msData = ((((uint64_t)msTmpUp<<16)+msTmpMid)<<32)+msTmpLow;
-        vfat.lsData = ((((uint64_t)lsTmpUp<<16)+lsTmpMid)<<32)+lsTmpLow;
-        if(inpf.eof()) return false;
-        return true;
+      /*
+       * VFAT blocks as read from the GLIB tracking data FIFO
+       */
+
+      static const int VFAT_BLOCK_WORDS = 7;
+
+      /**
+       * @brief unpacks one 7 word GLIB tracking data block, with the layout used by GEMDataParker::readVFATblock
+       * @returns false if the first word does not carry the 1010 and 1100 markers
+       */
+      static bool decodeVFATblock(uint32_t const* block, VFATData& vfat) {
+        vfat.BC     = block[0] >> 16;    // 1010:4 BC:12
+        vfat.EC     = block[0] & 0xffff; // 1100:4 EC:8 Flags:4
+        vfat.ChipID = block[1] >> 16;    // 1110:4 ChipID:12
+        uint64_t data1 = ((block[1] & 0xffff) << 16) | (block[2] >> 16);
+        uint64_t data2 = ((block[2] & 0xffff) << 16) | (block[3] >> 16);
+        uint64_t data3 = ((block[3] & 0xffff) << 16) | (block[4] >> 16);
+        uint64_t data4 = ((block[4] & 0xffff) << 16) | (block[5] >> 16);
+        vfat.msData = (data1 << 32) | data2;
+        vfat.lsData = (data3 << 32) | data4;
+        vfat.crc    = block[5] & 0xffff;
+        vfat.BXfrOH = block[6];
+        return ((vfat.BC >> 12) == 0xa) && ((vfat.EC >> 12) == 0xc);
+      };
+
+      /**
+       * @brief packs a VFAT back into the 7 word block decodeVFATblock reads
+       */
+      static void encodeVFATblock(VFATData const& vfat, uint32_t* block) {
+        uint32_t data1 = vfat.msData >> 32, data2 = vfat.msData & 0xffffffff;
+        uint32_t data3 = vfat.lsData >> 32, data4 = vfat.lsData & 0xffffffff;
+        block[0] = (uint32_t(vfat.BC) << 16) | vfat.EC;
+        block[1] = (uint32_t(vfat.ChipID) << 16) | (data1 >> 16);
+        block[2] = ((data1 & 0xffff) << 16) | (data2 >> 16);
+        block[3] = ((data2 & 0xffff) << 16) | (data3 >> 16);
+        block[4] = ((data3 & 0xffff) << 16) | (data4 >> 16);
+        block[5] = ((data4 & 0xffff) << 16) | vfat.crc;
+        block[6] = vfat.BXfrOH;
+      };
+
+      /*
+       * VFAT records in run files
+       *
+       * A full record is the 3 words written by writeVFATdata, the first carrying the 1010, 1100 and 1110
+       * markers of BC, EC and ChipID. A GEB whose header has GEB_ZS_RECORDS set holds zero suppressed
+       * records instead, all starting with BC:16 EC:16 ChipID:16 crc:16:
+       *   - a VFAT with no hits among the first 24 of the GEB is only that word, and has its ZSFlag bit,
+       *     23 - its position in the GEB, set in the GEB header
+       *   - any other VFAT has a second word, nHits:8 then up to VFAT_ZS_MAX_HITS channel numbers of
+       *     8 bits each, followed by msData and lsData in two more words if it has more hits
+       * The sumVFAT field of the GEB header counts the VFAT words actually written. Full and zero
+       * suppressed records decode to the same VFATData. In Hex files the BX word still follows every record.
+       */
+
+      static const uint64_t GEB_ZS_RECORDS        = 0x1ULL;  ///< GEB header bit of zero suppressed GEBs
+      static const int      GEB_ZSFLAG_SHIFT      = 40;
+      static const uint64_t GEB_ZSFLAG_MASK       = 0xffffffULL << GEB_ZSFLAG_SHIFT;
+      static const int      GEB_SUMVFAT_SHIFT     = 23;
+      static const uint64_t GEB_SUMVFAT_MASK      = 0x7ffULL << GEB_SUMVFAT_SHIFT;
+      static const size_t   GEB_ZSFLAG_VFATS      = 24;
+      static const unsigned VFAT_ZS_MAX_HITS      = 7;
+      static const size_t   VFAT_RECORD_MAX_WORDS = 4;
+
+      /**
+       * @returns the ZSFlag bit of the VFAT at index in its GEB, 0 past the first GEB_ZSFLAG_VFATS
+       */
+      static uint64_t zsFlagBit(size_t const& index) {
+        return index < GEB_ZSFLAG_VFATS ? 1ULL << (GEB_ZSFLAG_SHIFT + GEB_ZSFLAG_VFATS - 1 - index) : 0; };
+
+      /**
+       * @brief packs the VFAT into a zero suppressed record
+       * @param headerOnly whether a VFAT with no hits may be written as its first word alone
+       * @returns the number of words written to record, at most VFAT_RECORD_MAX_WORDS
+       */
+      static int encodeVFATzs(VFATData const& vfat, bool const& headerOnly, uint64_t* record) {
+        uint64_t bc = vfat.BC;
+        uint64_t ec = vfat.EC;
+        uint64_t ci = vfat.ChipID;
+        record[0] = (bc << 48) | (ec << 32) | (ci << 16) | vfat.crc;
+        unsigned nHits = __builtin_popcountll(vfat.lsData) + __builtin_popcountll(vfat.msData);
+        if (!nHits && headerOnly)
+          return 1;
+
+        uint64_t hits = static_cast<uint64_t>(nHits) << 56;
+        if (nHits > VFAT_ZS_MAX_HITS) {
+          record[1] = hits;
+          record[2] = vfat.msData;
+          record[3] = vfat.lsData;
+          return 4;
+        }
+        // channel n is bit n of lsData for n < 64, bit n-64 of msData otherwise
+        int shift = 48;
+        for (uint64_t bits = vfat.lsData; bits; bits &= bits - 1, shift -= 8)
+          hits |= static_cast<uint64_t>(__builtin_ctzll(bits)) << shift;
+        for (uint64_t bits = vfat.msData; bits; bits &= bits - 1, shift -= 8)
+          hits |= static_cast<uint64_t>(64 + __builtin_ctzll(bits)) << shift;
+        record[1] = hits;
+        return 2;
+      };
+
+      /**
+       * @returns the number of words of the VFAT record starting at words[0], BX word included if withBX,
+       *          as far as the nWords already read tell, at least nWords + 1 while more are needed
+       */
+      static size_t vfatRecordWords(uint64_t const* words, size_t const& nWords, uint64_t const& gebHeader,
+                                    size_t const& index, bool const& withBX) {
+        size_t nRecord;
+        if (!(gebHeader & GEB_ZS_RECORDS))
+          nRecord = 3;
+        else if (gebHeader & zsFlagBit(index))
+          nRecord = 1;
+        else if (nWords < 2)
+          nRecord = 2;  // the second word tells
+        else
+          nRecord = (words[1] >> 56) > VFAT_ZS_MAX_HITS ? 4 : 2;
+        return nRecord + (withBX ? 1 : 0);
+      };
+
+      /**
+       * @brief unpacks the VFAT record, full or zero suppressed, starting at words[0]
+       * @param nWords number of words available from words[0]
+       * @param gebHeader header of the GEB the record belongs to
+       * @param index position of the record in its GEB
+       * @param withBX whether the BX word follows the record, as in Hex files
+       * @returns the number of words used, 0 if words[0] does not start a valid VFAT record
+       */
+      static size_t decodeVFATrecord(uint64_t const* words, size_t const& nWords, uint64_t const& gebHeader,
+                                     size_t const& index, bool const& withBX, VFATData& vfat) {
+        if (!nWords)
+          return 0;
+        uint64_t word = words[0];
+        if ((word >> 60) != 0xa || ((word >> 44) & 0xf) != 0xc)
+          return 0;
+        size_t nUsed = vfatRecordWords(words, nWords, gebHeader, index, withBX);
+        if (nUsed > nWords)
+          return 0;
+        size_t nRecord = nUsed - (withBX ? 1 : 0);
+
+        vfat.BC     = word >> 48;
+        vfat.EC     = (word >> 32) & 0xffff;
+        vfat.ChipID = (word >> 16) & 0xffff;
+        if (!(gebHeader & GEB_ZS_RECORDS)) {
+          vfat.msData = (word << 48) | (words[1] >> 16);
+          vfat.lsData = (words[1] << 48) | (words[2] >> 16);
+          vfat.crc    = words[2] & 0xffff;
+        } else {
+          vfat.crc    = word & 0xffff;
+          vfat.msData = 0;
+          vfat.lsData = 0;
+          if (nRecord == 4) {
+            vfat.msData = words[2];
+            vfat.lsData = words[3];
+          } else if (nRecord == 2) {
+            unsigned nHits = words[1] >> 56;
+            for (unsigned hit = 0; hit < nHits; ++hit) {
+              unsigned channel = (words[1] >> (48 - 8*hit)) & 0xff;
+              if (channel < 64)
+                vfat.lsData |= 1ULL << channel;
+              else if (channel < 128)
+                vfat.msData |= 1ULL << (channel - 64);
+              else
+                return 0;
+            }
+          }
+        }
+        vfat.BXfrOH = withBX ? words[nRecord] : 0;
+        return nUsed;
       };
 
       //
@@ -3,6 +3,8 @@
 #ifndef GEM_READOUT_GEMDATAPARKER_H
 #define GEM_READOUT_GEMDATAPARKER_H
 
+#include <fstream>
+#include <memory>
 #include <string>
 #include <queue>
 
@@ -21,6 +23,9 @@
 #include "gem/utils/LockGuard.h"
 
 #include "gem/readout/GEMDataAMCformat.h"
+#include "gem/readout/GEMEventArena.h"
+#include "gem/readout/GEMEventBuilder.h"
+#include "gem/readout/GEMEventSerializer.h"
 
 namespace gem {
   namespace hw {
@@ -69,23 +74,12 @@ namespace gem {
                              );
       void GEMevSelector   ( const  uint32_t& ES
                            );
-      void GEMfillHeaders  ( uint32_t const& BC,
-                             uint32_t const& BX,
-                             gem::readout::GEMDataAMCformat::GEMData& gem,
-                             gem::readout::GEMDataAMCformat::GEBData& geb
-                           );
-      bool VFATfillData    ( int const& islot,
-                             gem::readout::GEMDataAMCformat::GEBData& geb
-                           );
-      void GEMfillTrailers ( gem::readout::GEMDataAMCformat::GEMData& gem,
-                             gem::readout::GEMDataAMCformat::GEBData& geb
-                           );
-      void writeGEMevent   ( std::string outFile,
-                             bool const& OKprint,
-                             std::string const& TypeDataFlag,
-                             gem::readout::GEMDataAMCformat::GEMData& gem,
-                             gem::readout::GEMDataAMCformat::GEBData& geb,
-                             gem::readout::GEMDataAMCformat::VFATData& vfat
+      /**
+       * @brief writes the whole event to outf, in the format chosen at construction
+       */
+      void writeGEMevent   ( std::ofstream& outf,
+                             gem::readout::GEMArenaEvent const& gem,
+                             gem::readout::GEMArenaGEB const& geb
                            );
       int queueDepth       () {return m_dataque.size();}
 
@@ -103,9 +97,6 @@ namespace gem {
 
 
     private:
-      // moved from globals...
-      uint32_t m_ESexp;
-      bool     m_isFirst;
       //uint64_t m_ZSFlag;
       uint32_t m_contvfats;
 
@@ -119,10 +110,8 @@ namespace gem {
 
       uint8_t m_latency, m_VT1, m_VT2;
 
-      static const int MaxVFATS = 24; // was 32 ???
-      static const int MaxERRS  = 4095; // should this also be 24? Or we can accomodate full GLIB FIFO of bad blocks belonging to the same event?
-
-      std::unique_ptr<GEMslotContents> slotInfo;
+      // sorts the VFATs of each event by slot, in recycled fixed capacity records
+      GEMEventBuilder m_builder;
 
       log4cplus::Logger m_gemLogger;
       gem::hw::glib::HwGLIB* p_glibDevice;
@@ -131,6 +120,11 @@ namespace gem {
       std::string m_errFileName;
       std::string m_outputType;
 
+      // resolved from m_outputType once, at construction
+      std::unique_ptr<GEMEventSerializer> p_serializer;
+      std::ofstream m_outFile;
+      std::ofstream m_errFile;
+
       // queue safety
       mutable gem::utils::Lock m_queueLock;
       // The main data flow
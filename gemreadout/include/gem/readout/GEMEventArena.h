@@ -0,0 +1,197 @@
+/** @file GEMEventArena.h */
+
+#ifndef GEM_READOUT_GEMEVENTARENA_H
+#define GEM_READOUT_GEMEVENTARENA_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "gem/readout/GEMDataAMCformat.h"
+#include "gem/utils/Lock.h"
+#include "gem/utils/LockGuard.h"
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMArenaVector
+     * @brief The std::vector interface used by the readout, over storage owned by a GEMEventPool
+     *
+     * The capacity is fixed when the pool attaches the storage, push_back never allocates and
+     * refuses elements beyond the capacity.
+     */
+    template <class T>
+      class GEMArenaVector
+      {
+      public:
+        typedef T*       iterator;
+        typedef T const* const_iterator;
+
+        GEMArenaVector() : p_data(NULL), m_size(0), m_capacity(0) {};
+
+        void attach(T* data, size_t const& capacity) { p_data = data; m_size = 0; m_capacity = capacity; };
+
+        /**
+         * @returns false, and drops the element, if the vector is full
+         */
+        bool push_back(T const& value) {
+          if (m_size == m_capacity)
+            return false;
+          p_data[m_size++] = value;
+          return true;
+        };
+
+        /**
+         * @brief appends the next element in place, keeping whatever the storage already holds
+         * @returns NULL if the vector is full
+         */
+        T* extend() { return (m_size == m_capacity) ? NULL : &p_data[m_size++]; };
+
+        void clear() { m_size = 0; };
+
+        size_t size()     const { return m_size; };
+        size_t capacity() const { return m_capacity; };
+        bool   empty()    const { return m_size == 0; };
+        bool   full()     const { return m_size == m_capacity; };
+
+        T&       operator[](size_t const& i)       { return p_data[i]; };
+        T const& operator[](size_t const& i) const { return p_data[i]; };
+        T&       back()       { return p_data[m_size-1]; };
+        T const& back() const { return p_data[m_size-1]; };
+
+        iterator       begin()       { return p_data; };
+        iterator       end()         { return p_data + m_size; };
+        const_iterator begin() const { return p_data; };
+        const_iterator end()   const { return p_data + m_size; };
+
+      private:
+        T*     p_data;
+        size_t m_size;
+        size_t m_capacity;
+      };
+
+    /**
+     * GEB block of a GEMArenaEvent, same fields as GEMDataAMCformat::GEBData
+     */
+    struct GEMArenaGEB {
+      uint64_t header;
+      uint64_t runhed;
+      GEMArenaVector<GEMDataAMCformat::VFATData> vfats;
+      uint64_t trailer;
+    };
+
+    /**
+     * Fixed capacity event, same fields as GEMDataAMCformat::GEMData, so code reading the fields
+     * of either works on both
+     */
+    struct GEMArenaEvent {
+      uint64_t header1;
+      uint64_t header2;
+      uint64_t header3;
+      GEMArenaVector<GEMArenaGEB> gebs;
+      uint64_t trailer2;
+      uint64_t trailer1;
+
+      /**
+       * @brief appends an empty GEB, with room for the pool's number of VFATs per GEB
+       * @returns NULL if the event already holds the pool's number of GEBs
+       */
+      GEMArenaGEB* addGEB() {
+        GEMArenaGEB* geb = gebs.extend();
+        if (geb) {
+          geb->header  = 0;
+          geb->runhed  = 0;
+          geb->trailer = 0;
+          geb->vfats.clear();
+        }
+        return geb;
+      };
+    };
+
+    /**
+     * @class GEMEventPool
+     * @brief Recycles fixed capacity events, so building an event allocates nothing
+     *
+     * All events, GEBs and VFATs are carved out of three arrays allocated once at construction.
+     * acquire takes an event from the free list and release returns it, both only move a pointer.
+     */
+    class GEMEventPool
+    {
+    public:
+      /**
+       * @param nEvents number of events that can be in use at the same time
+       * @param maxGEBs capacity of the gebs of each event
+       * @param maxVFATs capacity of the vfats of each GEB
+       */
+      GEMEventPool(size_t const& nEvents, size_t const& maxGEBs, size_t const& maxVFATs) :
+        m_lock(toolbox::BSem::FULL, true),
+        m_events(nEvents),
+        m_gebs(nEvents*maxGEBs),
+        m_vfats(nEvents*maxGEBs*maxVFATs),
+        m_nExhausted(0)
+      {
+        m_free.reserve(nEvents);
+        for (size_t e = 0; e < nEvents; ++e) {
+          m_events[e].gebs.attach(&m_gebs[e*maxGEBs], maxGEBs);
+          for (size_t g = 0; g < maxGEBs; ++g)
+            m_gebs[e*maxGEBs + g].vfats.attach(&m_vfats[(e*maxGEBs + g)*maxVFATs], maxVFATs);
+          m_free.push_back(&m_events[nEvents - 1 - e]);
+        }
+      };
+
+      /**
+       * @returns an empty event, NULL if all events are in use
+       */
+      GEMArenaEvent* acquire() {
+        gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+        if (m_free.empty()) {
+          ++m_nExhausted;
+          return NULL;
+        }
+        GEMArenaEvent* event = m_free.back();
+        m_free.pop_back();
+        event->header1  = 0;
+        event->header2  = 0;
+        event->header3  = 0;
+        event->trailer2 = 0;
+        event->trailer1 = 0;
+        event->gebs.clear();
+        return event;
+      };
+
+      void release(GEMArenaEvent* event) {
+        if (!event)
+          return;
+        gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+        m_free.push_back(event);
+      };
+
+      size_t getCapacity()  const { return m_events.size(); };
+      size_t getAvailable() {
+        gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+        return m_free.size();
+      };
+      /// number of acquire calls that found no free event
+      uint64_t getExhausted() {
+        gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+        return m_nExhausted;
+      };
+
+    private:
+      // Prevent copying, the events point into the pool's own arrays
+      GEMEventPool(GEMEventPool const&);
+      GEMEventPool& operator=(GEMEventPool const&);
+
+      gem::utils::Lock                       m_lock;
+      std::vector<GEMArenaEvent>             m_events;
+      std::vector<GEMArenaGEB>               m_gebs;
+      std::vector<GEMDataAMCformat::VFATData> m_vfats;
+      std::vector<GEMArenaEvent*>            m_free;
+      uint64_t                               m_nExhausted;
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMEVENTARENA_H
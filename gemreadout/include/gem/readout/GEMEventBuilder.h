@@ -0,0 +1,174 @@
+/** @file GEMEventBuilder.h */
+
+#ifndef GEM_READOUT_GEMEVENTBUILDER_H
+#define GEM_READOUT_GEMEVENTBUILDER_H
+
+#include <stdint.h>
+
+#include "gem/readout/GEMDataAMCformat.h"
+#include "gem/readout/GEMEventArena.h"
+#include "gem/readout/GEMSlotMapService.h"
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMEventBuilder
+     * @brief Groups decoded VFATs into GEM events and fills their framing words
+     *
+     * Consecutive VFATs with the same EC and BC form an event. With a slot map, VFATs whose ChipID
+     * is in no slot go to a separate error event, built alongside the payload event.
+     * The events are pooled records, one of each is in use between the first add and release.
+     * Shared by GEMDataParker, GLIBReadout and GEMReadoutReplay, which decode, time and write the events.
+     */
+    class GEMEventBuilder
+    {
+    public:
+      static const int MaxVFATS = 24;    // was 32 ???
+      static const int MaxERRS  = 4095;  // a full GLIB FIFO of VFATs in no known slot
+
+      /**
+       * @param slotMap sorts VFATs of no known slot into the error event, NULL to keep them all in the payload
+       */
+      explicit GEMEventBuilder(GEMSlotMap const* slotMap=NULL) :
+        p_slotMap(slotMap),
+        m_eventPool(1, 1, MaxVFATS+1),  // GEMDataParker kept up to MaxVFATS+1 VFATs per event
+        m_errorPool(1, 1, MaxERRS),
+        p_event(NULL),
+        p_errEvent(NULL),
+        m_ES(0),
+        m_latency(0),
+        m_VT1(0),
+        m_VT2(0),
+        m_runhed(0),
+        m_nDropped(0) {};
+
+      ~GEMEventBuilder() { release(); };
+
+      /**
+       * @returns the event selector of the VFAT, its 8 bit EC and 12 bit BC
+       */
+      static uint32_t eventSelector(GEMDataAMCformat::VFATData const& vfat) {
+        return (((vfat.EC >> 4) & 0xff) << 12) | (vfat.BC & 0x0fff); };
+
+      /**
+       * @returns true if vfat belongs to another event than the one being built, which must
+       *          then be completed and released before vfat is added
+       */
+      bool startsNewEvent(GEMDataAMCformat::VFATData const& vfat) const {
+        return p_event && eventSelector(vfat) != m_ES; };
+
+      /**
+       * @brief adds vfat to the event being built, starting one if none is
+       * @returns false if the event is full and the VFAT was dropped
+       */
+      bool add(GEMDataAMCformat::VFATData const& vfat) {
+        if (!p_event) {
+          p_event    = m_eventPool.acquire();
+          p_errEvent = m_errorPool.acquire();
+          p_event->addGEB();
+          p_errEvent->addGEB();
+          m_ES = eventSelector(vfat);
+        }
+        bool noSlot = p_slotMap && p_slotMap->slotIndex(vfat.ChipID) < 0;
+        if ((noSlot ? p_errEvent : p_event)->gebs[0].vfats.push_back(vfat))
+          return true;
+        ++m_nDropped;
+        return false;
+      };
+
+      /**
+       * @brief fills the framing words of the payload event and of a non empty error event
+       * @param event LV1ID written in the GEM header
+       */
+      void complete(uint32_t const& event) {
+        fillFraming(event, *p_event, p_event->gebs[0]);
+        if (!p_errEvent->gebs[0].vfats.empty())
+          fillFraming(event, *p_errEvent, p_errEvent->gebs[0]);
+      };
+
+      /**
+       * @brief returns the events to their pools, the next add starts a new event
+       */
+      void release() {
+        m_eventPool.release(p_event);
+        m_errorPool.release(p_errEvent);
+        p_event    = NULL;
+        p_errEvent = NULL;
+      };
+
+      bool     hasEvent()         const { return p_event != NULL; };
+      uint32_t getEventSelector() const { return m_ES; };
+
+      /// only valid between add and release
+      GEMArenaEvent& getEvent()      { return *p_event; };
+      GEMArenaGEB&   getGEB()        { return p_event->gebs[0]; };
+      GEMArenaEvent& getErrorEvent() { return *p_errEvent; };
+      GEMArenaGEB&   getErrorGEB()   { return p_errEvent->gebs[0]; };
+
+      size_t getNVFATs()  const { return p_event    ? p_event->gebs[0].vfats.size()    : 0; };
+      size_t getNErrors() const { return p_errEvent ? p_errEvent->gebs[0].vfats.size() : 0; };
+
+      /**
+       * @brief scan point written in the GEM header 2 of the following events
+       */
+      void setScanParameters(uint8_t const& latency, uint8_t const& VT1, uint8_t const& VT2) {
+        m_latency = latency;
+        m_VT1     = VT1;
+        m_VT2     = VT2;
+      };
+
+      /**
+       * @brief GEB run header word of the following events
+       */
+      void setRunHeader(uint64_t const& runhed) { m_runhed = runhed; };
+
+      /// number of VFATs that did not fit in their event
+      uint64_t getDropped() const { return m_nDropped; };
+
+    private:
+      // Prevent copying, the events point into the pools
+      GEMEventBuilder(GEMEventBuilder const&);
+      GEMEventBuilder& operator=(GEMEventBuilder const&);
+
+      void fillFraming(uint32_t const& event, GEMArenaEvent& gem, GEMArenaGEB& geb) const {
+        uint64_t nVFATs = geb.vfats.size();
+
+        // AmcNo:4 | ZeroFlag:4 | LV1ID:24 | BXID:12 | DataLgth:20
+        gem.header1 = (0x1ULL << 60) | ((0x0000000000ffffffULL & event) << 32) | 0x1;
+        // FormatVersion:4 | RunType:4 | Latency:8 | VT1:8 | VT2:8 | OrN:16 | BoardID:16
+        gem.header2 = (0x1ULL << 56) | (static_cast<uint64_t>(m_latency) << 48) |
+          (static_cast<uint64_t>(m_VT1) << 40) | (static_cast<uint64_t>(m_VT2) << 32) | (0x1ULL << 16) | 0x1;
+        // BufStat:24 | DAVList:24 | DAVCount:5 | FormatVer:3 | MP7BordStat:8
+        gem.header3 = (0x1ULL << 40) | (0x1ULL << 16) | ((0x1fULL & nVFATs) << 11) | (0x1ULL << 8) | 0x1;
+
+        // ZSFlag:24 | ChamID:5 | sumVFAT:11, full VFAT records of 3 words, GEMEventSerializer
+        // rewrites ZSFlag and sumVFAT when it writes zero suppressed records
+        geb.header  = (0x1fULL << 35) |
+          (((3*nVFATs) << GEMDataAMCformat::GEB_SUMVFAT_SHIFT) & GEMDataAMCformat::GEB_SUMVFAT_MASK);
+        geb.runhed  = m_runhed;
+        // OHcrc:16 | OHwCount:16 | ChamStatus:16
+        geb.trailer = (0x1ULL << 48) | (0x1ULL << 32) | (0x1ULL << 16);
+
+        // EventStat:32 | GEBerrFlag:24
+        gem.trailer2 = (0x1ULL << 40) | 0x1;
+        // crc:32 | LV1IDT:8 | ZeroFlag:4 | DataLgth:20
+        gem.trailer1 = (0x1ULL << 32) | (0x1ULL << 24) | 0x1;
+      };
+
+      GEMSlotMap const* p_slotMap;
+
+      GEMEventPool   m_eventPool;
+      GEMEventPool   m_errorPool;
+      GEMArenaEvent* p_event;     ///< event being built, NULL if none
+      GEMArenaEvent* p_errEvent;  ///< VFATs of the event being built that are in no known slot
+      uint32_t       m_ES;        ///< EC and BC of the event being built
+
+      uint8_t  m_latency, m_VT1, m_VT2;
+      uint64_t m_runhed;
+      uint64_t m_nDropped;
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMEVENTBUILDER_H
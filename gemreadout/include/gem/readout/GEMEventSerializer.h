@@ -0,0 +1,236 @@
+/** @file GEMEventSerializer.h */
+
+#ifndef GEM_READOUT_GEMEVENTSERIALIZER_H
+#define GEM_READOUT_GEMEVENTSERIALIZER_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "gem/readout/GEMDataAMCformat.h"
+#include "gem/readout/GEMEventArena.h"
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMEventSerializer
+     * @brief Writes a whole GEM event in the output format chosen at configure time
+     *
+     * The format is resolved once, by create, into one of the GEMEventSerializerT instantiations below.
+     * An event is then serialised into a memory buffer in a single pass, with no per field format
+     * checks and no logging, and handed to the stream with one write.
+     * The bytes produced are identical to those of the GEMDataAMCformat::write* functions,
+     * unless zero suppression is switched on.
+     * GEMDataParker and GLIBReadout write their events with it, but are not part of the build, so
+     * GEMReadoutReplay is the only compiled user.
+     */
+    class GEMEventSerializer
+    {
+    public:
+      GEMEventSerializer() : m_lastEventSize(0), m_zeroSuppression(false) {};
+      virtual ~GEMEventSerializer() {};
+
+      /**
+       * @param outputType "Hex" for text output, anything else for binary, as for the write* functions
+       * @returns a new serializer for the format, owned by the caller
+       */
+      static GEMEventSerializer* create(std::string const& outputType);
+
+      /**
+       * @brief serialises the event into buffer, which must hold at least maxEventSize(geb.vfats.size()) bytes
+       * @returns the number of bytes written
+       */
+      virtual size_t serialize(GEMDataAMCformat::GEMData const& gem, GEMDataAMCformat::GEBData const& geb,
+                               char* buffer) const = 0;
+      virtual size_t serialize(GEMArenaEvent const& gem, GEMArenaGEB const& geb, char* buffer) const = 0;
+
+      virtual size_t maxEventSize(size_t const& nVFATs) const = 0;
+
+      virtual std::string getFormatName() const = 0;
+
+      /**
+       * @brief serialises the event into an internal buffer and writes it to outf
+       * @returns false if the stream is in a failed state after the write
+       */
+      bool write(std::ostream& outf, GEMDataAMCformat::GEMData const& gem, GEMDataAMCformat::GEBData const& geb) {
+        return writeEvent(outf, gem, geb);
+      };
+      bool write(std::ostream& outf, GEMArenaEvent const& gem, GEMArenaGEB const& geb) {
+        return writeEvent(outf, gem, geb);
+      };
+
+      /**
+       * @brief switches the VFAT records of the following events between full and zero suppressed,
+       *        see GEMDataAMCformat::encodeVFATzs, the GEB header says which so this may change at any event
+       */
+      void setZeroSuppression(bool const& zs) { m_zeroSuppression = zs; };
+      bool isZeroSuppressed() const { return m_zeroSuppression; };
+
+      /**
+       * @returns the number of bytes handed to the stream by the last write
+       */
+      size_t getLastEventSize() const { return m_lastEventSize; };
+
+    private:
+      template <class GEM, class GEB>
+        bool writeEvent(std::ostream& outf, GEM const& gem, GEB const& geb) {
+          size_t needed = maxEventSize(geb.vfats.size());
+          if (m_buffer.size() < needed)
+            m_buffer.resize(needed);
+          size_t size = serialize(gem, geb, &m_buffer[0]);
+          outf.write(&m_buffer[0], size);
+          m_lastEventSize = size;
+          return outf.good();
+        };
+
+      std::vector<char> m_buffer;
+      size_t            m_lastEventSize;
+      bool              m_zeroSuppression;
+    };
+
+    /**
+     * One 64 bit word per line, as 16 lower case hexadecimal digits
+     */
+    struct GEMHexFormat {
+      static const bool   AMC13_WRAPPER = false;  ///< CDF and AMC13 words around the event
+      static const bool   RUN_HEADER    = true;   ///< GEB run header after the GEB header
+      static const bool   VFAT_BX       = true;   ///< BX from the OptoHybrid as a fourth VFAT word
+      static const size_t WORD_SIZE     = 17;
+
+      static char* putWord(char* out, uint64_t word) {
+        static const char digits[] = "0123456789abcdef";
+        for (int nibble = 15; nibble >= 0; --nibble)
+          *out++ = digits[(word >> (4*nibble)) & 0xf];
+        *out++ = '\n';
+        return out;
+      };
+
+      static std::string name() { return "Hex"; };
+    };
+
+    /**
+     * One 64 bit word per 8 bytes, in host order
+     */
+    struct GEMBinaryFormat {
+      static const bool   AMC13_WRAPPER = true;
+      static const bool   RUN_HEADER    = false;
+      static const bool   VFAT_BX       = false;
+      static const size_t WORD_SIZE     = sizeof(uint64_t);
+
+      static char* putWord(char* out, uint64_t word) {
+        memcpy(out, &word, sizeof(word));
+        return out + sizeof(word);
+      };
+
+      static std::string name() { return "Bin"; };
+    };
+
+    template <class Format>
+      class GEMEventSerializerT : public GEMEventSerializer
+      {
+      public:
+        static const uint64_t CDF_HEADER    = 0x5fffffffffffffffULL;
+        static const uint64_t AMC13_HEADER1 = 0xff1ffffffffffff0ULL;
+        static const uint64_t AMC13_HEADER2 = 0xffffffffffffffffULL;
+        static const uint64_t AMC13_TRAILER = 0xbadc0ffeebadcafeULL;
+        static const uint64_t CDF_TRAILER   = 0xafffffffffffffffULL;
+
+        size_t serialize(GEMDataAMCformat::GEMData const& gem, GEMDataAMCformat::GEBData const& geb,
+                         char* buffer) const {
+          return serializeEvent(gem, geb, buffer);
+        };
+
+        size_t serialize(GEMArenaEvent const& gem, GEMArenaGEB const& geb, char* buffer) const {
+          return serializeEvent(gem, geb, buffer);
+        };
+
+        size_t maxEventSize(size_t const& nVFATs) const {
+          // 3 GEM headers, GEB header, run header, a record and a BX word per VFAT, GEB trailer,
+          // 2 GEM trailers, 5 AMC13 words
+          return Format::WORD_SIZE*(14 + (GEMDataAMCformat::VFAT_RECORD_MAX_WORDS + 1)*nVFATs);
+        };
+
+        std::string getFormatName() const { return Format::name(); };
+
+      private:
+        /**
+         * GEMData and GEMArenaEvent have the same fields, the words are written identically for both
+         */
+        template <class GEM, class GEB>
+          size_t serializeEvent(GEM const& gem, GEB const& geb, char* buffer) const {
+          char* out = buffer;
+          if (Format::AMC13_WRAPPER) {
+            out = Format::putWord(out, CDF_HEADER);
+            out = Format::putWord(out, AMC13_HEADER1);
+            out = Format::putWord(out, AMC13_HEADER2);
+          }
+          out = Format::putWord(out, gem.header1);
+          out = Format::putWord(out, gem.header2);
+          out = Format::putWord(out, gem.header3);
+
+          // zero suppressed GEBs get their flags and word count once the records are written
+          char* gebHeader = out;
+          out = Format::putWord(out, geb.header);
+          if (Format::RUN_HEADER)
+            out = Format::putWord(out, geb.runhed);
+
+          bool     zs      = isZeroSuppressed();
+          uint64_t zsFlags = GEMDataAMCformat::GEB_ZS_RECORDS;
+          uint64_t nWords  = 0;
+          size_t   index   = 0;
+          for (auto vfat = geb.vfats.begin(); vfat != geb.vfats.end(); ++vfat, ++index) {
+            if (zs) {
+              uint64_t record[GEMDataAMCformat::VFAT_RECORD_MAX_WORDS];
+              uint64_t zsFlag = GEMDataAMCformat::zsFlagBit(index);
+              int      nZS    = GEMDataAMCformat::encodeVFATzs(*vfat, zsFlag != 0, record);
+              if (nZS == 1)
+                zsFlags |= zsFlag;
+              for (int word = 0; word < nZS; ++word)
+                out = Format::putWord(out, record[word]);
+              nWords += nZS;
+            } else {
+              uint64_t bc = vfat->BC;
+              uint64_t ec = vfat->EC;
+              uint64_t ci = vfat->ChipID;
+              out = Format::putWord(out, (bc << 48) | (ec << 32) | (ci << 16) | (vfat->msData >> 48));
+              out = Format::putWord(out, (vfat->msData << 16) | (vfat->lsData >> 48));
+              out = Format::putWord(out, (vfat->lsData << 16) | vfat->crc);
+            }
+            if (Format::VFAT_BX)
+              out = Format::putWord(out, vfat->BXfrOH);
+          }
+
+          if (zs) {
+            uint64_t header = geb.header & ~(GEMDataAMCformat::GEB_ZSFLAG_MASK | GEMDataAMCformat::GEB_SUMVFAT_MASK);
+            Format::putWord(gebHeader, header | zsFlags |
+                            ((nWords << GEMDataAMCformat::GEB_SUMVFAT_SHIFT) & GEMDataAMCformat::GEB_SUMVFAT_MASK));
+          }
+
+          out = Format::putWord(out, geb.trailer);
+          out = Format::putWord(out, gem.trailer2);
+          out = Format::putWord(out, gem.trailer1);
+          if (Format::AMC13_WRAPPER) {
+            out = Format::putWord(out, AMC13_TRAILER);
+            out = Format::putWord(out, CDF_TRAILER);
+          }
+          return out - buffer;
+        };
+      };
+
+    typedef GEMEventSerializerT<GEMHexFormat>    GEMHexEventSerializer;
+    typedef GEMEventSerializerT<GEMBinaryFormat> GEMBinaryEventSerializer;
+
+    inline GEMEventSerializer* GEMEventSerializer::create(std::string const& outputType)
+    {
+      if (outputType == "Hex")
+        return new GEMHexEventSerializer();
+      return new GEMBinaryEventSerializer();
+    }
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMEVENTSERIALIZER_H
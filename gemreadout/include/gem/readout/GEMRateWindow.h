@@ -0,0 +1,105 @@
+/** @file GEMRateWindow.h */
+
+#ifndef GEM_READOUT_GEMRATEWINDOW_H
+#define GEM_READOUT_GEMRATEWINDOW_H
+
+#include <stdint.h>
+#include <time.h>
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMRateWindow
+     * @brief Item and byte rates over the last seconds, e.g., events/s and bytes/s of a readout stage
+     *
+     * Counts are accumulated in a ring of one second slots, keyed by the CLOCK_MONOTONIC second
+     * they were recorded in, so that the rate over any window up to N_SLOTS-1 seconds can be read
+     * without keeping the individual records. Only complete seconds are used, the rates therefore
+     * lag by up to one second. Slots of seconds with no record are simply out of date and ignored.
+     * No locking is done, callers are expected to protect the object.
+     */
+    class GEMRateWindow
+    {
+    public:
+      static const unsigned N_SLOTS = 64;
+
+      GEMRateWindow() { reset(); };
+
+      /**
+       * @param sec CLOCK_MONOTONIC second the items were handled in, see now()
+       */
+      void record(uint64_t const& sec, uint64_t const& nItems, uint64_t const& nBytes) {
+        Slot& slot = m_slots[sec%N_SLOTS];
+        if (slot.sec != sec) {
+          slot.sec    = sec;
+          slot.nItems = 0;
+          slot.nBytes = 0;
+        }
+        slot.nItems += nItems;
+        slot.nBytes += nBytes;
+      };
+
+      void reset() {
+        for (unsigned i = 0; i < N_SLOTS; ++i) {
+          m_slots[i].sec    = NO_SECOND;
+          m_slots[i].nItems = 0;
+          m_slots[i].nBytes = 0;
+        }
+      };
+
+      /**
+       * @param sec current CLOCK_MONOTONIC second, see now()
+       * @param window number of complete seconds before sec to average over, at most N_SLOTS-1
+       * @returns the number of items per second over the window
+       */
+      double getItemRate(uint64_t const& sec, unsigned const& window) const {
+        uint64_t nItems, nBytes;
+        sum(sec, window, nItems, nBytes);
+        return window ? static_cast<double>(nItems)/window : 0.;
+      };
+
+      double getByteRate(uint64_t const& sec, unsigned const& window) const {
+        uint64_t nItems, nBytes;
+        sum(sec, window, nItems, nBytes);
+        return window ? static_cast<double>(nBytes)/window : 0.;
+      };
+
+      /**
+       * @returns the current CLOCK_MONOTONIC second
+       */
+      static uint64_t now() {
+        timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec;
+      };
+
+    private:
+      static const uint64_t NO_SECOND = ~0ULL;
+
+      struct Slot {
+        uint64_t sec;
+        uint64_t nItems;
+        uint64_t nBytes;
+      };
+
+      void sum(uint64_t const& sec, unsigned window, uint64_t& nItems, uint64_t& nBytes) const {
+        nItems = 0;
+        nBytes = 0;
+        if (window > N_SLOTS-1)
+          window = N_SLOTS-1;
+        for (uint64_t s = (sec > window ? sec-window : 0); s < sec; ++s) {
+          Slot const& slot = m_slots[s%N_SLOTS];
+          if (slot.sec != s)
+            continue;
+          nItems += slot.nItems;
+          nBytes += slot.nBytes;
+        }
+      };
+
+      Slot m_slots[N_SLOTS];
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMRATEWINDOW_H
@@ -17,6 +17,9 @@
 
 #include "gem/base/GEMFSMApplication.h"
 
+#include "gem/readout/GEMRateWindow.h"
+#include "gem/readout/GEMStageStatistics.h"
+
 #include "gem/utils/GEMLogging.h"
 #include "gem/utils/Lock.h"
 #include "gem/utils/LockGuard.h"
@@ -28,6 +31,8 @@ namespace gem {
 
     class GEMReadoutApplication : public gem::base::GEMFSMApplication
       {
+        friend class GEMReadoutWebApplication;
+
       public:
         static const int I2O_READOUT_NOTIFY;
         static const int I2O_READOUT_CONFIRM;
@@ -42,6 +47,25 @@ namespace gem {
           } ReadoutCommands;
         };
 
+        /**
+         * Stages of the readout chain, each records the time it spends on its work through recordStage
+         */
+        enum ReadoutStage {
+          STAGE_FIFO_READ = 0,  ///< hardware buffer to memory
+          STAGE_DECODE    = 1,  ///< raw words to VFAT blocks
+          STAGE_BUILD     = 2,  ///< VFAT blocks to events
+          STAGE_DQM       = 3,  ///< online histograms
+          STAGE_WRITE     = 4,  ///< events to the output file
+          N_READOUT_STAGES
+        };
+
+        static const unsigned RATE_WINDOW_SHORT = 10;  ///< seconds
+
+        /**
+         * @returns the name the stage is published under, e.g., "FIFORead"
+         */
+        static std::string getStageName(ReadoutStage const& stage);
+
         GEMReadoutApplication(xdaq::ApplicationStub *stub)
           throw (xdaq::exception::Exception);
 
@@ -88,6 +112,28 @@ namespace gem {
 
         virtual int readout(unsigned int expected, unsigned int* eventNumbers, std::vector< ::toolbox::mem::Reference* >& data) = 0;
 
+        /**
+         * @brief adds one unit of work of a stage, to be called from readout() only
+         * The work is accumulated without locking and published at the end of the readout cycle
+         * @param nsec time spent by the stage, see GEMStageStatistics::elapsedNanoseconds
+         * @param nItems number of items (VFAT blocks, events, ...) handled
+         * @param nBytes number of bytes handled
+         */
+        void recordStage(ReadoutStage const& stage, uint64_t const& nsec,
+                         uint64_t const& nItems, uint64_t const& nBytes) {
+          m_cycleStats[stage].record(nsec, nItems, nBytes);
+          m_cycleRecorded = true;
+        };
+
+        /**
+         * @brief sets the number of items waiting for a stage, to be called from readout() only
+         */
+        void setQueueDepth(ReadoutStage const& stage, uint64_t const& depth) {
+          m_cycleQueueDepth[stage] = depth;
+          if (depth > m_cycleMaxQueueDepth[stage])
+            m_cycleMaxQueueDepth[stage] = depth;
+        };
+
         std::string m_outFileName;
         std::shared_ptr<toolbox::Task> m_task;
         toolbox::mem::Pool*            m_pool;
@@ -105,6 +151,7 @@ namespace gem {
           xdata::String outputType;
           xdata::String outputLocation;
           xdata::String setupLocation;
+          xdata::Boolean zeroSuppression;  ///< may be changed during a run, applied from the next event
         };
 
         xdata::Bag<GEMReadoutSettings> m_readoutSettings;
@@ -117,6 +164,35 @@ namespace gem {
         double m_usecUsed;
 
       private:
+        /**
+         * @brief merges the work of the readout cycle into the published statistics,
+         *        and updates the InfoSpace items at most once per second
+         */
+        void publishStageStatistics();
+
+        void resetStageStatistics();
+
+        // accumulated by the readout task during a cycle, no locking
+        GEMStageStatistics m_cycleStats[N_READOUT_STAGES];
+        uint64_t           m_cycleQueueDepth[N_READOUT_STAGES];
+        uint64_t           m_cycleMaxQueueDepth[N_READOUT_STAGES];
+        bool               m_cycleRecorded;
+
+        // published, protected by m_stageLock
+        mutable gem::utils::Lock m_stageLock;
+        GEMStageStatistics m_stageStats[N_READOUT_STAGES];
+        GEMRateWindow      m_stageRates[N_READOUT_STAGES];
+        uint64_t           m_stageQueueDepth[N_READOUT_STAGES];
+        uint64_t           m_stageMaxQueueDepth[N_READOUT_STAGES];
+        uint64_t           m_lastPublished;  ///< CLOCK_MONOTONIC second of the last InfoSpace update
+
+        xdata::UnsignedInteger64 m_stageItems[N_READOUT_STAGES];
+        xdata::UnsignedInteger64 m_stageBytes[N_READOUT_STAGES];
+        xdata::Double            m_stageItemRate[N_READOUT_STAGES];  ///< over RATE_WINDOW_SHORT
+        xdata::Double            m_stageByteRate[N_READOUT_STAGES];  ///< over RATE_WINDOW_SHORT
+        xdata::Double            m_stageLatencyMean[N_READOUT_STAGES];
+        xdata::UnsignedInteger32 m_stageLatencyP99[N_READOUT_STAGES];
+        xdata::UnsignedInteger64 m_stageQueue[N_READOUT_STAGES];
 
       };
 
@@ -0,0 +1,42 @@
+/** @file GEMReadoutMonitor.h */
+
+#ifndef GEM_READOUT_GEMREADOUTMONITOR_H
+#define GEM_READOUT_GEMREADOUTMONITOR_H
+
+#include "gem/base/GEMMonitor.h"
+
+namespace gem {
+  namespace readout {
+
+    class GEMReadoutApplication;
+
+    class GEMReadoutMonitor : public gem::base::GEMMonitor
+      {
+      public:
+
+        /**
+         * Constructor from GEMFSMApplication derived classes
+         * @param readoutApp the readout application to be monitored
+         */
+        GEMReadoutMonitor(GEMReadoutApplication* readoutApp);
+
+        virtual ~GEMReadoutMonitor();
+
+        /**
+         * The readout counters and stage telemetry are pushed into the application info space
+         * by the readout task, the update only takes them into the JSON snapshot
+         */
+        virtual void updateMonitorables();
+
+        /**
+         * @brief adds the "Readout" set and one set per readout stage
+         */
+        void setupReadoutMonitoring();
+
+      private:
+      };  // class GEMReadoutMonitor
+
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMREADOUTMONITOR_H
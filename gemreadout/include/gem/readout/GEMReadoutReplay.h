@@ -0,0 +1,161 @@
+/** @file GEMReadoutReplay.h */
+
+#ifndef GEM_READOUT_GEMREADOUTREPLAY_H
+#define GEM_READOUT_GEMREADOUTREPLAY_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log4cplus/logger.h"
+
+#include "gem/readout/GEMDataAMCformat.h"
+#include "gem/readout/GEMEventArena.h"
+#include "gem/readout/GEMEventBuilder.h"
+#include "gem/readout/GEMEventSerializer.h"
+#include "gem/readout/GEMSlotMapService.h"
+#include "gem/readout/GEMStageStatistics.h"
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMReplayDQM
+     * @brief DQM stage of a GEMReadoutReplay, e.g., a gemOnlineDQM
+     */
+    class GEMReplayDQM
+    {
+    public:
+      virtual ~GEMReplayDQM() {};
+
+      virtual void update(GEMArenaGEB const& geb) = 0;
+
+      /**
+       * @brief waits until every GEB passed to update has been processed
+       */
+      virtual void drain() {};
+    };
+
+    /**
+     * @class GEMReadoutReplay
+     * @brief Drives recorded data through the decode, build, DQM and write stages of the readout
+     *
+     * The input is a dump of the GLIB tracking data FIFO, or a run file written by the readout, whose
+     * VFATs are turned back into tracking data blocks. The whole input is loaded in memory before
+     * the replay, which then runs with no hardware and no xDAQ services, as fast as possible
+     * or at a target event rate. Events are built by a GEMEventBuilder, as in GEMDataParker and
+     * GLIBReadout: consecutive VFAT blocks with the same EC and BC form an event, VFATs in no known
+     * slot go to a separate error event.
+     */
+    class GEMReadoutReplay
+    {
+    public:
+      enum InputFormat {
+        GLIB_DUMP_HEX    = 0x0,  ///< one 32 bit tracking data word per line, in hexadecimal
+        GLIB_DUMP_BINARY = 0x1,  ///< 32 bit tracking data words in host order
+        RUN_FILE_HEX     = 0x2,  ///< run file written with outputType "Hex"
+        RUN_FILE_BINARY  = 0x3   ///< run file written with outputType "Bin"
+      };
+
+      /**
+       * @param name one of "glibhex", "glibbin", "runhex", "runbin"
+       * @returns false if the name is not known
+       */
+      static bool parseInputFormat(std::string const& name, InputFormat& format);
+
+      /**
+       * @param slotFile slot table used to sort VFATs into payload and error events
+       * @param outFileName file the events are written to, if empty they are serialised but not written
+       * @param errFileName file the events of VFATs in no known slot are written to, may be empty
+       * @param outputType "Hex" or "Bin", as for the readout
+       */
+      GEMReadoutReplay(std::string const& slotFile,
+                       std::string const& outFileName="",
+                       std::string const& errFileName="",
+                       std::string const& outputType="Bin");
+      ~GEMReadoutReplay();
+
+      /**
+       * @brief replaces the loaded data with the tracking data words of the file
+       * @returns false if the file could not be read
+       */
+      bool load(std::string const& inFileName, InputFormat const& format);
+
+      size_t getWordCount() const { return m_words.size(); };
+
+      /**
+       * @param dqm DQM stage, not owned, NULL to skip the stage
+       */
+      void setDQM(GEMReplayDQM* dqm) { p_dqm = dqm; };
+
+      /**
+       * @param rate target number of events per second, 0 to replay as fast as possible
+       */
+      void setRate(double const& rate) { m_rate = rate; };
+
+      /**
+       * @param zs write zero suppressed VFAT records, see GEMDataAMCformat::encodeVFATzs
+       */
+      void setZeroSuppression(bool const& zs) { p_serializer->setZeroSuppression(zs); };
+
+      /**
+       * @brief replays the loaded data nPasses times
+       * @returns the throughput of the whole replay and the statistics of each stage
+       */
+      std::string run(unsigned const& nPasses=1);
+
+    private:
+      // Prevent copying.
+      GEMReadoutReplay(GEMReadoutReplay const&);
+      GEMReadoutReplay& operator=(GEMReadoutReplay const&);
+
+      bool loadGLIBDump(std::ifstream& inf, bool const& binary);
+      bool loadRunFile(std::ifstream& inf, bool const& binary);
+
+      /**
+       * @brief fills the framing words of the built events, passes them to the DQM and writes them
+       */
+      void completeEvent();
+
+      /**
+       * @returns the size of the serialised event
+       */
+      size_t writeEvent(std::ofstream& outf, GEMArenaEvent const& gem, GEMArenaGEB const& geb);
+
+      void throttle(timespec const& start);
+
+      log4cplus::Logger m_gemLogger;
+
+      GEMSlotMap const&                   m_slotMap;
+      std::unique_ptr<GEMEventSerializer> p_serializer;
+      std::ofstream                       m_outFile;
+      std::ofstream                       m_errFile;
+      std::vector<char>                   m_buffer;
+      GEMReplayDQM*                       p_dqm;
+      double                              m_rate;
+
+      std::vector<uint32_t> m_words;  ///< the loaded tracking data
+
+      GEMEventBuilder m_builder;
+
+      uint64_t m_nEvents;
+      uint64_t m_nErrEvents;
+      uint64_t m_nVFATs;
+      uint64_t m_nDropped;          ///< VFATs beyond the capacity of an event
+      uint64_t m_nMisaligned;       ///< words skipped to find the start of a VFAT block
+      uint64_t m_decodeNsec;        ///< decode time of the event being built
+      uint64_t m_buildNsec;         ///< build time of the event being built
+
+      GEMStageStatistics m_decode;
+      GEMStageStatistics m_build;
+      GEMStageStatistics m_dqm;
+      GEMStageStatistics m_write;
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMREADOUTREPLAY_H
@@ -12,7 +12,6 @@ namespace gem {
 
     class GEMReadoutWebApplication : public gem::base::GEMWebApplication
       {
-        //friend class GEMReadoutMonitor;
         friend class GEMReadoutApplication;
 
       public:
@@ -34,9 +33,6 @@ namespace gem {
         virtual void applicationPage(xgi::Input *in, xgi::Output *out)
           throw (xgi::exception::Exception);
 
-        virtual void jsonUpdate(xgi::Input *in, xgi::Output *out)
-          throw (xgi::exception::Exception);
-
       private:
         //GEMReadoutWebApplication(GEMReadoutWebApplication const&);
       };
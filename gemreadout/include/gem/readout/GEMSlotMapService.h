@@ -0,0 +1,186 @@
+/** @file GEMSlotMapService.h */
+
+#ifndef GEM_READOUT_GEMSLOTMAPSERVICE_H
+#define GEM_READOUT_GEMSLOTMAPSERVICE_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "log4cplus/logger.h"
+
+#include "toolbox/TimeInterval.h"
+#include "toolbox/task/TimerListener.h"
+
+#include "gem/utils/Lock.h"
+
+namespace toolbox {
+  namespace task {
+    class Timer;
+    class TimerEvent;
+  }
+}
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMSlotTable
+     * @brief One parsed slot table, never modified once built
+     *
+     * Holds the ChipID of each GEB slot, and the slot of each of the 4096 possible ChipIDs.
+     */
+    class GEMSlotTable
+    {
+    public:
+      static const int      NSLOTS   = 24;
+      static const int      NCHIPIDS = 4096;  ///< ChipIDs are 12 bits
+      static const uint16_t NO_CHIP  = 0xfff; ///< ChipID of an empty slot
+
+      /**
+       * @brief builds an empty table, no slot holds a chip
+       */
+      GEMSlotTable();
+
+      /**
+       * @returns the slot of the chip, -1 if the chip is not in the table
+       */
+      int slotIndex(uint32_t const& chipID) const { return m_slotIndex[chipID & 0x0fff]; };
+
+      /**
+       * @returns the ChipID in the slot, NO_CHIP if the slot is empty
+       */
+      uint32_t chipIDFromSlot(int const& slot) const {
+        return (slot >= 0 && slot < NSLOTS) ? m_chipID[slot] : NO_CHIP; };
+
+      uint32_t numberOfSlots() const { return m_nSlots; };
+
+      /**
+       * @returns the number of slots whose ChipID is also in an earlier slot
+       */
+      uint32_t numberOfDuplicates() const { return m_nDuplicates; };
+
+      /**
+       * @returns false if the file could not be read, all slots are then empty
+       */
+      bool isValid() const { return m_valid; };
+
+    private:
+      friend class GEMSlotMapService;
+
+      /**
+       * @brief parses the 3 lines of 8 comma separated hexadecimal ChipIDs of a slot table file
+       */
+      bool read(std::string const& path);
+
+      uint16_t m_chipID[NSLOTS];
+      int8_t   m_slotIndex[NCHIPIDS];
+      uint32_t m_nSlots;
+      uint32_t m_nDuplicates;
+      bool     m_valid;
+    };
+
+    /**
+     * @class GEMSlotMap
+     * @brief Handle on the current table of one slot table file
+     *
+     * The handle lives as long as the process, so it can be kept by any reader.
+     * A reload replaces the current table with a single pointer store; readers never lock
+     * and always see either the old or the new table, never a partially built one.
+     * Replaced tables are kept, so a reader still using one is never left with a dangling pointer.
+     */
+    class GEMSlotMap
+    {
+    public:
+      int slotIndex(uint32_t const& chipID) const { return p_current->slotIndex(chipID); };
+
+      GEMSlotTable const& current() const { return *p_current; };
+
+      std::string const& getFileName() const { return m_fileName; };
+
+    private:
+      friend class GEMSlotMapService;
+
+      GEMSlotMap(std::string const& fileName, std::string const& path);
+      ~GEMSlotMap();
+
+      // Prevent copying.
+      GEMSlotMap(GEMSlotMap const&);
+      GEMSlotMap& operator=(GEMSlotMap const&);
+
+      std::string                m_fileName;
+      std::string                m_path;
+      time_t                     m_mtime;
+      GEMSlotTable const*        volatile p_current;
+      std::vector<GEMSlotTable*> m_tables;  ///< every table this map has held, owned
+    };
+
+    /**
+     * @class GEMSlotMapService
+     * @brief Process wide cache of the slot tables in $BUILD_HOME/$GEM_OS_PROJECT/gemreadout/data/
+     *
+     * Each file is parsed the first time it is asked for, after which lookups involve no file I/O.
+     * Tables are reloaded explicitly with reload, or when their file changes if the
+     * service has been told to watch for changes.
+     */
+    class GEMSlotMapService : public toolbox::task::TimerListener
+    {
+    public:
+      static GEMSlotMapService& getInstance();
+
+      /**
+       * @param slotFile the name of the slot table file, relative to the data directory
+       * @returns the map of that file, parsing the file if this is the first request for it
+       */
+      GEMSlotMap const& getSlotMap(std::string const& slotFile);
+
+      /**
+       * @brief parses the file again and makes the new table current
+       * @returns false if the file could not be read, the current table is then kept
+       */
+      bool reload(std::string const& slotFile);
+
+      /**
+       * @brief reloads every known table whose file modification time has changed
+       * @returns the number of tables reloaded
+       */
+      unsigned reloadChanged();
+
+      /**
+       * @brief checks the files of all known tables for changes every period
+       */
+      void startWatching(toolbox::TimeInterval const& period);
+      void stopWatching();
+
+      void timeExpired(toolbox::task::TimerEvent& event);
+
+      /**
+       * @returns the full path of a slot table file
+       */
+      static std::string slotFilePath(std::string const& slotFile);
+
+    private:
+      GEMSlotMapService();
+      ~GEMSlotMapService();
+
+      // Prevent copying.
+      GEMSlotMapService(GEMSlotMapService const&);
+      GEMSlotMapService& operator=(GEMSlotMapService const&);
+
+      bool reload(GEMSlotMap& slotMap);
+
+      static time_t modificationTime(std::string const& path);
+
+      log4cplus::Logger m_gemLogger;
+      gem::utils::Lock  m_lock;  ///< protects m_maps and serializes reloads, never taken by lookups
+
+      std::map<std::string, GEMSlotMap*> m_maps;
+      toolbox::task::Timer*              p_timer;
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMSLOTMAPSERVICE_H
@@ -0,0 +1,103 @@
+/** @file GEMStageStatistics.h */
+
+#ifndef GEM_READOUT_GEMSTAGESTATISTICS_H
+#define GEM_READOUT_GEMSTAGESTATISTICS_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <iomanip>
+#include <sstream>
+#include <string>
+
+#include "gem/utils/GEMLatencyHistogram.h"
+
+namespace gem {
+  namespace readout {
+
+    /**
+     * @class GEMStageStatistics
+     * @brief Work done by one stage of the readout chain (FIFO read, decode, build, DQM, write)
+     *
+     * Each record adds the time the stage spent on one unit of work, usually an event, and the
+     * number of items and bytes it handled. Rates are computed over the busy time of the stage,
+     * i.e., they are the rates the stage could sustain if nothing else limited it.
+     * No locking is done, callers are expected to protect the object.
+     */
+    class GEMStageStatistics
+    {
+    public:
+      explicit GEMStageStatistics(std::string const& name="") : m_name(name) { reset(); };
+
+      /**
+       * @param nsec time spent by the stage on this unit of work
+       * @param nItems number of items (VFAT blocks, events, ...) handled
+       * @param nBytes number of bytes handled
+       */
+      void record(uint64_t const& nsec, uint64_t const& nItems, uint64_t const& nBytes) {
+        m_latency.record((nsec + 500)/1000);
+        m_nsec   += nsec;
+        m_nItems += nItems;
+        m_nBytes += nBytes;
+      };
+
+      /**
+       * @brief adds the work recorded in another object, e.g., one accumulated without locking
+       */
+      void merge(GEMStageStatistics const& other) {
+        m_latency.merge(other.m_latency);
+        m_nsec   += other.m_nsec;
+        m_nItems += other.m_nItems;
+        m_nBytes += other.m_nBytes;
+      };
+
+      void reset() {
+        m_latency.reset();
+        m_nsec   = 0;
+        m_nItems = 0;
+        m_nBytes = 0;
+      };
+
+      std::string const& getName() const { return m_name; };
+      uint64_t getBusyNanoseconds() const { return m_nsec; };
+      uint64_t getItems()           const { return m_nItems; };
+      uint64_t getBytes()           const { return m_nBytes; };
+      double   getItemRate()        const { return m_nsec ? m_nItems*1.e9/m_nsec : 0.; };
+      double   getByteRate()        const { return m_nsec ? m_nBytes*1.e9/m_nsec : 0.; };
+
+      /**
+       * @returns the distribution of the time spent per record, in microseconds
+       */
+      gem::utils::GEMLatencyHistogram const& getLatency() const { return m_latency; };
+
+      /**
+       * @returns e.g. "decode: 1200 items, 3.1e+07 items/s, 870.2 MB/s, busy 38us, n=100 mean=0.4us ..."
+       */
+      std::string toString() const {
+        std::stringstream res;
+        res << m_name << ": " << m_nItems << " items, "
+            << std::scientific << std::setprecision(2) << getItemRate() << " items/s, "
+            << std::fixed << std::setprecision(1) << getByteRate()/1.e6 << " MB/s, "
+            << "busy " << m_nsec/1000 << "us, " << m_latency.toString();
+        return res.str();
+      };
+
+      /**
+       * @returns the number of nanoseconds elapsed between two CLOCK_MONOTONIC readings
+       */
+      static uint64_t elapsedNanoseconds(timespec const& start, timespec const& stop) {
+        int64_t nsec = (static_cast<int64_t>(stop.tv_sec) - start.tv_sec)*1000000000LL + (stop.tv_nsec - start.tv_nsec);
+        return nsec > 0 ? nsec : 0;
+      };
+
+    private:
+      std::string                     m_name;
+      gem::utils::GEMLatencyHistogram m_latency;
+      uint64_t                        m_nsec;
+      uint64_t                        m_nItems;
+      uint64_t                        m_nBytes;
+    };
+  }  // namespace gem::readout
+}  // namespace gem
+
+#endif  // GEM_READOUT_GEMSTAGESTATISTICS_H
@@ -7,85 +7,38 @@
 #include <fstream>
 #include <sstream>
 #include <cstdlib>
+#include <string>
+
+#include "gem/readout/GEMSlotMapService.h"
 
 namespace gem {
   namespace readout {
 
+    /**
+     * Slot table of a GEB, the file is parsed once per process by GEMSlotMapService,
+     * and is shared by all GEMslotContents built for it
+     */
     class GEMslotContents {
-      //struct is a class with all members public by default
     public:
-      GEMslotContents(const std::string& slotFile) {
-        slotFile_ = slotFile;
-        getSlotCfg();
-      };
-    private:
-      uint16_t slot[24];
-      bool isFileRead;
-      std::string slotFile_;
-
-       void initSlots() {
-        for (int i = 0; i < 24; ++i)
-          slot[i] = 0xfff;
-        isFileRead = false;
-        return;
+      GEMslotContents(const std::string& slotFile) :
+        slotMap_(GEMSlotMapService::getInstance().getSlotMap(slotFile)) {
       };
 
-      void getSlotCfg() {
-        std::ifstream ifile;
-        std::string build_home     = std::getenv("BUILD_HOME");
-        std::string gem_os_project = std::getenv("GEM_OS_PROJECT");
-        std::string path           = build_home + "/" + gem_os_project;
-        path += "/gemreadout/data/";
-        path += slotFile_;
-        ifile.open(path);
-
-        if(!ifile.is_open()) {
-          std::cout << "[GEMslotContents]: The file: " << ifile << " is missing.\n" << std::endl;
-          isFileRead = false;
-          return;
-        };
-
-        for (int row = 0; row < 3; row++) {
-          std::string line;
-          std::getline(ifile, line);
-          std::istringstream iss(line);
-          if ( !ifile.good() ) break;
-          for (int col = 0; col < 8; col++) {
-            std::string val;
-            std::getline(iss,val,',');
-            std::stringstream convertor(val);
-            convertor >> std::hex >> slot[8*row+col];
-          }
-        }
-        ifile.close();
-        isFileRead = true;
-      };
-
-    public:
       /*
        *  Slot Index converter from Hex ChipID
        */
       int GEBslotIndex(const uint32_t& GEBChipID) {
-        int indxslot = -1;
-        //std::cout << "\nUsing slot file: " << slotFile_ << std::endl;
-        for (int islot = 0; islot < 24; islot++) {
-          if ( (GEBChipID & 0x0fff ) == slot[islot] ) indxslot = islot;
-        }//end for slot
-
-        return (indxslot);
+        return slotMap_.slotIndex(GEBChipID);
       };
       uint32_t GEBChipIdFromSlot(int slotindex){
-            return slot[slotindex];
+        return slotMap_.current().chipIDFromSlot(slotindex);
       };
       uint32_t GEBNumberOfSlots(){
-        uint32_t count=0;
-        for (int islot = 0; islot < 24; islot++) {
-            if(slot[islot]==0xfff) continue;
-            count++;
-        }
-        return count;
+        return slotMap_.current().numberOfSlots();
       };
 
+    private:
+      GEMSlotMap const& slotMap_;
     };  // class GEMslotContents
   }  // namespace gem::readout
 }  // namespace gem
@@ -10,9 +10,13 @@
 #include <fstream>
 #include <string>
 #include <cstring>
+#include <unistd.h>
 #include <cstdlib>
 #include <sstream>
 #include <vector>
+#include <map>
+#include <deque>
+#include <algorithm>
 #include <cstdint>
 #include <stdexcept>
 #include <memory>
@@ -43,56 +47,388 @@
 #include <TTree.h>
 #include <TBranch.h>
 #include <TError.h>
+#include <TThread.h>
+#include <TVirtualMutex.h>
+
+#include "toolbox/TimeInterval.h"
+#include "toolbox/TimeVal.h"
+#include "toolbox/task/Timer.h"
+#include "toolbox/task/TimerEvent.h"
+#include "toolbox/task/TimerFactory.h"
+#include "toolbox/task/TimerListener.h"
+#include "toolbox/task/exception/Exception.h"
+#include "toolbox/task/Action.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
+#include "toolbox/lang/Class.h"
+#include "toolbox/BSem.h"
 
 #include "gem/readout/GEMDataAMCformat.h"
+#include "gem/readout/GEMEventArena.h"
 #include "gem/datachecker/GEMDataChecker.h"
-#include "gem/readout/GEMslotContents.h"
-#include "GEMClusterization/GEMStrip.h"
-#include "GEMClusterization/GEMStripCollection.h"
-#include "GEMClusterization/GEMClusterContainer.h"
-#include "GEMClusterization/GEMClusterizer.h"
+#include "gem/readout/GEMSlotMapService.h"
+#include "gem/readout/GEMBitmaskClusterizer.h"
+#include "gem/readout/GEMOccupancyAccumulator.h"
+#include "gem/utils/Lock.h"
+#include "gem/utils/LockGuard.h"
 
 namespace gem {
   namespace readout {
-    class gemOnlineDQM {
+    /**
+     * Filling and rendering are decoupled: each filler fills one of its two buffers of histograms, and
+     * render swaps the buffers of all fillers, adds the filled ones to the displayed histograms and only
+     * redraws the displayed histograms that received new entries.
+     * Only the slot and cluster histograms are filled per GEB. The strips fired and the beam profile
+     * are rebuilt by render from the channel counts of the fillers' occupancy accumulators.
+     * render runs from a timer at a configurable period (startRendering) or on request, e.g., from a web page
+     *
+     * With nWorkers > 0, Update only queues the GEB, round robin, to one of nWorkers waiting workloops,
+     * each of which fills its own histograms. A worker whose queue holds MAX_QUEUE GEBs drops new ones.
+     * With nWorkers == 0, Update fills the histograms on the calling thread.
+     */
+    class gemOnlineDQM : public toolbox::task::TimerListener, public toolbox::lang::Class {
       public:
-        gemOnlineDQM(std::string slotFile){this->init(slotFile);}
-        ~gemOnlineDQM(){}
+        static const int NCHANNELS = 128;
+        static const int NHISTS    = NVFAT+4;
+        static const int NFILLED   = 3;  // histograms filled per GEB, the first NFILLED of DQMHistograms
+        static const unsigned MAX_QUEUE = 4096;
+
+        gemOnlineDQM(std::string slotFile, std::string const& name="gemOnlineDQM", unsigned const& nWorkers=0) :
+          slot_map(GEMSlotMapService::getInstance().getSlotMap(slotFile)),
+          dqm_name(name),
+          timer_name(name+":render"),
+          render_timer(0),
+          render_canvas(0),
+          strip_events(NVFAT, 0),
+          render_lock(toolbox::BSem::FULL, true),
+          threaded(nWorkers > 0),
+          wait_when_full(false),
+          running(false),
+          next_worker(0),
+          p_fillSig(0)
+        {
+          this->init(slotFile, nWorkers > 0 ? nWorkers : 1);
+          if (threaded)
+            this->startWorkers();
+        }
+        ~gemOnlineDQM(){
+          this->stopRendering();
+          this->stopWorkers();
+          for (auto w = workers.begin(); w != workers.end(); ++w)
+            delete *w;
+          if (render_canvas) {
+            R__LOCKGUARD2(gROOTMutex);
+            delete render_canvas;
+          }
+        }
         void Update(const gem::readout::GEMDataAMCformat::GEBData& geb){
-          for (auto it = geb.vfats.begin(); it != geb.vfats.end(); ++it){
-            hiVFATsn->Fill(this->sn(*it));
-            for (unsigned i = 0; i < NVFAT; ++i){
-              this->fillStrips(*it, i);
+          if (!threaded) {
+            DQMWorker& worker = *workers[0];
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock(worker.fill_lock);
+            this->fill(worker, geb);
+            ++worker.nFilled;
+            return;
+          }
+
+          this->queue(geb);
+        }
+        /**
+         * filled in place when not threaded, otherwise copied into a GEBData for the worker queue
+         */
+        void Update(const gem::readout::GEMArenaGEB& geb){
+          if (!threaded) {
+            DQMWorker& worker = *workers[0];
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock(worker.fill_lock);
+            this->fill(worker, geb);
+            ++worker.nFilled;
+            return;
+          }
+
+          gem::readout::GEMDataAMCformat::GEBData copy;
+          copy.header  = geb.header;
+          copy.runhed  = geb.runhed;
+          copy.trailer = geb.trailer;
+          copy.vfats.assign(geb.vfats.begin(), geb.vfats.end());
+          this->queue(copy);
+        }
+
+        /**
+         * @brief waits until the workers have filled every queued GEB
+         */
+        void drain(){
+          if (!threaded)
+            return;
+          for (auto w = workers.begin(); w != workers.end(); ++w) {
+            while (true) {
+              uint64_t queued, filled;
+              {
+                gem::utils::LockGuard<gem::utils::Lock> guardedLock((*w)->queue_lock);
+                queued = (*w)->nQueued;
+              }
+              {
+                gem::utils::LockGuard<gem::utils::Lock> guardedLock((*w)->fill_lock);
+                filled = (*w)->nFilled;
+              }
+              if (filled >= queued)
+                break;
+              usleep(1000);
+            }
+          }
+        }
+
+        /**
+         * render the changed histograms every period, to prefix, from a toolbox timer thread
+         */
+        void startRendering(toolbox::TimeInterval const& period, TString const& prefix="./temp_plots/"){
+          this->stopRendering();
+          // creates gROOTMutex, so that the ROOT calls of the timer thread can take the ROOT global lock
+          TThread::Initialize();
+          {
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock(render_lock);
+            render_prefix = prefix;
+          }
+          if (toolbox::task::getTimerFactory()->hasTimer(timer_name))
+            render_timer = toolbox::task::getTimerFactory()->getTimer(timer_name);
+          else
+            render_timer = toolbox::task::getTimerFactory()->createTimer(timer_name);
+          render_timer->start();
+          render_timer->scheduleAtFixedRate(toolbox::TimeVal::gettimeofday(), this, period, 0, "gemOnlineDQMRender");
+        }
+        void stopRendering(){
+          if (!render_timer)
+            return;
+          try {
+            render_timer->stop();
+          } catch (toolbox::task::exception::Exception const& ex) {
+            if (DEBUG_) std::cout << "[gemOnlineDQM]: render timer was not active " << ex.what() << std::endl;
+          }
+          render_timer = 0;
+        }
+        void timeExpired(toolbox::task::TimerEvent& event){
+          this->render();
+        }
+
+        /**
+         * move the newly filled entries to the displayed histograms and redraw those that changed
+         * @returns the number of histograms that were redrawn
+         */
+        int render(){
+          gem::utils::LockGuard<gem::utils::Lock> renderGuard(render_lock);
+          bool changed[NHISTS];
+          if (!this->merge(changed))
+            return 0;
+          return this->print(changed, render_prefix);
+        }
+
+        /**
+         * @brief merges the histograms of all fillers and writes the result to a ROOT file
+         */
+        void save(std::string const& fileName){
+          gem::utils::LockGuard<gem::utils::Lock> renderGuard(render_lock);
+          bool changed[NHISTS];
+          this->merge(changed);
+          R__LOCKGUARD2(gROOTMutex);
+          TFile outf(fileName.c_str(), "RECREATE");
+          for (int i = 0; i < NHISTS; ++i)
+            display.get(i)->Write();
+          outf.Close();
+        }
+
+        /**
+         * @returns the number of GEBs filled and dropped by each worker and the overall filling rate
+         */
+        std::string getStatistics(){
+          std::stringstream stats;
+          uint64_t nFilled = 0, nDropped = 0;
+          for (size_t w = 0; w < workers.size(); ++w) {
+            uint64_t filled, dropped;
+            {
+              gem::utils::LockGuard<gem::utils::Lock> guardedLock(workers[w]->fill_lock);
+              filled = workers[w]->nFilled;
+            }
+            {
+              gem::utils::LockGuard<gem::utils::Lock> guardedLock(workers[w]->queue_lock);
+              dropped = workers[w]->nDropped;
             }
-            this->fillClusters();
-            this->print();
+            nFilled  += filled;
+            nDropped += dropped;
+            stats << "worker " << w << ": " << filled << " GEBs filled, " << dropped << " dropped" << std::endl;
           }
+          stats << nFilled << " GEBs filled, " << nDropped << " dropped by "
+                << (threaded ? workers.size() : 0) << " workers";
+          return stats.str();
         }
 
+        /**
+         * @param counts array of NCHANNELS entries, set to the number of hits of each channel of the VFAT
+         *        in slot, over every GEB filled so far
+         * @returns the number of GEBs the VFAT was in
+         */
+        uint64_t getChannelCounts(int const& slot, uint64_t* counts){
+          for (int chan = 0; chan < NCHANNELS; ++chan)
+            counts[chan] = 0;
+          uint64_t events = 0;
+          for (auto w = workers.begin(); w != workers.end(); ++w) {
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock((*w)->fill_lock);
+            uint64_t const* workerCounts = (*w)->occupancy.getChannelCounts(slot);
+            if (!workerCounts)
+              return 0;
+            for (int chan = 0; chan < NCHANNELS; ++chan)
+              counts[chan] += workerCounts[chan];
+            events += (*w)->occupancy.getEvents(slot);
+          }
+          return events;
+        }
+        /**
+         * @returns the fraction of the channels of the VFAT in slot that fired, over every GEB filled so far
+         */
+        double getOccupancy(int const& slot){
+          uint64_t hits = 0, events = 0;
+          for (auto w = workers.begin(); w != workers.end(); ++w) {
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock((*w)->fill_lock);
+            hits   += (*w)->occupancy.getHits(slot);
+            events += (*w)->occupancy.getEvents(slot);
+          }
+          return events ? static_cast<double>(hits)/(events*NCHANNELS) : 0.;
+        }
+
+        /**
+         * @param wait whether Update waits for a full worker queue to drain rather than drop the GEB,
+         *        so that a replayed stream measures what the workers sustain
+         */
+        void setWaitWhenFull(bool const& wait){ wait_when_full = wait; }
+
+        /**
+         * @brief sets the strips that fired in geb in the mask of their eta partition, as fill does
+         * @param masks array of 8 masks, one per eta partition, that are cleared first
+         */
+        template <class GEB>
+          void etaMasks(const GEB& geb, GEMStripMask* masks) const {
+            for (int ieta = 0; ieta < 8; ++ieta)
+              masks[ieta].clear();
+            for (auto it = geb.vfats.begin(); it != geb.vfats.end(); ++it) {
+              int slot = slot_map.slotIndex(it->ChipID);
+              if (slot < 0)
+                continue;
+              uint64_t words[2] = {it->lsData, it->msData};
+              for (int w = 0; w < 2; ++w)
+                for (uint64_t bits = words[w]; bits; bits &= bits - 1) {
+                  int chan = 64*w + __builtin_ctzll(bits);
+                  if (strip_map[slot][chan] >= 0)
+                    masks[slot%8].set(profile_strip[slot][chan]);
+                }
+            }
+          }
+
       private:
-        std::map<int,int> strip_maps[NVFAT];
-        std::map<int, GEMStripCollection> allstrips;
+        typedef struct DQMHistograms {
+          TH1F* hiVFATsn;
+          TH1F* hiClusterMult;
+          TH1F* hiClusterSize;
+          TH1F* hiStripsFired[NVFAT];
+          TH2F* hiBeamProfile;
+          TH1* get(int i) {
+            if (i == 0) return hiVFATsn;
+            if (i == 1) return hiClusterMult;
+            if (i == 2) return hiClusterSize;
+            if (i < NVFAT+3) return hiStripsFired[i-3];
+            return hiBeamProfile;
+          }
+        } DQMHistograms;
+
+        // flat lookup tables, filled once in init
+        int strip_map[NVFAT][NCHANNELS];    // strip of each channel, -1 if unmapped
+        int profile_strip[NVFAT][NCHANNELS];// strip in the eta partition, for the beam profile and clustering
         std::string slot_file;
-        TH1F* hiVFATsn;
-        TH1F* hiClusterMult;
-        TH1F* hiClusterSize;
-        TH1F* hiStripsFired[NVFAT];
-        TH2F* hiBeamProfile;
+        GEMSlotMap const& slot_map;  // shared, reloaded by GEMSlotMapService, lookups take no lock
+
+        /**
+         * Everything one filler needs: its histograms, its strip masks and, when threaded, its queue
+         */
+        typedef struct DQMWorker {
+          DQMWorker() :
+            active(0),
+            fill_lock(toolbox::BSem::FULL, true),
+            queue_lock(toolbox::BSem::FULL, true),
+            have_data(toolbox::BSem::EMPTY),
+            workloop(0),
+            nQueued(0),
+            nFilled(0),
+            nDropped(0),
+            occupancy(NVFAT) {}
+          DQMHistograms    buffers[2];   // buffers[active] is being filled
+          int              active;
+          GEMStripMask     eta_masks[8]; // fired strips of each eta partition in the current GEB
+          gem::utils::Lock fill_lock;    // protects buffers, active, nFilled and occupancy
+          gem::utils::Lock queue_lock;   // protects queue, nQueued and nDropped
+          toolbox::BSem    have_data;
+          std::deque<gem::readout::GEMDataAMCformat::GEBData> queue;
+          toolbox::task::WorkLoop* workloop;
+          uint64_t nQueued;
+          uint64_t nFilled;
+          uint64_t nDropped;
+          GEMOccupancyAccumulator occupancy;  // hits per channel of each slot, never reset
+        } DQMWorker;
+
+        std::string           dqm_name;
+        std::string           timer_name;
+        toolbox::task::Timer* render_timer;
+        TString               render_prefix;
+        TString               render_dir;     // prefix the output directory was created for
+        TCanvas*              render_canvas;  // created on the first render, reused afterwards
+        std::vector<uint64_t> strip_events;   // GEBs of each slot when its strip histogram was last rebuilt
+
+        DQMHistograms    display;          // accumulated contents, what is rendered
+        gem::utils::Lock render_lock;
+
+        std::vector<DQMWorker*>         workers;
+        bool                            threaded;
+        bool                            wait_when_full;
+        volatile bool                   running;
+        unsigned                        next_worker;
+        toolbox::task::ActionSignature* p_fillSig;
 //=================================================================================================================
-        void init(std::string slotFile_){
-          slot_file = slotFile_;
+        /**
+         * @param withStrips whether to book the strip and beam profile histograms, only displayed
+         */
+        void bookHistograms(DQMHistograms& histos, std::string const& suffix, bool const& withStrips){
           std::string type[NVFAT] = {"Slot0" , "Slot1" , "Slot2" , "Slot3" , "Slot4" , "Slot5" , "Slot6" , "Slot7",
                                      "Slot8" , "Slot9" , "Slot10", "Slot11", "Slot12", "Slot13", "Slot14", "Slot15",
                                      "Slot16", "Slot17", "Slot18", "Slot19", "Slot20", "Slot21", "Slot22", "Slot23"};
           char name[128], title[500];
-          hiVFATsn       = new TH1F("VFATsn", "VFAT slot number", 24,  0., 24. );
-          hiClusterMult  = new TH1F("ClusterMult", "Cluster multiplicity", 384,  0, 384 );
-          hiClusterSize  = new TH1F("ClusterSize", "Cluster size", 384,  0, 384 );
-          hiBeamProfile  = new TH2F("BeamProfile", "Beam Profile", 8, 0, 8, 384, 0, 384);
+          histos.hiVFATsn       = new TH1F(("VFATsn"+suffix).c_str(), "VFAT slot number", 24,  0., 24. );
+          histos.hiClusterMult  = new TH1F(("ClusterMult"+suffix).c_str(), "Cluster multiplicity", 384,  0, 384 );
+          histos.hiClusterSize  = new TH1F(("ClusterSize"+suffix).c_str(), "Cluster size", 384,  0, 384 );
+          histos.hiBeamProfile  = withStrips ?
+            new TH2F(("BeamProfile"+suffix).c_str(), "Beam Profile", 8, 0, 8, 384, 0, 384) : 0;
           for (unsigned i = 0; i < NVFAT; i++){
-            sprintf (name , "hiStripsFired_%s", type[i].c_str());
+            sprintf (name , "hiStripsFired_%s%s", type[i].c_str(), suffix.c_str());
             sprintf (title, "Strips fired for VFAT chip %s", type[i].c_str());
-            hiStripsFired[i] = new TH1F(name, title, 20, 0., 20.);
+            histos.hiStripsFired[i] = withStrips ? new TH1F(name, title, 20, 0., 20.) : 0;
+          }
+          // owned here, not by whichever ROOT directory is current
+          for (int i = 0; i < (withStrips ? NHISTS : NFILLED); ++i)
+            histos.get(i)->SetDirectory(0);
+        }
+        void init(std::string slotFile_, unsigned const& nFillers){
+          slot_file = slotFile_;
+          render_prefix = "./temp_plots/";
+          this->bookHistograms(display, "", true);
+          for (unsigned w = 0; w < nFillers; ++w) {
+            DQMWorker* worker = new DQMWorker();
+            char suffix[64];
+            sprintf(suffix, "_w%d_fill0", w);
+            this->bookHistograms(worker->buffers[0], suffix, false);
+            sprintf(suffix, "_w%d_fill1", w);
+            this->bookHistograms(worker->buffers[1], suffix, false);
+            workers.push_back(worker);
+          }
+
+          for (unsigned i = 0; i < NVFAT; i++){
+            for (int chan = 0; chan < NCHANNELS; ++chan) {
+              strip_map[i][chan]     = -1;
+              profile_strip[i][chan] = -1;
+            }
             std::string path;
             path = std::getenv("BUILD_HOME");
             if (DEBUG_) std::cout << "[gemOnlineDQM]: path to maps : " << path << std::endl;
@@ -106,61 +442,219 @@ namespace gem {
               path += "/gem-light-dqm/dqm-root/data/v2b_schema_chips18-23.csv";
             }
             this->readMap(i,path);
+            for (int chan = 0; chan < NCHANNELS; ++chan)
+              if (strip_map[i][chan] >= 0)
+                profile_strip[i][chan] = strip_map[i][chan] + ((int) i/8)*128;
           }
         }
-        void fillClusters(){
-          int ncl=0;
-          for (std::map<int, GEMStripCollection>::iterator ieta=allstrips.begin(); ieta!= allstrips.end(); ieta++){
-            GEMClusterizer clizer;
-            GEMClusterContainer cls = clizer.doAction(ieta->second);
-            ncl+=cls.size();
-            for (GEMClusterContainer::iterator icl=cls.begin();icl!=cls.end();icl++){
-              hiClusterSize->Fill(icl->clusterSize());
+        void startWorkers(){
+          running = true;
+          p_fillSig = toolbox::task::bind(this, &gemOnlineDQM::fillQueued, "fillQueued");
+          for (size_t w = 0; w < workers.size(); ++w) {
+            char loopName[256];
+            sprintf(loopName, "urn:toolbox-task-workloop:%s:fill:%d", dqm_name.c_str(), (int)w);
+            workers[w]->workloop = toolbox::task::getWorkLoopFactory()->getWorkLoop(loopName, "waiting");
+            if (!workers[w]->workloop->isActive())
+              workers[w]->workloop->activate();
+            workers[w]->workloop->submit(p_fillSig);
+          }
+        }
+        DQMWorker& nextWorker(){
+          return *workers[__sync_fetch_and_add(&next_worker, 1)%workers.size()];
+        }
+        void queue(const gem::readout::GEMDataAMCformat::GEBData& geb){
+          DQMWorker& worker = this->nextWorker();
+          while (!this->enqueue(worker, geb, !wait_when_full) && wait_when_full)
+            usleep(10);
+        }
+        /**
+         * @param countDrop whether a full queue counts the GEB as dropped
+         * @returns false if the queue of worker is full
+         */
+        bool enqueue(DQMWorker& worker, const gem::readout::GEMDataAMCformat::GEBData& geb, bool const& countDrop){
+          bool wasEmpty;
+          {
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock(worker.queue_lock);
+            if (worker.queue.size() >= MAX_QUEUE) {
+              if (countDrop)
+                ++worker.nDropped;
+              return false;
+            }
+            wasEmpty = worker.queue.empty();
+            worker.queue.push_back(geb);
+            ++worker.nQueued;
+          }
+          // the worker empties its whole queue each time it wakes up
+          if (wasEmpty)
+            worker.have_data.give();
+          return true;
+        }
+        void stopWorkers(){
+          if (!running)
+            return;
+          running = false;
+          for (auto w = workers.begin(); w != workers.end(); ++w) {
+            (*w)->have_data.give();
+            try {
+              (*w)->workloop->cancel();
+            } catch (toolbox::task::exception::Exception const& ex) {
+              if (DEBUG_) std::cout << "[gemOnlineDQM]: unable to cancel fill workloop " << ex.what() << std::endl;
+            }
+          }
+        }
+        /**
+         * Workloop action, waits for GEBs on the queue of the calling worker and fills them
+         * @returns true to be called again, until the workers are stopped
+         */
+        bool fillQueued(toolbox::task::WorkLoop* wl){
+          DQMWorker* worker = 0;
+          for (auto w = workers.begin(); w != workers.end(); ++w)
+            if ((*w)->workloop == wl)
+              worker = *w;
+          if (!worker)
+            return false;
+
+          worker->have_data.take();
+          std::deque<gem::readout::GEMDataAMCformat::GEBData> events;
+          {
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock(worker->queue_lock);
+            events.swap(worker->queue);
+          }
+          for (auto geb = events.begin(); geb != events.end(); ++geb) {
+            // per GEB, so that render never waits for a whole batch
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock(worker->fill_lock);
+            this->fill(*worker, *geb);
+            ++worker->nFilled;
+          }
+          return running;
+        }
+        /**
+         * fill must be called with worker.fill_lock held
+         */
+        template <class GEB>
+          void fill(DQMWorker& worker, const GEB& geb){
+            DQMHistograms& histos = worker.buffers[worker.active];
+            for (auto it = geb.vfats.begin(); it != geb.vfats.end(); ++it){
+              int slot = this->sn(*it);
+              histos.hiVFATsn->Fill(slot);
+              if (slot < 0)
+                continue;
+              worker.occupancy.add(slot, it->lsData, it->msData);
+              this->fillEtaMasks(worker.eta_masks, *it, slot);
+            }
+            this->fillClusters(histos, worker.eta_masks);
+          }
+        /**
+         * swaps the buffers of every filler and adds the filled ones to the displayed histograms,
+         * then rebuilds the strip histograms of the slots that were in new GEBs
+         * @param changed set for each histogram that received entries
+         * @returns true if any histogram changed
+         */
+        bool merge(bool* changed){
+          bool anyChanged = false;
+          for (int i = 0; i < NHISTS; ++i)
+            changed[i] = false;
+          for (auto w = workers.begin(); w != workers.end(); ++w) {
+            int filled;
+            {
+              gem::utils::LockGuard<gem::utils::Lock> fillGuard((*w)->fill_lock);
+              filled = (*w)->active;
+              (*w)->active = 1 - (*w)->active;
+            }
+            for (int i = 0; i < NFILLED; ++i) {
+              TH1* from = (*w)->buffers[filled].get(i);
+              if (from->GetEntries() == 0)
+                continue;
+              display.get(i)->Add(from);
+              from->Reset();
+              changed[i] = true;
+              anyChanged = true;
+            }
+          }
+          return this->mergeStrips(changed) || anyChanged;
+        }
+        /**
+         * fills the strips fired of each slot with new GEBs, and then the beam profile, from the summed
+         * channel counts, with the same contents as filling them once per hit
+         * @returns true if any slot had new GEBs
+         */
+        bool mergeStrips(bool* changed){
+          uint64_t counts[NVFAT][NCHANNELS];
+          bool anyChanged = false;
+          for (int slot = 0; slot < NVFAT; ++slot) {
+            uint64_t events = this->getChannelCounts(slot, counts[slot]);
+            if (events == strip_events[slot])
+              continue;
+            strip_events[slot] = events;
+            changed[NFILLED+slot] = true;
+            anyChanged = true;
+          }
+          if (!anyChanged)
+            return false;
+
+          display.hiBeamProfile->Reset();
+          uint64_t nProfile = 0;
+          for (int slot = 0; slot < NVFAT; ++slot) {
+            bool refill = changed[NFILLED+slot];
+            if (refill)
+              display.hiStripsFired[slot]->Reset();
+            uint64_t nStrips = 0;
+            for (int chan = 0; chan < NCHANNELS; ++chan) {
+              if (strip_map[slot][chan] < 0 || !counts[slot][chan])
+                continue;
+              if (refill)
+                display.hiStripsFired[slot]->Fill(strip_map[slot][chan], counts[slot][chan]);
+              display.hiBeamProfile->Fill(slot%8, profile_strip[slot][chan], counts[slot][chan]);
+              nStrips += counts[slot][chan];
             }
+            if (refill)
+              display.hiStripsFired[slot]->SetEntries(nStrips);
+            nProfile += nStrips;
           }
-          hiClusterMult->Fill(ncl);
-          allstrips.clear();
+          display.hiBeamProfile->SetEntries(nProfile);
+          changed[NHISTS-1] = true;
+          return true;
+        }
+        uint64_t getFilled(){
+          uint64_t filled = 0;
+          for (auto w = workers.begin(); w != workers.end(); ++w) {
+            gem::utils::LockGuard<gem::utils::Lock> guardedLock((*w)->fill_lock);
+            filled += (*w)->nFilled;
+          }
+          return filled;
+        }
+        void fillClusters(DQMHistograms& histos, GEMStripMask* eta_masks){
+          int ncl=0;
+          GEMBitmaskCluster cls[GEMBitmaskClusterizer::MAX_CLUSTERS];
+          for (int ieta = 0; ieta < 8; ++ieta) {
+            if (eta_masks[ieta].empty())
+              continue;
+            int n = GEMBitmaskClusterizer::clusterize(eta_masks[ieta], cls);
+            ncl+=n;
+            for (int icl = 0; icl < n; ++icl)
+              histos.hiClusterSize->Fill(cls[icl].size);
+            eta_masks[ieta].clear();
+          }
+          histos.hiClusterMult->Fill(ncl);
         }
         int sn(const gem::readout::GEMDataAMCformat::VFATData& vfat){
-          std::unique_ptr<gem::readout::GEMslotContents> slotInfo_ = std::unique_ptr<gem::readout::GEMslotContents> (new gem::readout::GEMslotContents(slot_file));
-          uint32_t t_chipID = static_cast<uint32_t>(0x0fff & vfat.ChipID);
-          return slotInfo_->GEBslotIndex(t_chipID);
-        }
-        void fillStrips(const gem::readout::GEMDataAMCformat::VFATData& vfat, int m){
-          uint16_t chan0xfFiredchip = 0;
-          for (int chan = 0; chan < 128; ++chan) {
-            if (chan < 64){
-              chan0xfFiredchip = ((vfat.lsData >> chan) & 0x1);
-              if(chan0xfFiredchip) {
-                hiStripsFired[m]->Fill(strip_maps[m].find(chan+1)->second);
-                int m_i = (int) m%8;
-                int m_j = strip_maps[m].find(chan+1)->second + ((int) m/8)*128;
-  		          if (allstrips.find(m_i) == allstrips.end()){
-  		            GEMStripCollection strips;
-  		            allstrips[m_i]=strips;
-  		          }
-  		          // bx set to 0...
-  		          GEMStrip s(m_j,0);
-  		          allstrips[m_i].insert(s);
-                if (DEBUG_) std::cout << "[gemOnlineDQM]: Beam profile x : " << m_i << " Beam profile y : " << m_j <<  std::endl;
-                hiBeamProfile->Fill(m_i,m_j);
-              }
-            } else {
-              chan0xfFiredchip = ((vfat.msData >> (chan-64)) & 0x1);
-              if(chan0xfFiredchip) {
-                hiStripsFired[m]->Fill(strip_maps[m].find(chan+1)->second);
-                int m_i = (int) m%8;
-                int m_j = strip_maps[m].find(chan+1)->second + ((int) m/8)*128;
-  		          if (allstrips.find(m_i) == allstrips.end()){
-  		            GEMStripCollection strips;
-  		            allstrips[m_i]=strips;
-  		          }
-  		          // bx set to 0...
-  		          GEMStrip s(m_j,0);
-  		          allstrips[m_i].insert(s);
-                if (DEBUG_) std::cout << "[gemOnlineDQM]: Beam profile x : " << m_i << " Beam profile y : " << m_j <<  std::endl;
-                hiBeamProfile->Fill(m_i,m_j);
-              }
+          return slot_map.slotIndex(vfat.ChipID);
+        }
+        /**
+         * sets the strips that fired in the mask of their eta partition, the strip histograms are
+         * rebuilt from the occupancy accumulators by mergeStrips
+         */
+        void fillEtaMasks(GEMStripMask* eta_masks, const gem::readout::GEMDataAMCformat::VFATData& vfat, int m){
+          // only the channels that fired are visited, lowest set bit first
+          uint64_t words[2] = {vfat.lsData, vfat.msData};
+          int m_i = (int) m%8;
+          for (int w = 0; w < 2; ++w) {
+            uint64_t bits = words[w];
+            while (bits) {
+              int chan = 64*w + __builtin_ctzll(bits);
+              bits &= bits - 1;
+              if (strip_map[m][chan] >= 0)
+                eta_masks[m_i].set(profile_strip[m][chan]);
             }
           }
         }
@@ -192,26 +686,34 @@ namespace gem {
             convertor << val;
             convertor >> std::dec >> map_.first;
             if (DEBUG_) std::cout << "[gemOnlineDQM]: Second val recorded : " << map_.first << std::endl;
-            strip_maps[slot_].insert(map_);
+            // channels are numbered from 1 in the map files
+            if (map_.first >= 1 && map_.first <= NCHANNELS)
+              strip_map[slot_][map_.first-1] = map_.second;
           }
         }
-        void print(TString prefix="./temp_plots/")
+        /**
+         * print must be called with render_lock held, it may run on the timer thread
+         */
+        int print(bool const* changed, TString const& prefix)
         {
-          TCanvas *c = new TCanvas("c","c", 600,600);
-          c->cd();
-          hiVFATsn->Draw();
-          gROOT->ProcessLine(".!mkdir -p ./"+prefix);
-          c->Print(prefix+hiVFATsn->GetTitle()+".png","png");
-          hiClusterMult->Draw();
-          c->Print(prefix+hiClusterMult->GetTitle()+".png","png");
-          hiClusterSize->Draw();
-          c->Print(prefix+hiClusterSize->GetTitle()+".png","png");
-          for (unsigned i = 0; i < NVFAT; i++){
-            hiStripsFired[i]->Draw();
-            c->Print(prefix+hiStripsFired[i]->GetTitle()+".png","png");
+          R__LOCKGUARD2(gROOTMutex);
+          if (!render_canvas)
+            render_canvas = new TCanvas((dqm_name+":canvas").c_str(), dqm_name.c_str(), 600, 600);
+          if (prefix != render_dir) {
+            gSystem->mkdir(prefix, kTRUE);
+            render_dir = prefix;
+          }
+          render_canvas->cd();
+          int nDrawn = 0;
+          for (int i = 0; i < NHISTS; ++i) {
+            if (!changed[i])
+              continue;
+            TH1* h = display.get(i);
+            h->Draw();
+            render_canvas->Print(prefix+h->GetTitle()+".png","png");
+            ++nDrawn;
           }
-          hiBeamProfile->Draw();
-          c->Print(prefix+hiBeamProfile->GetTitle()+".png","png");
+          return nDrawn;
         }
     };
   }  // namespace gem::readout
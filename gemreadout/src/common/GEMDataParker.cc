@@ -34,16 +34,10 @@ typedef gem::readout::GEMDataAMCformat::GEMData  AMCGEMData;
 typedef gem::readout::GEMDataAMCformat::GEBData  AMCGEBData;
 typedef gem::readout::GEMDataAMCformat::VFATData AMCVFATData;
 //
-//why are these global and not part of the header???
-std::vector<AMCVFATData> vfats;
-std::vector<AMCVFATData> erros;
 
 const uint32_t gem::readout::GEMDataParker::kUPDATE = 5000;
 const uint32_t gem::readout::GEMDataParker::kUPDATE7 = 7;
 
-// I have no idea what this is for
-int rvent_ = 0;
-
 const int gem::readout::GEMDataParker::I2O_READOUT_NOTIFY=0x84;
 const int gem::readout::GEMDataParker::I2O_READOUT_CONFIRM=0x85;
 
@@ -54,9 +48,11 @@ gem::readout::GEMDataParker::GEMDataParker(gem::hw::glib::HwGLIB& glibDevice,
                                            std::string const& outputType,
                                            std::string const& slotFileName,
                                            GEMRunType  const& runType) :
-  m_ESexp(-1),
-  m_isFirst(true),
   m_contvfats(0),
+  m_latency(0),
+  m_VT1(0),
+  m_VT2(0),
+  m_builder(&GEMSlotMapService::getInstance().getSlotMap(slotFileName)),
   m_gemLogger(log4cplus::Logger::getInstance(LOG4CPLUS_TEXT("gem:readout:GEMDataParker"))),
   m_queueLock(toolbox::BSem::FULL, true),
   m_runType(runType)
@@ -74,15 +70,21 @@ gem::readout::GEMDataParker::GEMDataParker(gem::hw::glib::HwGLIB& glibDevice,
   m_counter = {0,0,0,0,0};
   m_vfat = 0;
   m_event = 0;
-  rvent_ = 0;
   m_sumVFAT = 0;
-  slotInfo = std::unique_ptr<gem::readout::GEMslotContents>(new gem::readout::GEMslotContents(m_slotFileName));
+  m_builder.setRunHeader(Runtype());
+
+  p_serializer = std::unique_ptr<gem::readout::GEMEventSerializer>(gem::readout::GEMEventSerializer::create(m_outputType));
+  m_outFile.open(m_outFileName.c_str(), std::ios_base::app | std::ios::binary);
+  m_errFile.open(m_errFileName.c_str(), std::ios_base::app | std::ios::binary);
+  if (!m_outFile.is_open() || !m_errFile.is_open())
+    ERROR("GEMDataParker unable to open " << m_outFileName << " or " << m_errFileName);
+  INFO("GEMDataParker writing " << p_serializer->getFormatName() << " events to " << m_outFileName);
 }
 
 uint32_t* gem::readout::GEMDataParker::dumpData(uint8_t const& readout_mask)
 {
 
-  INFO("info dump data parker");
+  DEBUG("info dump data parker");
   DEBUG("Reading out dumpData(" << (int)readout_mask << ")");
   uint32_t *point = &m_counter[0];
   m_contvfats = 0;
@@ -215,7 +217,7 @@ uint32_t* gem::readout::GEMDataParker::getGLIBData(uint8_t const& gtx, uint32_t
 uint32_t* gem::readout::GEMDataParker::selectData(uint32_t counter[5])
 {
   for(int j = 0; j < 5; j++) {
-    INFO("GEMDataParker::selectData counter " << j <<  " "<< counter[j] );
+    DEBUG("GEMDataParker::selectData counter " << j <<  " "<< counter[j] );
   }
   uint32_t *point = &counter[0];
   DEBUG("GEMDataParker::selectData point  " << std::hex << point );
@@ -228,12 +230,8 @@ uint32_t* gem::readout::GEMDataParker::GEMEventMaker(uint32_t counter[5])
 {
   uint32_t *point = &counter[0];
 
-  AMCGEMData  gem;
-  AMCGEBData  geb;
   AMCVFATData vfat;
 
-  int islot = -1;
-
   // Booking FIFO variables
   uint64_t msVFAT, lsVFAT;
   uint32_t ES;
@@ -251,15 +249,12 @@ uint32_t* gem::readout::GEMDataParker::GEMEventMaker(uint32_t counter[5])
 
   m_vfat++;
 
-  islot = slotInfo->GEBslotIndex( (uint32_t)chipid);
-
   // GEM Event selector
   ES = ( evn << 12 ) | bcn;
   DEBUG(" ::GEMEventMaker ES 0x" << std::hex << ES << " evn 0x"<< evn <<
-        " bcn 0x" << std::hex << bcn << std::dec << " vftas.size " <<
-        vfats.size() << " erros.size " << erros.size() << " chip ID 0x" <<
-        std::hex << (int)chipid << std::dec <<
-        " slot number " << islot << " m_isFirst " << m_isFirst << " event " << m_event);
+        " bcn 0x" << std::hex << bcn << std::dec << " vfats " <<
+        m_builder.getNVFATs() << " errors " << m_builder.getNErrors() << " chip ID 0x" <<
+        std::hex << (int)chipid << std::dec << " event " << m_event);
 
   lsVFAT = (data3 << 32) | (data4);
   msVFAT = (data1 << 32) | (data2);
@@ -272,37 +267,25 @@ uint32_t* gem::readout::GEMDataParker::GEMEventMaker(uint32_t counter[5])
   vfat.BXfrOH = BX;                                     // BXfrOH:32
   vfat.crc    = vfatcrc;                                // crc:16
 
-  if ( ES == m_ESexp ) {
-    m_isFirst = false;
-  } else {
-    m_isFirst = true;
-
-    if ( vfats.size() != 0 || erros.size() != 0 ) {
-      DEBUG(" ::GEMEventMaker m_isFirst GEMevSelector ");
-      gem::readout::GEMDataParker::GEMevSelector(m_ESexp);
-    }
-
-    m_event++;
-    // VFATS dimensions have limits
-    vfats.reserve(MaxVFATS);
-    erros.reserve(MaxERRS);
-    m_ESexp = ES;
+  // the VFATs of an event are consecutive, the first VFAT of another event completes it
+  if (m_builder.startsNewEvent(vfat)) {
+    DEBUG(" ::GEMEventMaker new event, GEMevSelector ");
+    gem::readout::GEMDataParker::GEMevSelector(m_builder.getEventSelector());
   }
-  DEBUG(" ::GEMEventMaker ES 0x" << std::hex << ES << std::dec << " bool " << m_isFirst );
-  if (islot < 0 || islot > 23) {
-    if ( int(erros.size()) <MaxERRS ) erros.push_back(vfat);
-    DEBUG(" ::GEMEventMaker warning !!! islot is undefined " << islot << " erros.size " << int(erros.size()) );
-  } else {
-    // VFATs Pay Load
-    if ( int(vfats.size()) <= MaxVFATS ) vfats.push_back(vfat);
-    DEBUG(" ::GEMEventMaker m_event " << m_event << " vfats.size " << vfats.size() << std::hex << " ES 0x" << ES << std::dec );
-  }//end of event selection
+  if (!m_builder.hasEvent())
+    m_event++;
+  // VFATs in no known slot go to the error event
+  if (!m_builder.add(vfat))
+    WARN("GEMDataParker::GEMEventMaker event of ES 0x" << std::hex << ES << " is full, dropped ChipID 0x"
+         << vfat.ChipID << std::dec << ", " << m_builder.getDropped() << " VFATs dropped so far");
+  DEBUG(" ::GEMEventMaker m_event " << m_event << " vfats " << m_builder.getNVFATs() << " errors "
+        << m_builder.getNErrors() << std::hex << " ES 0x" << ES << std::dec );
 
   counter[0] = m_vfat;
   counter[1] = m_event;
-  counter[2] = vfats.size() + erros.size();
-  counter[3] = vfats.size();
-  counter[4] = erros.size();
+  counter[2] = m_builder.getNVFATs() + m_builder.getNErrors();
+  counter[3] = m_builder.getNVFATs();
+  counter[4] = m_builder.getNErrors();
 
   return point;
 }
@@ -310,272 +293,31 @@ uint32_t* gem::readout::GEMDataParker::GEMEventMaker(uint32_t counter[5])
 void gem::readout::GEMDataParker::GEMevSelector(const  uint32_t& ES)
 {
   //  GEM Event Data Format definition
-  AMCGEMData  gem;
-  AMCGEBData  geb;
-  AMCVFATData vfat;
+  m_builder.complete(m_event);
+  GEMArenaGEB& geb    = m_builder.getGEB();
+  GEMArenaGEB& errGEB = m_builder.getErrorGEB();
+
+  DEBUG(" ::GEMevSelector ES 0x" << std::hex << ES << std::dec << " vfats " << geb.vfats.size()
+        << " errors " << errGEB.vfats.size() << " event " << m_event);
 
-  DEBUG(" ::GEMEventMaker vfats.size " << int(vfats.size()) << " rvent_ " << rvent_ << " event " << m_event);
-
-  uint32_t locEvent = 0;
-  uint32_t locError = 0;
-  std::string TypeDataFlag = "PayLoad";
-
-  // contents all local events (one buffer, all links):
-  locEvent++;
-  uint32_t nChip = 0;
-  for (auto iVFAT=vfats.begin(); iVFAT != vfats.end(); ++iVFAT) {//try auto
-
-    uint8_t ECff = ( (0x0ff0 & (*iVFAT).EC ) >> 4);
-    uint32_t localEvent = ( ECff << 12 ) | ( 0x0fff & (*iVFAT).BC );
-
-    DEBUG(" ::GEMEventMaker vfats ES 0x" << std::hex << ( 0x00ffffff & ES) << " and from vfat 0x" <<
-          ( 0x00ffffff & localEvent ) << " EC 0x" << (int)ECff << " BC 0x" << ( 0x0fff & (*iVFAT).BC ) << std::dec );
-
-    if ( ES == localEvent ) {
-      nChip++;
-      // VFATs Pay Load
-      geb.vfats.push_back(*iVFAT);
-      int islot = slotInfo->GEBslotIndex((uint32_t)(*iVFAT).ChipID);
-      DEBUG(" ::GEMevSelector slot number " << islot );
-
-      if ( gem::readout::GEMDataParker::VFATfillData( islot, geb) ) {
-        if ( vfats.size() == nChip ) {
-
-          gem::readout::GEMDataParker::GEMfillHeaders(m_event, 1, gem, geb);
-          gem::readout::GEMDataParker::GEMfillTrailers(gem, geb);
-          // GEM Event Writing
-          DEBUG(" ::GEMEventMaker writing...  geb.vfats.size " << int(geb.vfats.size()) );
-          TypeDataFlag = "PayLoad";
-          if(int(geb.vfats.size()) != 0) gem::readout::GEMDataParker::writeGEMevent(m_outFileName, false, TypeDataFlag,
-                                                                                    gem, geb, vfat);
-          geb.vfats.clear();
-        }// end of writing event
-      }// if slot correct
-    }// if localEvent
-  }// end of GEB PayLoad Data
-
-  geb.vfats.clear();
-  TypeDataFlag = "Errors";
-
-  // contents all local events (one buffer, all links):
-  DEBUG(" ::GEMEventMaker END ES 0x" << std::hex << ES << std::dec << " errES " <<  erros.size() <<
-        " rvent_ " << rvent_ );
-
-  uint32_t nErro = 0;
-  for (auto iErr=erros.begin(); iErr != erros.end(); ++iErr) {
-
-    uint8_t ECff = ( (0x0ff0 & (*iErr).EC ) >> 4);
-    uint32_t localErr = ( ECff << 12 ) | ( 0x0fff & (*iErr).BC );
-    DEBUG(" ::GEMEventMaker ERROR vfats ES 0x" << ES << " EC " << localErr );
-
-    if( ES == localErr ) {
-      nErro++;
-      DEBUG(" ::GEMEventMaker " << " nErro " << nErro << " ES 0x" << std::hex << ES << std::dec );
-      // VFATs Errors
-      geb.vfats.push_back(*iErr);
-      if ( erros.size() == nErro ) {
-        // GEMDataAMCformat::printVFATdataBits(nErro, vfat);
-        int islot = -1;
-        gem::readout::GEMDataParker::VFATfillData( islot, geb);
-        gem::readout::GEMDataParker::GEMfillHeaders(rvent_, nErro, gem, geb);
-        gem::readout::GEMDataParker::GEMfillTrailers(gem, geb);
-        // GEM ERRORS Event Writing
-        TypeDataFlag = "Errors";
-        if(int(geb.vfats.size()) != 0) gem::readout::GEMDataParker::writeGEMevent(m_errFileName, false, TypeDataFlag,
-                                                                                  gem, geb, vfat);
-        geb.vfats.clear();
-      }// if localErr
-    }// if localErr
-  }// end of GEB PayLoad Data
-
-  geb.vfats.clear();
+  // GEM Event Writing
+  if (!geb.vfats.empty())
+    gem::readout::GEMDataParker::writeGEMevent(m_outFile, m_builder.getEvent(), geb);
+  // GEM ERRORS Event Writing
+  if (!errGEB.vfats.empty())
+    gem::readout::GEMDataParker::writeGEMevent(m_errFile, m_builder.getErrorEvent(), errGEB);
 
   if (m_event%kUPDATE == 0 &&  m_event != 0) {
-    DEBUG(" ::GEMEventMaker vfats.size " << std::setfill(' ') << std::setw(7) << int(vfats.size()) <<
-          " erros.size " << std::setfill(' ') << std::setw(3) << int(erros.size()) <<
-          " locEvent   " << std::setfill(' ') << std::setw(6) << locEvent <<
-          " locError   " << std::setfill(' ') << std::setw(3) << locError << " event " << m_event
-          );
+    DEBUG(" ::GEMevSelector vfats " << std::setfill(' ') << std::setw(7) << int(geb.vfats.size()) <<
+          " errors " << std::setfill(' ') << std::setw(3) << int(errGEB.vfats.size()) << " event " << m_event);
   }
 
-  locEvent = 0;
-
-  vfats.clear();
-  erros.clear();
-  // reset event logic
-  m_isFirst = true;
+  m_builder.release();
 }
 
-bool gem::readout::GEMDataParker::VFATfillData(int const& islot, AMCGEBData&  geb)
+void gem::readout::GEMDataParker::writeGEMevent(std::ofstream& outf, GEMArenaEvent const& gem, GEMArenaGEB const& geb)
 {
-  // Chamber Header, Zero Suppression flags, Chamber ID
-  uint64_t ZSFlag  = 0x0;                    // :24
-  uint64_t ChamID  = 0xffffffffffffffff & (0b00011111);                  // :5
-  uint64_t sumVFAT = int(3*int(geb.vfats.size()));  // :11
-  geb.header  = (ZSFlag << 40)|(ChamID << 35)|(sumVFAT << 23);
-  ZSFlag =  (0xffffff0000000000 & geb.header) >> 40;
-  ChamID =  (0x000000fff0000000 & geb.header) >> 28;
-  sumVFAT=  (0x000000000fffffff & geb.header);
-
-  DEBUG(" ::VFATfillData ChamID 0x" << ChamID << std::dec << " islot " << islot << " sumVFAT " << sumVFAT);
-
-  if (islot == -1) {
-    return (false);
-  } else {
-    ZSFlag           = (ZSFlag | (1 << (23-islot))); // :24
-    return (true);
-  }// end else
-}// end VFATfillData
-
-
-void gem::readout::GEMDataParker::writeGEMevent(std::string  outFile, bool const&  OKprint,
-                                                std::string const& TypeDataFlag,
-                                                AMCGEMData&  gem, AMCGEBData&  geb, AMCVFATData& vfat)
-{
-  if(OKprint) {
-    DEBUG(" ::writeGEMevent m_vfat " << m_vfat << " event " << m_event << " sumVFAT " << (0x000000000fffffff & geb.header) <<
-          " geb.vfats.size " << int(geb.vfats.size()) );
-  }
-  // GEM Chamber's Data
-  if (m_outputType == "Hex") {
-    GEMDataAMCformat::writeGEMhd1 (outFile, m_event, gem);
-    GEMDataAMCformat::writeGEMhd2 (outFile, m_event, gem);
-    GEMDataAMCformat::writeGEMhd3 (outFile, m_event, gem);
-  } else {
-    GEMDataAMCformat::writeGEMhd1Binary (outFile, m_event, gem);
-    GEMDataAMCformat::writeGEMhd2Binary (outFile, m_event, gem);
-    GEMDataAMCformat::writeGEMhd3Binary (outFile, m_event, gem);
-  }
-  //  GEB Headers Data
-  if (m_outputType == "Hex") {
-    GEMDataAMCformat::writeGEBheader (outFile, m_event, geb);
-    GEMDataAMCformat::writeGEBrunhed (outFile, m_event, geb);
-  } else {
-    GEMDataAMCformat::writeGEBheaderBinary (outFile, m_event, geb);
-    //GEMDataAMCformat::writeGEBrunhedBinary (outFile, m_event, geb);
-  } // GEMDataAMCformat::printGEBheader (m_event, geb);
-  //  GEB PayLoad Data
-  int nChip=0;
-  for (auto iVFAT=geb.vfats.begin(); iVFAT != geb.vfats.end(); ++iVFAT) {
-    nChip++;
-
-    if (m_outputType == "Hex") {
-      GEMDataAMCformat::writeVFATdata (outFile, nChip, *iVFAT);
-    } else {
-      GEMDataAMCformat::writeVFATdataBinary (outFile, nChip, *iVFAT);
-    };
-  }//end of GEB PayLoad Data
-  //  GEB Trailers Data
-  if (m_outputType == "Hex") {
-    GEMDataAMCformat::writeGEBtrailer (outFile, m_event, geb);
-  } else {
-    GEMDataAMCformat::writeGEBtrailerBinary (outFile, m_event, geb);
-  }
-  //  GEM Trailers Data
-  if (m_outputType == "Hex") {
-    GEMDataAMCformat::writeGEMtr2 (outFile, m_event, gem);
-    GEMDataAMCformat::writeGEMtr1 (outFile, m_event, gem);
-  } else {
-    GEMDataAMCformat::writeGEMtr2Binary (outFile, m_event, gem);
-    GEMDataAMCformat::writeGEMtr1Binary (outFile, m_event, gem);
-  }
-}
-
-void gem::readout::GEMDataParker::GEMfillHeaders(uint32_t const& event, uint32_t const& DAVCount_,
-                                                 AMCGEMData& gem, AMCGEBData& geb)
-{
-
-  // GEM, All Chamber Data
-  // GEM Event Headers [1]
-  uint64_t AmcNo       = BOOST_BINARY( 1 );            // :4
-  uint64_t ZeroFlag    = BOOST_BINARY( 0000 );         // :4
-  uint64_t LV1ID       = (0x0000000000ffffff & event); // :24
-  uint64_t BXID        = 0;                            // :12  ! why we have only 12 Bits for BX !
-  uint64_t DataLgth    = BOOST_BINARY( 1 );            // :20
-
-  gem.header1 = (AmcNo <<60)|(ZeroFlag << 56)|(LV1ID << 32)|(BXID << 20)|(DataLgth);
-
-  AmcNo    =  (0xf000000000000000 & gem.header1) >> 60;
-  ZeroFlag =  (0x0f00000000000000 & gem.header1) >> 56;
-  LV1ID    =  (0x00ffffff00000000 & gem.header1) >> 32;
-  BXID     =  (0x00000000ffffffff & gem.header1) >> 20;
-  DataLgth =  (0x00000000000fffff & gem.header1);
-
-  DEBUG(" ::GEMfillHeaders event " << event << " LV1ID " << LV1ID << " BXID " << BXID);
-
-  // GEM Event Headers [2]
-  uint64_t User        = BOOST_BINARY( 1 );    // :32
-  uint64_t OrN         = BOOST_BINARY( 1 );    // :16
-  uint64_t BoardID     = BOOST_BINARY( 1 );    // :16
-  uint64_t FormatVersion = 0x0;
-  uint64_t runType = 0x1;
-  uint64_t temp = 0x00000000000000ff;
-
-  //gem.header2 = (User << 32)|(OrN << 16)|(BoardID);
-  gem.header2 = (FormatVersion << 60) | (runType << 56) | ((temp & m_latency) << 48) | ((temp & m_VT1) << 40) | ((temp & m_VT2) << 32) |(OrN << 16)|(BoardID);
-
-  User     =  (0xffffffff00000000 & gem.header2) >> 32;
-  OrN      =  (0x00000000ffff0000 & gem.header2) >> 16;
-  BoardID  =  (0x000000000000ffff & gem.header2);
-
-  // GEM Event Headers [3]
-  uint64_t DAVList     = BOOST_BINARY( 1 );    // :24
-  uint64_t BufStat     = BOOST_BINARY( 1 );    // :24
-  //uint64_t DAVCount    = BOOST_BINARY( 1 );    // :5
-  uint64_t DAVCount    = 0x00000000ffffffff & DAVCount_;
-  uint64_t FormatVer   = BOOST_BINARY( 1 );    // :3
-  uint64_t MP7BordStat = BOOST_BINARY( 1 );    // :8
-
-  gem.header3 = (BufStat << 40)|(DAVList << 16)|(DAVCount << 11)|(FormatVer << 8)|(MP7BordStat);
-  DEBUG("GEM HEADER 3 " << std::hex << gem.header3 << "\n");
-
-  DAVList     = (0xffffff0000000000 & gem.header3) >> 40;
-  BufStat     = (0x000000ffffff0000 & gem.header3) >> 16;
-  uint16_t DAVCount_check;
-  DAVCount_check= 0b0000000000011111 & (gem.header3 >> 11);
-  FormatVer   = (0x0000000000000f00 & gem.header3) >> 8;
-  MP7BordStat = (0x00000000000000ff & gem.header3);
-
-  DEBUG("DAVCount " << std::hex << DAVCount_check << "\n");
-
-  // last geb header:
-  geb.runhed  = Runtype();
-  INFO("GEMfillHeadres" << geb.runhed);
-}// end GEMfillHeaders
-
-void gem::readout::GEMDataParker::GEMfillTrailers(AMCGEMData&  gem,AMCGEBData&  geb)
-{
-  // GEM, All Chamber Data
-  // GEM Event Treailer [2]
-  uint64_t EventStat  = BOOST_BINARY( 1 );    // :32
-  uint64_t GEBerrFlag = BOOST_BINARY( 1 );    // :24
-
-  gem.trailer2 = ( EventStat << 40)|(GEBerrFlag);
-
-  // GEM Event Treailer [1]
-  uint64_t crc      = BOOST_BINARY( 1 );    // :32
-  uint64_t LV1IDT   = BOOST_BINARY( 1 );    // :8
-  uint64_t ZeroFlag = BOOST_BINARY( 0000 ); // :4
-  uint64_t DataLgth = BOOST_BINARY( 1 );    // :20
-
-  gem.trailer1 = (crc<<32)|(LV1IDT << 24)|(ZeroFlag <<20)|(DataLgth);
-
-  crc      = (0xffffffff00000000 & gem.trailer1) >> 32;
-  LV1IDT   = (0x00000000ff000000 & gem.trailer1) >> 24;
-  ZeroFlag = (0x0000000000f00000 & gem.trailer1) >> 20;
-  DataLgth = (0x00000000000fffff & gem.trailer1);
-
-  // Chamber Trailer, OptoHybrid: crc, wordcount, Chamber status
-  uint64_t OHcrc       = BOOST_BINARY( 1 ); // :16
-  uint64_t OHwCount    = BOOST_BINARY( 1 ); // :16
-  uint64_t ChamStatus  = BOOST_BINARY( 1 ); // :16
-  geb.trailer = ((OHcrc << 48)|(OHwCount << 32 )|(ChamStatus << 16));
-
-  OHcrc      = (0xffff000000000000 & geb.trailer) >> 48;
-  OHwCount   = (0x0000ffff00000000 & geb.trailer) >> 32;
-  ChamStatus = (0x00000000ffff0000 & geb.trailer) >> 16;
-
-  DEBUG(" OHcrc 0x" << std::hex << OHcrc << " OHwCount " << OHwCount << " ChamStatus " << ChamStatus << std::dec);
+  p_serializer->write(outf, gem, geb);
 }
 
 void gem::readout::GEMDataParker::readVFATblock(std::queue<uint32_t>& dataque)
@@ -650,5 +392,7 @@ void gem::readout::GEMDataParker::ScanRoutines(uint8_t latency, uint8_t VT1, uin
   m_latency = latency;
   m_VT1 = VT1;
   m_VT2 = VT2;
+  m_builder.setScanParameters(m_latency, m_VT1, m_VT2);
+  m_builder.setRunHeader(Runtype());
   DEBUG("GEMDataParker::ScanRoutines Latency = " << (int)m_latency  << " VT1 = " << (int)m_VT1 << " VT2 = " << (int)m_VT2);
 }
@@ -9,15 +9,21 @@
 #include "gem/readout/GEMReadoutApplication.h"
 
 #include <iomanip>
+#include <sstream>
+#include <time.h>
 
 #include "toolbox/mem/Pool.h"
 #include "toolbox/mem/MemoryPoolFactory.h"
 #include "toolbox/mem/CommittedHeapAllocator.h"
 
 #include "gem/readout/GEMReadoutWebApplication.h"
+#include "gem/readout/GEMReadoutMonitor.h"
 
 const int gem::readout::GEMReadoutApplication::I2O_READOUT_NOTIFY=0x84;
 const int gem::readout::GEMReadoutApplication::I2O_READOUT_CONFIRM=0x85;
+const unsigned gem::readout::GEMReadoutApplication::RATE_WINDOW_SHORT;
+
+typedef gem::base::utils::GEMInfoSpaceToolBox::UpdateType GEMUpdateType;
 
 /*
   namespace gem {
@@ -42,6 +48,7 @@ gem::readout::GEMReadoutApplication::GEMReadoutSettings::GEMReadoutSettings() {
   outputType     = "Bin";
   outputLocation = "/tmp";
   setupLocation  = "";
+  zeroSuppression = false;
 }
 
 void gem::readout::GEMReadoutApplication::GEMReadoutSettings::registerFields(xdata::Bag<gem::readout::GEMReadoutApplication::GEMReadoutSettings>* bag) {
@@ -51,6 +58,7 @@ void gem::readout::GEMReadoutApplication::GEMReadoutSettings::registerFields(xda
   bag->addField("outputType",     &outputType);
   bag->addField("outputLocation", &outputLocation);
   bag->addField("setupLocation",  &setupLocation);
+  bag->addField("zeroSuppression", &zeroSuppression);
 }
 
 
@@ -62,7 +70,10 @@ gem::readout::GEMReadoutApplication::GEMReadoutApplication(xdaq::ApplicationStub
   m_deviceName("ReadoutDevice"),
   m_eventsReadout(0),
   m_usecPerEvent(0.0),
-  m_usecUsed(0.0)
+  m_usecUsed(0.0),
+  m_cycleRecorded(false),
+  m_stageLock(toolbox::BSem::FULL, true),
+  m_lastPublished(0)
 {
   DEBUG("GEMReadoutApplication ctor begin");
   //i2o::bind(this,&ReadoutApplication::onReadoutNotify,I2O_READOUT_NOTIFY,XDAQ_ORGANIZATION_ID);
@@ -70,8 +81,11 @@ gem::readout::GEMReadoutApplication::GEMReadoutApplication(xdaq::ApplicationStub
   p_appInfoSpace->fireItemAvailable("ReadoutSettings",&m_readoutSettings);
   p_appInfoSpace->fireItemAvailable("DeviceName",     &m_deviceName);
   p_appInfoSpace->fireItemAvailable("ConnectionFile", &m_connectionFile);
-  p_appInfoSpace->fireItemAvailable("EventsReadout",  &m_eventsReadout);
-  p_appInfoSpace->fireItemAvailable("uSecPerEvent",   &m_usecPerEvent);
+  // created through the toolbox so the monitor can serve them
+  p_appInfoSpaceToolBox->createInteger64("EventsReadout", m_eventsReadout.value_, &m_eventsReadout,
+                                         GEMUpdateType::PROCESS, "docstring", "dec");
+  p_appInfoSpaceToolBox->createDouble("uSecPerEvent", m_usecPerEvent.value_, &m_usecPerEvent,
+                                      GEMUpdateType::PROCESS, "docstring", "dec");
 
   p_appInfoSpace->addItemRetrieveListener("ReadoutSettings", this);
   p_appInfoSpace->addItemRetrieveListener("DeviceName",      this);
@@ -85,6 +99,32 @@ gem::readout::GEMReadoutApplication::GEMReadoutApplication(xdaq::ApplicationStub
   p_appInfoSpace->addItemChangedListener( "EventsReadout",   this);
   p_appInfoSpace->addItemChangedListener( "uSecPerEvent",    this);
 
+  // per stage telemetry, updated by the readout task
+  resetStageStatistics();
+  for (unsigned stage = 0; stage < N_READOUT_STAGES; ++stage) {
+    std::string name = getStageName(static_cast<ReadoutStage>(stage));
+    m_cycleQueueDepth[stage]    = 0;
+    m_cycleMaxQueueDepth[stage] = 0;
+    p_appInfoSpaceToolBox->createUInt64(name+"Items", 0, &m_stageItems[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+    p_appInfoSpaceToolBox->createUInt64(name+"Bytes", 0, &m_stageBytes[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+    p_appInfoSpaceToolBox->createDouble(name+"ItemRate", 0., &m_stageItemRate[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+    p_appInfoSpaceToolBox->createDouble(name+"ByteRate", 0., &m_stageByteRate[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+    p_appInfoSpaceToolBox->createDouble(name+"LatencyMean", 0., &m_stageLatencyMean[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+    p_appInfoSpaceToolBox->createUInt32(name+"LatencyP99", 0, &m_stageLatencyP99[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+    p_appInfoSpaceToolBox->createUInt64(name+"QueueDepth", 0, &m_stageQueue[stage],
+                                        GEMUpdateType::PROCESS, "docstring", "dec");
+  }
+
+  // the monitor must exist before the web interface, which keeps a pointer to it
+  p_gemMonitor = new gem::readout::GEMReadoutMonitor(this);
+  dynamic_cast<gem::readout::GEMReadoutMonitor*>(p_gemMonitor)->setupReadoutMonitoring();
+
   p_gemWebInterface = new gem::readout::GEMReadoutWebApplication(this);
 
   ////set up the info hwCfgInfoSpace
@@ -151,6 +191,7 @@ void gem::readout::GEMReadoutApplication::initializeAction()
   m_eventsReadout.value_ = 0;
   m_usecPerEvent.value_  = 0;
   m_usecUsed = 0;
+  resetStageStatistics();
 }
 
 void gem::readout::GEMReadoutApplication::configureAction()
@@ -299,7 +340,74 @@ int gem::readout::GEMReadoutApplication::readoutTask()
         m_usecUsed += deltaU;
         m_usecPerEvent.value_ = m_usecUsed/(m_eventsReadout.value_);
       }
+      publishStageStatistics();
     }
   }
   return 0;
 }
+
+std::string gem::readout::GEMReadoutApplication::getStageName(ReadoutStage const& stage)
+{
+  switch (stage) {
+  case (STAGE_FIFO_READ) : return "FIFORead";
+  case (STAGE_DECODE)    : return "Decode";
+  case (STAGE_BUILD)     : return "Build";
+  case (STAGE_DQM)       : return "DQM";
+  case (STAGE_WRITE)     : return "Write";
+  default                : return "Unknown";
+  }
+}
+
+void gem::readout::GEMReadoutApplication::publishStageStatistics()
+{
+  uint64_t now = GEMRateWindow::now();
+  if (!m_cycleRecorded && now == m_lastPublished)
+    return;
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_stageLock);
+  for (unsigned stage = 0; stage < N_READOUT_STAGES; ++stage) {
+    GEMStageStatistics& cycle = m_cycleStats[stage];
+    if (cycle.getLatency().getCount()) {
+      m_stageStats[stage].merge(cycle);
+      m_stageRates[stage].record(now, cycle.getItems(), cycle.getBytes());
+      cycle.reset();
+    }
+    m_stageQueueDepth[stage] = m_cycleQueueDepth[stage];
+    if (m_cycleMaxQueueDepth[stage] > m_stageMaxQueueDepth[stage])
+      m_stageMaxQueueDepth[stage] = m_cycleMaxQueueDepth[stage];
+    m_cycleMaxQueueDepth[stage] = 0;
+  }
+  m_cycleRecorded = false;
+
+  if (now == m_lastPublished)
+    return;
+  m_lastPublished = now;
+  for (unsigned stage = 0; stage < N_READOUT_STAGES; ++stage) {
+    gem::utils::GEMLatencyHistogram const& latency = m_stageStats[stage].getLatency();
+    m_stageItems[stage]       = m_stageStats[stage].getItems();
+    m_stageBytes[stage]       = m_stageStats[stage].getBytes();
+    m_stageItemRate[stage]    = m_stageRates[stage].getItemRate(now, RATE_WINDOW_SHORT);
+    m_stageByteRate[stage]    = m_stageRates[stage].getByteRate(now, RATE_WINDOW_SHORT);
+    m_stageLatencyMean[stage] = latency.getMean();
+    m_stageLatencyP99[stage]  = static_cast<uint32_t>(latency.getQuantile(0.99));
+    m_stageQueue[stage]       = m_stageQueueDepth[stage];
+  }
+}
+
+void gem::readout::GEMReadoutApplication::resetStageStatistics()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_stageLock);
+  for (unsigned stage = 0; stage < N_READOUT_STAGES; ++stage) {
+    m_stageStats[stage].reset();
+    m_stageRates[stage].reset();
+    m_stageQueueDepth[stage]    = 0;
+    m_stageMaxQueueDepth[stage] = 0;
+    m_stageItems[stage]       = 0;
+    m_stageBytes[stage]       = 0;
+    m_stageItemRate[stage]    = 0.;
+    m_stageByteRate[stage]    = 0.;
+    m_stageLatencyMean[stage] = 0.;
+    m_stageLatencyP99[stage]  = 0;
+    m_stageQueue[stage]       = 0;
+  }
+}
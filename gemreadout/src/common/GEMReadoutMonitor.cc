@@ -0,0 +1,53 @@
+/**
+ * class: GEMReadoutMonitor
+ * description: Monitor for GEMReadoutApplication derived applications, serves the readout counters
+ *              and the per stage telemetry through the monitoring JSON snapshot
+ */
+
+#include "gem/readout/GEMReadoutMonitor.h"
+#include "gem/readout/GEMReadoutApplication.h"
+#include "gem/base/GEMFSMApplication.h"
+
+typedef gem::base::utils::GEMInfoSpaceToolBox::UpdateType GEMUpdateType;
+
+gem::readout::GEMReadoutMonitor::GEMReadoutMonitor(GEMReadoutApplication* readoutApp) :
+  GEMMonitor(readoutApp->getApplicationLogger(), static_cast<gem::base::GEMFSMApplication*>(readoutApp), 0)
+{
+  // default constructor
+}
+
+gem::readout::GEMReadoutMonitor::~GEMReadoutMonitor()
+{
+  // make sure no update is running on this object while it is torn down
+  stopMonitoring();
+}
+
+void gem::readout::GEMReadoutMonitor::setupReadoutMonitoring()
+{
+  DEBUG("GEMReadoutMonitor::setupReadoutMonitoring");
+  addMonitorableSet("Readout", "Application");
+  addMonitorable("Readout", "Application",
+                 std::make_pair("EventsReadout", ""),
+                 GEMUpdateType::PROCESS, "dec");
+  addMonitorable("Readout", "Application",
+                 std::make_pair("uSecPerEvent", ""),
+                 GEMUpdateType::PROCESS, "dec");
+
+  for (unsigned stage = 0; stage < GEMReadoutApplication::N_READOUT_STAGES; ++stage) {
+    std::string name = GEMReadoutApplication::getStageName(static_cast<GEMReadoutApplication::ReadoutStage>(stage));
+    std::string setname = "Stage " + name;
+    addMonitorableSet(setname, "Application");
+    addMonitorable(setname, "Application", std::make_pair(name+"Items",       ""), GEMUpdateType::PROCESS, "dec");
+    addMonitorable(setname, "Application", std::make_pair(name+"Bytes",       ""), GEMUpdateType::PROCESS, "dec");
+    addMonitorable(setname, "Application", std::make_pair(name+"ItemRate",    ""), GEMUpdateType::PROCESS, "dec");
+    addMonitorable(setname, "Application", std::make_pair(name+"ByteRate",    ""), GEMUpdateType::PROCESS, "dec");
+    addMonitorable(setname, "Application", std::make_pair(name+"LatencyMean", ""), GEMUpdateType::PROCESS, "dec");
+    addMonitorable(setname, "Application", std::make_pair(name+"LatencyP99",  ""), GEMUpdateType::PROCESS, "dec");
+    addMonitorable(setname, "Application", std::make_pair(name+"QueueDepth",  ""), GEMUpdateType::PROCESS, "dec");
+  }
+}
+
+void gem::readout::GEMReadoutMonitor::updateMonitorables()
+{
+  DEBUG("GEMReadoutMonitor: Updating monitorables");
+}
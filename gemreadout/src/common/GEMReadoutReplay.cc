@@ -0,0 +1,268 @@
+/**
+ * class: GEMReadoutReplay
+ * description: Replays recorded tracking data or run files through the readout stages, without hardware
+ */
+
+#include "gem/readout/GEMReadoutReplay.h"
+
+#include <stdlib.h>
+
+#include <iomanip>
+#include <sstream>
+
+#include "gem/utils/GEMLogging.h"
+
+bool gem::readout::GEMReadoutReplay::parseInputFormat(std::string const& name, InputFormat& format)
+{
+  if (name == "glibhex")
+    format = GLIB_DUMP_HEX;
+  else if (name == "glibbin")
+    format = GLIB_DUMP_BINARY;
+  else if (name == "runhex")
+    format = RUN_FILE_HEX;
+  else if (name == "runbin")
+    format = RUN_FILE_BINARY;
+  else
+    return false;
+  return true;
+}
+
+gem::readout::GEMReadoutReplay::GEMReadoutReplay(std::string const& slotFile,
+                                                 std::string const& outFileName,
+                                                 std::string const& errFileName,
+                                                 std::string const& outputType) :
+  m_gemLogger(log4cplus::Logger::getInstance("GEMReadoutReplay")),
+  m_slotMap(GEMSlotMapService::getInstance().getSlotMap(slotFile)),
+  p_serializer(GEMEventSerializer::create(outputType)),
+  p_dqm(NULL),
+  m_rate(0.),
+  m_builder(&m_slotMap),
+  m_decode("decode"),
+  m_build("build"),
+  m_dqm("dqm"),
+  m_write("write")
+{
+  if (!outFileName.empty()) {
+    m_outFile.open(outFileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!m_outFile.is_open())
+      ERROR("GEMReadoutReplay unable to open " << outFileName << ", events will not be written");
+  }
+  if (!errFileName.empty()) {
+    m_errFile.open(errFileName.c_str(), std::ios::binary | std::ios::trunc);
+    if (!m_errFile.is_open())
+      ERROR("GEMReadoutReplay unable to open " << errFileName << ", error events will not be written");
+  }
+}
+
+gem::readout::GEMReadoutReplay::~GEMReadoutReplay()
+{
+}
+
+bool gem::readout::GEMReadoutReplay::load(std::string const& inFileName, InputFormat const& format)
+{
+  m_words.clear();
+  bool binary = (format == GLIB_DUMP_BINARY || format == RUN_FILE_BINARY);
+  std::ifstream inf(inFileName.c_str(), binary ? std::ios::binary : std::ios::in);
+  if (!inf.is_open()) {
+    ERROR("GEMReadoutReplay::load unable to open " << inFileName);
+    return false;
+  }
+
+  bool loaded = (format == GLIB_DUMP_HEX || format == GLIB_DUMP_BINARY) ?
+    loadGLIBDump(inf, binary) : loadRunFile(inf, binary);
+  INFO("GEMReadoutReplay::load " << m_words.size() << " tracking data words from " << inFileName);
+  return loaded;
+}
+
+bool gem::readout::GEMReadoutReplay::loadGLIBDump(std::ifstream& inf, bool const& binary)
+{
+  if (binary) {
+    uint32_t word;
+    while (inf.read(reinterpret_cast<char*>(&word), sizeof(word)))
+      m_words.push_back(word);
+  } else {
+    std::string token;
+    while (inf >> token)
+      m_words.push_back(strtoul(token.c_str(), NULL, 16) & 0xffffffff);
+  }
+  return true;
+}
+
+bool gem::readout::GEMReadoutReplay::loadRunFile(std::ifstream& inf, bool const& binary)
+{
+  std::vector<uint64_t> words;
+  if (binary) {
+    uint64_t word;
+    while (inf.read(reinterpret_cast<char*>(&word), sizeof(word)))
+      words.push_back(word);
+  } else {
+    std::string line;
+    while (std::getline(inf, line))
+      if (!line.empty())
+        words.push_back(strtoull(line.c_str(), NULL, 16));
+  }
+
+  // GEMEventSerializer layout, Bin events are wrapped in 3 AMC13 words ahead and 2 behind,
+  // Hex events have a run header after the GEB header and a BX word after each VFAT record,
+  // the VFAT records run up to the GEB trailer and decode to whole tracking data blocks
+  size_t nHeaders  = binary ? 7 : 5;
+  size_t gebOffset = binary ? 6 : 3;
+  size_t nTrailers = binary ? 5 : 3;
+  uint32_t block[GEMDataAMCformat::VFAT_BLOCK_WORDS];
+  for (size_t w = 0; w + nHeaders <= words.size(); w += nTrailers) {
+    uint64_t gebHeader = words[w + gebOffset];
+    w += nHeaders;
+    for (size_t index = 0; w < words.size(); ++index) {
+      GEMDataAMCformat::VFATData vfat;
+      size_t nUsed = GEMDataAMCformat::decodeVFATrecord(&words[w], words.size() - w, gebHeader, index, !binary, vfat);
+      if (!nUsed)
+        break;
+      GEMDataAMCformat::encodeVFATblock(vfat, block);
+      m_words.insert(m_words.end(), block, block + GEMDataAMCformat::VFAT_BLOCK_WORDS);
+      w += nUsed;
+    }
+  }
+  return true;
+}
+
+std::string gem::readout::GEMReadoutReplay::run(unsigned const& nPasses)
+{
+  m_nEvents     = 0;
+  m_nErrEvents  = 0;
+  m_nVFATs      = 0;
+  m_nDropped    = 0;
+  m_nMisaligned = 0;
+  m_decodeNsec  = 0;
+  m_buildNsec   = 0;
+  m_decode.reset();
+  m_build.reset();
+  m_dqm.reset();
+  m_write.reset();
+
+  timespec start, stop, t0, t1;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (unsigned pass = 0; pass < nPasses; ++pass) {
+    size_t pos = 0;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    while (pos + GEMDataAMCformat::VFAT_BLOCK_WORDS <= m_words.size()) {
+      GEMDataAMCformat::VFATData vfat;
+      if (!GEMDataAMCformat::decodeVFATblock(&m_words[pos], vfat)) {
+        // skipped words count as decode time of the next VFAT
+        ++pos;
+        ++m_nMisaligned;
+        continue;
+      }
+      pos += GEMDataAMCformat::VFAT_BLOCK_WORDS;
+      clock_gettime(CLOCK_MONOTONIC, &t1);
+      uint64_t decodeNsec = GEMStageStatistics::elapsedNanoseconds(t0, t1);
+
+      if (m_builder.startsNewEvent(vfat)) {
+        completeEvent();
+        throttle(start);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+      }
+      m_decodeNsec += decodeNsec;
+      if (!m_builder.add(vfat))
+        ++m_nDropped;
+      ++m_nVFATs;
+      clock_gettime(CLOCK_MONOTONIC, &t0);
+      m_buildNsec += GEMStageStatistics::elapsedNanoseconds(t1, t0);
+    }
+    if (m_builder.hasEvent())
+      completeEvent();
+  }
+  if (p_dqm)
+    p_dqm->drain();
+  m_outFile.flush();
+  m_errFile.flush();
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  uint64_t usec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+  uint64_t inputBytes = static_cast<uint64_t>(nPasses)*m_words.size()*sizeof(uint32_t);
+  std::stringstream res;
+  res << nPasses << " passes over " << m_words.size() << " words: "
+      << m_nEvents << " events, " << m_nErrEvents << " with VFATs in no known slot, "
+      << m_nVFATs << " VFATs, " << m_nDropped << " VFATs dropped, "
+      << m_nMisaligned << " misaligned words" << std::endl;
+  res << "total " << usec << "us";
+  if (usec > 0)
+    res << ", " << std::fixed << std::setprecision(0) << m_nEvents*1.e6/usec << " events/s, "
+        << std::setprecision(1) << inputBytes/static_cast<double>(usec) << " MB/s of tracking data";
+  if (m_rate > 0)
+    res << " (target " << std::setprecision(0) << m_rate << " events/s)";
+  res << std::endl
+      << m_decode.toString() << std::endl
+      << m_build.toString()  << std::endl;
+  if (p_dqm)
+    res << m_dqm.toString() << std::endl;
+  res << m_write.toString();
+  return res.str();
+}
+
+void gem::readout::GEMReadoutReplay::completeEvent()
+{
+  timespec start, stop;
+  GEMArenaGEB& geb    = m_builder.getGEB();
+  GEMArenaGEB& errGEB = m_builder.getErrorGEB();
+  size_t nVFATs = geb.vfats.size() + errGEB.vfats.size();
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  m_builder.complete(m_nEvents);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  m_buildNsec += GEMStageStatistics::elapsedNanoseconds(start, stop);
+
+  m_decode.record(m_decodeNsec, nVFATs, nVFATs*GEMDataAMCformat::VFAT_BLOCK_WORDS*sizeof(uint32_t));
+  m_build.record(m_buildNsec, 1, nVFATs*sizeof(GEMDataAMCformat::VFATData));
+  m_decodeNsec = 0;
+  m_buildNsec  = 0;
+
+  if (p_dqm && !geb.vfats.empty()) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    p_dqm->update(geb);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    m_dqm.record(GEMStageStatistics::elapsedNanoseconds(start, stop), 1,
+                 geb.vfats.size()*sizeof(GEMDataAMCformat::VFATData));
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  size_t nBytes = 0;
+  if (!geb.vfats.empty())
+    nBytes += writeEvent(m_outFile, m_builder.getEvent(), geb);
+  if (!errGEB.vfats.empty())
+    nBytes += writeEvent(m_errFile, m_builder.getErrorEvent(), errGEB);
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  m_write.record(GEMStageStatistics::elapsedNanoseconds(start, stop), 1, nBytes);
+
+  ++m_nEvents;
+  if (!errGEB.vfats.empty())
+    ++m_nErrEvents;
+  m_builder.release();
+}
+
+size_t gem::readout::GEMReadoutReplay::writeEvent(std::ofstream& outf, GEMArenaEvent const& gem,
+                                                  GEMArenaGEB const& geb)
+{
+  size_t needed = p_serializer->maxEventSize(geb.vfats.size());
+  if (m_buffer.size() < needed)
+    m_buffer.resize(needed);
+  size_t size = p_serializer->serialize(gem, geb, &m_buffer[0]);
+  if (outf.is_open())
+    outf.write(&m_buffer[0], size);
+  return size;
+}
+
+void gem::readout::GEMReadoutReplay::throttle(timespec const& start)
+{
+  if (m_rate <= 0)
+    return;
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  uint64_t due     = static_cast<uint64_t>(m_nEvents*1.e9/m_rate);
+  uint64_t elapsed = GEMStageStatistics::elapsedNanoseconds(start, now);
+  if (elapsed >= due)
+    return;
+  timespec wait;
+  wait.tv_sec  = (due - elapsed)/1000000000ULL;
+  wait.tv_nsec = (due - elapsed)%1000000000ULL;
+  nanosleep(&wait, NULL);
+}
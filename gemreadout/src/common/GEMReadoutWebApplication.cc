@@ -55,12 +55,3 @@ void gem::readout::GEMReadoutWebApplication::applicationPage(xgi::Input* in, xgi
   *out << "  <div class=\"xdaq-tab\" title=\"Application page\"/>"  << std::endl;
   *out << "  </div>" << std::endl;
 }
-
-void gem::readout::GEMReadoutWebApplication::jsonUpdate(xgi::Input* in, xgi::Output* out)
-  throw (xgi::exception::Exception)
-{
-  DEBUG("GEMReadoutWebApplication::jsonUpdate");
-  out->getHTTPResponseHeader().addHeader("Content-Type", "application/json");
-  *out << " { " << std::endl;
-  *out << " } " << std::endl;
-}
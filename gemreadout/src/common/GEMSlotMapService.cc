@@ -0,0 +1,222 @@
+/**
+ * class: GEMSlotMapService
+ * description: Process wide cache of the GEB slot tables, with lock free ChipID to slot lookups
+ */
+
+#include "gem/readout/GEMSlotMapService.h"
+
+#include <sys/stat.h>
+
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "toolbox/TimeVal.h"
+#include "toolbox/task/Timer.h"
+#include "toolbox/task/TimerEvent.h"
+#include "toolbox/task/TimerFactory.h"
+#include "toolbox/task/exception/Exception.h"
+
+#include "gem/utils/GEMLogging.h"
+#include "gem/utils/LockGuard.h"
+
+namespace {
+  const std::string SLOTMAP_TIMER_NAME = "GEMSlotMapService:watch";
+}
+
+gem::readout::GEMSlotTable::GEMSlotTable() :
+  m_nSlots(0),
+  m_nDuplicates(0),
+  m_valid(false)
+{
+  for (int slot = 0; slot < NSLOTS; ++slot)
+    m_chipID[slot] = NO_CHIP;
+  for (int id = 0; id < NCHIPIDS; ++id)
+    m_slotIndex[id] = -1;
+}
+
+bool gem::readout::GEMSlotTable::read(std::string const& path)
+{
+  std::ifstream ifile(path.c_str());
+  if (!ifile.is_open())
+    return false;
+
+  for (int row = 0; row < 3; ++row) {
+    std::string line;
+    std::getline(ifile, line);
+    std::istringstream iss(line);
+    if (!ifile.good())
+      break;
+    for (int col = 0; col < 8; ++col) {
+      std::string val;
+      std::getline(iss, val, ',');
+      std::stringstream convertor(val);
+      uint16_t chipID;
+      // an empty or malformed field leaves the slot empty, a failed extraction would store 0
+      if (!(convertor >> std::hex >> chipID))
+        chipID = NO_CHIP;
+      m_chipID[8*row+col] = chipID & 0x0fff;
+    }
+  }
+
+  // an empty slot must not claim ChipID 0xfff, and the last slot holding a chip wins, as it did
+  // for GEMslotContents
+  m_nSlots      = 0;
+  m_nDuplicates = 0;
+  for (int slot = 0; slot < NSLOTS; ++slot) {
+    if (m_chipID[slot] == NO_CHIP)
+      continue;
+    if (m_slotIndex[m_chipID[slot]] >= 0)
+      ++m_nDuplicates;
+    m_slotIndex[m_chipID[slot]] = slot;
+    ++m_nSlots;
+  }
+  m_valid = true;
+  return true;
+}
+
+gem::readout::GEMSlotMap::GEMSlotMap(std::string const& fileName, std::string const& path) :
+  m_fileName(fileName),
+  m_path(path),
+  m_mtime(0),
+  p_current(NULL)
+{
+  m_tables.push_back(new GEMSlotTable());
+  p_current = m_tables.back();
+}
+
+gem::readout::GEMSlotMap::~GEMSlotMap()
+{
+  for (auto table = m_tables.begin(); table != m_tables.end(); ++table)
+    delete *table;
+}
+
+gem::readout::GEMSlotMapService& gem::readout::GEMSlotMapService::getInstance()
+{
+  static GEMSlotMapService service;
+  return service;
+}
+
+gem::readout::GEMSlotMapService::GEMSlotMapService() :
+  m_gemLogger(log4cplus::Logger::getInstance("GEMSlotMapService")),
+  m_lock(toolbox::BSem::FULL, true),
+  p_timer(NULL)
+{
+}
+
+gem::readout::GEMSlotMapService::~GEMSlotMapService()
+{
+  stopWatching();
+  for (auto slotMap = m_maps.begin(); slotMap != m_maps.end(); ++slotMap)
+    delete slotMap->second;
+}
+
+gem::readout::GEMSlotMap const& gem::readout::GEMSlotMapService::getSlotMap(std::string const& slotFile)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  auto slotMap = m_maps.find(slotFile);
+  if (slotMap != m_maps.end())
+    return *(slotMap->second);
+
+  GEMSlotMap* newMap = new GEMSlotMap(slotFile, slotFilePath(slotFile));
+  m_maps[slotFile] = newMap;
+  if (!reload(*newMap))
+    WARN("GEMSlotMapService::getSlotMap unable to read " << newMap->m_path << ", all slots are empty");
+  return *newMap;
+}
+
+bool gem::readout::GEMSlotMapService::reload(std::string const& slotFile)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  auto slotMap = m_maps.find(slotFile);
+  if (slotMap == m_maps.end()) {
+    GEMSlotMap* newMap = new GEMSlotMap(slotFile, slotFilePath(slotFile));
+    m_maps[slotFile] = newMap;
+    return reload(*newMap);
+  }
+  return reload(*(slotMap->second));
+}
+
+bool gem::readout::GEMSlotMapService::reload(GEMSlotMap& slotMap)
+{
+  // called with m_lock held
+  time_t mtime = modificationTime(slotMap.m_path);
+  GEMSlotTable* table = new GEMSlotTable();
+  if (!table->read(slotMap.m_path)) {
+    delete table;
+    return false;
+  }
+
+  slotMap.m_tables.push_back(table);
+  slotMap.m_mtime = mtime;
+  // full barrier, the table is completely built before readers can see it
+  __sync_lock_test_and_set(&slotMap.p_current, table);
+  INFO("GEMSlotMapService::reload " << slotMap.m_path << ": " << table->numberOfSlots() << " occupied slots");
+  if (table->numberOfDuplicates() > 0)
+    WARN("GEMSlotMapService::reload " << slotMap.m_path << ": " << table->numberOfDuplicates()
+         << " ChipIDs are in more than one slot, the last of their slots is used");
+  return true;
+}
+
+unsigned gem::readout::GEMSlotMapService::reloadChanged()
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  unsigned nReloaded = 0;
+  for (auto slotMap = m_maps.begin(); slotMap != m_maps.end(); ++slotMap) {
+    time_t mtime = modificationTime(slotMap->second->m_path);
+    if (mtime == 0 || mtime == slotMap->second->m_mtime)
+      continue;
+    if (reload(*(slotMap->second)))
+      ++nReloaded;
+  }
+  return nReloaded;
+}
+
+void gem::readout::GEMSlotMapService::startWatching(toolbox::TimeInterval const& period)
+{
+  stopWatching();
+  if (toolbox::task::getTimerFactory()->hasTimer(SLOTMAP_TIMER_NAME))
+    p_timer = toolbox::task::getTimerFactory()->getTimer(SLOTMAP_TIMER_NAME);
+  else
+    p_timer = toolbox::task::getTimerFactory()->createTimer(SLOTMAP_TIMER_NAME);
+  p_timer->start();
+  p_timer->scheduleAtFixedRate(toolbox::TimeVal::gettimeofday(), this, period, 0, "GEMSlotMapServiceWatch");
+}
+
+void gem::readout::GEMSlotMapService::stopWatching()
+{
+  if (!p_timer)
+    return;
+  try {
+    p_timer->stop();
+  } catch (toolbox::task::exception::Exception const& ex) {
+    DEBUG("GEMSlotMapService::stopWatching timer was not active: " << ex.what());
+  }
+  p_timer = NULL;
+}
+
+void gem::readout::GEMSlotMapService::timeExpired(toolbox::task::TimerEvent& event)
+{
+  unsigned nReloaded = reloadChanged();
+  if (nReloaded)
+    INFO("GEMSlotMapService::timeExpired reloaded " << nReloaded << " changed slot tables");
+}
+
+std::string gem::readout::GEMSlotMapService::slotFilePath(std::string const& slotFile)
+{
+  char const* build_home     = std::getenv("BUILD_HOME");
+  char const* gem_os_project = std::getenv("GEM_OS_PROJECT");
+  std::string path = std::string(build_home ? build_home : "") + "/" + (gem_os_project ? gem_os_project : "");
+  path += "/gemreadout/data/";
+  path += slotFile;
+  return path;
+}
+
+time_t gem::readout::GEMSlotMapService::modificationTime(std::string const& path)
+{
+  struct stat info;
+  if (stat(path.c_str(), &info) != 0)
+    return 0;
+  return info.st_mtime;
+}
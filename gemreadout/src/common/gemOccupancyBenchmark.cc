@@ -0,0 +1,132 @@
+/**
+ * gemOccupancyBenchmark: adds the same random hit masks with GEMOccupancyAccumulator and with a loop
+ * over the 128 bits of each mask, and reports the throughput of both and whether their counts agree
+ *
+ * usage: gemOccupancyBenchmark [-n events] [-c chips] [-o occupancy]...
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "gem/readout/GEMOccupancyAccumulator.h"
+#include "gem/utils/GEMLatencyHistogram.h"
+
+namespace {
+  typedef gem::readout::GEMOccupancyAccumulator GEMOccupancyAccumulator;
+
+  /**
+   * @param nEvents number of masks per chip
+   * @param occupancy probability for each channel to have fired
+   * @param nDiffer set to the number of channel counts on which they disagree
+   * @returns the throughput of both and nDiffer
+   */
+  std::string benchmark(unsigned const& nEvents, double const& occupancy, unsigned const& nChips,
+                        unsigned& nDiffer)
+  {
+    const int      NCHANNELS = GEMOccupancyAccumulator::NCHANNELS;
+    const unsigned NMASKS    = 1024;
+    std::vector<uint64_t> masks(2*NMASKS, 0);
+    unsigned seed = 12345;
+    for (unsigned m = 0; m < NMASKS; ++m)
+      for (int chan = 0; chan < NCHANNELS; ++chan)
+        if (rand_r(&seed) < occupancy*RAND_MAX)
+          masks[2*m + chan/64] |= 0x1ULL << (chan%64);
+
+    GEMOccupancyAccumulator acc(nChips);
+    timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned event = 0; event < nEvents; ++event)
+      for (unsigned chip = 0; chip < nChips; ++chip) {
+        unsigned m = (event + chip)%NMASKS;
+        acc.add(chip, masks[2*m], masks[2*m+1]);
+      }
+    for (unsigned chip = 0; chip < nChips; ++chip)
+      acc.getChannelCounts(chip);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    uint64_t slicedUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+
+    std::vector<uint64_t> reference(nChips*NCHANNELS, 0);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (unsigned event = 0; event < nEvents; ++event)
+      for (unsigned chip = 0; chip < nChips; ++chip) {
+        unsigned m = (event + chip)%NMASKS;
+        uint64_t words[2] = {masks[2*m], masks[2*m+1]};
+        for (int chan = 0; chan < NCHANNELS; ++chan)
+          if ((words[chan/64] >> (chan%64)) & 0x1)
+            ++reference[chip*NCHANNELS + chan];
+      }
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    uint64_t loopUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+
+    nDiffer = 0;
+    for (unsigned chip = 0; chip < nChips; ++chip) {
+      uint64_t const* counts = acc.getChannelCounts(chip);
+      for (int chan = 0; chan < NCHANNELS; ++chan)
+        if (counts[chan] != reference[chip*NCHANNELS + chan])
+          ++nDiffer;
+    }
+
+    uint64_t nMasks = static_cast<uint64_t>(nEvents)*nChips;
+    std::stringstream stats;
+    stats << nMasks << " masks at occupancy " << occupancy << ": "
+          << "bit-sliced " << slicedUsec << "us, per bit loop " << loopUsec << "us, "
+          << nDiffer << " channel counts differ";
+    if (slicedUsec > 0)
+      stats << " (" << std::fixed << std::setprecision(0) << nMasks*1.e6/slicedUsec << " masks/s, speedup "
+            << std::setprecision(1) << static_cast<double>(loopUsec)/slicedUsec << ")";
+    return stats.str();
+  }
+
+  void usage(char const* name)
+  {
+    std::cerr << "usage: " << name << " [-n events] [-c chips] [-o occupancy]..." << std::endl
+              << "  -n  number of masks per chip (default 100000)" << std::endl
+              << "  -c  number of chips (default 24)" << std::endl
+              << "  -o  probability for each channel to have fired, may be repeated (default 0.01 0.05 0.2)"
+              << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  unsigned            nEvents = 100000;
+  unsigned            nChips  = 24;
+  std::vector<double> occupancies;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "n:c:o:h")) != -1) {
+    switch (opt) {
+    case 'n': nEvents = atoi(optarg);                  break;
+    case 'c': nChips  = atoi(optarg);                  break;
+    case 'o': occupancies.push_back(atof(optarg));     break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (occupancies.empty()) {
+    occupancies.push_back(0.01);
+    occupancies.push_back(0.05);
+    occupancies.push_back(0.2);
+  }
+
+  unsigned nDiffer = 0;
+  for (auto occupancy = occupancies.begin(); occupancy != occupancies.end(); ++occupancy) {
+    unsigned nDifferAt;
+    std::cout << benchmark(nEvents, *occupancy, nChips, nDifferAt) << std::endl;
+    nDiffer += nDifferAt;
+  }
+  return nDiffer ? 1 : 0;
+}
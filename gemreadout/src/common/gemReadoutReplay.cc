@@ -0,0 +1,265 @@
+/**
+ * gemReadoutReplay: replays recorded GLIB tracking data or run files through the readout stages
+ * and reports the throughput and latency of each stage, with no hardware and no xDAQ services
+ *
+ * usage: gemReadoutReplay [-f glibhex|glibbin|runhex|runbin] [-s slotFile] [-o outFile] [-e errFile]
+ *                         [-t Hex|Bin] [-z] [-r eventsPerSecond] [-n passes] [-d] [-w dqmWorkers]
+ *                         [-b] [-p dqmFile] [-g renderSeconds] [-c] inputFile
+ *
+ * slot files are looked up in $BUILD_HOME/$GEM_OS_PROJECT/gemreadout/data/, as for the readout
+ * -c needs the GEMClusterizer of gem-light-dqm, it is only built with make GEM_LIGHT_DQM=<checkout>
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "log4cplus/configurator.h"
+
+#include "toolbox/TimeInterval.h"
+
+#include "gem/readout/GEMReadoutReplay.h"
+#include "gem/readout/gemOnlineDQM.h"
+#ifdef GEM_CLUSTER_CROSSCHECK
+#include "GEMClusterization/GEMStrip.h"
+#include "GEMClusterization/GEMStripCollection.h"
+#include "GEMClusterization/GEMClusterContainer.h"
+#include "GEMClusterization/GEMClusterizer.h"
+#endif
+
+namespace {
+#ifdef GEM_CLUSTER_CROSSCHECK
+  /**
+   * Clusterizes the eta partitions of the replayed GEBs with GEMBitmaskClusterizer, as the online DQM
+   * does, and with GEMClusterizer, times both and counts the partitions on which they disagree
+   */
+  class ClusterCrossCheck
+  {
+  public:
+    ClusterCrossCheck() :
+      m_nMasks(0), m_nDiffer(0), m_nBitmask(0), m_nReference(0), m_bitmaskNsec(0), m_referenceNsec(0) {};
+
+    void check(gem::readout::gemOnlineDQM const& dqm, gem::readout::GEMArenaGEB const& geb)
+    {
+      dqm.etaMasks(geb, m_masks);
+      for (int ieta = 0; ieta < 8; ++ieta) {
+        if (m_masks[ieta].empty())
+          continue;
+        timespec t0, t1, t2;
+        clock_gettime(CLOCK_MONOTONIC, &t0);
+        int n = gem::readout::GEMBitmaskClusterizer::clusterize(m_masks[ieta], m_clusters);
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        GEMStripCollection strips;
+        for (int strip = 0; strip < gem::readout::GEMStripMask::NSTRIPS; ++strip)
+          if (m_masks[ieta].test(strip))
+            strips.insert(GEMStrip(strip,0));  // bx set to 0...
+        GEMClusterizer clizer;
+        GEMClusterContainer ref = clizer.doAction(strips);
+        clock_gettime(CLOCK_MONOTONIC, &t2);
+        m_bitmaskNsec   += gem::readout::GEMStageStatistics::elapsedNanoseconds(t0, t1);
+        m_referenceNsec += gem::readout::GEMStageStatistics::elapsedNanoseconds(t1, t2);
+        m_nBitmask      += n;
+        m_nReference    += ref.size();
+        ++m_nMasks;
+
+        // same number of clusters with the same sizes
+        std::vector<int> refSizes, sizes;
+        for (GEMClusterContainer::iterator icl = ref.begin(); icl != ref.end(); ++icl)
+          refSizes.push_back(icl->clusterSize());
+        for (int icl = 0; icl < n; ++icl)
+          sizes.push_back(m_clusters[icl].size);
+        std::sort(refSizes.begin(), refSizes.end());
+        std::sort(sizes.begin(), sizes.end());
+        if (refSizes != sizes)
+          ++m_nDiffer;
+      }
+    };
+
+    std::string getStatistics() const
+    {
+      std::stringstream stats;
+      stats << "cluster cross check: " << m_nMasks << " eta partitions, " << m_nDiffer << " differ, "
+            << "GEMBitmaskClusterizer " << m_nBitmask << " clusters in " << m_bitmaskNsec/1000 << "us, "
+            << "GEMClusterizer " << m_nReference << " clusters in " << m_referenceNsec/1000 << "us";
+      if (m_bitmaskNsec > 0)
+        stats << " (speedup " << std::fixed << std::setprecision(1)
+              << static_cast<double>(m_referenceNsec)/m_bitmaskNsec << ")";
+      return stats.str();
+    };
+
+  private:
+    gem::readout::GEMStripMask      m_masks[8];
+    gem::readout::GEMBitmaskCluster m_clusters[gem::readout::GEMBitmaskClusterizer::MAX_CLUSTERS];
+
+    uint64_t m_nMasks;
+    uint64_t m_nDiffer;
+    uint64_t m_nBitmask;
+    uint64_t m_nReference;
+    uint64_t m_bitmaskNsec;
+    uint64_t m_referenceNsec;
+  };
+#else
+  /**
+   * Built without gem-light-dqm, main refuses -c so this is never created
+   */
+  class ClusterCrossCheck
+  {
+  public:
+    void check(gem::readout::gemOnlineDQM const& dqm, gem::readout::GEMArenaGEB const& geb) {};
+    std::string getStatistics() const { return ""; };
+  };
+#endif
+
+  class OnlineDQMStage : public gem::readout::GEMReplayDQM
+  {
+  public:
+    OnlineDQMStage(std::string const& slotFile, unsigned const& nWorkers, bool const& wait, bool const& crossCheck) :
+      m_dqm(slotFile, "gemReadoutReplay", nWorkers),
+      p_crossCheck(crossCheck ? new ClusterCrossCheck() : 0)
+    {
+      m_dqm.setWaitWhenFull(wait);
+    };
+
+    void update(gem::readout::GEMArenaGEB const& geb)
+    {
+      if (p_crossCheck)
+        p_crossCheck->check(m_dqm, geb);
+      m_dqm.Update(geb);
+    };
+    void drain() { m_dqm.drain(); };
+
+    gem::readout::gemOnlineDQM& get() { return m_dqm; };
+
+    ClusterCrossCheck const* getCrossCheck() const { return p_crossCheck.get(); };
+
+  private:
+    gem::readout::gemOnlineDQM         m_dqm;
+    std::unique_ptr<ClusterCrossCheck> p_crossCheck;
+  };
+
+  void usage(char const* name)
+  {
+    std::cerr << "usage: " << name << " [-f glibhex|glibbin|runhex|runbin] [-s slotFile] [-o outFile] [-e errFile]"
+              << std::endl
+              << "       [-t Hex|Bin] [-z] [-r eventsPerSecond] [-n passes] [-d] [-w dqmWorkers] [-b]" << std::endl
+              << "       [-p dqmFile] [-g renderSeconds] [-c] inputFile"
+              << std::endl
+              << "  -f  input format, GLIB tracking data dump or run file (default glibhex)" << std::endl
+              << "  -s  slot table (default slot_table.csv)" << std::endl
+              << "  -o  output run file, events are only serialised if not given" << std::endl
+              << "  -e  output file for the events of VFATs in no known slot" << std::endl
+              << "  -t  output format (default Bin)" << std::endl
+              << "  -z  write zero suppressed VFAT records" << std::endl
+              << "  -r  target event rate, 0 for as fast as possible (default 0)" << std::endl
+              << "  -n  number of passes over the input (default 1)" << std::endl
+              << "  -d  fill the online DQM histograms" << std::endl
+              << "  -w  number of DQM filling workers, 0 to fill on the replay thread (default 0)" << std::endl
+              << "  -b  wait for the DQM workers when their queues are full, rather than drop GEBs" << std::endl
+              << "  -p  ROOT file the DQM histograms are saved to" << std::endl
+              << "  -g  render the changed DQM plots to ./temp_plots/ every renderSeconds while replaying" << std::endl
+              << "  -c  cross check the DQM clusters against GEMClusterizer, timed with the DQM stage,"
+              << " needs a build with GEM_LIGHT_DQM" << std::endl;
+  }
+}
+
+int main(int argc, char** argv)
+{
+  std::string format     = "glibhex";
+  std::string slotFile   = "slot_table.csv";
+  std::string outFile    = "";
+  std::string errFile    = "";
+  std::string outputType = "Bin";
+  std::string dqmFile    = "";
+  double      rate       = 0.;
+  unsigned    nPasses    = 1;
+  bool        withDQM    = false;
+  bool        zs         = false;
+  unsigned    nWorkers   = 0;
+  unsigned    renderSec  = 0;
+  bool        crossCheck = false;
+  bool        waitDQM    = false;
+
+  int opt;
+  while ((opt = getopt(argc, argv, "f:s:o:e:t:zr:n:dw:bp:g:ch")) != -1) {
+    switch (opt) {
+    case 'f': format     = optarg;               break;
+    case 's': slotFile   = optarg;               break;
+    case 'o': outFile    = optarg;               break;
+    case 'e': errFile    = optarg;               break;
+    case 't': outputType = optarg;               break;
+    case 'z': zs         = true;                 break;
+    case 'r': rate       = atof(optarg);         break;
+    case 'n': nPasses    = atoi(optarg);         break;
+    case 'd': withDQM    = true;                 break;
+    case 'w': nWorkers   = atoi(optarg);
+              withDQM    = true;                 break;
+    case 'b': waitDQM    = true;
+              withDQM    = true;                 break;
+    case 'p': dqmFile    = optarg;
+              withDQM    = true;                 break;
+    case 'g': renderSec  = atoi(optarg);
+              withDQM    = true;                 break;
+    case 'c': crossCheck = true;
+              withDQM    = true;                 break;
+    default:
+      usage(argv[0]);
+      return opt == 'h' ? 0 : 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+#ifndef GEM_CLUSTER_CROSSCHECK
+  if (crossCheck) {
+    std::cerr << "-c needs gemReadoutReplay built with make GEM_LIGHT_DQM=<gem-light-dqm checkout>" << std::endl;
+    return 1;
+  }
+#endif
+
+  gem::readout::GEMReadoutReplay::InputFormat inputFormat;
+  if (!gem::readout::GEMReadoutReplay::parseInputFormat(format, inputFormat)) {
+    std::cerr << "unknown input format " << format << std::endl;
+    usage(argv[0]);
+    return 1;
+  }
+
+  log4cplus::BasicConfigurator logConfig;
+  logConfig.configure();
+
+  gem::readout::GEMReadoutReplay replay(slotFile, outFile, errFile, outputType);
+  if (!replay.load(argv[optind], inputFormat))
+    return 1;
+
+  std::unique_ptr<OnlineDQMStage> dqm;
+  if (withDQM) {
+    dqm = std::unique_ptr<OnlineDQMStage>(new OnlineDQMStage(slotFile, nWorkers, waitDQM, crossCheck));
+    replay.setDQM(dqm.get());
+  }
+  replay.setRate(rate);
+  replay.setZeroSuppression(zs);
+  if (dqm && renderSec > 0)
+    dqm->get().startRendering(toolbox::TimeInterval(renderSec, 0));
+
+  std::cout << replay.run(nPasses) << std::endl;
+  if (dqm) {
+    if (renderSec > 0) {
+      dqm->get().stopRendering();
+      dqm->get().render();  // the entries filled since the last period
+    }
+    std::cout << dqm->get().getStatistics() << std::endl;
+    if (dqm->getCrossCheck())
+      std::cout << dqm->getCrossCheck()->getStatistics() << std::endl;
+    if (!dqmFile.empty())
+      dqm->get().save(dqmFile);
+  }
+  return 0;
+}
@@ -1,9 +1,17 @@
+// sequence number of the last update received, after the first full update only changes are requested
+var jsonSequence = 0;
+
 function sendrequest( jsonurl )
 {
+    if (jsonSequence > 0)
+        jsonurl = jsonurl + "?since=" + jsonSequence;
+
     if (window.jQuery) {
         // can use jQuery libraries rather than raw javascript
         $.getJSON(jsonurl)
             .done(function(data) {
+                    if ("jsonSequence" in data)
+                        jsonSequence = data.jsonSequence;
                     updateStatePage( data );
                 })
             .fail(function(data, textStatus, error) {
@@ -20,6 +28,8 @@ function sendrequest( jsonurl )
             {
                 if (xmlhttp.readyState==4 && xmlhttp.status==200) {
                     var res = eval( "(" + xmlhttp.responseText + ")" );
+                    if ("jsonSequence" in res)
+                        jsonSequence = res.jsonSequence;
                     updateStatePage( res );
                 }
             };
@@ -33,6 +43,8 @@ function updateStatePage( statejson )
     //console.log("statejson:"+statejson);
     for ( var set in statejson ) {
         //console.log("set:"+set);
+        if (set == "jsonSequence")
+            continue;
         var arr = statejson[set];
         //console.log("statejson[set]:"+statejson[set]);
         for( var i=0; i<arr.length; i++ ) {
@@ -7,6 +7,7 @@
 #include <string>
 #include <memory>
 
+#include "toolbox/BSem.h"
 #include "toolbox/task/TimerListener.h"
 #include "toolbox/fsm/FiniteStateMachine.h"
 
@@ -37,6 +38,7 @@ namespace gem {
     private:
       friend class GEMGlobalState;
       xoap::MessageReference updateMsg;
+      uint64_t updateCount;  // incremented on every change, lets a poll detect a concurrent push
     };
 
     /**
@@ -60,11 +62,18 @@ namespace gem {
      *   - else if any application is in STATE_PAUSED,       global state is STATE_PAUSED
      *   - else if any application is in STATE_CONFIGURED,   global state is STATE_CONFIGURED
      *   - else if all applications are in STATE_RUNNING,    global state is STATE_RUNNING
+     *
+     *   Applications push their state changes (see GEMFSM::notifySupervisor), and the global state
+     *   is recomputed from a count of applications per state on each notification.
+     *   The applications are only polled by a watchdog every WATCHDOG_SEC seconds,
+     *   and by waitForChange when no change has been pushed for WAIT_MSEC milliseconds.
      */
     class GEMGlobalState : public toolbox::task::TimerListener
       {
       public:
         // static const toolbox::fsm::State STATE_NULL = 0;
+        static const unsigned WATCHDOG_SEC = 10;
+        static const unsigned WAIT_MSEC    = 1000;
 
         GEMGlobalState(xdaq::ApplicationContext* context, GEMSupervisor* gemSupervisor);
 
@@ -82,10 +91,26 @@ namespace gem {
         void clear();
 
         /**
-         * @brief updates the global state based on the individual states of the managed applications
+         * @brief polls all managed applications for their state and updates the global state
          */
         void update();
 
+        /**
+         * @brief records a state change pushed by an application, and updates the global state
+         * @param className the class name of the application
+         * @param instance the instance number of the application
+         * @param stateName the new state of the application
+         * @param reason the state message of the application
+         */
+        void applicationStateChanged(std::string const& className, uint32_t const& instance,
+                                     std::string const& stateName, std::string const& reason);
+
+        /**
+         * @brief blocks until the global state changes, or at most WAIT_MSEC milliseconds,
+         *        after which the applications are polled, in case some do not push their state
+         */
+        void waitForChange();
+
         /**
          * @brief starts the update timer
          */
@@ -128,16 +153,37 @@ namespace gem {
 
       private:
         /**
-         * @brief updates the stored application state
+         * @brief queries the state of an application, does not modify the stored state
          * @param app is the application descriptor
+         * @param request is the state request message for the application
+         * @param state is set to the state of the application
+         * @param message is set to the state message of the application
+         * @returns false if the reply could not be interpreted, and the stored state should be kept
+         */
+        bool queryApplication(xdaq::ApplicationDescriptor* app, xoap::MessageReference const& request,
+                              toolbox::fsm::State& state, std::string& message);
+
+        /**
+         * @brief updates the stored application state and the per state counts, m_mutex must be held
          */
-        void updateApplication(xdaq::ApplicationDescriptor* app);
+        void setApplicationState(ApplicationMap::iterator app, toolbox::fsm::State const& state,
+                                 std::string const& message);
 
         /**
-         * @brief updates the global state based on the individual states of the managed applications
+         * @brief updates the global state from the per state counts, m_mutex must be held
          */
         void calculateGlobals();
 
+        /**
+         * @brief recomputes the global state and reports a change to the supervisor, m_mutex must be held
+         */
+        void publishGlobals();
+
+        /**
+         * @returns the state corresponding to a state name reported by an application, STATE_NULL if unknown
+         */
+        static toolbox::fsm::State parseStateName(std::string const& stateName);
+
         // std::shared_ptr<toolbox::task::Timer> p_timer;
         // std::shared_ptr<GEMSupervisor>        p_gemSupervisor;
         toolbox::task::Timer* p_timer;
@@ -151,6 +197,10 @@ namespace gem {
         toolbox::fsm::State m_globalState, m_forceGlobal;
         log4cplus::Logger m_gemLogger;
         mutable gem::utils::Lock m_mutex;
+
+        std::map<toolbox::fsm::State, unsigned> m_stateCounts;  // number of applications in each state
+        uint64_t      m_nChanges;  // number of global state changes
+        toolbox::BSem m_changed;   // given on every global state change
       };
   }  // namespace supervisor
 }  // namespace gem
@@ -3,6 +3,8 @@
 #ifndef GEM_SUPERVISOR_GEMSUPERVISOR_H
 #define GEM_SUPERVISOR_GEMSUPERVISOR_H
 
+#include <time.h>
+
 #include <string>
 #include <vector>
 
@@ -10,6 +12,8 @@
 
 #include "xdaq2rc/RcmsStateNotifier.h"
 
+#include "toolbox/BSem.h"
+
 #include "gem/base/GEMFSMApplication.h"
 #include "gem/utils/Lock.h"
 #include "gem/utils/LockGuard.h"
@@ -18,6 +22,13 @@
 #include "gem/supervisor/GEMGlobalState.h"
 #include "gem/supervisor/exception/Exception.h"
 
+namespace toolbox {
+  namespace task {
+    class WorkLoop;
+    class ActionSignature;
+  }
+}
+
 namespace gem {
   namespace supervisor {
 
@@ -64,6 +75,13 @@ namespace gem {
 	xoap::MessageReference EndScanPoint(xoap::MessageReference mns)
 	  throw (xoap::exception::Exception);
 
+        /**
+         * @brief SOAP callback receiving the state changes pushed by the supervised applications
+         * @param msg StateNotification message, see GEMSOAPToolBox::sendStateNotification
+         */
+        xoap::MessageReference StateNotification(xoap::MessageReference msg)
+          throw (xoap::exception::Exception);
+
         std::vector<xdaq::ApplicationDescriptor*> getSupervisedAppDescriptors() {
           return v_supervisedApps; };
 
@@ -76,6 +94,42 @@ namespace gem {
           return m_stateName.toString();
           };*/
       private:
+        /**
+         * Run parameters that can be sent to the supervised applications ahead of a command
+         */
+        enum RunParameters { PARAM_CFGTYPE   = 0x1,
+                             PARAM_RUNTYPE   = 0x2,
+                             PARAM_RUNNUMBER = 0x4,
+                             PARAM_SCANINFO  = 0x8
+        };
+
+        /**
+         * @brief Sends the run parameters and the command to the supervised applications, one class
+         *        of applications after the other, in the order the classes were found by init
+         *        All applications of a class are commanded concurrently, each is served by its own workloop,
+         *        the replies are collected as they arrive, and an application that has not replied within
+         *        SOAPTimeoutMSec of its dispatch is reported as timed out without holding up the others
+         *        of its class, the following classes are not commanded if any application failed
+         * @param command the FSM command to send, e.g., "Configure"
+         * @param parameters the RunParameters to send before the command
+         * @throws gem::supervisor::exception::Exception listing the applications that failed or timed out
+         */
+        void sendToSupervisedApps(std::string const& command, uint32_t const& parameters=0)
+          throw (gem::supervisor::exception::Exception);
+
+        /**
+         * Workloop action, sends the queued parameters and command to one supervised application,
+         * GEM applications receive both in a single TransitionWithParameters message
+         * @returns false, each submission handles exactly one command
+         */
+        bool runSOAPJob(toolbox::task::WorkLoop* wl);
+
+        /**
+         * @param abandoned number of workloops of the application already given up on after a timeout
+         * @returns the activated workloop serving the SOAP commands to the application
+         */
+        toolbox::task::WorkLoop* getSOAPWorkLoop(xdaq::ApplicationDescriptor* ad, unsigned const& abandoned);
+
         /**
          * @param classname is the class to check to see whether it is a GEMApplication inherited application
          * @throws
@@ -125,6 +179,12 @@ namespace gem {
         void sendRunNumber(int64_t const& runNumber, xdaq::ApplicationDescriptor* ad)
           throw (gem::supervisor::exception::Exception);
 
+        /**
+         * @param parameters the RunParameters to collect
+         * @returns the selected run parameters in the form expected by GEMSOAPToolBox::sendCommandWithParameters
+         */
+        std::vector<std::vector<std::string> > getRunParameters(uint32_t const& parameters);
+
         std::shared_ptr<GEMSupervisorMonitor> m_supervisorMonitor;
 
         mutable gem::utils::Lock m_deviceLock;
@@ -157,6 +217,24 @@ namespace gem {
         xdata::String              m_rcmsStateListenerUrl;
         xdaq2rc::RcmsStateNotifier m_gemRCMSNotifier;
 
+        typedef struct {
+          xdaq::ApplicationDescriptor* app;
+          toolbox::task::WorkLoop*     workloop;
+          std::string                  command;
+          uint32_t                     parameters;
+          bool                         busy;    // queued or running in the workloop
+          unsigned                     stage;   // commanded after all applications of lower stages
+          unsigned                     abandoned;  // workloops left blocked by a timed out command
+          bool                         failed;
+          std::string                  error;
+          timespec                     dispatched;
+        } SOAPJob;
+
+        xdata::UnsignedInteger32        m_soapTimeout;  // per application, in milliseconds
+        gem::utils::Lock                m_soapLock;     // protects m_soapJobs
+        toolbox::BSem                   m_soapReply;    // given by a workloop each time an application replies
+        std::vector<SOAPJob>            m_soapJobs;     // one per supervised application
+        toolbox::task::ActionSignature* p_soapJobSig;
       };
   }  // namespace gem::supervisor
 }  // namespace gem
@@ -143,6 +143,16 @@ namespace gem {
             throw (xgi::exception::Exception);
           void redirect(xgi::Input* in, xgi::Output* out);
 
+          /**
+           * Fits the scan histogram and saves it as a PNG, done once at the end of the scan
+           */
+          void writeScanImage();
+
+          /**
+           * @returns the ADC samples read per second of acquisition time in the current scan
+           */
+          double getSamplesPerSecond() const;
+
           //action performed callback
           void actionPerformed(xdata::Event& event);
 
@@ -196,6 +206,9 @@ namespace gem {
           uint8_t  curDACRegValue;
           uint32_t curDACValue;
           uint64_t stepSize_, samplesTaken_;
+          uint64_t totalSamples_, acquisitionUsec_;
+          uint64_t skippedPoints_;  // DAC points whose samples could not be read
+          timespec scanStart_;
           bool is_working_, is_initialized_, is_configured_, is_running_;
 	  vfat_shared_ptr vfatDevice_;
 
@@ -0,0 +1,175 @@
+/** @file GEMSCurveFitter.h */
+
+#ifndef GEM_SUPERVISOR_TBUTILS_GEMSCURVEFITTER_H
+#define GEM_SUPERVISOR_TBUTILS_GEMSCURVEFITTER_H
+
+#include <stdint.h>
+
+#include <string>
+#include <vector>
+
+#include "log4cplus/logger.h"
+
+#include "toolbox/BSem.h"
+#include "toolbox/lang/Class.h"
+
+#include "gem/utils/GEMLatencyHistogram.h"
+#include "gem/utils/Lock.h"
+
+namespace toolbox {
+  namespace task {
+    class WorkLoop;
+    class ActionSignature;
+  }
+}
+
+namespace gem {
+  namespace supervisor {
+    namespace tbutils {
+
+      /**
+       * @class GEMSCurveFitter
+       * @brief Fits error function S-curves to the occupancy of many channels in parallel
+       *
+       * The occupancy of a channel as a function of the scanned register (threshold, calibration
+       * pulse height, ...) is modelled as
+       *   f(x) = A/2 * (1 + erf(s*(x - mu)/(sqrt(2)*sigma)))
+       * where s = +1 for a rising and -1 for a falling curve, mu is the threshold and sigma the noise.
+       * The starting point comes from the moments of the discrete derivative of the curve, and
+       * is refined with a three parameter Levenberg-Marquardt minimisation of the binomial chi2.
+       * A fit allocates nothing and works directly on the raw hit counts.
+       *
+       * fitAll() splits the curves over a pool of waiting workloops and returns once all are done.
+       */
+      class GEMSCurveFitter : public toolbox::lang::Class
+      {
+      public:
+        static const unsigned MAX_WORKERS    = 16;
+        static const unsigned MAX_ITERATIONS = 100;
+        static const unsigned MIN_POINTS     = 4;    ///< fewer points than this are not fitted
+        static const double   MAX_CHI2_NDF;          ///< fits above this are flagged FIT_BAD_CHI2
+
+        enum FitStatus {
+          FIT_OK            = 0,
+          FIT_NO_DATA       = 1,  ///< too few points or no triggers
+          FIT_NO_TRANSITION = 2,  ///< the curve is flat, there is nothing to fit
+          FIT_NOT_CONVERGED = 3,  ///< MAX_ITERATIONS reached
+          FIT_OUT_OF_RANGE  = 4,  ///< the threshold lies outside the scanned range
+          FIT_BAD_CHI2      = 5,  ///< chi2/ndf above MAX_CHI2_NDF
+          N_FIT_STATUS      = 6
+        };
+
+        typedef struct SCurveFit {
+          double    threshold;   ///< mu, in units of the scanned register
+          double    noise;       ///< sigma, in units of the scanned register
+          double    amplitude;   ///< plateau occupancy
+          double    chi2;
+          unsigned  ndf;
+          unsigned  iterations;
+          bool      rising;      ///< true if the occupancy increases with the scanned register
+          FitStatus status;
+        } SCurveFit;
+
+        /**
+         * @param name unique name, used to build the names of the worker workloops
+         * @param nWorkers number of workloops to fit with, 0 uses one per online CPU (up to MAX_WORKERS)
+         */
+        GEMSCurveFitter(std::string const& name, unsigned const& nWorkers=0);
+
+        ~GEMSCurveFitter();
+
+        /**
+         * @brief fit all curves in parallel, blocks until every curve is fitted
+         * @param x the scanned values, common to all curves
+         * @param hits hit counts of all curves, curve i occupies hits[i*x.size()] to hits[(i+1)*x.size()-1]
+         * @param nTriggers triggers sent at each point
+         * @param fits resized to the number of curves and filled with the fit results
+         */
+        void fitAll(std::vector<double> const& x, std::vector<uint32_t> const& hits,
+                    uint32_t const& nTriggers, std::vector<SCurveFit>& fits);
+
+        /**
+         * @returns a human readable summary of the last fitAll: number of fits, wall time,
+         *          fits per second, time per fit and the number of fits with each status
+         */
+        std::string getStatistics() const;
+
+        /**
+         * @returns the time taken by each fit of the last fitAll
+         */
+        gem::utils::GEMLatencyHistogram const& getFitTimes() const { return m_fitTimes; };
+
+        /**
+         * @brief fit a single S-curve
+         * @param x the scanned values, in increasing order
+         * @param hits the hit count at each point
+         * @param nPoints number of points
+         * @param nTriggers triggers sent at each point
+         */
+        static SCurveFit fit(double const* x, uint32_t const* hits, size_t const& nPoints,
+                             uint32_t const& nTriggers);
+
+        static std::string statusName(FitStatus const& status);
+
+      private:
+        // Prevent copying.
+        GEMSCurveFitter(GEMSCurveFitter const&);
+        GEMSCurveFitter& operator=(GEMSCurveFitter const&);
+
+        /**
+         * Workloop action, fits the range of curves assigned to the calling workloop
+         * @returns false, each submission handles exactly one range
+         */
+        bool fitRange(toolbox::task::WorkLoop* wl);
+
+        /**
+         * @returns the binomial chi2 of the model with parameters (amplitude, mu, sigma)
+         */
+        static double chi2(double const* x, uint32_t const* hits, size_t const& nPoints,
+                           uint32_t const& nTriggers, double const* par, double const& sign);
+
+        /**
+         * @brief occupancy of a point and its inverse variance, (hits+1)/(nTriggers+2) is used
+         *        for the variance so that empty and full points keep a finite weight
+         */
+        static void occupancy(uint32_t const& hits, uint32_t const& nTriggers, double& y, double& w);
+
+        /**
+         * Solves the 3x3 linear system m*solution = v by Gaussian elimination with partial pivoting
+         * @returns false if the system is singular
+         */
+        static bool solve3(double m[3][3], double v[3], double solution[3]);
+
+        typedef struct Worker {
+          toolbox::task::WorkLoop*        workloop;
+          size_t                          first;
+          size_t                          last;
+          gem::utils::GEMLatencyHistogram fitTimes;
+        } Worker;
+
+        log4cplus::Logger m_gemLogger;
+        gem::utils::Lock  m_lock;       ///< held by fitAll for the whole job
+        gem::utils::Lock  m_doneLock;   ///< guards m_nDone
+        toolbox::BSem     m_rangeDone;  ///< wakes up fitAll, the finished ranges are counted in m_nDone
+        unsigned          m_nDone;
+
+        std::vector<Worker>             m_workers;
+        toolbox::task::ActionSignature* p_fitSig;
+
+        // the job being fitted, only valid during fitAll
+        double const*   p_x;
+        uint32_t const* p_hits;
+        SCurveFit*      p_fits;
+        size_t          m_nPoints;
+        uint32_t        m_nTriggers;
+
+        gem::utils::GEMLatencyHistogram m_fitTimes;
+        uint64_t m_wallUsec;
+        size_t   m_nFits;
+        size_t   m_statusCount[N_FIT_STATUS];
+      };
+    }  // namespace gem::supervisor::tbutils
+  }  // namespace gem::supervisor
+}  // namespace gem
+
+#endif  // GEM_SUPERVISOR_TBUTILS_GEMSCURVEFITTER_H
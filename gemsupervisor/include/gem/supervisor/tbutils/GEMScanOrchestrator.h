@@ -0,0 +1,158 @@
+/** @file GEMScanOrchestrator.h */
+
+#ifndef GEM_SUPERVISOR_TBUTILS_GEMSCANORCHESTRATOR_H
+#define GEM_SUPERVISOR_TBUTILS_GEMSCANORCHESTRATOR_H
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log4cplus/logger.h"
+
+#include "toolbox/BSem.h"
+#include "toolbox/lang/Class.h"
+
+#include "gem/utils/Lock.h"
+
+namespace toolbox {
+  namespace task {
+    class WorkLoop;
+    class ActionSignature;
+  }
+}
+
+namespace gem {
+  namespace hw {
+    namespace optohybrid {
+      class HwOptoHybrid;
+    }
+  }
+
+  namespace supervisor {
+    namespace tbutils {
+
+      /**
+       * @class GEMScanOrchestrator
+       * @brief Runs the same firmware scan concurrently on several OptoHybrid links
+       *
+       * Every registered link gets its own waiting workloop, which runs the OptoHybrid scan
+       * controller on each connected VFAT of that link in turn, polls it until the scan
+       * is done, and reads back the results.
+       * runScan() returns once every link has finished, with the per chip results of all links
+       * merged into a single map, and the overall throughput in chips per minute.
+       */
+      class GEMScanOrchestrator : public toolbox::lang::Class
+      {
+      public:
+        static const unsigned POLL_USEC = 1000;
+
+        typedef std::map<uint8_t, std::vector<uint32_t> > ChipResults;  ///< raw scan points, keyed by VFAT slot
+        typedef std::map<int, ChipResults>                LinkResults;  ///< chip results, keyed by link
+
+        typedef struct ScanConfig {
+          uint8_t  mode;        ///< scan mode, see HwOptoHybrid::configureScanGenerator
+          uint8_t  min;         ///< first value of the scanned register
+          uint8_t  max;         ///< last value of the scanned register
+          uint8_t  step;        ///< step between successive points
+          uint8_t  channel;     ///< channel to scan, for the per channel modes only
+          uint32_t nTriggers;   ///< triggers to collect at each point
+          uint32_t timeoutSec;  ///< time after which a link that has not finished is abandoned
+        } ScanConfig;
+
+        /**
+         * @param name unique name, used to build the names of the link workloops
+         */
+        GEMScanOrchestrator(std::string const& name);
+
+        ~GEMScanOrchestrator();
+
+        /**
+         * @brief add a link to the orchestrator, or update the VFAT mask of an existing one
+         * @param link identifier of the link, e.g., the GTX link number
+         * @param optohybrid the OptoHybrid on the link, each link should use its own device object
+         * @param vfatMask VFATs to exclude from the scans, a set bit masks the corresponding slot
+         */
+        void addLink(int const& link, std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid> optohybrid,
+                     uint32_t const& vfatMask);
+
+        size_t getNLinks() const { return m_links.size(); };
+
+        /**
+         * @brief run the scan on all links at once
+         * @param config the scan to run
+         * @returns true if the scan finished successfully on every link
+         */
+        bool runScan(ScanConfig const& config);
+
+        /**
+         * @returns the merged results of the last scan
+         */
+        LinkResults const& getResults() const { return m_results; };
+
+        /**
+         * @returns a human readable summary of the last scan, with the time per link
+         *          and the throughput in chips per minute
+         */
+        std::string getStatistics() const;
+
+        /**
+         * @brief run a scan on each un-masked VFAT of a single OptoHybrid, blocks until all scans are done
+         * @param optohybrid the OptoHybrid running the scan
+         * @param vfatMask VFATs to exclude from the scan
+         * @param config the scan to run
+         * @param results filled with the raw results of each scanned VFAT
+         * @returns false if the scan range is empty or the scans did not finish within config.timeoutSec
+         * @throws gem::hw::exception::HardwareProblem if the results could not be read
+         */
+        static bool runLinkScan(gem::hw::optohybrid::HwOptoHybrid& optohybrid, uint32_t const& vfatMask,
+                                ScanConfig const& config, ChipResults& results);
+
+        /**
+         * @brief write scan results as "link slot value hits" lines
+         * @param fileName the output file
+         * @param results the results to write
+         */
+        static void writeResults(std::string const& fileName, LinkResults const& results);
+
+      private:
+        // Prevent copying.
+        GEMScanOrchestrator(GEMScanOrchestrator const&);
+        GEMScanOrchestrator& operator=(GEMScanOrchestrator const&);
+
+        /**
+         * Workloop action, runs the scan on the link served by the calling workloop
+         * @returns false, each submission handles exactly one scan
+         */
+        bool scanLink(toolbox::task::WorkLoop* wl);
+
+        typedef struct ScanLink {
+          int                      link;
+          std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid> optohybrid;
+          uint32_t                 vfatMask;
+          toolbox::task::WorkLoop* workloop;
+          bool                     busy;
+          bool                     success;
+          uint64_t                 usec;
+          ChipResults              results;
+        } ScanLink;
+
+        log4cplus::Logger m_gemLogger;
+        gem::utils::Lock  m_lock;
+        toolbox::BSem     m_linkDone;  ///< wakes up runScan, the finished links are counted in m_nDone
+
+        std::string                     m_name;
+        std::vector<ScanLink>           m_links;
+        toolbox::task::ActionSignature* p_scanSig;
+
+        ScanConfig  m_config;
+        LinkResults m_results;
+        uint64_t    m_scanUsec;
+        unsigned    m_nChips;
+        unsigned    m_nDone;  ///< links that have finished the current scan, guarded by m_lock
+      };
+    }  // namespace gem::supervisor::tbutils
+  }  // namespace gem::supervisor
+}  // namespace gem
+
+#endif  // GEM_SUPERVISOR_TBUTILS_GEMSCANORCHESTRATOR_H
@@ -37,6 +37,8 @@
 #include "xdata/Vector.h"
 
 #include "gem/readout/GEMslotContents.h"
+#include "gem/supervisor/tbutils/GEMScanOrchestrator.h"
+#include "gem/supervisor/tbutils/GEMSCurveFitter.h"
 
 namespace toolbox {
   namespace fsm {
@@ -212,6 +214,10 @@ namespace gem {
             xdata::Integer       localTriggerMode;
             xdata::Integer       localTriggerPeriod;
 	    xdata::Boolean       EnableTrigCont;
+	    xdata::Boolean       useFirmwareScan;
+	    xdata::Boolean       scanAllLinks;
+	    xdata::Boolean       trimChannels;
+	    xdata::Integer       trimTarget;
 
 	    xdata::UnsignedShort deviceVT1;
 	    xdata::UnsignedShort deviceVT2;
@@ -220,6 +226,83 @@ namespace gem {
 	  };
 
 	protected:
+	  static const unsigned FW_SCAN_TIMEOUT_SEC = 120;
+	  static const unsigned FIFO_POLL_USEC      = 100;
+
+	  /**
+	   * Runs a whole scan in the OptoHybrid firmware on each selected VFAT in turn,
+	   * reading out the results of every VFAT in a single block read.
+	   * With scanAllLinks set at Initialize, the scan runs concurrently on every connected OptoHybrid of the GLIB,
+	   * see configureOtherLinks
+	   * @param mode the scan mode, see HwOptoHybrid::configureScanGenerator
+	   * @param min first value of the scanned register
+	   * @param max last value of the scanned register
+	   * @param step step between successive points
+	   * @param nTriggers number of triggers to collect at each point
+	   * @param results filled with the raw results of each VFAT, keyed by link and slot
+	   * @returns false if the range is empty, the scan did not finish in FW_SCAN_TIMEOUT_SEC
+	   * or the results could not be read
+	   */
+	  bool runFirmwareScan(uint8_t const& mode, uint8_t const& min, uint8_t const& max, uint8_t const& step,
+	                       uint32_t const& nTriggers, GEMScanOrchestrator::LinkResults& results);
+
+	  /**
+	   * Writes the results of a firmware scan as "link slot value hits" lines to <scanName>_FW_<UTC time>.dat
+	   * and as one histogram of hits per chip to <scanName>_FW_<UTC time>.root
+	   * @param xTitle title of the histogram x axis, i.e., the scanned register
+	   */
+	  void writeFirmwareScanResults(std::string const& scanName,
+	                                GEMScanOrchestrator::LinkResults const& results,
+	                                std::string const& xTitle);
+
+	  /**
+	   * Fits an S-curve to the results of every VFAT of a firmware scan and writes
+	   * "link slot threshold noise amplitude chi2 ndf status" lines to <scanName>_FW_fits_<UTC time>.dat
+	   * @param nTriggers the number of triggers sent at each scan point
+	   */
+	  void fitFirmwareScanResults(std::string const& scanName,
+	                              GEMScanOrchestrator::LinkResults const& results,
+	                              uint32_t const& nTriggers);
+
+	  /**
+	   * Aligns the thresholds of all channels of the selected chips with their TrimDACs,
+	   * see GEMTrimDACCalibration, and writes the chosen values to <scanName>_trim_<UTC time>.dat
+	   * @param minVT1 first VT1 value of the per channel threshold scans
+	   * @param maxVT1 last VT1 value of the per channel threshold scans
+	   * @param step VT1 step of the per channel threshold scans
+	   * @returns false if the trimming could not be done
+	   */
+	  bool trimChannelThresholds(std::string const& scanName, uint8_t const& minVT1, uint8_t const& maxVT1,
+	                             uint8_t const& step);
+
+	  /**
+	   * @returns the S-curve fitter, created on first use
+	   */
+	  std::shared_ptr<GEMSCurveFitter> getSCurveFitter();
+
+	  /**
+	   * @returns <prefix>_<UTC time>.dat, with the characters that are awkward in file names replaced
+	   */
+	  std::string scanFileName(std::string const& prefix) const;
+
+	  /**
+	   * Registers the selected OptoHybrid with the scan orchestrator, and with scanAllLinks set,
+	   * the OptoHybrids on every other active GTX link of the GLIB together with their connected VFATs
+	   * @param connectionURI uHAL URI of the GLIB
+	   */
+	  void setupScanOrchestrator(std::string const& connectionURI);
+
+	  /**
+	   * Copies VT1, VT2 and the run mode of the first selected chip to the chips of the other links,
+	   * so that every link is scanned with the settings the scan applied to the selected chips
+	   * @returns false if there are other links but no selected chip to copy from
+	   */
+	  bool configureOtherLinks();
+
+	  std::shared_ptr<GEMScanOrchestrator> p_scanOrchestrator;
+	  std::map<int, std::vector<vfat_shared_ptr> > m_linkChips;  ///< connected VFATs of the other links, keyed by link
+	  std::shared_ptr<GEMSCurveFitter>     p_sCurveFitter;
+
 	  log4cplus::Logger m_gemLogger;
 
 	  toolbox::fsm::AsynchronousFiniteStateMachine* fsmP_;
@@ -0,0 +1,130 @@
+/** @file GEMTrimDACCalibration.h */
+
+#ifndef GEM_SUPERVISOR_TBUTILS_GEMTRIMDACCALIBRATION_H
+#define GEM_SUPERVISOR_TBUTILS_GEMTRIMDACCALIBRATION_H
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "log4cplus/logger.h"
+
+#include "gem/supervisor/tbutils/GEMScanOrchestrator.h"
+#include "gem/supervisor/tbutils/GEMSCurveFitter.h"
+
+namespace gem {
+  namespace hw {
+    namespace optohybrid {
+      class HwOptoHybrid;
+    }
+    namespace vfat {
+      class HwVFAT2;
+    }
+  }
+
+  namespace supervisor {
+    namespace tbutils {
+
+      /**
+       * @class GEMTrimDACCalibration
+       * @brief Aligns the thresholds of all channels of the VFATs on an OptoHybrid with their TrimDACs
+       *
+       * For each TrimDAC setting in the configuration, all channels of all chips are set to that value,
+       * and a per channel threshold scan is run by the OptoHybrid on each chip in turn.
+       * The S-curves of all channels are then fitted together.
+       * The TrimDAC that puts each channel on the target threshold is interpolated from a straight line
+       * through the fitted thresholds, the 128 values of each chip are written in bulk,
+       * and a last scan verifies the result.
+       * The scan controller handles a single channel of a single chip at a time, so every trim point
+       * costs 128 scans per chip, two trim points at the ends of the range are enough for the line.
+       * The TrimDACs loaded before the calibration are restored if it fails.
+       */
+      class GEMTrimDACCalibration
+      {
+      public:
+        static const unsigned N_CHANNELS  = 128;
+        static const uint8_t  MAX_TRIMDAC = 0x1f;
+
+        typedef struct TrimConfig {
+          std::vector<uint8_t> trimPoints;  ///< TrimDAC settings to scan at, at least two, the range ends are best
+          uint8_t  min;         ///< first VT1 value of the threshold scans
+          uint8_t  max;         ///< last VT1 value of the threshold scans
+          uint8_t  step;        ///< VT1 step of the threshold scans
+          uint32_t nTriggers;   ///< triggers at each point of the threshold scans
+          uint32_t timeoutSec;  ///< time after which a single channel scan is abandoned
+          double   target;      ///< threshold to align to, negative uses the mean of each chip at TrimDAC MAX_TRIMDAC/2
+          double   tolerance;   ///< channels within this distance of the target after trimming are counted as trimmed
+        } TrimConfig;
+
+        typedef struct ChipTrim {
+          uint8_t              slot;
+          double               target;
+          std::vector<uint8_t> trimDAC;   ///< the TrimDAC chosen for each channel
+          std::vector<double>  before;    ///< thresholds at the TrimDACs loaded before, from the fitted lines, -1 if not trimmed
+          std::vector<double>  after;     ///< fitted thresholds after trimming
+          unsigned             nFailed;   ///< channels without enough good fits to interpolate
+          unsigned             nInTolerance;
+          double               rmsBefore; ///< RMS of the threshold around the target before trimming
+          double               rmsAfter;  ///< RMS of the threshold around the target after trimming
+        } ChipTrim;
+
+        /**
+         * @param optohybrid the OptoHybrid running the scans
+         * @param chips the VFATs to trim, all on the given OptoHybrid
+         * @param fitter the S-curve fitter to use
+         */
+        GEMTrimDACCalibration(std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid> optohybrid,
+                              std::vector<std::shared_ptr<gem::hw::vfat::HwVFAT2> > const& chips,
+                              std::shared_ptr<GEMSCurveFitter> fitter);
+
+        /**
+         * @brief run the whole trimming procedure, blocks until it is done
+         * @returns false if the configuration is invalid, the TrimDACs could not be read or set,
+         *          or a scan failed, in which case the TrimDACs loaded before are kept or restored
+         */
+        bool run(TrimConfig const& config);
+
+        std::vector<ChipTrim> const& getResults() const { return m_results; };
+
+        /**
+         * @brief write "slot channel trimDAC before after target" lines for every trimmed channel
+         */
+        void writeResults(std::string const& fileName) const;
+
+      private:
+        /**
+         * Runs a threshold scan on each channel of each chip in turn, and fits all S-curves together
+         * @param thresholds filled with the fitted threshold of each channel, indexed by chip*N_CHANNELS + channel
+         * @param status filled with the fit status of each channel, same index
+         * @returns false if one of the scans failed
+         */
+        bool scanThresholds(TrimConfig const& config, std::vector<double>& thresholds,
+                            std::vector<GEMSCurveFitter::FitStatus>& status);
+
+        /**
+         * @returns false if the TrimDACs of one of the chips could not be set
+         */
+        bool setAllTrimDACs(uint8_t const& trimDAC);
+
+        /**
+         * Writes back the TrimDACs the chips had when run was called
+         */
+        void restoreTrimDACs();
+
+        log4cplus::Logger m_gemLogger;
+
+        std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid>    p_optohybrid;
+        std::vector<std::shared_ptr<gem::hw::vfat::HwVFAT2> > m_chips;
+        std::shared_ptr<GEMSCurveFitter>                      p_fitter;
+
+        uint32_t              m_vfatMask;
+        std::vector<ChipTrim> m_results;
+        std::vector<std::vector<uint8_t> > m_savedTrimDACs;  ///< TrimDACs of each chip when run was called
+      };
+    }  // namespace gem::supervisor::tbutils
+  }  // namespace gem::supervisor
+}  // namespace gem
+
+#endif  // GEM_SUPERVISOR_TBUTILS_GEMTRIMDACCALIBRATION_H
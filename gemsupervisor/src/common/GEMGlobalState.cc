@@ -1,5 +1,10 @@
 #include "gem/supervisor/GEMGlobalState.h"
 
+#include <sys/time.h>
+#include <strings.h>
+
+#include <vector>
+
 #include "toolbox/task/TimerFactory.h"
 #include "toolbox/task/Timer.h"
 
@@ -15,17 +20,21 @@ gem::supervisor::GEMApplicationState::GEMApplicationState()
   state          = gem::base::STATE_NULL;
   progress       = 1.0;
   progressWeight = 1.0;
+  updateCount    = 0;
 }
 
 gem::supervisor::GEMGlobalState::GEMGlobalState(xdaq::ApplicationContext* context, GEMSupervisor* gemSupervisor) :
   // m_globalState(gem::base::STATE_UNINIT),
   // p_gemSupervisor(std::make_shared<GEMSupervisor>(gemSupervisor)),
+  p_timer(NULL),
   p_gemSupervisor(gemSupervisor),
   p_appContext(context),
   p_srcApp(gemSupervisor->getApplicationDescriptor()),
   m_globalState(gem::base::STATE_INITIAL),
   m_gemLogger(gemSupervisor->getApplicationLogger()),
-  m_mutex(toolbox::BSem::FULL, true)
+  m_mutex(toolbox::BSem::FULL, true),
+  m_nChanges(0),
+  m_changed(toolbox::BSem::EMPTY)
 {
   // default constructor
 }
@@ -42,32 +51,101 @@ void gem::supervisor::GEMGlobalState::addApplication(xdaq::ApplicationDescriptor
   DEBUG("GEMGlobalState::addApplication");
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
 
-  m_states.insert(std::pair<xdaq::ApplicationDescriptor*, GEMApplicationState>(app, GEMApplicationState()));
+  if (!m_states.insert(std::pair<xdaq::ApplicationDescriptor*, GEMApplicationState>(app, GEMApplicationState())).second)
+    return;
 
   ApplicationMap::iterator i = m_states.find(app);
   std::string appURN = "urn:xdaq-application:"+app->getClassName();
   i->second.updateMsg = gem::utils::soap::GEMSOAPToolBox::createStateRequestMessage("app", appURN, true);
+  ++m_stateCounts[i->second.state];
 }
 
 void gem::supervisor::GEMGlobalState::clear()
 {
   DEBUG("GEMGlobalState::clear");
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
+  m_states.clear();
+  m_stateCounts.clear();
 }
 
 void gem::supervisor::GEMGlobalState::update()
 {
   DEBUG("GEMGlobalState::update");
+  // the SOAP queries are made without holding the lock, so pushed changes are not held up by a slow application
+  typedef struct {
+    xdaq::ApplicationDescriptor* app;
+    xoap::MessageReference       request;
+    uint64_t                     updateCount;
+  } PollEntry;
+  std::vector<PollEntry> apps;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
+    apps.reserve(m_states.size());
+    for (auto i = m_states.begin(); i != m_states.end(); ++i) {
+      PollEntry entry = {i->first, i->second.updateMsg, i->second.updateCount};
+      apps.push_back(entry);
+    }
+  }
+
+  for (auto entry = apps.begin(); entry != apps.end(); ++entry) {
+    toolbox::fsm::State state;
+    std::string message;
+    if (!queryApplication(entry->app, entry->request, state, message))
+      continue;
+
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
+    ApplicationMap::iterator i = m_states.find(entry->app);
+    // skip the result if the application pushed a newer state while it was being polled
+    if (i != m_states.end() && i->second.updateCount == entry->updateCount)
+      setApplicationState(i, state, message);
+  }
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
+  publishGlobals();
+}
+
+void gem::supervisor::GEMGlobalState::applicationStateChanged(std::string const& className, uint32_t const& instance,
+                                                               std::string const& stateName, std::string const& reason)
+{
+  toolbox::fsm::State state = parseStateName(stateName);
+  if (state == gem::base::STATE_NULL) {
+    WARN("GEMGlobalState::applicationStateChanged " << className << ":" << instance
+         << " pushed unknown state " << stateName);
+    return;
+  }
+
   gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
   for (auto i = m_states.begin(); i != m_states.end(); ++i) {
-    updateApplication(i->first);
+    if (i->first->getClassName() == className && i->first->getInstance() == instance) {
+      DEBUG("GEMGlobalState::applicationStateChanged " << className << ":" << instance << " is now " << stateName);
+      setApplicationState(i, state, reason);
+      publishGlobals();
+      return;
+    }
   }
-  toolbox::fsm::State before = m_globalState;
-  calculateGlobals();
-  m_globalStateName = getStateName(m_globalState);
-  DEBUG("GEMGlobalState::update before=" << before << " after=" << m_globalState);
-  if (before != m_globalState)
-    p_gemSupervisor->globalStateChanged(before, m_globalState);
+  DEBUG("GEMGlobalState::applicationStateChanged ignoring unmanaged application " << className << ":" << instance);
+}
+
+void gem::supervisor::GEMGlobalState::waitForChange()
+{
+  uint64_t before;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
+    before = m_nChanges;
+  }
+
+  timeval wait;
+  wait.tv_sec  = WAIT_MSEC/1000;
+  wait.tv_usec = (WAIT_MSEC%1000)*1000;
+  m_changed.take(&wait);
+
+  bool changed;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_mutex);
+    changed = (m_nChanges != before);
+  }
+  if (!changed)
+    update();
 }
 
 void gem::supervisor::GEMGlobalState::startTimer() {
@@ -75,7 +153,8 @@ void gem::supervisor::GEMGlobalState::startTimer() {
     // p_timer = std::make_shared<toolbox::task::Timer>(toolbox::task::TimerFactory::getInstance()->createTimer("GEMGlobalStateTimer"));
     p_timer = toolbox::task::TimerFactory::getInstance()->createTimer("GEMGlobalStateTimer");
     toolbox::TimeVal      start = toolbox::TimeVal::gettimeofday();
-    toolbox::TimeInterval delta(1, 0);  // how often is enough/too often?
+    // only a watchdog, state changes are pushed by the applications
+    toolbox::TimeInterval delta(WATCHDOG_SEC, 0);
     p_timer->activate();
     p_timer->scheduleAtFixedRate(start, this, delta, 0, "GEMGlobalStateUpdate");
   }
@@ -88,138 +167,116 @@ void gem::supervisor::GEMGlobalState::timeExpired(toolbox::task::TimerEvent& eve
 }
 
 
+void gem::supervisor::GEMGlobalState::setApplicationState(ApplicationMap::iterator app,
+                                                          toolbox::fsm::State const& state,
+                                                          std::string const& message)
+{
+  ++(app->second.updateCount);
+  app->second.stateMessage = message;
+  if (app->second.state == state)
+    return;
+
+  auto count = m_stateCounts.find(app->second.state);
+  if (count != m_stateCounts.end() && count->second > 0)
+    --(count->second);
+  ++m_stateCounts[state];
+  app->second.state = state;
+}
+
 void gem::supervisor::GEMGlobalState::calculateGlobals()
 {
   DEBUG("GEMGlobalState::calculateGlobalState");
   m_globalState = gem::base::STATE_NULL;
   m_globalStateMessage = "";
 
+  // at most one entry per state, independent of the number of applications
+  for (auto count = m_stateCounts.begin(); count != m_stateCounts.end(); ++count) {
+    if (count->second == 0)
+      continue;
+    int pg = getStatePriority(m_globalState);
+    int pa = getStatePriority(count->first);
+    if (pa < pg)
+      m_globalState = count->first;
+  }
+
+  auto failed = m_stateCounts.find(gem::base::STATE_FAILED);
+  if (failed == m_stateCounts.end() || failed->second == 0)
+    return;
+
   for (auto appState = m_states.begin(); appState != m_states.end(); ++appState) {
-    DEBUG("GEMGlobalState::calculateGlobalState:" << appState->first->getClassName().c_str() << ":"
-          << appState->first->getInstance() << " has state message "
-          << appState->second.stateMessage.c_str() << " and state:"
-          << appState->second.state);
     if (appState->second.state == gem::base::STATE_FAILED) {
       m_globalStateMessage += toolbox::toString(" (%s:%d) : %s ", appState->first->getClassName().c_str(),
                                                 appState->first->getInstance(),
                                                 appState->second.stateMessage.c_str());
     }
+  }
+}
 
-    int pg = getStatePriority(m_globalState);
-    int pa = getStatePriority(appState->second.state);
-    if (pa < pg)
-      m_globalState = appState->second.state;
+void gem::supervisor::GEMGlobalState::publishGlobals()
+{
+  toolbox::fsm::State before = m_globalState;
+  calculateGlobals();
+  m_globalStateName = getStateName(m_globalState);
+  DEBUG("GEMGlobalState::publishGlobals before=" << before << " after=" << m_globalState);
+  if (before != m_globalState) {
+    ++m_nChanges;
+    p_gemSupervisor->globalStateChanged(before, m_globalState);
+    m_changed.give();
   }
 }
 
 
-void gem::supervisor::GEMGlobalState::updateApplication(xdaq::ApplicationDescriptor* app)
+bool gem::supervisor::GEMGlobalState::queryApplication(xdaq::ApplicationDescriptor* app,
+                                                       xoap::MessageReference const& request,
+                                                       toolbox::fsm::State& state, std::string& message)
 {
-  ApplicationMap::iterator i   = m_states.find(app);
-  xoap::MessageReference   msg = xoap::createMessage(i->second.updateMsg), answer;
+  xoap::MessageReference   msg = xoap::createMessage(request), answer;
   std::string nstag = "gemapp";
   std::stringstream debugstream;
   msg->writeTo(debugstream);
+  std::string failure = "";
   try {
     answer = p_appContext->postSOAP(msg, *p_srcApp, *app);
   } catch (xoap::exception::Exception& e) {
-    ERROR("GEMGlobalState::updateApplication caught exception communicating with " << app->getClassName() << ":" << app->getInstance()
-          << ". Applcation probably crashed, setting state to FAILED"
-          << " (xoap::exception::Exception)" << e.what());
-    INFO("GEMGlobalState::updateApplication tried sending SOAP [" << debugstream << "]");
-    i->second.state        = gem::base::STATE_FAILED;
-    i->second.stateMessage = "Communication failure, assuming state is FAILED, may mean application/executive crash.";
-    return;
+    failure = std::string(" (xoap::exception::Exception)") + e.what();
   } catch (xdaq::exception::Exception& e) {
-    ERROR("GEMGlobalState::updateApplication caught exception communicating with " << app->getClassName() << ":" << app->getInstance()
-          << ". Applcation probably crashed, setting state to FAILED"
-          << " (xdaq::exception::Exception)" << e.what());
-    INFO("GEMGlobalState::updateApplication tried sending SOAP [" << debugstream << "]");
-    i->second.state        = gem::base::STATE_FAILED;
-    i->second.stateMessage = "Communication failure, assuming state is FAILED, may mean application/executive crash.";
-    return;
+    failure = std::string(" (xdaq::exception::Exception)") + e.what();
   } catch (xcept::Exception& e) {
-    ERROR("GEMGlobalState::updateApplication caught exception communicating with " << app->getClassName() << ":" << app->getInstance()
-          << ". Applcation probably crashed, setting state to FAILED"
-          << " (xcept::Exception)" << e.what());
-    INFO("GEMGlobalState::updateApplication tried sending SOAP [" << debugstream << "]");
-    i->second.state        = gem::base::STATE_FAILED;
-    i->second.stateMessage = "Communication failure, assuming state is FAILED, may mean application/executive crash.";
-    return;
+    failure = std::string(" (xcept::Exception)") + e.what();
   } catch (std::exception& e) {
-    ERROR("GEMGlobalState::updateApplication caught exception communicating with " << app->getClassName() << ":" << app->getInstance()
-          << ". Applcation probably crashed, setting state to FAILED"
-          << " (std::exception)" << e.what());
-    INFO("GEMGlobalState::updateApplication tried sending SOAP [" << debugstream << "]");
-    i->second.state        = gem::base::STATE_FAILED;
-    i->second.stateMessage = "Communication failure, assuming state is FAILED, may mean application/executive crash.";
-    return;
+    failure = std::string(" (std::exception)") + e.what();
   } catch (...) {
-    ERROR("GEMGlobalState::updateApplication caught exception communicating with " << app->getClassName() << ":" << app->getInstance()
-          << ". Applcation probably crashed, setting state to FAILED");
-    INFO("GEMGlobalState::updateApplication tried sending SOAP [" << debugstream << "]");
-    i->second.state        = gem::base::STATE_FAILED;
-    i->second.stateMessage = "Communication failure, assuming state is FAILED, may mean application/executive crash.";
-    return;
+    failure = " (unknown exception)";
+  }
+  if (!failure.empty()) {
+    ERROR("GEMGlobalState::queryApplication caught exception communicating with " << app->getClassName() << ":" << app->getInstance()
+          << ". Applcation probably crashed, setting state to FAILED" << failure);
+    INFO("GEMGlobalState::queryApplication tried sending SOAP [" << debugstream.str() << "]");
+    state   = gem::base::STATE_FAILED;
+    message = "Communication failure, assuming state is FAILED, may mean application/executive crash.";
+    return true;
   }
 
   // parse answer here
   std::string    appUrn = "urn:xdaq-application:" + app->getClassName();
   xoap::SOAPName stateReply("StateName", nstag, appUrn);
+  xoap::SOAPName messageReply("StateMessage", nstag, appUrn);
 
   xoap::SOAPElement props = answer->getSOAPPart().getEnvelope().getBody().getChildElements()[0].getChildElements()[0];
   std::vector<xoap::SOAPElement> basic = props.getChildElements(stateReply);
   if (basic.size() == 1) {
     std::string stateString = basic[0].getValue();
-    DEBUG("GEMGlobalState::updateApplication " << app->getClassName() << ":" << static_cast<int>(app->getInstance())
+    DEBUG("GEMGlobalState::queryApplication " << app->getClassName() << ":" << static_cast<int>(app->getInstance())
           << " returned state " << stateString);
-
-    if (!strcasecmp(stateString.c_str(), "Uninitialized"))
-      i->second.state = gem::base::STATE_UNINIT;
-    else if (!strcasecmp(stateString.c_str(), "Halted"))
-      i->second.state = gem::base::STATE_HALTED;
-    else if (!strcasecmp(stateString.c_str(), "Cold-Init"))
-      i->second.state = gem::base::STATE_COLD;
-    else if (!strcasecmp(stateString.c_str(), "Initial"))
-      i->second.state = gem::base::STATE_INITIAL;
-    else if (!strcasecmp(stateString.c_str(), "Configured"))
-      i->second.state = gem::base::STATE_CONFIGURED;
-    else if (!strcasecmp(stateString.c_str(), "Active"))
-      i->second.state = gem::base::STATE_RUNNING;
-    else if (!strcasecmp(stateString.c_str(), "Enabled"))
-      i->second.state = gem::base::STATE_RUNNING;
-    else if (!strcasecmp(stateString.c_str(), "Running"))
-      i->second.state = gem::base::STATE_RUNNING;
-    else if (!strcasecmp(stateString.c_str(), "Paused"))
-      i->second.state = gem::base::STATE_PAUSED;
-    else if (!strcasecmp(stateString.c_str(), "Suspended"))
-      i->second.state = gem::base::STATE_PAUSED;
-
-    else if (!strcasecmp(stateString.c_str(), "Initializing"))
-      i->second.state = gem::base::STATE_INITIALIZING;
-    else if (!strcasecmp(stateString.c_str(), "Configuring"))
-      i->second.state = gem::base::STATE_CONFIGURING;
-    else if (!strcasecmp(stateString.c_str(), "Halting"))
-      i->second.state = gem::base::STATE_HALTING;
-    else if (!strcasecmp(stateString.c_str(), "Pausing"))
-      i->second.state = gem::base::STATE_PAUSING;
-    else if (!strcasecmp(stateString.c_str(), "Stopping"))
-      i->second.state = gem::base::STATE_STOPPING;
-    else if (!strcasecmp(stateString.c_str(), "Starting"))
-      i->second.state = gem::base::STATE_STARTING;
-    else if (!strcasecmp(stateString.c_str(), "Resuming"))
-      i->second.state = gem::base::STATE_RESUMING;
-    else if (!strcasecmp(stateString.c_str(), "Resetting"))
-      i->second.state = gem::base::STATE_RESETTING;
-    else if (!strcasecmp(stateString.c_str(), "Fixing"))
-      i->second.state = gem::base::STATE_FIXING;
-    else if (!strcasecmp(stateString.c_str(), "Failed"))
-      i->second.state = gem::base::STATE_FAILED;
-    else if (!strcasecmp(stateString.c_str(), "Error"))
-      i->second.state = gem::base::STATE_FAILED;
-    else
-      WARN("GEMGlobalState::updateApplication " << app->getClassName() << ":" << static_cast<int>(app->getInstance())
+    state = parseStateName(stateString);
+    if (state == gem::base::STATE_NULL) {
+      WARN("GEMGlobalState::queryApplication " << app->getClassName() << ":" << static_cast<int>(app->getInstance())
            << " " << stateString);
+      return false;
+    }
+    std::vector<xoap::SOAPElement> stateMessage = props.getChildElements(messageReply);
+    message = (stateMessage.size() == 1) ? stateMessage[0].getValue() : "";
+    return true;
   } else {
     std::string toolInput;
     xoap::dumpTree(msg->getSOAPPart().getEnvelope().getDOMNode(), toolInput);
@@ -232,10 +289,60 @@ void gem::supervisor::GEMGlobalState::updateApplication(xdaq::ApplicationDescrip
             << answer->getSOAPPart().getEnvelope().getBody().getFault().getFaultString()
             << std::endl << tool);
     }
-    DEBUG("GEMGlobalState::updateApplication " << app->getClassName() << ":" << static_cast<int>(app->getInstance())
+    DEBUG("GEMGlobalState::queryApplication " << app->getClassName() << ":" << static_cast<int>(app->getInstance())
           << std::endl << static_cast<int>(basic.size())
           << std::endl << tool);
   }
+  return false;
+}
+
+toolbox::fsm::State gem::supervisor::GEMGlobalState::parseStateName(std::string const& stateName)
+{
+  char const* stateString = stateName.c_str();
+  if (!strcasecmp(stateString, "Uninitialized"))
+    return gem::base::STATE_UNINIT;
+  else if (!strcasecmp(stateString, "Halted"))
+    return gem::base::STATE_HALTED;
+  else if (!strcasecmp(stateString, "Cold-Init"))
+    return gem::base::STATE_COLD;
+  else if (!strcasecmp(stateString, "Initial"))
+    return gem::base::STATE_INITIAL;
+  else if (!strcasecmp(stateString, "Configured"))
+    return gem::base::STATE_CONFIGURED;
+  else if (!strcasecmp(stateString, "Active"))
+    return gem::base::STATE_RUNNING;
+  else if (!strcasecmp(stateString, "Enabled"))
+    return gem::base::STATE_RUNNING;
+  else if (!strcasecmp(stateString, "Running"))
+    return gem::base::STATE_RUNNING;
+  else if (!strcasecmp(stateString, "Paused"))
+    return gem::base::STATE_PAUSED;
+  else if (!strcasecmp(stateString, "Suspended"))
+    return gem::base::STATE_PAUSED;
+
+  else if (!strcasecmp(stateString, "Initializing"))
+    return gem::base::STATE_INITIALIZING;
+  else if (!strcasecmp(stateString, "Configuring"))
+    return gem::base::STATE_CONFIGURING;
+  else if (!strcasecmp(stateString, "Halting"))
+    return gem::base::STATE_HALTING;
+  else if (!strcasecmp(stateString, "Pausing"))
+    return gem::base::STATE_PAUSING;
+  else if (!strcasecmp(stateString, "Stopping"))
+    return gem::base::STATE_STOPPING;
+  else if (!strcasecmp(stateString, "Starting"))
+    return gem::base::STATE_STARTING;
+  else if (!strcasecmp(stateString, "Resuming"))
+    return gem::base::STATE_RESUMING;
+  else if (!strcasecmp(stateString, "Resetting"))
+    return gem::base::STATE_RESETTING;
+  else if (!strcasecmp(stateString, "Fixing"))
+    return gem::base::STATE_FIXING;
+  else if (!strcasecmp(stateString, "Failed"))
+    return gem::base::STATE_FAILED;
+  else if (!strcasecmp(stateString, "Error"))
+    return gem::base::STATE_FAILED;
+  return gem::base::STATE_NULL;
 }
 
 // static functions
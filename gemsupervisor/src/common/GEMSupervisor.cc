@@ -8,13 +8,21 @@
 
 #include "gem/supervisor/GEMSupervisor.h"
 
+#include <sys/time.h>
+
 #include <iomanip>
 
+#include "toolbox/string.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
+#include "toolbox/task/Action.h"
+
 #include "gem/supervisor/GEMSupervisorWeb.h"
 #include "gem/supervisor/GEMSupervisorMonitor.h"
 
 #include "gem/utils/soap/GEMSOAPToolBox.h"
 #include "gem/utils/exception/Exception.h"
+#include "gem/utils/GEMLatencyHistogram.h"
 
 typedef gem::base::utils::GEMInfoSpaceToolBox::UpdateType GEMUpdateType;
 
@@ -27,10 +35,16 @@ gem::supervisor::GEMSupervisor::GEMSupervisor(xdaq::ApplicationStub* stub) :
   m_reportToRCMS(false),
   m_gemRCMSNotifier(this->getApplicationLogger(),
                     this->getApplicationDescriptor(),
-                    this->getApplicationContext())
+                    this->getApplicationContext()),
+  m_soapTimeout(10000),
+  m_soapLock(toolbox::BSem::FULL, true),
+  m_soapReply(toolbox::BSem::EMPTY),
+  p_soapJobSig(NULL)
 {
+  p_soapJobSig = toolbox::task::bind(this, &gem::supervisor::GEMSupervisor::runSOAPJob, "runSOAPJob");
 
   xoap::bind(this, &gem::supervisor::GEMSupervisor::EndScanPoint, "EndScanPoint",  XDAQ_NS_URI );
+  xoap::bind(this, &gem::supervisor::GEMSupervisor::StateNotification, "StateNotification", XDAQ_NS_URI);
   // xgi::framework::deferredbind(this, this, &GEMSupervisor::xgiDefault, "Default");
 
   DEBUG("Creating the GEMSupervisorWeb interface");
@@ -41,6 +55,7 @@ gem::supervisor::GEMSupervisor::GEMSupervisor(xdaq::ApplicationStub* stub) :
   //p_gemMonitor      = new gem generic system monitor
 
   p_appInfoSpace->fireItemAvailable("DatabaseInfo",&m_dbInfo);
+  p_appInfoSpace->fireItemAvailable("SOAPTimeoutMSec",&m_soapTimeout);
   // p_appInfoSpace->fireItemAvailable("DatabaseName",&m_dbName);
   // p_appInfoSpace->fireItemAvailable("DatabaseHost",&m_dbHost);
   // p_appInfoSpace->fireItemAvailable("DatabasePort",&m_dbPort);
@@ -160,6 +175,10 @@ void gem::supervisor::GEMSupervisor::init()
 {
   v_supervisedApps.clear();
   v_supervisedApps.reserve(0);
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+    m_soapJobs.clear();
+  }
 
   m_globalState.clear();
 
@@ -199,6 +218,27 @@ void gem::supervisor::GEMSupervisor::init()
         p_appStateInfoSpaceToolBox->createString(managedAppStateName.str(), managedAppStateURN.str(), NULL);
 
         m_globalState.addApplication(*j);
+
+        // each application gets its own workloop, so a slow reply only delays that application
+        SOAPJob job;
+        job.app        = *j;
+        job.workloop   = getSOAPWorkLoop(*j, 0);
+        job.parameters = 0;
+        job.busy       = false;
+        job.failed     = false;
+        job.abandoned  = 0;
+        gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+        // applications of the same class are commanded together, the classes in the order they are found
+        job.stage = 0;
+        for (auto other = m_soapJobs.begin(); other != m_soapJobs.end(); ++other) {
+          if (other->app->getClassName() == job.app->getClassName()) {
+            job.stage = other->stage;
+            break;
+          }
+          if (other->stage >= job.stage)
+            job.stage = other->stage + 1;
+        }
+        m_soapJobs.push_back(job);
       }
       DEBUG("done");
     }  // done iterating over applications in group
@@ -234,8 +274,7 @@ void gem::supervisor::GEMSupervisor::initializeAction()
   while ((m_globalState.getStateName() != "Initial") && (getCurrentState() != "Initial")) {
     INFO("GEMSupervisor::initializeAction global state not in " << gem::base::STATE_INITIAL
           << " sleeping (" << m_globalState.getStateName() << ")");
-    usleep(100);
-    m_globalState.update();
+    m_globalState.waitForChange();
   }
 
   p_gemDBHelper = std::make_shared<gem::utils::db::GEMDatabaseUtils>(m_dbHost.toString(),
@@ -247,11 +286,13 @@ void gem::supervisor::GEMSupervisor::initializeAction()
     // if (p_gemDBHelper->connect(m_dbName.toString())) {
     p_gemDBHelper->connect(m_dbName.toString());
 
-    // for (std::vector<xdaq::ApplicationDescriptor*>::iterator i=v_supervisedApps.begin(); i!=v_supervisedApps.end(); i++) {
-    for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-      INFO("GEMSupervisor::initializeAction Initializing " << (*i)->getClassName());
-      gem::utils::soap::GEMSOAPToolBox::sendCommand("Initialize", p_appContext, p_appDescriptor, *i);
-    }
+    INFO("GEMSupervisor::initializeAction Initializing " << v_supervisedApps.size() << " applications");
+    sendToSupervisedApps("Initialize");
+  } catch (gem::supervisor::exception::Exception& e) {
+    std::stringstream msg;
+    msg << "GEMSupervisor::initializeAction unable to initialize the supervised applications " << e.what();
+    ERROR(msg.str());
+    fireEvent("Fail");
   } catch (gem::utils::exception::DBConnectionError& e) {
     std::stringstream msg;
     msg << "GEMSupervisor::initializeAction unable to connect to the database (DBConnectionError)" << e.what();
@@ -272,7 +313,6 @@ void gem::supervisor::GEMSupervisor::initializeAction()
     fireEvent("Fail");
     // XCEPT_RAISE(gem::utils::exception::Exception, msg.str());
   }
-  m_globalState.update();
 }
 
 void gem::supervisor::GEMSupervisor::configureAction()
@@ -283,29 +323,19 @@ void gem::supervisor::GEMSupervisor::configureAction()
     INFO("GEMSupervisor::configureAction global state not in " << gem::base::STATE_HALTED
           << " or "  << gem::base::STATE_CONFIGURED
           << " sleeping (" << m_globalState.getStateName() << ")");
-    usleep(100);
-    m_globalState.update();
+    m_globalState.waitForChange();
   }
 
   try {
-    for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-      sendCfgType("testCfgType", (*i));
-      sendRunType("testRunType", (*i));
-      sendRunNumber(10254, (*i));
-
-      if (m_scanInfo.bag.scanType.value_ == 2 || m_scanInfo.bag.scanType.value_ == 3) {
-	INFO("GEMSupervisor::configureAction Setting ScanParameters " << (*i)->getClassName());
-	sendScanParameters(*i);
-      }
-
-      INFO("GEMSupervisor::configureAction Configuring " << (*i)->getClassName());
-      gem::utils::soap::GEMSOAPToolBox::sendCommand("Configure", p_appContext, p_appDescriptor, *i);
-      if (((*i)->getClassName()).rfind("AMC13") != std::string::npos) {
-        INFO("GEMSupervisor::configureAction Sending AMC13 Parameters to " << (*i)->getClassName());
-        gem::utils::soap::GEMSOAPToolBox::sendAMC13Config(p_appContext, p_appDescriptor, *i);
-      }
+    uint32_t parameters = PARAM_CFGTYPE | PARAM_RUNTYPE | PARAM_RUNNUMBER;
+    if (m_scanInfo.bag.scanType.value_ == 2 || m_scanInfo.bag.scanType.value_ == 3) {
+      INFO("GEMSupervisor::configureAction Setting ScanParameters");
+      parameters |= PARAM_SCANINFO;
     }
 
+    INFO("GEMSupervisor::configureAction Configuring " << v_supervisedApps.size() << " applications");
+    sendToSupervisedApps("Configure", parameters);
+
   } catch (gem::supervisor::exception::Exception& e) {
     ERROR("GEMSupervisor::configureAction " << e.what());
     throw e;
@@ -318,7 +348,6 @@ void gem::supervisor::GEMSupervisor::configureAction()
   } catch (...) {
     ERROR("GEMSupervisor::configureAction ");
   }
-  m_globalState.update();
   INFO("GEMSupervisor::configureAction GlobalState = " << m_globalState.getStateName());
 }
 
@@ -328,8 +357,7 @@ void gem::supervisor::GEMSupervisor::startAction()
   while ((m_globalState.getStateName() != "Configured") && (getCurrentState() != "Configured")) {
     INFO("GEMSupervisor::startAction global state not in " << gem::base::STATE_CONFIGURED
           << " sleeping (" << m_globalState.getStateName() << ")");
-    usleep(100);
-    m_globalState.update();
+    m_globalState.waitForChange();
   }
   updateRunNumber();
 
@@ -344,11 +372,8 @@ void gem::supervisor::GEMSupervisor::startAction()
   }
 
   try {
-    for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-      sendRunNumber(m_runNumber, (*i));
-      INFO("GEMSupervisor::startAction Starting " << (*i)->getClassName());
-      gem::utils::soap::GEMSOAPToolBox::sendCommand("Start", p_appContext, p_appDescriptor, *i);
-    }
+    INFO("GEMSupervisor::startAction Starting " << v_supervisedApps.size() << " applications");
+    sendToSupervisedApps("Start", PARAM_RUNNUMBER);
 
   } catch (gem::supervisor::exception::Exception& e) {
     ERROR("GEMSupervisor::startAction " << e.what());
@@ -362,7 +387,6 @@ void gem::supervisor::GEMSupervisor::startAction()
   } catch (...) {
     ERROR("GEMSupervisor::startAction ");
   }
-  m_globalState.update();
   INFO("GEMSupervisor::startAction GlobalState = " << m_globalState.getStateName());
 }
 
@@ -372,15 +396,11 @@ void gem::supervisor::GEMSupervisor::pauseAction()
   while ((m_globalState.getStateName() != "Running") && (getCurrentState() != "Running")) {
     INFO("GEMSupervisor::pauseAction global state not in " << gem::base::STATE_RUNNING
           << " sleeping (" << m_globalState.getStateName() << ")");
-    usleep(100);
-    m_globalState.update();
+    m_globalState.waitForChange();
   }
 
-  for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-    INFO("GEMSupervisor::pauseAction Pausing " << (*i)->getClassName());
-    gem::utils::soap::GEMSOAPToolBox::sendCommand("Pause", p_appContext, p_appDescriptor, *i);
-  }
-  m_globalState.update();
+  INFO("GEMSupervisor::pauseAction Pausing " << v_supervisedApps.size() << " applications");
+  sendToSupervisedApps("Pause");
 }
 
 void gem::supervisor::GEMSupervisor::resumeAction()
@@ -389,15 +409,11 @@ void gem::supervisor::GEMSupervisor::resumeAction()
   while ((m_globalState.getStateName() != "Paused") && (getCurrentState() != "Paused")) {
     INFO("GEMSupervisor::pauseAction global state not in " << gem::base::STATE_PAUSED
           << " sleeping (" << m_globalState.getStateName() << ")");
-    usleep(100);
-    m_globalState.update();
+    m_globalState.waitForChange();
   }
 
-  for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-    INFO("GEMSupervisor::resumeAction Resuming " << (*i)->getClassName());
-    gem::utils::soap::GEMSOAPToolBox::sendCommand("Resume", p_appContext, p_appDescriptor, *i);
-  }
-  m_globalState.update();
+  INFO("GEMSupervisor::resumeAction Resuming " << v_supervisedApps.size() << " applications");
+  sendToSupervisedApps("Resume");
 }
 
 void gem::supervisor::GEMSupervisor::stopAction()
@@ -408,36 +424,26 @@ void gem::supervisor::GEMSupervisor::stopAction()
     INFO("GEMSupervisor::pauseAction global state not in " << gem::base::STATE_RUNNING
           << " or " << gem::base::STATE_PAUSED
           << " sleeping (" << m_globalState.getStateName() << ")");
-    usleep(100);
-    m_globalState.update();
+    m_globalState.waitForChange();
   }
 
-  for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-    INFO("GEMSupervisor::stopAction Stopping " << (*i)->getClassName());
-    gem::utils::soap::GEMSOAPToolBox::sendCommand("Stop", p_appContext, p_appDescriptor, *i);
-  }
-  m_globalState.update();
+  INFO("GEMSupervisor::stopAction Stopping " << v_supervisedApps.size() << " applications");
+  sendToSupervisedApps("Stop");
 }
 
 void gem::supervisor::GEMSupervisor::haltAction()
   throw (gem::supervisor::exception::Exception)
 {
-  for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-    INFO("GEMSupervisor::haltAction Halting " << (*i)->getClassName());
-    gem::utils::soap::GEMSOAPToolBox::sendCommand("Halt", p_appContext, p_appDescriptor, *i);
-  }
-  m_globalState.update();
+  INFO("GEMSupervisor::haltAction Halting " << v_supervisedApps.size() << " applications");
+  sendToSupervisedApps("Halt");
 }
 
 void gem::supervisor::GEMSupervisor::resetAction()
   throw (gem::supervisor::exception::Exception)
 {
-  for (auto i = v_supervisedApps.begin(); i != v_supervisedApps.end(); ++i) {
-    INFO("GEMSupervisor::resetAction Resetting " << (*i)->getClassName());
-    gem::utils::soap::GEMSOAPToolBox::sendCommand("Reset", p_appContext, p_appDescriptor, *i);
-  }
+  INFO("GEMSupervisor::resetAction Resetting " << v_supervisedApps.size() << " applications");
+  sendToSupervisedApps("Reset");
   // gem::base::GEMFSMApplication::resetAction();
-  m_globalState.update();
 }
 
 /*
@@ -593,7 +599,7 @@ void gem::supervisor::GEMSupervisor::sendCfgType(std::string const& cfgType, xda
   throw (gem::supervisor::exception::Exception)
 {
   INFO("GEMSupervisor::sendCfgType to " << ad->getClassName());
-  gem::utils::soap::GEMSOAPToolBox::sendApplicationParameter("CfgType", "xsd:string", m_cfgType.toString(),
+  gem::utils::soap::GEMSOAPToolBox::sendApplicationParameter("CfgType", "xsd:string", cfgType,
                                                              p_appContext, p_appDescriptor, ad);
 }
 
@@ -601,7 +607,7 @@ void gem::supervisor::GEMSupervisor::sendRunType(std::string const& runType, xda
   throw (gem::supervisor::exception::Exception)
 {
   INFO("GEMSupervisor::sendRunType to " << ad->getClassName());
-  gem::utils::soap::GEMSOAPToolBox::sendApplicationParameter("RunType", "xsd:string", m_runType.toString(),
+  gem::utils::soap::GEMSOAPToolBox::sendApplicationParameter("RunType", "xsd:string", runType,
                                                              p_appContext, p_appDescriptor, ad);
 }
 
@@ -609,8 +615,10 @@ void gem::supervisor::GEMSupervisor::sendRunNumber(int64_t const& runNumber, xda
   throw (gem::supervisor::exception::Exception)
 {
   INFO("GEMSupervisor::sendRunNumber to " << ad->getClassName());
+  std::stringstream runNumberValue;
+  runNumberValue << runNumber;
   gem::utils::soap::GEMSOAPToolBox::sendApplicationParameter("RunNumber", "xsd:long",
-                                                             m_runNumber.toString(),
+                                                             runNumberValue.str(),
                                                              p_appContext, p_appDescriptor, ad);
 }
 
@@ -625,6 +633,208 @@ void gem::supervisor::GEMSupervisor::sendScanParameters(xdaq::ApplicationDescrip
 
 }
 
+std::vector<std::vector<std::string> > gem::supervisor::GEMSupervisor::getRunParameters(uint32_t const& parameters)
+{
+  std::vector<std::vector<std::string> > runParameters;
+  std::vector<std::string> parameter(3);
+  if (parameters & PARAM_CFGTYPE) {
+    parameter[0] = "CfgType";   parameter[1] = m_cfgType.toString();   parameter[2] = "xsd:string";
+    runParameters.push_back(parameter);
+  }
+  if (parameters & PARAM_RUNTYPE) {
+    parameter[0] = "RunType";   parameter[1] = m_runType.toString();   parameter[2] = "xsd:string";
+    runParameters.push_back(parameter);
+  }
+  if (parameters & PARAM_RUNNUMBER) {
+    parameter[0] = "RunNumber"; parameter[1] = m_runNumber.toString(); parameter[2] = "xsd:long";
+    runParameters.push_back(parameter);
+  }
+  if (parameters & PARAM_SCANINFO)
+    gem::utils::soap::GEMSOAPToolBox::appendParameterBag("ScanInfo", m_scanInfo, runParameters);
+  return runParameters;
+}
+
+void gem::supervisor::GEMSupervisor::sendToSupervisedApps(std::string const& command, uint32_t const& parameters)
+  throw (gem::supervisor::exception::Exception)
+{
+  uint64_t timeout = static_cast<uint64_t>(m_soapTimeout.value_)*1000;
+  std::stringstream failures;
+
+  unsigned nStages = 0;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+    for (auto job = m_soapJobs.begin(); job != m_soapJobs.end(); ++job)
+      if (job->stage + 1 > nStages)
+        nStages = job->stage + 1;
+  }
+
+  // one class after the other, as the serial loop did, but all applications of a class at once
+  for (unsigned stage = 0; stage < nStages && failures.str().empty(); ++stage) {
+    std::vector<size_t> pending;
+    {
+      gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+      for (size_t idx = 0; idx < m_soapJobs.size(); ++idx) {
+        SOAPJob& job = m_soapJobs.at(idx);
+        if (job.stage != stage)
+          continue;
+        job.command    = command;
+        job.parameters = parameters;
+        job.busy       = true;
+        job.failed     = false;
+        job.error      = "";
+        clock_gettime(CLOCK_MONOTONIC, &job.dispatched);
+        job.workloop->submit(p_soapJobSig);
+        pending.push_back(idx);
+      }
+    }
+
+    while (!pending.empty()) {
+      timespec now;
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      uint64_t nextDeadline = timeout;
+      {
+        gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+        for (auto idx = pending.begin(); idx != pending.end(); ) {
+          SOAPJob& job = m_soapJobs.at(*idx);
+          uint64_t waited = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(job.dispatched, now);
+          if (!job.busy) {
+            if (job.failed) {
+              ERROR("GEMSupervisor::sendToSupervisedApps " << command << " failed for "
+                    << job.app->getClassName() << ":lid:" << job.app->getLocalId() << ": " << job.error);
+              failures << " " << job.app->getClassName() << ":lid:" << job.app->getLocalId()
+                       << " (" << job.error << ")";
+            } else {
+              INFO("GEMSupervisor::sendToSupervisedApps " << job.app->getClassName() << ":lid:"
+                   << job.app->getLocalId() << " acknowledged " << command << " after " << waited/1000 << "ms");
+            }
+            idx = pending.erase(idx);
+          } else if (waited >= timeout) {
+            ERROR("GEMSupervisor::sendToSupervisedApps " << command << " timed out for "
+                  << job.app->getClassName() << ":lid:" << job.app->getLocalId()
+                  << " after " << waited/1000 << "ms, abandoning its workloop");
+            failures << " " << job.app->getClassName() << ":lid:" << job.app->getLocalId() << " (timed out)";
+            // the blocked SOAP call can't be cancelled, leave it to its workloop, whose late reply
+            // is then ignored by runSOAPJob, and give the application a fresh one for the next command
+            ++job.abandoned;
+            job.busy     = false;
+            job.failed   = true;
+            job.error    = "timed out";
+            job.workloop = getSOAPWorkLoop(job.app, job.abandoned);
+            idx = pending.erase(idx);
+          } else {
+            if (timeout - waited < nextDeadline)
+              nextDeadline = timeout - waited;
+            ++idx;
+          }
+        }
+      }
+      if (pending.empty())
+        break;
+
+      // sleep until the next reply arrives, or the earliest outstanding timeout expires
+      timeval wait;
+      wait.tv_sec  = nextDeadline/1000000;
+      wait.tv_usec = nextDeadline%1000000;
+      m_soapReply.take(&wait);
+    }
+  }
+
+  if (!failures.str().empty()) {
+    std::string msg = "Command " + command + " was not acknowledged by:" + failures.str();
+    XCEPT_RAISE(gem::supervisor::exception::Exception, msg);
+  }
+}
+
+toolbox::task::WorkLoop* gem::supervisor::GEMSupervisor::getSOAPWorkLoop(xdaq::ApplicationDescriptor* ad,
+                                                                         unsigned const& abandoned)
+{
+  std::string loopName = toolbox::toString("urn:toolbox-task-workloop:GEMSupervisor:lid%d:soap:%s:lid%d",
+                                           p_appDescriptor->getLocalId(),
+                                           ad->getClassName().c_str(), ad->getLocalId());
+  if (abandoned)
+    loopName += toolbox::toString(":%d", abandoned);
+  toolbox::task::WorkLoop* loop = toolbox::task::getWorkLoopFactory()->getWorkLoop(loopName, "waiting");
+  if (!loop->isActive())
+    loop->activate();
+  return loop;
+}
+
+bool gem::supervisor::GEMSupervisor::runSOAPJob(toolbox::task::WorkLoop* wl)
+{
+  SOAPJob job;
+  bool found = false;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+    for (auto j = m_soapJobs.begin(); j != m_soapJobs.end(); ++j) {
+      if (j->workloop == wl) {
+        job   = *j;
+        found = true;
+        break;
+      }
+    }
+  }
+  if (!found)
+    return false;
+
+  xdaq::ApplicationDescriptor* ad = job.app;
+  std::string error;
+  try {
+    if (isGEMApplication(ad->getClassName())) {
+      INFO("GEMSupervisor::runSOAPJob sending " << job.command << " with parameters to " << ad->getClassName());
+      gem::utils::soap::GEMSOAPToolBox::sendCommandWithParameters(job.command, getRunParameters(job.parameters),
+                                                                  p_appContext, p_appDescriptor, ad);
+    } else {
+      if (job.parameters & PARAM_CFGTYPE)
+        sendCfgType(m_cfgType.toString(), ad);
+      if (job.parameters & PARAM_RUNTYPE)
+        sendRunType(m_runType.toString(), ad);
+      if (job.parameters & PARAM_RUNNUMBER)
+        sendRunNumber(m_runNumber.value_, ad);
+      if (job.parameters & PARAM_SCANINFO)
+        sendScanParameters(ad);
+
+      INFO("GEMSupervisor::runSOAPJob sending " << job.command << " to " << ad->getClassName());
+      gem::utils::soap::GEMSOAPToolBox::sendCommand(job.command, p_appContext, p_appDescriptor, ad);
+    }
+    if (job.command == "Configure" && (ad->getClassName()).rfind("AMC13") != std::string::npos) {
+      INFO("GEMSupervisor::runSOAPJob Sending AMC13 Parameters to " << ad->getClassName());
+      gem::utils::soap::GEMSOAPToolBox::sendAMC13Config(p_appContext, p_appDescriptor, ad);
+    }
+  } catch (xcept::Exception& e) {
+    error = e.what();
+  } catch (std::exception& e) {
+    error = e.what();
+  } catch (...) {
+    error = "unknown exception";
+  }
+
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_soapLock);
+    for (auto j = m_soapJobs.begin(); j != m_soapJobs.end(); ++j) {
+      if (j->workloop == wl) {
+        j->busy   = false;
+        j->failed = !error.empty();
+        j->error  = error;
+        break;
+      }
+    }
+  }
+  m_soapReply.give();
+  return false;
+}
+
+xoap::MessageReference gem::supervisor::GEMSupervisor::StateNotification(xoap::MessageReference msg)
+  throw (xoap::exception::Exception)
+{
+  std::string commandName = "StateNotification";
+  std::string className, stateName, reason;
+  uint32_t instance = 0;
+  gem::utils::soap::GEMSOAPToolBox::extractStateNotification(msg, className, instance, stateName, reason);
+  DEBUG("GEMSupervisor::StateNotification " << className << ":" << instance << " is now " << stateName);
+  m_globalState.applicationStateChanged(className, instance, stateName, reason);
+  return gem::utils::soap::GEMSOAPToolBox::makeSOAPReply(commandName, "Received");
+}
+
 xoap::MessageReference gem::supervisor::GEMSupervisor::EndScanPoint(xoap::MessageReference msg)
   throw (xoap::exception::Exception)
 {
@@ -651,8 +861,7 @@ xoap::MessageReference gem::supervisor::GEMSupervisor::EndScanPoint(xoap::Messag
 
     while ((m_globalState.getStateName() != "Paused") && (getCurrentState() != "Paused")) {
       TRACE("GEMSupervisor::EndScanPoint GlobalState = " << m_globalState.getStateName());
-      usleep(100);//testing change of state
-      m_globalState.update();
+      m_globalState.waitForChange();
     }
 
     DEBUG("GEMSupervisor::EndScanPoint GlobalState = " << m_globalState.getStateName()
@@ -663,8 +872,7 @@ xoap::MessageReference gem::supervisor::GEMSupervisor::EndScanPoint(xoap::Messag
     m_scanParameter = updatedParameter;
     while ((m_globalState.getStateName() != "Running") && (getCurrentState() != "Running")) {
       TRACE("GEMSupervisor::EndScanPoint GlobalState = " << m_globalState.getStateName());
-      usleep(100);//testing change of state
-      m_globalState.update();
+      m_globalState.waitForChange();
     }
   } else {
     INFO("GEMSupervisor::EndScanPoint Scan Finished " << updatedParameter);
@@ -20,7 +20,8 @@ gem::supervisor::GEMSupervisorMonitor::GEMSupervisorMonitor(GEMSupervisor* gemSu
 
 gem::supervisor::GEMSupervisorMonitor::~GEMSupervisorMonitor()
 {
-  // default destructor
+  // make sure no update is running on this object while it is torn down
+  stopMonitoring();
 }
 
 void gem::supervisor::GEMSupervisorMonitor::setupAppStateMonitoring()
@@ -46,7 +47,8 @@ void gem::supervisor::GEMSupervisorMonitor::setupAppStateMonitoring()
 
 void gem::supervisor::GEMSupervisorMonitor::updateMonitorables()
 {
-  updateApplicationStates();
+  if (isSetDue("AppStates"))
+    updateApplicationStates();
   // updateTriggerCounts();
 }
 
@@ -1,5 +1,6 @@
 #include "gem/supervisor/tbutils/ADCScan.h"
 #include "gem/hw/vfat/HwVFAT2.h"
+#include "gem/utils/GEMLatencyHistogram.h"
 
 #include "TH1.h"
 #include "TF1.h"
@@ -9,6 +10,8 @@
 #include "TROOT.h"
 #include "TString.h"
 
+#include <time.h>
+
 #include <algorithm>
 #include <ctime>
 
@@ -88,8 +91,12 @@ gem::supervisor::tbutils::ADCScan::ADCScan(xdaq::ApplicationStub * s)
   is_running_     (false)
 {
 
-  curDACRegValue = 0;
-  curDACValue    = 0;
+  curDACRegValue   = 0;
+  curDACValue      = 0;
+  samplesTaken_    = 0;
+  totalSamples_    = 0;
+  acquisitionUsec_ = 0;
+  skippedPoints_   = 0;
   // Detect when the setting of default parameters has been performed
   this->getApplicationInfoSpace()->addListener(this, "urn:xdaq-event:setDefaultValues");
 
@@ -299,50 +306,50 @@ bool gem::supervisor::tbutils::ADCScan::run(toolbox::task::WorkLoop* wl)
     return false;
   }
 
+  // all samples of a DAC point are read in a single transaction
   if (samplesTaken_ < confParams_.bag.nSamples) {
+    uint32_t nSamples = confParams_.bag.nSamples;
+    timespec acqStart, acqStop;
+
     hw_semaphore_.take();
     vfatDevice_->setDeviceBaseNode("OptoHybrid.GEB.VFAT_ADC");
-    LOG4CPLUS_DEBUG(getApplicationLogger(), "trying to read the "
+    LOG4CPLUS_DEBUG(getApplicationLogger(), "reading " << nSamples << " samples of the "
                     << dacMap[confParams_.bag.dacToScan.toString()].first
                     << " ADC for "
                     << confParams_.bag.dacToScan.toString());
-    curDACValue = vfatDevice_->readReg(vfatDevice_->getDeviceBaseNode(),dacMap[confParams_.bag.dacToScan.toString()].first);
-
-    ++samplesTaken_;
+    register_pair_list samples(nSamples,
+                               register_pair(vfatDevice_->getDeviceBaseNode()+"."+
+                                             dacMap[confParams_.bag.dacToScan.toString()].first, 0x0));
+    clock_gettime(CLOCK_MONOTONIC, &acqStart);
+    bool read = vfatDevice_->readRegs(samples);
+    clock_gettime(CLOCK_MONOTONIC, &acqStop);
     vfatDevice_->setDeviceBaseNode("OptoHybrid.GEB.VFATS."+confParams_.bag.deviceName.toString());
     hw_semaphore_.give();
 
-    histo->Fill((unsigned)curDACRegValue, curDACValue);
+    samplesTaken_ = nSamples;
+    if (!read) {
+      // the samples are left at 0x0, filling them would pull the fit down
+      ++skippedPoints_;
+      LOG4CPLUS_WARN(getApplicationLogger(), "unable to read the samples of "
+                     << confParams_.bag.dacToScan.toString() << " = " << (unsigned)curDACRegValue
+                     << ", skipping the point");
+      wl_semaphore_.give();
+      return true;
+    }
+
+    acquisitionUsec_ += gem::utils::GEMLatencyHistogram::elapsedMicroseconds(acqStart, acqStop);
+    totalSamples_    += nSamples;
+
+    for (auto sample = samples.begin(); sample != samples.end(); ++sample)
+      histo->Fill((unsigned)curDACRegValue, sample->second);
+    if (!samples.empty())
+      curDACValue = samples.back().second;
 
     wl_semaphore_.give();
     return true;
   }
   else {
-    //move to the next point
-    std::string imgRoot = "${XDAQ_DOCUMENT_ROOT}/gemdaq/gemsupervisor/html/images/tbutils/dacscan/"+confParams_.bag.deviceName.toString()+"_";
-    std::stringstream ss;
-    ss << confParams_.bag.dacToScan.toString() << "_scan.png";
-    std::string imgName = ss.str();
-    //do a fit here to project the height of the image at the end
-    TF1* imgFit = new TF1("pol1","pol1",
-                          confParams_.bag.minDACValue-0.5,
-                          confParams_.bag.maxDACValue+0.5);
-    outputCanvas->cd();
-    histo->Draw("colz");
-    histo->Fit(imgFit,"QN");
-    double projVal = imgFit->Eval(confParams_.bag.maxDACValue);
-    LOG4CPLUS_INFO(getApplicationLogger(),"projected value a last step " << projVal);
-    histo->SetMaximum(1.2*projVal);
-    //histo->GetYaxis()->SetRangeUser(0., 1.2*projVal);
-    outputCanvas->cd();
-    //histo->SetMarkerStyle(23);
-    //histo->SetMarkerSize(2);
-    //outputCanvas->DrawFrame(-0.5,254.5,-0.5,1.2*projVal);
-    histo->Draw("colz");
-    outputCanvas->Update();
-    outputCanvas->SaveAs(TString(imgRoot+imgName));
-    delete imgFit;
-
+    //move to the next point, the fit and the image are only made once the scan is over
     samplesTaken_ = 0;
 
     if (curDACRegValue < confParams_.bag.maxDACValue) {
@@ -362,6 +369,17 @@ bool gem::supervisor::tbutils::ADCScan::run(toolbox::task::WorkLoop* wl)
       hw_semaphore_.take();
       vfatDevice_->setDeviceBaseNode("OptoHybrid.GEB.VFATS."+confParams_.bag.deviceName.toString());
       hw_semaphore_.give();
+
+      timespec scanStop;
+      clock_gettime(CLOCK_MONOTONIC, &scanStop);
+      uint64_t scanUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(scanStart_, scanStop);
+      LOG4CPLUS_INFO(getApplicationLogger(), "ADC scan of " << confParams_.bag.dacToScan.toString()
+                     << " took " << totalSamples_ << " samples in " << scanUsec/1.e6 << "s, "
+                     << getSamplesPerSecond() << " samples/s while reading, "
+                     << (scanUsec ? totalSamples_/(scanUsec/1.e6) : 0.) << " samples/s overall, "
+                     << skippedPoints_ << " point(s) skipped after a failed read");
+
+      writeScanImage();
       wl_semaphore_.give();
       wl_->submit(stopSig_);
       return false;
@@ -369,6 +387,32 @@ bool gem::supervisor::tbutils::ADCScan::run(toolbox::task::WorkLoop* wl)
   }
 }
 
+void gem::supervisor::tbutils::ADCScan::writeScanImage()
+{
+  std::string imgRoot = "${XDAQ_DOCUMENT_ROOT}/gemdaq/gemsupervisor/html/images/tbutils/dacscan/"+confParams_.bag.deviceName.toString()+"_";
+  std::stringstream ss;
+  ss << confParams_.bag.dacToScan.toString() << "_scan.png";
+  std::string imgName = ss.str();
+  //do a fit here to project the height of the image at the end
+  TF1* imgFit = new TF1("pol1","pol1",
+                        confParams_.bag.minDACValue-0.5,
+                        confParams_.bag.maxDACValue+0.5);
+  outputCanvas->cd();
+  histo->Fit(imgFit,"QN");
+  double projVal = imgFit->Eval(confParams_.bag.maxDACValue);
+  LOG4CPLUS_INFO(getApplicationLogger(),"projected value a last step " << projVal);
+  histo->SetMaximum(1.2*projVal);
+  histo->Draw("colz");
+  outputCanvas->Update();
+  outputCanvas->SaveAs(TString(imgRoot+imgName));
+  delete imgFit;
+}
+
+double gem::supervisor::tbutils::ADCScan::getSamplesPerSecond() const
+{
+  return acquisitionUsec_ ? totalSamples_/(acquisitionUsec_/1.e6) : 0.;
+}
+
 // SOAP interface
 xoap::MessageReference gem::supervisor::tbutils::ADCScan::onInitialize(xoap::MessageReference message)
   throw (xoap::exception::Exception) {
@@ -583,6 +627,11 @@ void gem::supervisor::tbutils::ADCScan::scanParameters(xgi::Output *out)
       .set("type","number").set("min","0").set("readonly")
       .set("value",boost::str(boost::format("%d")%(samplesTaken_)))
          << cgicc::br() << std::endl
+         << cgicc::label("Samples/s").set("for","SamplesPerSecond") << std::endl
+         << cgicc::input().set("id","SamplesPerSecond").set("name","SamplesPerSecond")
+      .set("type","text").set("readonly")
+      .set("value",boost::str(boost::format("%.0f")%(getSamplesPerSecond())))
+         << cgicc::br() << std::endl
 
          << cgicc::span()   << std::endl;
   }
@@ -1174,7 +1223,11 @@ void gem::supervisor::tbutils::ADCScan::startAction(toolbox::Event::Reference e)
 
   is_working_ = true;
 
-  samplesTaken_ = 0;
+  samplesTaken_    = 0;
+  totalSamples_    = 0;
+  acquisitionUsec_ = 0;
+  skippedPoints_   = 0;
+  clock_gettime(CLOCK_MONOTONIC, &scanStart_);
 
   time_t now = time(0);
   // convert now to string form
@@ -0,0 +1,406 @@
+/**
+ * class: GEMSCurveFitter
+ * description: Parallel error function fits of threshold and calibration scan S-curves
+ */
+
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+#include "gem/supervisor/tbutils/GEMSCurveFitter.h"
+
+#include "gem/utils/GEMLogging.h"
+#include "gem/utils/LockGuard.h"
+
+#include "toolbox/string.h"
+#include "toolbox/task/exception/Exception.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
+#include "toolbox/task/Action.h"
+
+const double gem::supervisor::tbutils::GEMSCurveFitter::MAX_CHI2_NDF = 10.;
+
+gem::supervisor::tbutils::GEMSCurveFitter::GEMSCurveFitter(std::string const& name, unsigned const& nWorkers) :
+  m_gemLogger(log4cplus::Logger::getInstance("GEMSCurveFitter")),
+  m_lock(toolbox::BSem::FULL, true),
+  m_doneLock(toolbox::BSem::FULL, true),
+  m_rangeDone(toolbox::BSem::EMPTY),
+  m_nDone(0),
+  p_fitSig(NULL),
+  p_x(NULL),
+  p_hits(NULL),
+  p_fits(NULL),
+  m_nPoints(0),
+  m_nTriggers(0),
+  m_wallUsec(0),
+  m_nFits(0)
+{
+  for (unsigned s = 0; s < N_FIT_STATUS; ++s)
+    m_statusCount[s] = 0;
+
+  unsigned nLoops = nWorkers;
+  if (nLoops == 0) {
+    long nCPU = sysconf(_SC_NPROCESSORS_ONLN);
+    nLoops = nCPU > 0 ? static_cast<unsigned>(nCPU) : 1;
+  }
+  if (nLoops > MAX_WORKERS)
+    nLoops = MAX_WORKERS;
+
+  p_fitSig = toolbox::task::bind(this, &GEMSCurveFitter::fitRange, "fitRange");
+  for (unsigned w = 0; w < nLoops; ++w) {
+    std::string loopName = toolbox::toString("urn:toolbox-task-workloop:%s:fit:worker%d", name.c_str(), w);
+    Worker worker;
+    worker.workloop = toolbox::task::getWorkLoopFactory()->getWorkLoop(loopName, "waiting");
+    worker.first    = 0;
+    worker.last     = 0;
+    if (!worker.workloop->isActive())
+      worker.workloop->activate();
+    m_workers.push_back(worker);
+  }
+  DEBUG("GEMSCurveFitter::GEMSCurveFitter created " << m_workers.size() << " fit workers");
+}
+
+gem::supervisor::tbutils::GEMSCurveFitter::~GEMSCurveFitter()
+{
+  for (auto worker = m_workers.begin(); worker != m_workers.end(); ++worker) {
+    try {
+      worker->workloop->cancel();
+    } catch (toolbox::task::exception::Exception& e) {
+      WARN("GEMSCurveFitter::~GEMSCurveFitter unable to cancel fit workloop: " << e.what());
+    }
+  }
+}
+
+void gem::supervisor::tbutils::GEMSCurveFitter::fitAll(std::vector<double> const& x,
+                                                       std::vector<uint32_t> const& hits,
+                                                       uint32_t const& nTriggers,
+                                                       std::vector<SCurveFit>& fits)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+
+  size_t nCurves = x.empty() ? 0 : hits.size()/x.size();
+  fits.resize(nCurves);
+  m_fitTimes.reset();
+  m_nFits = nCurves;
+  for (unsigned s = 0; s < N_FIT_STATUS; ++s)
+    m_statusCount[s] = 0;
+  if (nCurves == 0) {
+    m_wallUsec = 0;
+    return;
+  }
+
+  timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  p_x         = &x[0];
+  p_hits      = &hits[0];
+  p_fits      = &fits[0];
+  m_nPoints   = x.size();
+  m_nTriggers = nTriggers;
+
+  // contiguous ranges, so each worker walks through its part of the hit array in order
+  size_t perWorker  = nCurves/m_workers.size();
+  size_t remainder  = nCurves%m_workers.size();
+  size_t first      = 0;
+  unsigned nSubmitted = 0;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> doneLock(m_doneLock);
+    m_nDone = 0;
+  }
+  for (size_t w = 0; w < m_workers.size() && first < nCurves; ++w) {
+    size_t count = perWorker + (w < remainder ? 1 : 0);
+    m_workers[w].first = first;
+    m_workers[w].last  = first + count;
+    m_workers[w].fitTimes.reset();
+    first += count;
+    m_workers[w].workloop->submit(p_fitSig);
+    ++nSubmitted;
+  }
+
+  // m_rangeDone is binary, gives from workers finishing together collapse into one,
+  // so the finished ranges are counted under m_doneLock and the semaphore only wakes us up
+  while (true) {
+    {
+      gem::utils::LockGuard<gem::utils::Lock> doneLock(m_doneLock);
+      if (m_nDone >= nSubmitted)
+        break;
+    }
+    m_rangeDone.take();
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+  m_wallUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+
+  for (auto worker = m_workers.begin(); worker != m_workers.end(); ++worker)
+    m_fitTimes.merge(worker->fitTimes);
+  for (auto fit = fits.begin(); fit != fits.end(); ++fit)
+    ++m_statusCount[fit->status];
+
+  p_x    = NULL;
+  p_hits = NULL;
+  p_fits = NULL;
+
+  DEBUG("GEMSCurveFitter::fitAll " << getStatistics());
+}
+
+bool gem::supervisor::tbutils::GEMSCurveFitter::fitRange(toolbox::task::WorkLoop* wl)
+{
+  // the job pointers and ranges are only changed by fitAll, which waits for all workers
+  Worker* worker = NULL;
+  for (auto w = m_workers.begin(); w != m_workers.end(); ++w) {
+    if (w->workloop == wl) {
+      worker = &(*w);
+      break;
+    }
+  }
+  if (!worker)
+    return false;
+
+  timespec start, stop;
+  for (size_t curve = worker->first; curve < worker->last; ++curve) {
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    p_fits[curve] = fit(p_x, p_hits + curve*m_nPoints, m_nPoints, m_nTriggers);
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    worker->fitTimes.record(gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop));
+  }
+
+  {
+    gem::utils::LockGuard<gem::utils::Lock> doneLock(m_doneLock);
+    ++m_nDone;
+  }
+  m_rangeDone.give();
+  return false;
+}
+
+std::string gem::supervisor::tbutils::GEMSCurveFitter::getStatistics() const
+{
+  std::stringstream stats;
+  stats << m_nFits << " fits with " << m_workers.size() << " workers in "
+        << std::fixed << std::setprecision(3) << m_wallUsec/1.e6 << "s";
+  if (m_wallUsec > 0)
+    stats << " (" << std::setprecision(0) << m_nFits/(m_wallUsec/1.e6) << " fits/s)";
+  stats << ", per fit " << m_fitTimes.toString() << ", status:";
+  for (unsigned s = 0; s < N_FIT_STATUS; ++s)
+    if (m_statusCount[s])
+      stats << " " << statusName(static_cast<FitStatus>(s)) << "=" << m_statusCount[s];
+  return stats.str();
+}
+
+std::string gem::supervisor::tbutils::GEMSCurveFitter::statusName(FitStatus const& status)
+{
+  switch (status) {
+  case FIT_OK:            return "OK";
+  case FIT_NO_DATA:       return "NO_DATA";
+  case FIT_NO_TRANSITION: return "NO_TRANSITION";
+  case FIT_NOT_CONVERGED: return "NOT_CONVERGED";
+  case FIT_OUT_OF_RANGE:  return "OUT_OF_RANGE";
+  case FIT_BAD_CHI2:      return "BAD_CHI2";
+  default:                return "UNKNOWN";
+  }
+}
+
+void gem::supervisor::tbutils::GEMSCurveFitter::occupancy(uint32_t const& hits, uint32_t const& nTriggers,
+                                                          double& y, double& w)
+{
+  double p = (hits + 1.)/(nTriggers + 2.);
+  y = static_cast<double>(hits)/nTriggers;
+  w = (nTriggers + 2.)/(p*(1. - p));
+  if (p >= 1.)  // more hits than triggers, noisy channel
+    w = 1.;
+}
+
+double gem::supervisor::tbutils::GEMSCurveFitter::chi2(double const* x, uint32_t const* hits,
+                                                       size_t const& nPoints, uint32_t const& nTriggers,
+                                                       double const* par, double const& sign)
+{
+  double scale = sign/(M_SQRT2*par[2]);
+  double sum   = 0.;
+  double y, w;
+  for (size_t i = 0; i < nPoints; ++i) {
+    occupancy(hits[i], nTriggers, y, w);
+    double r = y - 0.5*par[0]*(1. + erf(scale*(x[i] - par[1])));
+    sum += w*r*r;
+  }
+  return sum;
+}
+
+bool gem::supervisor::tbutils::GEMSCurveFitter::solve3(double m[3][3], double v[3], double solution[3])
+{
+  for (int col = 0; col < 3; ++col) {
+    int pivot = col;
+    for (int row = col + 1; row < 3; ++row)
+      if (fabs(m[row][col]) > fabs(m[pivot][col]))
+        pivot = row;
+    if (fabs(m[pivot][col]) < 1e-300)
+      return false;
+    if (pivot != col) {
+      for (int k = 0; k < 3; ++k) {
+        double tmp = m[col][k]; m[col][k] = m[pivot][k]; m[pivot][k] = tmp;
+      }
+      double tmp = v[col]; v[col] = v[pivot]; v[pivot] = tmp;
+    }
+    for (int row = col + 1; row < 3; ++row) {
+      double f = m[row][col]/m[col][col];
+      for (int k = col; k < 3; ++k)
+        m[row][k] -= f*m[col][k];
+      v[row] -= f*v[col];
+    }
+  }
+  for (int row = 2; row >= 0; --row) {
+    double sum = v[row];
+    for (int k = row + 1; k < 3; ++k)
+      sum -= m[row][k]*solution[k];
+    solution[row] = sum/m[row][row];
+  }
+  return true;
+}
+
+gem::supervisor::tbutils::GEMSCurveFitter::SCurveFit gem::supervisor::tbutils::GEMSCurveFitter::fit(
+  double const* x, uint32_t const* hits, size_t const& nPoints, uint32_t const& nTriggers)
+{
+  SCurveFit result;
+  result.threshold  = 0.;
+  result.noise      = 0.;
+  result.amplitude  = 0.;
+  result.chi2       = 0.;
+  result.ndf        = 0;
+  result.iterations = 0;
+  result.rising     = true;
+  result.status     = FIT_NO_DATA;
+  if (nPoints < MIN_POINTS || nTriggers == 0)
+    return result;
+  result.ndf = nPoints - 3;
+
+  // direction of the transition from the average occupancy of the first and last third
+  size_t   third = nPoints/3;
+  uint64_t low = 0, high = 0;
+  uint32_t minHits = hits[0], maxHits = hits[0];
+  for (size_t i = 0; i < nPoints; ++i) {
+    if (i < third)
+      low += hits[i];
+    else if (i >= nPoints - third)
+      high += hits[i];
+    if (hits[i] < minHits)
+      minHits = hits[i];
+    if (hits[i] > maxHits)
+      maxHits = hits[i];
+  }
+  result.rising = high >= low;
+  double sign   = result.rising ? 1. : -1.;
+
+  // less than a couple of percent between lowest and highest point, nothing to fit
+  if ((maxHits - minHits) < 3 || (maxHits - minHits) < 0.02*nTriggers) {
+    result.status = FIT_NO_TRANSITION;
+    return result;
+  }
+
+  // initial values from the moments of the derivative, which for an S-curve is a gaussian
+  double sumD = 0., sumDX = 0., sumDX2 = 0., minStep = x[nPoints-1] - x[0];
+  for (size_t i = 1; i < nPoints; ++i) {
+    double d  = sign*(static_cast<double>(hits[i]) - static_cast<double>(hits[i-1]));
+    double xm = 0.5*(x[i] + x[i-1]);
+    if (x[i] - x[i-1] < minStep)
+      minStep = x[i] - x[i-1];
+    if (d <= 0.)
+      continue;
+    sumD   += d;
+    sumDX  += d*xm;
+    sumDX2 += d*xm*xm;
+  }
+  if (sumD <= 0.) {
+    result.status = FIT_NO_TRANSITION;
+    return result;
+  }
+  double minSigma = minStep > 0. ? 0.1*minStep : 1e-3;
+  double par[3];
+  par[0] = static_cast<double>(maxHits)/nTriggers;
+  par[1] = sumDX/sumD;
+  par[2] = sqrt(std::max(sumDX2/sumD - par[1]*par[1], 0.));
+  if (par[2] < 0.5*minStep)
+    par[2] = 0.5*minStep > minSigma ? 0.5*minStep : minSigma;
+
+  // Levenberg-Marquardt, the jacobian is accumulated directly into the normal equations
+  double lambda   = 1e-3;
+  double chi2Best = chi2(x, hits, nPoints, nTriggers, par, sign);
+  bool   converged = false;
+  unsigned iter = 0;
+  for (; iter < MAX_ITERATIONS && !converged; ++iter) {
+    double jtj[3][3] = {{0.,0.,0.},{0.,0.,0.},{0.,0.,0.}};
+    double jtr[3]    = {0.,0.,0.};
+    double scale = sign/(M_SQRT2*par[2]);
+    double y, w;
+    for (size_t i = 0; i < nPoints; ++i) {
+      occupancy(hits[i], nTriggers, y, w);
+      double z     = scale*(x[i] - par[1]);
+      double gauss = par[0]*M_2_SQRTPI*0.5*exp(-z*z);
+      double j[3];
+      j[0] = 0.5*(1. + erf(z));
+      j[1] = -gauss*scale;
+      j[2] = -gauss*z/par[2];
+      double r = y - par[0]*j[0];
+      for (int a = 0; a < 3; ++a) {
+        jtr[a] += w*j[a]*r;
+        for (int b = 0; b <= a; ++b)
+          jtj[a][b] += w*j[a]*j[b];
+      }
+    }
+    for (int a = 0; a < 3; ++a)
+      for (int b = a + 1; b < 3; ++b)
+        jtj[a][b] = jtj[b][a];
+
+    // increase the damping until a step lowers the chi2
+    while (true) {
+      double m[3][3], v[3], delta[3];
+      for (int a = 0; a < 3; ++a) {
+        for (int b = 0; b < 3; ++b)
+          m[a][b] = jtj[a][b];
+        m[a][a] += lambda*jtj[a][a];
+        v[a] = jtr[a];
+      }
+
+      double trial[3];
+      bool   solved = solve3(m, v, delta);
+      if (solved) {
+        for (int a = 0; a < 3; ++a)
+          trial[a] = par[a] + delta[a];
+      }
+      if (solved && trial[2] > minSigma && trial[0] > 0.) {
+        double chi2Trial = chi2(x, hits, nPoints, nTriggers, trial, sign);
+        if (chi2Trial <= chi2Best) {
+          converged = (chi2Best - chi2Trial) <= 1e-6*chi2Best + 1e-12;
+          for (int a = 0; a < 3; ++a)
+            par[a] = trial[a];
+          chi2Best = chi2Trial;
+          lambda  *= 0.1;
+          break;
+        }
+      }
+      lambda *= 10.;
+      if (lambda > 1e10) {
+        // no step improves the chi2 any more, we are at the minimum
+        converged = true;
+        break;
+      }
+    }
+  }
+
+  result.amplitude  = par[0];
+  result.threshold  = par[1];
+  result.noise      = par[2];
+  result.chi2       = chi2Best;
+  result.iterations = iter;
+
+  if (!converged)
+    result.status = FIT_NOT_CONVERGED;
+  else if (par[1] < x[0] || par[1] > x[nPoints-1])
+    result.status = FIT_OUT_OF_RANGE;
+  else if (chi2Best/result.ndf > MAX_CHI2_NDF)
+    result.status = FIT_BAD_CHI2;
+  else
+    result.status = FIT_OK;
+  return result;
+}
@@ -0,0 +1,270 @@
+/**
+ * class: GEMScanOrchestrator
+ * description: Runs firmware scans concurrently on several OptoHybrid links,
+ *              one workloop per link, and merges the per chip results
+ */
+
+#include <unistd.h>
+#include <time.h>
+
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+#include "gem/supervisor/tbutils/GEMScanOrchestrator.h"
+
+#include "gem/hw/optohybrid/HwOptoHybrid.h"
+
+#include "gem/utils/GEMLogging.h"
+#include "gem/utils/GEMLatencyHistogram.h"
+#include "gem/utils/LockGuard.h"
+
+#include "toolbox/string.h"
+#include "toolbox/task/exception/Exception.h"
+#include "toolbox/task/WorkLoop.h"
+#include "toolbox/task/WorkLoopFactory.h"
+#include "toolbox/task/Action.h"
+
+#include "xcept/Exception.h"
+
+gem::supervisor::tbutils::GEMScanOrchestrator::GEMScanOrchestrator(std::string const& name) :
+  m_gemLogger(log4cplus::Logger::getInstance("GEMScanOrchestrator")),
+  m_lock(toolbox::BSem::FULL, true),
+  m_linkDone(toolbox::BSem::EMPTY),
+  m_name(name),
+  p_scanSig(NULL),
+  m_scanUsec(0),
+  m_nChips(0),
+  m_nDone(0)
+{
+  p_scanSig = toolbox::task::bind(this, &GEMScanOrchestrator::scanLink, "scanLink");
+}
+
+gem::supervisor::tbutils::GEMScanOrchestrator::~GEMScanOrchestrator()
+{
+  for (auto link = m_links.begin(); link != m_links.end(); ++link) {
+    try {
+      link->workloop->cancel();
+    } catch (toolbox::task::exception::Exception& e) {
+      WARN("GEMScanOrchestrator::~GEMScanOrchestrator unable to cancel workloop for link "
+           << link->link << ": " << e.what());
+    }
+  }
+}
+
+void gem::supervisor::tbutils::GEMScanOrchestrator::addLink(int const& link,
+                                                            std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid> optohybrid,
+                                                            uint32_t const& vfatMask)
+{
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  for (auto l = m_links.begin(); l != m_links.end(); ++l) {
+    if (l->link == link) {
+      l->optohybrid = optohybrid;
+      l->vfatMask   = vfatMask;
+      return;
+    }
+  }
+
+  std::string loopName = toolbox::toString("urn:toolbox-task-workloop:%s:scan:link%d", m_name.c_str(), link);
+  toolbox::task::WorkLoop* loop = toolbox::task::getWorkLoopFactory()->getWorkLoop(loopName, "waiting");
+  if (!loop->isActive())
+    loop->activate();
+
+  ScanLink scanLink;
+  scanLink.link       = link;
+  scanLink.optohybrid = optohybrid;
+  scanLink.vfatMask   = vfatMask;
+  scanLink.workloop   = loop;
+  scanLink.busy       = false;
+  scanLink.success    = false;
+  scanLink.usec       = 0;
+  m_links.push_back(scanLink);
+  INFO("GEMScanOrchestrator::addLink added link " << link << " with VFAT mask 0x"
+       << std::hex << std::setw(8) << std::setfill('0') << vfatMask << std::dec);
+}
+
+bool gem::supervisor::tbutils::GEMScanOrchestrator::runScan(ScanConfig const& config)
+{
+  timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  unsigned nSubmitted = 0;
+  bool     success    = true;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+    m_config = config;
+    m_results.clear();
+    m_nDone = 0;
+    for (auto link = m_links.begin(); link != m_links.end(); ++link) {
+      if (link->busy) {
+        ERROR("GEMScanOrchestrator::runScan link " << link->link << " is still running the previous scan");
+        success = false;
+        continue;
+      }
+      link->busy    = true;
+      link->success = false;
+      link->usec    = 0;
+      link->results.clear();
+      link->workloop->submit(p_scanSig);
+      ++nSubmitted;
+    }
+  }
+
+  // each link enforces its own timeout, so every submitted job reports back.
+  // m_linkDone is binary, gives from links finishing together collapse into one,
+  // so the finished links are counted under the lock and the semaphore only wakes us up
+  while (true) {
+    {
+      gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+      if (m_nDone >= nSubmitted)
+        break;
+    }
+    m_linkDone.take();
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+  m_scanUsec = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+  m_nChips   = 0;
+  for (auto link = m_links.begin(); link != m_links.end(); ++link) {
+    if (link->busy || !link->success) {
+      success = false;
+      continue;
+    }
+    m_nChips += link->results.size();
+    m_results[link->link] = link->results;
+  }
+  INFO("GEMScanOrchestrator::runScan " << getStatistics());
+  return success;
+}
+
+bool gem::supervisor::tbutils::GEMScanOrchestrator::scanLink(toolbox::task::WorkLoop* wl)
+{
+  std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid> optohybrid;
+  uint32_t   vfatMask = 0;
+  int        linkID   = -1;
+  ScanConfig config;
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+    for (auto link = m_links.begin(); link != m_links.end(); ++link) {
+      if (link->workloop == wl) {
+        optohybrid = link->optohybrid;
+        vfatMask   = link->vfatMask;
+        linkID     = link->link;
+        break;
+      }
+    }
+    config = m_config;
+  }
+  if (linkID < 0)
+    return false;
+
+  timespec start, stop;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  ChipResults results;
+  bool success = false;
+  try {
+    success = runLinkScan(*optohybrid, vfatMask, config, results);
+  } catch (xcept::Exception& e) {
+    ERROR("GEMScanOrchestrator::scanLink link " << linkID << " failed: " << e.what());
+  } catch (std::exception& e) {
+    ERROR("GEMScanOrchestrator::scanLink link " << linkID << " failed: " << e.what());
+  }
+  clock_gettime(CLOCK_MONOTONIC, &stop);
+
+  {
+    gem::utils::LockGuard<gem::utils::Lock> guardedLock(m_lock);
+    for (auto link = m_links.begin(); link != m_links.end(); ++link) {
+      if (link->workloop == wl) {
+        link->results.swap(results);
+        link->success = success;
+        link->usec    = gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, stop);
+        link->busy    = false;
+        break;
+      }
+    }
+    ++m_nDone;
+  }
+  m_linkDone.give();
+  return false;
+}
+
+bool gem::supervisor::tbutils::GEMScanOrchestrator::runLinkScan(gem::hw::optohybrid::HwOptoHybrid& optohybrid,
+                                                                uint32_t const& vfatMask,
+                                                                ScanConfig const& config,
+                                                                ChipResults& results)
+{
+  log4cplus::Logger m_gemLogger(log4cplus::Logger::getInstance("GEMScanOrchestrator"));
+  results.clear();
+  uint32_t npoints = gem::hw::optohybrid::HwOptoHybrid::getScanPoints(config.min, config.max, config.step);
+  if (npoints == 0) {
+    WARN("GEMScanOrchestrator::runLinkScan empty scan range [" << (int)config.min << "," << (int)config.max
+         << "] with step " << (int)config.step);
+    return false;
+  }
+
+  DEBUG("GEMScanOrchestrator::runLinkScan mode " << (int)config.mode << " from " << (int)config.min
+        << " to " << (int)config.max << " in steps of " << (int)config.step << " (" << npoints << " points), "
+        << config.nTriggers << " triggers per point, VFAT mask 0x" << std::hex << vfatMask << std::dec);
+
+  // the OptoHybrid scan controller runs on one VFAT at a time, the links still run in parallel
+  uint64_t timeoutUsec = static_cast<uint64_t>(config.timeoutSec)*1000000;
+  uint64_t nPolls      = 0;
+  timespec start, now;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  for (uint8_t chip = 0; chip < gem::hw::optohybrid::MAX_VFATS; ++chip) {
+    if ((vfatMask >> chip) & 0x1)
+      continue;
+
+    optohybrid.configureScanGenerator(config.mode, config.min, config.max, config.step, chip, config.channel, true);
+    optohybrid.startScanGenerator(config.nTriggers);
+
+    while (optohybrid.statusScanGenerator()) {
+      ++nPolls;
+      // the register reads take time as well, so the time is measured rather than the polls counted
+      clock_gettime(CLOCK_MONOTONIC, &now);
+      if (gem::utils::GEMLatencyHistogram::elapsedMicroseconds(start, now) > timeoutUsec) {
+        ERROR("GEMScanOrchestrator::runLinkScan scan did not finish within " << config.timeoutSec << "s");
+        optohybrid.stopScanGenerator(true);
+        return false;
+      }
+      usleep(POLL_USEC);
+    }
+
+    results[chip] = optohybrid.getScanResults(npoints);
+  }
+
+  DEBUG("GEMScanOrchestrator::runLinkScan finished after " << nPolls << " polls, read "
+        << npoints << " points from " << results.size() << " VFATs");
+  return true;
+}
+
+std::string gem::supervisor::tbutils::GEMScanOrchestrator::getStatistics() const
+{
+  std::stringstream stats;
+  double minutes = m_scanUsec/60.e6;
+  stats << m_nChips << " chips on " << m_links.size() << " links in "
+        << std::fixed << std::setprecision(2) << m_scanUsec/1.e6 << "s";
+  if (minutes > 0)
+    stats << " (" << std::setprecision(1) << m_nChips/minutes << " chips/min)";
+  for (auto link = m_links.begin(); link != m_links.end(); ++link)
+    stats << std::endl << "  link " << link->link << ": "
+          << (link->success ? "ok" : "FAILED") << ", " << link->results.size() << " chips in "
+          << std::setprecision(2) << link->usec/1.e6 << "s";
+  return stats.str();
+}
+
+void gem::supervisor::tbutils::GEMScanOrchestrator::writeResults(std::string const& fileName,
+                                                                 LinkResults const& results)
+{
+  std::ofstream outf(fileName.c_str());
+  outf << "# link slot value hits" << std::endl;
+  for (auto link = results.begin(); link != results.end(); ++link)
+    for (auto chip = link->second.begin(); chip != link->second.end(); ++chip)
+      for (auto point = chip->second.begin(); point != chip->second.end(); ++point)
+        outf << link->first << " " << (int)chip->first << " "
+             << ((*point >> 24) & 0xff) << " " << (*point & 0xffffff) << std::endl;
+  outf.close();
+}
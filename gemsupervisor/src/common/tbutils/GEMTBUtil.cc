@@ -6,6 +6,10 @@
 #include "gem/utils/GEMLogging.h"
 #include "gem/utils/soap/GEMSOAPToolBox.h"
 
+#include "TH1.h"
+#include "TFile.h"
+#include "TString.h"
+
 #include <algorithm>
 #include <ctime>
 
@@ -13,6 +17,7 @@
 #include <iostream>
 #include <ctime>
 #include <sstream>
+#include <fstream>
 #include <cstdlib>
 
 #include "cgicc/HTTPRedirectHeader.h"
@@ -20,6 +25,7 @@
 #include <string>
 
 #include "gem/supervisor/tbutils/VFAT2XMLParser.h"
+#include "gem/supervisor/tbutils/GEMTrimDACCalibration.h"
 
 #include "xoap/MessageReference.h"
 #include "xoap/MessageFactory.h"
@@ -74,6 +80,18 @@ void gem::supervisor::tbutils::GEMTBUtil::ConfigParams::registerFields(xdata::Ba
   bag->addField("slotFileName",  &slotFileName);
   bag->addField("enableLEMOTrigger",  &enableLEMOTrigger);
 
+  // the OptoHybrid ScanController only exists in the V2 OptoHybrid firmware,
+  // older firmware has to be scanned point by point from the software
+  useFirmwareScan = false;
+  scanAllLinks    = false;
+  bag->addField("useFirmwareScan",    &useFirmwareScan);
+  bag->addField("scanAllLinks",       &scanAllLinks);
+
+  trimChannels = false;
+  trimTarget   = -1;
+  bag->addField("trimChannels",       &trimChannels);
+  bag->addField("trimTarget",         &trimTarget);
+
 
 }
 
@@ -1337,6 +1355,8 @@ void gem::supervisor::tbutils::GEMTBUtil::initializeAction(toolbox::Event::Refer
     return;
   }
 
+  setupScanOrchestrator(tmpURI.str());
+
   is_initialized_ = true;
   hw_semaphore_.give();
 
@@ -1842,3 +1862,254 @@ void gem::supervisor::tbutils::GEMTBUtil::AMC13TriggerSetup()
   }
   DEBUG("-----------The message to AMC13 configuring parameters has been sent------------");
 }
+
+bool gem::supervisor::tbutils::GEMTBUtil::configureOtherLinks()
+{
+  if (m_linkChips.empty())
+    return true;
+
+  if (vfatDevice_.empty()) {
+    ERROR("GEMTBUtil::configureOtherLinks no chip selected to take the settings of the other links from");
+    return false;
+  }
+
+  // the derived scans only configure the selected chips
+  uint8_t vt1     = vfatDevice_.front()->getVThreshold1();
+  uint8_t vt2     = vfatDevice_.front()->getVThreshold2();
+  uint8_t runMode = vfatDevice_.front()->getRunMode();
+  for (auto link = m_linkChips.begin(); link != m_linkChips.end(); ++link) {
+    DEBUG("GEMTBUtil::configureOtherLinks setting VT1 " << (int)vt1 << ", VT2 " << (int)vt2
+          << " and run mode " << (int)runMode << " on the " << link->second.size() << " chips of link " << link->first);
+    for (auto chip = link->second.begin(); chip != link->second.end(); ++chip) {
+      (*chip)->setVThreshold1(vt1);
+      (*chip)->setVThreshold2(vt2);
+      (*chip)->setRunMode(runMode);
+    }
+  }
+  return true;
+}
+
+bool gem::supervisor::tbutils::GEMTBUtil::runFirmwareScan(uint8_t  const& mode,
+                                                         uint8_t  const& min,
+                                                         uint8_t  const& max,
+                                                         uint8_t  const& step,
+                                                         uint32_t const& nTriggers,
+                                                         GEMScanOrchestrator::LinkResults& results)
+{
+  GEMScanOrchestrator::ScanConfig config;
+  config.mode       = mode;
+  config.min        = min;
+  config.max        = max;
+  config.step       = step;
+  config.channel    = 0;
+  config.nTriggers  = nTriggers;
+  config.timeoutSec = FW_SCAN_TIMEOUT_SEC;
+
+  results.clear();
+  if (confParams_.bag.scanAllLinks && p_scanOrchestrator) {
+    bool configured = false;
+    try {
+      configured = configureOtherLinks();
+    } catch (xcept::Exception& e) {
+      ERROR("GEMTBUtil::runFirmwareScan unable to configure the chips of the other links: " << e.what());
+    } catch (std::exception& e) {
+      ERROR("GEMTBUtil::runFirmwareScan unable to configure the chips of the other links: " << e.what());
+    }
+    if (!configured)
+      return false;
+    bool success = p_scanOrchestrator->runScan(config);
+    results = p_scanOrchestrator->getResults();
+    return success;
+  }
+
+  // only the selected chips take part in the scan
+  uint32_t chipMask = gem::hw::optohybrid::ALL_VFATS_DATA_MASK;
+  for (auto chip = vfatDevice_.begin(); chip != vfatDevice_.end(); ++chip)
+    chipMask &= ~(0x1 << (*chip)->getSlot());
+
+  try {
+    return GEMScanOrchestrator::runLinkScan(*optohybridDevice_, chipMask, config,
+                                            results[confParams_.bag.ohGTXLink.value_]);
+  } catch (xcept::Exception& e) {
+    ERROR("GEMTBUtil::runFirmwareScan unable to read the scan results: " << e.what());
+  } catch (std::exception& e) {
+    ERROR("GEMTBUtil::runFirmwareScan unable to read the scan results: " << e.what());
+  }
+  results.clear();
+  return false;
+}
+
+void gem::supervisor::tbutils::GEMTBUtil::writeFirmwareScanResults(std::string const& scanName,
+                                                                  GEMScanOrchestrator::LinkResults const& results,
+                                                                  std::string const& xTitle)
+{
+  std::string fileName = scanFileName(scanName+"_FW");
+  GEMScanOrchestrator::writeResults(fileName, results);
+  INFO("GEMTBUtil::writeFirmwareScanResults wrote " << scanName << " results to " << fileName);
+
+  // the same histograms the software scans get from the DAQ stream, one per chip
+  std::string rootFileName = fileName.substr(0, fileName.rfind(".dat"))+".root";
+  TFile* outFile = TFile::Open(rootFileName.c_str(), "RECREATE");
+  if (!outFile || outFile->IsZombie()) {
+    ERROR("GEMTBUtil::writeFirmwareScanResults unable to open " << rootFileName);
+    delete outFile;
+    return;
+  }
+
+  outFile->cd();
+  for (auto link = results.begin(); link != results.end(); ++link) {
+    for (auto chip = link->second.begin(); chip != link->second.end(); ++chip) {
+      if (chip->second.empty())
+        continue;
+      int minVal = (chip->second.front() >> 24) & 0xff;
+      int maxVal = (chip->second.back()  >> 24) & 0xff;
+      double halfStep = chip->second.size() > 1 ? 0.5*(maxVal-minVal)/(chip->second.size()-1) : 0.5;
+      TString histName  = toolbox::toString("link%d_VFAT%d", link->first, (int)chip->first);
+      TString histTitle = toolbox::toString("%s link %d VFAT %d;%s;hits", scanName.c_str(), link->first,
+                                            (int)chip->first, xTitle.c_str());
+      TH1F* histo = new TH1F(histName, histTitle, chip->second.size(), minVal-halfStep, maxVal+halfStep);
+      for (auto point = chip->second.begin(); point != chip->second.end(); ++point)
+        histo->Fill((*point >> 24) & 0xff, *point & 0xffffff);
+    }
+  }
+  outFile->Write();
+  outFile->Close();
+  delete outFile;  // also deletes the histograms it owns
+  INFO("GEMTBUtil::writeFirmwareScanResults wrote " << scanName << " histograms to " << rootFileName);
+}
+
+void gem::supervisor::tbutils::GEMTBUtil::fitFirmwareScanResults(std::string const& scanName,
+                                                                GEMScanOrchestrator::LinkResults const& results,
+                                                                uint32_t const& nTriggers)
+{
+  // all chips are scanned over the same points, the scanned value sits in the 8 MSBs of each word
+  std::vector<double>   x;
+  std::vector<uint32_t> hits;
+  std::vector<std::pair<int, uint8_t> > chips;
+  for (auto link = results.begin(); link != results.end(); ++link) {
+    for (auto chip = link->second.begin(); chip != link->second.end(); ++chip) {
+      if (x.empty())
+        for (auto point = chip->second.begin(); point != chip->second.end(); ++point)
+          x.push_back((*point >> 24) & 0xff);
+      if (chip->second.size() != x.size()) {
+        WARN("GEMTBUtil::fitFirmwareScanResults link " << link->first << " slot " << (int)chip->first
+             << " has " << chip->second.size() << " points instead of " << x.size() << ", not fitted");
+        continue;
+      }
+      for (auto point = chip->second.begin(); point != chip->second.end(); ++point)
+        hits.push_back(*point & 0xffffff);
+      chips.push_back(std::make_pair(link->first, chip->first));
+    }
+  }
+  if (chips.empty())
+    return;
+
+  std::shared_ptr<GEMSCurveFitter> fitter = getSCurveFitter();
+  std::vector<GEMSCurveFitter::SCurveFit> fits;
+  fitter->fitAll(x, hits, nTriggers, fits);
+  INFO("GEMTBUtil::fitFirmwareScanResults " << scanName << ": " << fitter->getStatistics());
+
+  std::string fileName = scanFileName(scanName+"_FW_fits");
+  std::ofstream outf(fileName.c_str());
+  outf << "# link slot threshold noise amplitude chi2 ndf status" << std::endl;
+  for (size_t c = 0; c < chips.size(); ++c)
+    outf << chips[c].first << " " << (int)chips[c].second << " "
+         << fits[c].threshold << " " << fits[c].noise << " " << fits[c].amplitude << " "
+         << fits[c].chi2 << " " << fits[c].ndf << " "
+         << GEMSCurveFitter::statusName(fits[c].status) << std::endl;
+  outf.close();
+  INFO("GEMTBUtil::fitFirmwareScanResults wrote " << scanName << " fits to " << fileName);
+}
+
+bool gem::supervisor::tbutils::GEMTBUtil::trimChannelThresholds(std::string const& scanName, uint8_t const& minVT1,
+                                                               uint8_t const& maxVT1, uint8_t const& step)
+{
+  GEMTrimDACCalibration::TrimConfig config;
+  // the threshold is linear in the TrimDAC, the two ends of the range give the line with the fewest scans
+  config.trimPoints.push_back(0x0);
+  config.trimPoints.push_back(GEMTrimDACCalibration::MAX_TRIMDAC);
+  config.min        = minVT1;
+  config.max        = maxVT1;
+  config.step       = step;
+  config.nTriggers  = nTriggers_;
+  config.timeoutSec = FW_SCAN_TIMEOUT_SEC;
+  config.target     = confParams_.bag.trimTarget.value_;
+  config.tolerance  = 1.;
+
+  GEMTrimDACCalibration trimming(optohybridDevice_, vfatDevice_, getSCurveFitter());
+  if (!trimming.run(config)) {
+    ERROR("GEMTBUtil::trimChannelThresholds trimming failed, the previous TrimDACs were restored");
+    return false;
+  }
+
+  std::string fileName = scanFileName(scanName+"_trim");
+  trimming.writeResults(fileName);
+  INFO("GEMTBUtil::trimChannelThresholds wrote the TrimDAC settings to " << fileName);
+  return true;
+}
+
+std::shared_ptr<gem::supervisor::tbutils::GEMSCurveFitter> gem::supervisor::tbutils::GEMTBUtil::getSCurveFitter()
+{
+  if (!p_sCurveFitter)
+    p_sCurveFitter = std::shared_ptr<GEMSCurveFitter>(
+      new GEMSCurveFitter(toolbox::toString("GEMTBUtil:lid%d", getApplicationDescriptor()->getLocalId())));
+  return p_sCurveFitter;
+}
+
+std::string gem::supervisor::tbutils::GEMTBUtil::scanFileName(std::string const& prefix) const
+{
+  time_t now  = time(0);
+  tm    *gmtm = gmtime(&now);
+  char* utcTime = asctime(gmtm);
+  std::string fileName = prefix+"_";
+  fileName.append(utcTime);
+  fileName.erase(std::remove(fileName.begin(), fileName.end(), '\n'), fileName.end());
+  fileName.append(".dat");
+  std::replace(fileName.begin(), fileName.end(), ' ', '_' );
+  std::replace(fileName.begin(), fileName.end(), ':', '-');
+  return fileName;
+}
+
+void gem::supervisor::tbutils::GEMTBUtil::setupScanOrchestrator(std::string const& connectionURI)
+{
+  if (!p_scanOrchestrator)
+    p_scanOrchestrator = std::shared_ptr<GEMScanOrchestrator>(
+      new GEMScanOrchestrator(toolbox::toString("GEMTBUtil:lid%d", getApplicationDescriptor()->getLocalId())));
+
+  m_linkChips.clear();
+  std::vector<gem::hw::GEMHwDevice::linkStatus> const& activeLinks = glibDevice_->getActiveLinks();
+  for (auto gtx = activeLinks.begin(); gtx != activeLinks.end(); ++gtx) {
+    int link = gtx->first;
+    if (link == confParams_.bag.ohGTXLink.value_) {
+      uint32_t chipMask = gem::hw::optohybrid::ALL_VFATS_DATA_MASK;
+      for (auto chip = vfatDevice_.begin(); chip != vfatDevice_.end(); ++chip)
+        chipMask &= ~(0x1 << (*chip)->getSlot());
+      p_scanOrchestrator->addLink(link, optohybridDevice_, chipMask);
+      continue;
+    }
+
+    if (!confParams_.bag.scanAllLinks)
+      continue;
+
+    // each link gets its own devices, so the links do not serialize on a single hardware lock
+    std::string addressTable = "file://${GEM_ADDRESS_TABLE_PATH}/glib_address_table.xml";
+    optohybrid_shared_ptr optohybrid(new gem::hw::optohybrid::HwOptoHybrid(toolbox::toString("OptoHybrid%02d", link),
+                                                                           connectionURI, addressTable, link));
+    if (!optohybrid->isHwConnected()) {
+      DEBUG("GEMTBUtil::setupScanOrchestrator no OptoHybrid on link " << link);
+      continue;
+    }
+
+    uint32_t chipMask = optohybrid->getConnectedVFATMask();
+    for (int slot = 0; slot < 24; ++slot) {
+      if ((chipMask >> slot) & 0x1)
+        continue;
+      std::string vfat = toolbox::toString("VFAT%d", slot);
+      vfat_shared_ptr chip(new gem::hw::vfat::HwVFAT2(vfat, connectionURI, addressTable));
+      chip->setDeviceBaseNode(toolbox::toString("GLIB.OptoHybrid_%d.OptoHybrid.GEB.VFATS.%s", link, vfat.c_str()));
+      m_linkChips[link].push_back(chip);
+    }
+    p_scanOrchestrator->addLink(link, optohybrid, chipMask);
+  }
+  INFO("GEMTBUtil::setupScanOrchestrator scans will run on " << p_scanOrchestrator->getNLinks() << " links");
+}
@@ -0,0 +1,262 @@
+/**
+ * class: GEMTrimDACCalibration
+ * description: Per channel TrimDAC alignment of all VFATs on an OptoHybrid
+ */
+
+#include <math.h>
+
+#include <algorithm>
+#include <fstream>
+
+#include "gem/supervisor/tbutils/GEMTrimDACCalibration.h"
+
+#include "gem/hw/optohybrid/HwOptoHybrid.h"
+#include "gem/hw/vfat/HwVFAT2.h"
+
+#include "gem/utils/GEMLogging.h"
+
+#include "xcept/Exception.h"
+
+const unsigned gem::supervisor::tbutils::GEMTrimDACCalibration::N_CHANNELS;
+const uint8_t  gem::supervisor::tbutils::GEMTrimDACCalibration::MAX_TRIMDAC;
+
+gem::supervisor::tbutils::GEMTrimDACCalibration::GEMTrimDACCalibration(
+  std::shared_ptr<gem::hw::optohybrid::HwOptoHybrid> optohybrid,
+  std::vector<std::shared_ptr<gem::hw::vfat::HwVFAT2> > const& chips,
+  std::shared_ptr<GEMSCurveFitter> fitter) :
+  m_gemLogger(log4cplus::Logger::getInstance("GEMTrimDACCalibration")),
+  p_optohybrid(optohybrid),
+  m_chips(chips),
+  p_fitter(fitter),
+  m_vfatMask(gem::hw::optohybrid::ALL_VFATS_DATA_MASK)
+{
+  for (auto chip = m_chips.begin(); chip != m_chips.end(); ++chip)
+    m_vfatMask &= ~(0x1 << (*chip)->getSlot());
+}
+
+bool gem::supervisor::tbutils::GEMTrimDACCalibration::run(TrimConfig const& config)
+{
+  m_results.clear();
+  if (m_chips.empty() || config.trimPoints.size() < 2) {
+    ERROR("GEMTrimDACCalibration::run needs at least one chip and two trim points, have "
+          << m_chips.size() << " chips and " << config.trimPoints.size() << " trim points");
+    return false;
+  }
+
+  std::vector<uint8_t> trimPoints(config.trimPoints);
+  std::sort(trimPoints.begin(), trimPoints.end());
+  for (auto trim = trimPoints.begin(); trim != trimPoints.end(); ++trim)
+    if (*trim > MAX_TRIMDAC) {
+      ERROR("GEMTrimDACCalibration::run trim point " << (int)*trim << " above " << (int)MAX_TRIMDAC);
+      return false;
+    }
+
+  // put the chips back the way they were if anything goes wrong, nothing is touched if they can't be read
+  m_savedTrimDACs.assign(m_chips.size(), std::vector<uint8_t>());
+  for (size_t c = 0; c < m_chips.size(); ++c)
+    if (!m_chips[c]->getChannelTrimDACs(m_savedTrimDACs[c])) {
+      ERROR("GEMTrimDACCalibration::run unable to read the TrimDACs of slot " << (int)m_chips[c]->getSlot()
+            << ", not trimming");
+      m_savedTrimDACs.clear();
+      return false;
+    }
+
+  // thresholds of every channel at every trim point
+  size_t nTrims = trimPoints.size();
+  std::vector<std::vector<double> > thresholds(nTrims);
+  std::vector<std::vector<GEMSCurveFitter::FitStatus> > status(nTrims);
+  for (size_t t = 0; t < nTrims; ++t) {
+    INFO("GEMTrimDACCalibration::run scanning all channels at TrimDAC " << (int)trimPoints[t]);
+    if (!setAllTrimDACs(trimPoints[t]) || !scanThresholds(config, thresholds[t], status[t])) {
+      restoreTrimDACs();
+      return false;
+    }
+  }
+
+  for (size_t c = 0; c < m_chips.size(); ++c) {
+    ChipTrim chip;
+    chip.slot         = m_chips[c]->getSlot();
+    chip.nFailed      = 0;
+    chip.nInTolerance = 0;
+    chip.rmsBefore    = 0.;
+    chip.rmsAfter     = 0.;
+    chip.trimDAC.assign(m_savedTrimDACs[c].begin(), m_savedTrimDACs[c].end());
+    chip.trimDAC.resize(N_CHANNELS, MAX_TRIMDAC/2);
+    chip.before.assign(N_CHANNELS, -1.);
+
+    // the threshold moves linearly with the TrimDAC, fit a straight line through the good points
+    std::vector<double> slopes(N_CHANNELS, 0.), offsets(N_CHANNELS, 0.);
+    std::vector<bool>   good(N_CHANNELS, false);
+    for (unsigned ch = 0; ch < N_CHANNELS; ++ch) {
+      size_t index = c*N_CHANNELS + ch;
+      double n = 0., sx = 0., sy = 0., sxx = 0., sxy = 0.;
+      for (size_t t = 0; t < nTrims; ++t) {
+        if (status[t][index] != GEMSCurveFitter::FIT_OK)
+          continue;
+        n   += 1.;
+        sx  += trimPoints[t];
+        sy  += thresholds[t][index];
+        sxx += trimPoints[t]*trimPoints[t];
+        sxy += trimPoints[t]*thresholds[t][index];
+      }
+      double denom = n*sxx - sx*sx;
+      double slope = denom != 0. ? (n*sxy - sx*sy)/denom : 0.;
+      if (n < 2 || fabs(slope) < 1e-6) {
+        ++chip.nFailed;
+        continue;
+      }
+      slopes[ch]  = slope;
+      offsets[ch] = (sy - slope*sx)/n;
+      good[ch]    = true;
+      chip.before[ch] = offsets[ch] + slopes[ch]*chip.trimDAC[ch];
+    }
+
+    chip.target = config.target;
+    if (chip.target < 0) {
+      double sum = 0.;
+      unsigned n = 0;
+      for (unsigned ch = 0; ch < N_CHANNELS; ++ch)
+        if (good[ch]) {
+          sum += offsets[ch] + slopes[ch]*(MAX_TRIMDAC/2);
+          ++n;
+        }
+      chip.target = n ? sum/n : 0.;
+    }
+
+    double sumSq = 0.;
+    unsigned nBefore = 0;
+    for (unsigned ch = 0; ch < N_CHANNELS; ++ch) {
+      if (!good[ch])
+        continue;
+      sumSq += (chip.before[ch] - chip.target)*(chip.before[ch] - chip.target);
+      ++nBefore;
+      double trim = floor((chip.target - offsets[ch])/slopes[ch] + 0.5);
+      chip.trimDAC[ch] = static_cast<uint8_t>(std::min(std::max(trim, 0.), static_cast<double>(MAX_TRIMDAC)));
+    }
+    chip.rmsBefore = nBefore ? sqrt(sumSq/nBefore) : 0.;
+    m_results.push_back(chip);
+  }
+
+  bool written = true;
+  for (size_t c = 0; c < m_chips.size(); ++c)
+    written &= m_chips[c]->setChannelTrimDACs(m_results[c].trimDAC);
+
+  // verify with the new settings
+  std::vector<double> after;
+  std::vector<GEMSCurveFitter::FitStatus> afterStatus;
+  if (!written || !scanThresholds(config, after, afterStatus)) {
+    restoreTrimDACs();
+    return false;
+  }
+
+  for (size_t c = 0; c < m_chips.size(); ++c) {
+    ChipTrim& chip = m_results[c];
+    chip.after.assign(after.begin() + c*N_CHANNELS, after.begin() + (c+1)*N_CHANNELS);
+    double sumSq = 0.;
+    unsigned nAfter = 0;
+    for (unsigned ch = 0; ch < N_CHANNELS; ++ch) {
+      if (afterStatus[c*N_CHANNELS + ch] != GEMSCurveFitter::FIT_OK)
+        continue;
+      double diff = chip.after[ch] - chip.target;
+      sumSq += diff*diff;
+      ++nAfter;
+      if (fabs(diff) <= config.tolerance)
+        ++chip.nInTolerance;
+    }
+    chip.rmsAfter = nAfter ? sqrt(sumSq/nAfter) : 0.;
+    INFO("GEMTrimDACCalibration::run slot " << (int)chip.slot << " target " << chip.target
+         << ", RMS " << chip.rmsBefore << " -> " << chip.rmsAfter << ", "
+         << chip.nInTolerance << "/" << N_CHANNELS << " channels within " << config.tolerance
+         << ", " << chip.nFailed << " channels not trimmed");
+  }
+  return true;
+}
+
+bool gem::supervisor::tbutils::GEMTrimDACCalibration::scanThresholds(TrimConfig const& config,
+                                                                     std::vector<double>& thresholds,
+                                                                     std::vector<GEMSCurveFitter::FitStatus>& status)
+{
+  uint32_t nPoints = gem::hw::optohybrid::HwOptoHybrid::getScanPoints(config.min, config.max, config.step);
+  std::vector<double> x;
+  for (uint32_t point = 0; point < nPoints; ++point)
+    x.push_back(config.min + point*config.step);
+
+  GEMScanOrchestrator::ScanConfig scan;
+  scan.mode       = 0x1;  // threshold scan per channel
+  scan.min        = config.min;
+  scan.max        = config.max;
+  scan.step       = config.step;
+  scan.nTriggers  = config.nTriggers;
+  scan.timeoutSec = config.timeoutSec;
+
+  // the curves are only fitted once all channels have been scanned
+  std::vector<uint32_t> hits(m_chips.size()*N_CHANNELS*nPoints, 0);
+  for (unsigned ch = 0; ch < N_CHANNELS; ++ch) {
+    scan.channel = ch;
+    GEMScanOrchestrator::ChipResults results;
+    bool scanned = false;
+    try {
+      scanned = GEMScanOrchestrator::runLinkScan(*p_optohybrid, m_vfatMask, scan, results);
+    } catch (xcept::Exception& e) {
+      ERROR("GEMTrimDACCalibration::scanThresholds unable to read the results of channel " << ch << ": " << e.what());
+    } catch (std::exception& e) {
+      ERROR("GEMTrimDACCalibration::scanThresholds unable to read the results of channel " << ch << ": " << e.what());
+    }
+    if (!scanned) {
+      ERROR("GEMTrimDACCalibration::scanThresholds scan of channel " << ch << " failed");
+      return false;
+    }
+    for (size_t c = 0; c < m_chips.size(); ++c) {
+      auto chip = results.find(m_chips[c]->getSlot());
+      if (chip == results.end() || chip->second.size() != nPoints)
+        continue;
+      uint32_t* curve = &hits[(c*N_CHANNELS + ch)*nPoints];
+      for (uint32_t point = 0; point < nPoints; ++point)
+        curve[point] = chip->second[point] & 0xffffff;
+    }
+  }
+
+  std::vector<GEMSCurveFitter::SCurveFit> fits;
+  p_fitter->fitAll(x, hits, config.nTriggers, fits);
+  DEBUG("GEMTrimDACCalibration::scanThresholds " << p_fitter->getStatistics());
+
+  thresholds.resize(fits.size());
+  status.resize(fits.size());
+  for (size_t i = 0; i < fits.size(); ++i) {
+    thresholds[i] = fits[i].threshold;
+    status[i]     = fits[i].status;
+  }
+  return true;
+}
+
+bool gem::supervisor::tbutils::GEMTrimDACCalibration::setAllTrimDACs(uint8_t const& trimDAC)
+{
+  std::vector<uint8_t> trimDACs(N_CHANNELS, trimDAC);
+  for (auto chip = m_chips.begin(); chip != m_chips.end(); ++chip)
+    if (!(*chip)->setChannelTrimDACs(trimDACs)) {
+      ERROR("GEMTrimDACCalibration::setAllTrimDACs unable to set the TrimDACs of slot " << (int)(*chip)->getSlot());
+      return false;
+    }
+  return true;
+}
+
+void gem::supervisor::tbutils::GEMTrimDACCalibration::restoreTrimDACs()
+{
+  WARN("GEMTrimDACCalibration::restoreTrimDACs trimming failed, restoring the previous TrimDACs");
+  for (size_t c = 0; c < m_chips.size() && c < m_savedTrimDACs.size(); ++c)
+    if (!m_chips[c]->setChannelTrimDACs(m_savedTrimDACs[c]))
+      ERROR("GEMTrimDACCalibration::restoreTrimDACs unable to restore the TrimDACs of slot "
+            << (int)m_chips[c]->getSlot());
+}
+
+void gem::supervisor::tbutils::GEMTrimDACCalibration::writeResults(std::string const& fileName) const
+{
+  std::ofstream outf(fileName.c_str());
+  outf << "# slot channel trimDAC before after target" << std::endl;
+  for (auto chip = m_results.begin(); chip != m_results.end(); ++chip)
+    for (unsigned ch = 0; ch < N_CHANNELS; ++ch)
+      outf << (int)chip->slot << " " << ch << " " << (int)chip->trimDAC[ch] << " "
+           << chip->before[ch] << " " << (ch < chip->after.size() ? chip->after[ch] : -1.) << " "
+           << chip->target << std::endl;
+  outf.close();
+}
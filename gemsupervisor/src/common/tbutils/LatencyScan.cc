@@ -131,6 +131,26 @@ bool gem::supervisor::tbutils::LatencyScan::run(toolbox::task::WorkLoop* wl)
     return false;
   }
 
+  if (confParams_.bag.useFirmwareScan) {
+    // the whole latency range is scanned by the OptoHybrid, with CalPulse+L1A from the TTC
+    hw_semaphore_.take();
+    optohybridDevice_->setTrigSource(0x0);
+    enableTriggers();
+    glibDevice_->writeReg("GLIB.TTC.CONTROL.INHIBIT_L1A",0x0);
+
+    GEMScanOrchestrator::LinkResults results;
+    if (runFirmwareScan(0x2, minLatency_, std::min(0xff, maxLatency_), stepSize_, nTriggers_, results))
+      writeFirmwareScanResults("LatencyScan", results, "Latency");
+
+    disableTriggers();
+    glibDevice_->writeReg("GLIB.TTC.CONTROL.INHIBIT_L1A",0x1);
+    hw_semaphore_.give();
+
+    wl_->submit(stopSig_);
+    wl_semaphore_.give();
+    return false;
+  }
+
   hw_semaphore_.take();//take hw to set the trigger source, send L1A+Cal pulses,
 
   optohybridDevice_->setTrigSource(0x0);// trigger sources
@@ -227,7 +247,7 @@ bool gem::supervisor::tbutils::LatencyScan::run(toolbox::task::WorkLoop* wl)
 	optohybridDevice_->broadcastWrite("Latency",0xFF,0x0,false);
       }//end else
 
-      sleep(0.01);
+      usleep(10000);
 
       //uint32_t bufferDepth = 0;
       //bufferDepth = glibDevice_->getFIFOVFATBlockOccupancy(readout_mask);
@@ -239,12 +259,10 @@ bool gem::supervisor::tbutils::LatencyScan::run(toolbox::task::WorkLoop* wl)
       }
       while ((glibDevice_->readReg(glibDevice_->getDeviceBaseNode(),
                                     toolbox::toString("DAQ.GTX%d.STATUS.EVENT_FIFO_IS_EMPTY",
-                                                      confParams_.bag.ohGTXLink.value_))))
-	TRACE("waiting for FIFO is empty: "
-	      << glibDevice_->readReg(glibDevice_->getDeviceBaseNode(),
-                                      toolbox::toString("DAQ.GTX%d.STATUS.EVENT_FIFO_IS_EMPTY",
-                                                        confParams_.bag.ohGTXLink.value_))
-	      );
+                                                      confParams_.bag.ohGTXLink.value_)))) {
+	TRACE("waiting for FIFO is empty");
+	usleep(FIFO_POLL_USEC);
+      }
 
       glibDevice_->setDAQLinkRunParameter(1,currentLatency_);
 
@@ -101,6 +101,39 @@ bool gem::supervisor::tbutils::ThresholdScan::run(toolbox::task::WorkLoop* wl)
     return false;
   }
 
+  if (confParams_.bag.useFirmwareScan) {
+    // the whole VT1 range is scanned by the OptoHybrid, VT2 stays at the value set in startAction,
+    // the points are those the software scan steps through, from VT1 = maxThresh-minThresh
+    // down to the last VT1 with VT2-VT1 <= maxThresh
+    hw_semaphore_.take();
+    optohybridDevice_->setTrigSource(0x0);
+    enableTriggers();
+    glibDevice_->writeReg("GLIB.TTC.CONTROL.INHIBIT_L1A",0x0);
+
+    GEMScanOrchestrator::LinkResults results;
+    int     vt2    = std::max(0, maxThresh_);
+    uint8_t minVT1 = std::min(0xff, std::max(0, vt2-maxThresh_));
+    uint8_t maxVT1 = std::min(0xff, std::max(0, maxThresh_-minThresh_));
+    // a scan with untrimmed channels is not what was asked for, so a failed trimming aborts it
+    bool trimmed = !confParams_.bag.trimChannels.value_ ||
+      trimChannelThresholds("ThresholdScan", minVT1, maxVT1, stepSize_);
+    if (!trimmed)
+      ERROR("ThresholdScan::run channel trimming failed, not running the threshold scan");
+
+    if (trimmed && runFirmwareScan(0x0, minVT1, maxVT1, stepSize_, nTriggers_, results)) {
+      writeFirmwareScanResults("ThresholdScan", results, toolbox::toString("VT1 (VT2 = %d)", vt2));
+      fitFirmwareScanResults("ThresholdScan", results, nTriggers_);
+    }
+
+    disableTriggers();
+    glibDevice_->writeReg("GLIB.TTC.CONTROL.INHIBIT_L1A",0x1);
+    hw_semaphore_.give();
+
+    wl_->submit(stopSig_);
+    wl_semaphore_.give();
+    return false;
+  }
+
   //send triggers
   hw_semaphore_.take(); //take hw to send the trigger
 
@@ -183,7 +216,7 @@ bool gem::supervisor::tbutils::ThresholdScan::run(toolbox::task::WorkLoop* wl)
 	  (*chip)->setVThreshold1(0);
 	}
 
-      sleep(0.01);
+      usleep(10000);
 
       }// end else VT1 <stepsize
 
@@ -198,12 +231,10 @@ bool gem::supervisor::tbutils::ThresholdScan::run(toolbox::task::WorkLoop* wl)
 
       while ((glibDevice_->readReg(glibDevice_->getDeviceBaseNode(),
                                     toolbox::toString("DAQ.GTX%d.STATUS.EVENT_FIFO_IS_EMPTY",
-                                                      confParams_.bag.ohGTXLink.value_))))
-	TRACE("waiting for FIFO is empty: "
-	      << glibDevice_->readReg(glibDevice_->getDeviceBaseNode(),
-                                      toolbox::toString("DAQ.GTX%d.STATUS.EVENT_FIFO_IS_EMPTY",
-                                                        confParams_.bag.ohGTXLink.value_))
-	      );
+                                                      confParams_.bag.ohGTXLink.value_)))) {
+	TRACE("waiting for FIFO is empty");
+	usleep(FIFO_POLL_USEC);
+      }
 
       glibDevice_->setDAQLinkRunParameter(2,scanParams_.bag.deviceVT1);
       glibDevice_->setDAQLinkRunParameter(3,scanParams_.bag.deviceVT2);
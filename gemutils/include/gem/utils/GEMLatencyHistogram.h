@@ -0,0 +1,94 @@
+/** @file GEMLatencyHistogram.h */
+
+#ifndef GEM_UTILS_GEMLATENCYHISTOGRAM_H
+#define GEM_UTILS_GEMLATENCYHISTOGRAM_H
+
+#include <stdint.h>
+#include <time.h>
+
+#include <string>
+
+namespace gem {
+  namespace utils {
+
+    /**
+     * @class GEMLatencyHistogram
+     * @brief Fixed size log-linear (HDR style) histogram of latencies in microseconds
+     *
+     * Each power of two is split into 2^SUB_BUCKET_BITS linear sub-buckets, so any recorded
+     * value is known to within 1/2^SUB_BUCKET_BITS of its true value, from 1us up to ~71 minutes.
+     * Recording is a handful of integer operations and never allocates, no locking is done,
+     * callers are expected to protect the object (e.g., with the device lock)
+     */
+    class GEMLatencyHistogram
+    {
+    public:
+      static const unsigned SUB_BUCKET_BITS  = 3;
+      static const unsigned SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+      static const unsigned MAX_VALUE_BITS   = 32;
+      static const unsigned N_BUCKETS        = SUB_BUCKET_COUNT*(MAX_VALUE_BITS - SUB_BUCKET_BITS + 1);
+
+      GEMLatencyHistogram();
+
+      /**
+       * @brief add a single measurement to the histogram
+       * @param usec latency in microseconds, values beyond the range go into the last bucket
+       */
+      void record(uint64_t const& usec);
+
+      /**
+       * @brief add the contents of another histogram to this one
+       * @param other histogram to merge into this one
+       */
+      void merge(GEMLatencyHistogram const& other);
+
+      /**
+       * @brief clear all buckets and summary values
+       */
+      void reset();
+
+      uint64_t getCount() const { return m_count; };
+      uint64_t getMin()   const { return m_count ? m_min : 0; };
+      uint64_t getMax()   const { return m_max; };
+      uint64_t getSum()   const { return m_sum; };
+      double   getMean()  const { return m_count ? static_cast<double>(m_sum)/m_count : 0.; };
+
+      /**
+       * @param quantile fraction (0-1) of the recorded values that lie at or below the returned value
+       * @returns the highest value equivalent to the bucket containing the requested quantile,
+       *          capped at the maximum recorded value
+       */
+      uint64_t getQuantile(double const& quantile) const;
+
+      /**
+       * @returns a short human readable summary, e.g., for logging
+       */
+      std::string toString() const;
+
+      /**
+       * @returns the JSON object "{ "count":N, "mean":M, ..., "buckets":[[lower,count],...] }"
+       *          only non-empty buckets are written
+       */
+      std::string toJSON() const;
+
+      static unsigned bucketIndex(uint64_t const& usec);
+      static uint64_t bucketLowerEdge(unsigned const& index);
+      static uint64_t bucketUpperEdge(unsigned const& index);
+
+      /**
+       * @returns the number of microseconds elapsed between two CLOCK_MONOTONIC readings
+       */
+      static uint64_t elapsedMicroseconds(timespec const& start, timespec const& stop);
+
+    private:
+      uint64_t m_buckets[N_BUCKETS];
+      uint64_t m_count;
+      uint64_t m_sum;
+      uint64_t m_min;
+      uint64_t m_max;
+    };
+
+  }  // namespace gem::utils
+}  // namespace gem
+
+#endif  // GEM_UTILS_GEMLATENCYHISTOGRAM_H
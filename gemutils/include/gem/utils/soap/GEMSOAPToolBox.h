@@ -194,6 +194,84 @@ namespace gem {
                                                                 std::string const& appURN,
                                                                 bool const& isGEMApp);
 
+        /**
+         * @brief Pushes a state change of the source application to a supervising application
+         * @param stateName the new FSM state of the source application
+         * @param reason additional information about the state, e.g., the reason for a failure
+         * @param appCxt context in which the source/receiver applications are running
+         * @param srcDsc source application descriptor, identifies the application whose state changed
+         * @param destDsc destination application descriptor
+         * returns true if successful/completed
+         */
+        static bool sendStateNotification(std::string const& stateName,
+                                          std::string const& reason,
+                                          xdaq::ApplicationContext* appCxt,
+                                          xdaq::ApplicationDescriptor* srcDsc,
+                                          xdaq::ApplicationDescriptor* destDsc)
+          throw (gem::utils::exception::Exception);
+
+        /**
+         * @brief Extracts the content of a message created by sendStateNotification
+         * @param msg the received StateNotification message
+         * @param className is set to the class name of the application whose state changed
+         * @param instance is set to the instance number of the application whose state changed
+         * @param stateName is set to the new FSM state
+         * @param reason is set to the additional information about the state
+         */
+        static void extractStateNotification(xoap::MessageReference const& msg,
+                                             std::string& className,
+                                             uint32_t&    instance,
+                                             std::string& stateName,
+                                             std::string& reason);
+
+        /**
+         * @brief Sends an FSM command together with all the parameters it should be executed with,
+         *        so that the receiving application can apply them and fire the transition in a single transaction
+         * @param cmd FSM command to send to the application
+         * @param parameters vector of parameters, each contaning the parameter name, value, and the xsd type,
+         *        fields of a bag are named as <bag name>.<field name>
+         * @param appCxt context in which the source/receiver applications are running
+         * @param srcDsc source application descriptor
+         * @param destDsc destination application descriptor
+         * returns true if successful/completed
+         */
+        static bool sendCommandWithParameters(std::string const& cmd,
+                                              std::vector<std::vector<std::string> > const& parameters,
+                                              xdaq::ApplicationContext* appCxt,
+                                              xdaq::ApplicationDescriptor* srcDsc,
+                                              xdaq::ApplicationDescriptor* destDsc)
+          throw (gem::utils::exception::Exception);
+
+        /**
+         * @brief Extracts the content of a message created by sendCommandWithParameters
+         * @param msg the received TransitionWithParameters message
+         * @param parameters is filled with the name, value, and xsd type of each parameter in the message
+         * @returns the name of the FSM command
+         */
+        static std::string extractCommandWithParameters(xoap::MessageReference const& msg,
+                                                        std::vector<std::vector<std::string> >& parameters);
+
+        /**
+         * @brief Appends the fields of a bag to a parameter list for sendCommandWithParameters
+         * @param bagName name of the bag in the destination application info space
+         * @param bag the bag whose fields are appended
+         * @param parameters the parameter list to append to
+         */
+        template <typename T>
+          static void appendParameterBag(std::string const& bagName,
+                                         xdata::Bag<T> const& bag,
+                                         std::vector<std::vector<std::string> >& parameters)
+          {
+            for (auto b = bag.begin(); b != bag.end(); ++b) {
+              xdata::Serializable* s = bag.getField(b->first);
+              std::vector<std::string> parameter;
+              parameter.push_back(bagName+"."+b->first);
+              parameter.push_back(s->toString());
+              parameter.push_back(getXSDType(*s));
+              parameters.push_back(parameter);
+            }
+          }
+
         static void sendAMC13Config(xdaq::ApplicationContext* appCxt,
                                     xdaq::ApplicationDescriptor* src,
                                     xdaq::ApplicationDescriptor* dest);
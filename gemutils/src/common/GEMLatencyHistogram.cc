@@ -0,0 +1,142 @@
+#include <gem/utils/GEMLatencyHistogram.h>
+
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+gem::utils::GEMLatencyHistogram::GEMLatencyHistogram()
+{
+  reset();
+}
+
+unsigned gem::utils::GEMLatencyHistogram::bucketIndex(uint64_t const& usec)
+{
+  if (usec < SUB_BUCKET_COUNT)
+    return static_cast<unsigned>(usec);
+
+  unsigned msb = 63 - __builtin_clzll(usec);
+  if (msb >= MAX_VALUE_BITS)
+    return N_BUCKETS - 1;
+
+  // octave 1 starts at SUB_BUCKET_COUNT, each octave has SUB_BUCKET_COUNT linear bins
+  unsigned octave = msb - SUB_BUCKET_BITS + 1;
+  unsigned sub    = static_cast<unsigned>(usec >> (msb - SUB_BUCKET_BITS)) - SUB_BUCKET_COUNT;
+  return octave*SUB_BUCKET_COUNT + sub;
+}
+
+uint64_t gem::utils::GEMLatencyHistogram::bucketLowerEdge(unsigned const& index)
+{
+  if (index < SUB_BUCKET_COUNT)
+    return index;
+
+  unsigned octave = index / SUB_BUCKET_COUNT;
+  unsigned sub    = index % SUB_BUCKET_COUNT;
+  return static_cast<uint64_t>(SUB_BUCKET_COUNT + sub) << (octave - 1);
+}
+
+uint64_t gem::utils::GEMLatencyHistogram::bucketUpperEdge(unsigned const& index)
+{
+  if (index < SUB_BUCKET_COUNT)
+    return index;
+
+  unsigned octave = index / SUB_BUCKET_COUNT;
+  return bucketLowerEdge(index) + (static_cast<uint64_t>(1) << (octave - 1)) - 1;
+}
+
+uint64_t gem::utils::GEMLatencyHistogram::elapsedMicroseconds(timespec const& start, timespec const& stop)
+{
+  int64_t nsec = (static_cast<int64_t>(stop.tv_sec) - start.tv_sec)*1000000000LL
+    + (stop.tv_nsec - start.tv_nsec);
+  return nsec > 0 ? static_cast<uint64_t>(nsec)/1000 : 0;
+}
+
+void gem::utils::GEMLatencyHistogram::record(uint64_t const& usec)
+{
+  ++m_buckets[bucketIndex(usec)];
+  ++m_count;
+  m_sum += usec;
+  if (usec < m_min)
+    m_min = usec;
+  if (usec > m_max)
+    m_max = usec;
+}
+
+void gem::utils::GEMLatencyHistogram::merge(GEMLatencyHistogram const& other)
+{
+  for (unsigned bin = 0; bin < N_BUCKETS; ++bin)
+    m_buckets[bin] += other.m_buckets[bin];
+  m_count += other.m_count;
+  m_sum   += other.m_sum;
+  if (other.m_min < m_min)
+    m_min = other.m_min;
+  if (other.m_max > m_max)
+    m_max = other.m_max;
+}
+
+void gem::utils::GEMLatencyHistogram::reset()
+{
+  std::memset(m_buckets, 0, sizeof(m_buckets));
+  m_count = 0;
+  m_sum   = 0;
+  m_min   = ~static_cast<uint64_t>(0);
+  m_max   = 0;
+}
+
+uint64_t gem::utils::GEMLatencyHistogram::getQuantile(double const& quantile) const
+{
+  if (m_count == 0)
+    return 0;
+
+  double   q      = quantile < 0. ? 0. : (quantile > 1. ? 1. : quantile);
+  uint64_t target = static_cast<uint64_t>(q*m_count + 0.5);
+  if (target < 1)
+    target = 1;
+
+  uint64_t seen = 0;
+  for (unsigned bin = 0; bin < N_BUCKETS; ++bin) {
+    seen += m_buckets[bin];
+    if (seen >= target) {
+      uint64_t edge = bucketUpperEdge(bin);
+      return edge < m_max ? edge : m_max;
+    }
+  }
+  return m_max;
+}
+
+std::string gem::utils::GEMLatencyHistogram::toString() const
+{
+  std::stringstream res;
+  res << "n="     << getCount()
+      << " mean=" << std::fixed << std::setprecision(1) << getMean() << "us"
+      << " min="  << getMin()              << "us"
+      << " p50="  << getQuantile(0.50)     << "us"
+      << " p90="  << getQuantile(0.90)     << "us"
+      << " p99="  << getQuantile(0.99)     << "us"
+      << " max="  << getMax()              << "us";
+  return res.str();
+}
+
+std::string gem::utils::GEMLatencyHistogram::toJSON() const
+{
+  std::stringstream res;
+  res << "{ \"count\":" << getCount()
+      << ",\"mean\":"   << std::fixed << std::setprecision(1) << getMean()
+      << ",\"min\":"    << getMin()
+      << ",\"p50\":"    << getQuantile(0.50)
+      << ",\"p90\":"    << getQuantile(0.90)
+      << ",\"p99\":"    << getQuantile(0.99)
+      << ",\"p999\":"   << getQuantile(0.999)
+      << ",\"max\":"    << getMax()
+      << ",\"buckets\":[";
+  bool first = true;
+  for (unsigned bin = 0; bin < N_BUCKETS; ++bin) {
+    if (!m_buckets[bin])
+      continue;
+    if (!first)
+      res << ",";
+    res << "[" << bucketLowerEdge(bin) << "," << m_buckets[bin] << "]";
+    first = false;
+  }
+  res << "] }";
+  return res.str();
+}
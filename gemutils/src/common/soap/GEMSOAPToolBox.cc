@@ -1,3 +1,5 @@
+#include <cstdlib>
+
 #include <gem/utils/soap/GEMSOAPToolBox.h>
 
 xoap::MessageReference gem::utils::soap::GEMSOAPToolBox::makeSOAPReply(std::string const& command,
@@ -350,6 +352,152 @@ bool gem::utils::soap::GEMSOAPToolBox::sendApplicationParameter(std::string cons
 //   return true;
 // }
 
+bool gem::utils::soap::GEMSOAPToolBox::sendStateNotification(std::string const& stateName,
+                                                             std::string const& reason,
+                                                             xdaq::ApplicationContext* appCxt,
+                                                             xdaq::ApplicationDescriptor* srcDsc,
+                                                             xdaq::ApplicationDescriptor* destDsc)
+  throw (gem::utils::exception::Exception)
+{
+  log4cplus::Logger m_gemLogger(log4cplus::Logger::getInstance("GEMSOAPToolBoxLogger"));
+  try {
+    xoap::MessageReference msg = xoap::createMessage();
+
+    xoap::SOAPEnvelope env       = msg->getSOAPPart().getEnvelope();
+    xoap::SOAPName     soapcmd   = env.createName("StateNotification", "xdaq", XDAQ_NS_URI);
+    xoap::SOAPElement  container = env.getBody().addBodyElement(soapcmd);
+
+    container.addChildElement(env.createName("ClassName", "xdaq", XDAQ_NS_URI)).addTextNode(srcDsc->getClassName());
+    container.addChildElement(env.createName("Instance",  "xdaq", XDAQ_NS_URI)).addTextNode(
+      toolbox::toString("%d", srcDsc->getInstance()));
+    container.addChildElement(env.createName("StateName", "xdaq", XDAQ_NS_URI)).addTextNode(stateName);
+    container.addChildElement(env.createName("Reason",    "xdaq", XDAQ_NS_URI)).addTextNode(reason);
+
+    xoap::MessageReference response = appCxt->postSOAP(msg, *srcDsc, *destDsc);
+  } catch (xcept::Exception& e) {
+    XCEPT_RETHROW(gem::utils::exception::SOAPException,
+                  toolbox::toString("State notification %s failed [%s]", stateName.c_str(), e.what()), e);
+  } catch (std::exception& e) {
+    XCEPT_RAISE(gem::utils::exception::SOAPException,
+                toolbox::toString("State notification %s failed [%s]", stateName.c_str(), e.what()));
+  } catch (...) {
+    XCEPT_RAISE(gem::utils::exception::SOAPException,
+                toolbox::toString("State notification %s failed", stateName.c_str()));
+  }
+  return true;
+}
+
+void gem::utils::soap::GEMSOAPToolBox::extractStateNotification(xoap::MessageReference const& msg,
+                                                                std::string& className,
+                                                                uint32_t&    instance,
+                                                                std::string& stateName,
+                                                                std::string& reason)
+{
+  xoap::SOAPEnvelope env = msg->getSOAPPart().getEnvelope();
+  std::vector<xoap::SOAPElement> body = env.getBody().getChildElements();
+  if (body.size() != 1) {
+    XCEPT_RAISE(xoap::exception::Exception,
+                toolbox::toString("Expected exactly one element "
+                                  "in StateNotification SOAP message, "
+                                  "but found %d.", body.size()));
+  }
+
+  std::vector<xoap::SOAPElement> fields;
+  fields = body[0].getChildElements(env.createName("ClassName", "xdaq", XDAQ_NS_URI));
+  className = fields.size() == 1 ? fields[0].getValue() : "";
+  fields = body[0].getChildElements(env.createName("Instance",  "xdaq", XDAQ_NS_URI));
+  instance  = fields.size() == 1 ? strtoul(fields[0].getValue().c_str(), NULL, 10) : 0;
+  fields = body[0].getChildElements(env.createName("StateName", "xdaq", XDAQ_NS_URI));
+  stateName = fields.size() == 1 ? fields[0].getValue() : "";
+  fields = body[0].getChildElements(env.createName("Reason",    "xdaq", XDAQ_NS_URI));
+  reason    = fields.size() == 1 ? fields[0].getValue() : "";
+
+  if (className.empty() || stateName.empty())
+    XCEPT_RAISE(xoap::exception::Exception, "Incomplete StateNotification SOAP message");
+}
+
+bool gem::utils::soap::GEMSOAPToolBox::sendCommandWithParameters(std::string const& cmd,
+                                                                 std::vector<std::vector<std::string> > const& parameters,
+                                                                 xdaq::ApplicationContext* appCxt,
+                                                                 xdaq::ApplicationDescriptor* srcDsc,
+                                                                 xdaq::ApplicationDescriptor* destDsc)
+  throw (gem::utils::exception::Exception)
+{
+  log4cplus::Logger m_gemLogger(log4cplus::Logger::getInstance("GEMSOAPToolBoxLogger"));
+  try {
+    xoap::MessageReference msg = xoap::createMessage();
+
+    xoap::SOAPEnvelope env       = msg->getSOAPPart().getEnvelope();
+    xoap::SOAPName     soapcmd   = env.createName("TransitionWithParameters", "xdaq", XDAQ_NS_URI);
+    xoap::SOAPElement  container = env.getBody().addBodyElement(soapcmd);
+    container.addNamespaceDeclaration("xsd", "http://www.w3.org/2001/XMLSchema");
+    container.addNamespaceDeclaration("xsi", "http://www.w3.org/2001/XMLSchema-instance");
+    xoap::SOAPName tname = env.createName("type", "xsi", "http://www.w3.org/2001/XMLSchema-instance");
+    xoap::SOAPName pname = env.createName("name", "xdaq", XDAQ_NS_URI);
+
+    container.addChildElement(env.createName("Command", "xdaq", XDAQ_NS_URI)).addTextNode(cmd);
+    for (auto p = parameters.begin(); p != parameters.end(); ++p) {
+      if (p->size() != 3)
+        XCEPT_RAISE(gem::utils::exception::SOAPException,
+                    toolbox::toString("Malformed parameter (%d fields) for command %s", p->size(), cmd.c_str()));
+      xoap::SOAPElement par = container.addChildElement(env.createName("Parameter", "xdaq", XDAQ_NS_URI));
+      par.addAttribute(pname, p->at(0));
+      par.addAttribute(tname, p->at(2));
+      par.addTextNode(p->at(1));
+    }
+
+    xoap::MessageReference response = appCxt->postSOAP(msg, *srcDsc, *destDsc);
+  } catch (gem::utils::exception::Exception&) {
+    throw;
+  } catch (xcept::Exception& e) {
+    XCEPT_RETHROW(gem::utils::exception::SOAPException,
+                  toolbox::toString("Command %s with parameters failed [%s]", cmd.c_str(), e.what()), e);
+  } catch (std::exception& e) {
+    XCEPT_RAISE(gem::utils::exception::SOAPException,
+                toolbox::toString("Command %s with parameters failed [%s]", cmd.c_str(), e.what()));
+  } catch (...) {
+    XCEPT_RAISE(gem::utils::exception::SOAPException,
+                toolbox::toString("Command %s with parameters failed", cmd.c_str()));
+  }
+  return true;
+}
+
+std::string gem::utils::soap::GEMSOAPToolBox::extractCommandWithParameters(xoap::MessageReference const& msg,
+                                                                           std::vector<std::vector<std::string> >& parameters)
+{
+  xoap::SOAPEnvelope env = msg->getSOAPPart().getEnvelope();
+  std::vector<xoap::SOAPElement> body = env.getBody().getChildElements();
+  if (body.size() != 1) {
+    XCEPT_RAISE(xoap::exception::Exception,
+                toolbox::toString("Expected exactly one element "
+                                  "in TransitionWithParameters SOAP message, "
+                                  "but found %d.", body.size()));
+  }
+
+  std::vector<xoap::SOAPElement> fields;
+  fields = body[0].getChildElements(env.createName("Command", "xdaq", XDAQ_NS_URI));
+  if (fields.size() != 1 || fields[0].getValue().empty())
+    XCEPT_RAISE(xoap::exception::Exception, "No command in TransitionWithParameters SOAP message");
+  std::string commandName = fields[0].getValue();
+
+  xoap::SOAPName tname = env.createName("type", "xsi", "http://www.w3.org/2001/XMLSchema-instance");
+  xoap::SOAPName pname = env.createName("name", "xdaq", XDAQ_NS_URI);
+  parameters.clear();
+  fields = body[0].getChildElements(env.createName("Parameter", "xdaq", XDAQ_NS_URI));
+  for (auto f = fields.begin(); f != fields.end(); ++f) {
+    std::vector<std::string> parameter;
+    parameter.push_back(f->getAttributeValue(pname));
+    parameter.push_back(f->getValue());
+    parameter.push_back(f->getAttributeValue(tname));
+    if (parameter.at(0).empty())
+      XCEPT_RAISE(xoap::exception::Exception,
+                  toolbox::toString("Unnamed parameter in TransitionWithParameters SOAP message for %s",
+                                    commandName.c_str()));
+    parameters.push_back(parameter);
+  }
+  return commandName;
+}
+
 xoap::MessageReference gem::utils::soap::GEMSOAPToolBox::createStateRequestMessage(std::string const& nstag,
                                                                                    std::string const& appURN,
                                                                                    bool const& isGEMApp)